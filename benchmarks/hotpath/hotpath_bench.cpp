@@ -0,0 +1,470 @@
+/**
+ * Thread scaling microbenchmark of the library's own hot path.
+ *
+ * The library sources are linked into this binary. After construct() has
+ * run, the shim's real_* pointers of reads, readahead and fadvise are
+ * redirected to stubs that do no I/O, so only the bookkeeping is timed.
+ * open, fstat, dup and close stay real: the files are sparse files in -d.
+ * The binary is built with DISABLE_CONCURRENT_EVICTION, so only the evict
+ * op evicts, and with LOCK_HOLD_STATS for the lock hold times.
+ *
+ * For 1, 2, 4 .. -T threads every op runs for -t ms:
+ *   pfd            get_perfd_struct_fast of a random fd
+ *   handle_read    handle_read of a random 4K of a random fd
+ *   heap_update    heap_update (pvt and global heap) of a random portion
+ *   pvt_heap       update_pvt_heap of a random portion
+ *   add_fd         add_fd_to_inode then remove_fd_from_fdlist of a dup fd
+ *   evict          the threads do handle_read while one more thread calls
+ *                  evict_portions for a portion at a time; its ns/op is
+ *                  reported in the evict_ns column
+ *
+ * Per op and thread count it prints ns/op (wall time * threads / ops),
+ * total Mops/s, scaling efficiency (Mops/s / (threads * Mops/s at 1
+ * thread)) and the p50/p99 hold times in ns of the i_map shard locks,
+ * unlinked_lock, file_heap_lock and g_heap_lock. Hold times come from
+ * pow2 bins, so they are the upper bound of the bin.
+ *
+ * hotpath_bench [-d dir] [-f files] [-F fds_per_file] [-p portions_per_file]
+ *               [-T max_threads] [-t ms] [-o op]
+ *
+ * Build and run: make run
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "inode.hpp"
+#include "prefetch_evict.hpp"
+#include "utils/latency_tracking/latency_tracking.hpp"
+
+#ifndef LOCK_HOLD_STATS
+#error "build with -DLOCK_HOLD_STATS, see the Makefile"
+#endif
+
+#define BENCH_READ_SIZE 4096
+#define PORTION_SIZE (1UL << (PAGE_SHIFT + PVT_HEAP_PG_ORDER))
+
+/*
+ * The shim's function pointers, see utils/shim/shim.cpp.
+ * Global variable names are not mangled with their type.
+ */
+extern ssize_t (*pread_ptr)(int, void *, size_t, off_t);
+extern ssize_t (*pread64_ptr)(int, void *, size_t, off64_t);
+extern ssize_t (*read_ptr)(int, void *, size_t);
+extern ssize_t (*preadv_ptr)(int, const struct iovec *, int, off_t);
+extern ssize_t (*preadv2_ptr)(int, const struct iovec *, int, off_t, int);
+extern ssize_t (*readahead_ptr)(int, off64_t, size_t);
+extern int (*posix_fadvise_ptr)(int, off_t, off_t, int);
+extern int (*posix_fadvise64_ptr)(int, off_t, off_t, int);
+extern int (*fadvise_ptr)(int, off_t, off_t, int);
+extern int (*fadvise64_ptr)(int, off_t, off_t, int);
+
+static std::atomic<unsigned long> nr_fadvise(0);
+
+static ssize_t stub_pread(int fd, void *data, size_t size, off_t offset){
+        return size;
+}
+
+static ssize_t stub_pread64(int fd, void *data, size_t size, off64_t offset){
+        return size;
+}
+
+static ssize_t stub_read(int fd, void *data, size_t size){
+        return size;
+}
+
+static ssize_t stub_preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset){
+        ssize_t ret = 0;
+
+        for(int i = 0; i < iovcnt; i++){
+                ret += iov[i].iov_len;
+        }
+        return ret;
+}
+
+static ssize_t stub_preadv2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags){
+        return stub_preadv(fd, iov, iovcnt, offset);
+}
+
+static ssize_t stub_readahead(int fd, off64_t offset, size_t count){
+        return 0;
+}
+
+static int stub_fadvise(int fd, off_t offset, off_t len, int advice){
+        nr_fadvise.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+}
+
+static void stub_shim_functions(){
+        pread_ptr = stub_pread;
+        pread64_ptr = stub_pread64;
+        read_ptr = stub_read;
+        preadv_ptr = stub_preadv;
+        preadv2_ptr = stub_preadv2;
+        readahead_ptr = stub_readahead;
+        posix_fadvise_ptr = stub_fadvise;
+        posix_fadvise64_ptr = stub_fadvise;
+        fadvise_ptr = stub_fadvise;
+        fadvise64_ptr = stub_fadvise;
+}
+
+struct bench_file {
+        std::string path;
+        struct inode *uinode;
+        std::vector<int> fds;
+};
+
+enum bench_op {
+        OP_PFD,
+        OP_HANDLE_READ,
+        OP_HEAP_UPDATE,
+        OP_PVT_HEAP,
+        OP_ADD_FD,
+        OP_EVICT,
+        NR_OPS
+};
+
+static const char *op_names[NR_OPS] = {
+        "pfd", "handle_read", "heap_update", "pvt_heap", "add_fd", "evict"
+};
+
+static struct lat_tracker *lock_trackers[] = {
+        &imap_shard_lock_hold, &unlinked_lock_hold, &file_heap_lock_hold, &g_heap_lock_hold
+};
+#define NR_LOCKS (sizeof(lock_trackers) / sizeof(lock_trackers[0]))
+
+static std::vector<struct bench_file> files;
+static std::vector<int> all_fds;
+static std::vector<struct bench_file *> fd_files;
+static unsigned long nr_portions = 64;
+
+static std::atomic<bool> bench_go(false);
+static std::atomic<bool> bench_stop(false);
+
+static inline uint64_t xorshift(uint64_t *s){
+        *s ^= *s << 13;
+        *s ^= *s >> 7;
+        *s ^= *s << 17;
+        return *s;
+}
+
+static inline uint64_t now_ns(){
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*Creates nr_files sparse Data.db files and opens each nr_fds times through the library*/
+static int setup_files(const char *dir, int nr_files, int nr_fds){
+        char path[PATH_MAX];
+        int fd;
+
+        if(mkdir(dir, 0755) && errno != EEXIST){
+                fprintf(stderr, "mkdir %s: %s\n", dir, strerror(errno));
+                return -1;
+        }
+
+        files.resize(nr_files);
+        for(int i = 0; i < nr_files; i++){
+                snprintf(path, sizeof(path), "%s/nb-%d-big-Data.db", dir, i + 1);
+                files[i].path = path;
+
+                /*raw syscalls, the library does not see the setup*/
+                fd = syscall(SYS_openat, AT_FDCWD, path, O_CREAT | O_RDWR, 0644);
+                if(fd < 0 || syscall(SYS_ftruncate, fd, (long)(nr_portions * PORTION_SIZE))){
+                        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+                        return -1;
+                }
+                syscall(SYS_close, fd);
+
+                for(int j = 0; j < nr_fds; j++){
+                        fd = open(path, O_RDONLY);
+                        if(fd < 0){
+                                fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+                                return -1;
+                        }
+                        files[i].fds.push_back(fd);
+                        all_fds.push_back(fd);
+                        fd_files.push_back(&files[i]);
+                }
+
+                auto pfd = get_perfd_struct_fast(files[i].fds[0]);
+                if(!pfd || !pfd->uinode){
+                        fprintf(stderr, "%s is not tracked, is it whitelisted?\n", path);
+                        return -1;
+                }
+                files[i].uinode = pfd->uinode;
+        }
+        return 0;
+}
+
+static void cleanup_files(){
+        for(auto &f : files){
+                for(int fd : f.fds){
+                        close(fd);
+                }
+                syscall(SYS_unlinkat, AT_FDCWD, f.path.c_str(), 0);
+        }
+}
+
+/*runs op till bench_stop, returns the nr of ops done*/
+static unsigned long run_op(enum bench_op op, uint64_t seed){
+        unsigned long nr = 0;
+        uint64_t r;
+        size_t idx;
+        off_t offset;
+        off_t seek_head;
+        struct inode *uinode;
+        int fd;
+
+        while(!bench_go.load(std::memory_order_acquire)){
+                ;
+        }
+
+        while(!bench_stop.load(std::memory_order_relaxed)){
+                for(int i = 0; i < 64; i++, nr++){
+                        r = xorshift(&seed);
+                        idx = r % all_fds.size();
+                        offset = ((r >> 20) % nr_portions) * PORTION_SIZE + ((r >> 40) % (PORTION_SIZE / BENCH_READ_SIZE)) * BENCH_READ_SIZE;
+
+                        switch(op){
+                        case OP_PFD:
+                                if(!get_perfd_struct_fast(all_fds[idx])){
+                                        fprintf(stderr, "no pfd for fd:%d\n", all_fds[idx]);
+                                        _exit(1);
+                                }
+                                break;
+                        case OP_HANDLE_READ:
+                        case OP_EVICT:
+                                handle_read(all_fds[idx], offset, BENCH_READ_SIZE, false);
+                                break;
+                        case OP_HEAP_UPDATE:
+                                heap_update(fd_files[idx]->uinode, offset, BENCH_READ_SIZE, true);
+                                break;
+                        case OP_PVT_HEAP:
+                                update_pvt_heap(fd_files[idx]->uinode, offset, BENCH_READ_SIZE, true);
+                                break;
+                        case OP_ADD_FD:
+                                fd = syscall(SYS_dup, all_fds[idx]);
+                                uinode = add_fd_to_inode(fd, O_RDONLY, fd_files[idx]->path.c_str(), &seek_head);
+                                if(!uinode){
+                                        fprintf(stderr, "add_fd_to_inode failed for fd:%d\n", fd);
+                                        _exit(1);
+                                }
+                                remove_fd_from_fdlist(uinode, fd);
+                                syscall(SYS_close, fd);
+                                break;
+                        default:
+                                break;
+                        }
+                }
+        }
+        return nr;
+}
+
+static unsigned long run_evictor(unsigned long *claimed_kb){
+        unsigned long nr = 0;
+        long kb;
+
+        while(!bench_go.load(std::memory_order_acquire)){
+                ;
+        }
+
+        while(!bench_stop.load(std::memory_order_relaxed)){
+                kb = evict_portions(PORTION_SIZE / KB);
+                if(kb > 0){
+                        *claimed_kb += kb;
+                }
+                nr++;
+        }
+        return nr;
+}
+
+static uint64_t tracker_total(struct lat_tracker *t){
+        uint64_t total = 0;
+
+        for(int i = 0; i < NR_POW2_LATENCY_BINS; i++){
+                total += t->latencies_bin_ctr[i].load(std::memory_order_relaxed);
+        }
+        return total;
+}
+
+/*upper bound of the bin holding the pct percentile, 0 if nothing was binned*/
+static unsigned long tracker_pct(struct lat_tracker *t, double pct){
+        uint64_t total = tracker_total(t), sum = 0;
+
+        if(!total){
+                return 0;
+        }
+        for(int i = 0; i < NR_POW2_LATENCY_BINS; i++){
+                sum += t->latencies_bin_ctr[i].load(std::memory_order_relaxed);
+                if(sum >= pct * total){
+                        return 1UL << i;
+                }
+        }
+        return 1UL << (NR_POW2_LATENCY_BINS - 1);
+}
+
+static void reset_trackers(){
+        for(size_t l = 0; l < NR_LOCKS; l++){
+                for(int i = 0; i < NR_POW2_LATENCY_BINS; i++){
+                        lock_trackers[l]->latencies_bin_ctr[i].store(0, std::memory_order_relaxed);
+                }
+        }
+}
+
+static void bench(enum bench_op op, int max_threads, int ms){
+        double base_mops = 0;
+
+        /*1, 2, 4 .. and max_threads*/
+        for(int nr_threads = 1; nr_threads <= max_threads;
+                        nr_threads = (nr_threads < max_threads && nr_threads * 2 > max_threads) ? max_threads : nr_threads * 2){
+                std::vector<std::thread> threads;
+                std::vector<unsigned long> counts(nr_threads, 0);
+                unsigned long nr_evicts = 0, claimed_kb = 0, total = 0;
+                std::thread evictor;
+                uint64_t start, elapsed;
+                double mops;
+
+                reset_trackers();
+                nr_fadvise.store(0);
+                bench_go.store(false);
+                bench_stop.store(false);
+
+                for(int t = 0; t < nr_threads; t++){
+                        threads.emplace_back([op, t, &counts](){
+                                counts[t] = run_op(op, 0x9e3779b97f4a7c15ULL * (t + 1));
+                        });
+                }
+                if(op == OP_EVICT){
+                        evictor = std::thread([&nr_evicts, &claimed_kb](){
+                                nr_evicts = run_evictor(&claimed_kb);
+                        });
+                }
+
+                start = now_ns();
+                bench_go.store(true, std::memory_order_release);
+                usleep(ms * 1000);
+                bench_stop.store(true);
+                for(auto &th : threads){
+                        th.join();
+                }
+                if(op == OP_EVICT){
+                        evictor.join();
+                }
+                elapsed = now_ns() - start;
+
+                for(auto c : counts){
+                        total += c;
+                }
+                mops = (double)total * 1000 / elapsed;
+                if(nr_threads == 1){
+                        base_mops = mops;
+                }
+
+                printf("%-12s %7d %9.3f %9.1f %7.0f%%", op_names[op], nr_threads, mops,
+                                (double)elapsed * nr_threads / total, 100.0 * mops / (nr_threads * base_mops));
+                for(size_t l = 0; l < NR_LOCKS; l++){
+                        printf(" %7lu/%-7lu", tracker_pct(lock_trackers[l], 0.5), tracker_pct(lock_trackers[l], 0.99));
+                }
+                if(op == OP_EVICT){
+                        printf(" %9.0f  (%lu MB evicted, %lu fadvises)", nr_evicts ? (double)elapsed / nr_evicts : 0.0,
+                                        claimed_kb / KB, nr_fadvise.load());
+                }
+                putchar('\n');
+                fflush(stdout);
+        }
+}
+
+static void usage(const char *prog){
+        fprintf(stderr, "usage: %s [-d dir] [-f files] [-F fds_per_file] [-p portions_per_file] "
+                        "[-T max_threads] [-t ms] [-o op]\n", prog);
+}
+
+int main(int argc, char **argv){
+        const char *dir = "hotpath_data";
+        int nr_files = 64, nr_fds = 4, ms = 500, opt;
+        int max_threads = std::thread::hardware_concurrency();
+        int only_op = -1;
+
+        while((opt = getopt(argc, argv, "d:f:F:p:T:t:o:h")) != -1){
+                switch(opt){
+                case 'd':
+                        dir = optarg;
+                        break;
+                case 'f':
+                        nr_files = atoi(optarg);
+                        break;
+                case 'F':
+                        nr_fds = atoi(optarg);
+                        break;
+                case 'p':
+                        nr_portions = strtoul(optarg, NULL, 10);
+                        break;
+                case 'T':
+                        max_threads = atoi(optarg);
+                        break;
+                case 't':
+                        ms = atoi(optarg);
+                        break;
+                case 'o':
+                        for(int i = 0; i < NR_OPS; i++){
+                                if(!strcmp(optarg, op_names[i])){
+                                        only_op = i;
+                                }
+                        }
+                        if(only_op < 0){
+                                fprintf(stderr, "unknown op %s\n", optarg);
+                                return 1;
+                        }
+                        break;
+                default:
+                        usage(argv[0]);
+                        return opt == 'h' ? 0 : 1;
+                }
+        }
+        if(nr_files < 1 || nr_fds < 1 || nr_portions < 1 || max_threads < 1 || ms < 1){
+                usage(argv[0]);
+                return 1;
+        }
+
+        stub_shim_functions();
+
+        if(setup_files(dir, nr_files, nr_fds)){
+                cleanup_files();
+                return 1;
+        }
+
+        printf("\n%d files x %d fds, %lu portions of %lu KB per file, %d ms per run\n",
+                        nr_files, nr_fds, nr_portions, PORTION_SIZE / KB, ms);
+        printf("lock hold p50/p99 ns: shard = i_map shard lock, unlinked = unlinked_lock, "
+                        "file_heap = file_heap_lock, g_heap = g_heap_lock\n");
+        printf("%-12s %7s %9s %9s %8s %15s %15s %15s %15s %9s\n", "op", "threads", "Mops/s", "ns/op", "scaling",
+                        "shard", "unlinked", "file_heap", "g_heap", "evict_ns");
+
+        for(int op = 0; op < NR_OPS; op++){
+                if(only_op < 0 || only_op == op){
+                        bench((enum bench_op)op, max_threads, ms);
+                }
+        }
+
+        cleanup_files();
+
+        /*skips the latency dumps of the library's destructor*/
+        fflush(stdout);
+        _exit(0);
+}
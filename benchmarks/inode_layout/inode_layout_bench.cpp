@@ -0,0 +1,208 @@
+/**
+ * Memory and false sharing benchmark for struct inode.
+ *
+ * Compares the current struct inode against legacy_inode, a copy of the
+ * layout before the hot/cold split (filename[PATH_MAX], fdlist[MAX_FD_PER_INODE],
+ * locks packed next to the hot counters).
+ *
+ * 1. memory: allocates MAX_IMAP_FILES uinodes with Cassandra like filenames
+ *    and 2 open fds each; reports sizeof and RSS growth.
+ * 2. false sharing: on one uinode, lock threads hammer file_heap_lock and
+ *    fdlist_lock while counter threads bump nr_accesses/last_access_tstamp
+ *    like heap_update does; reports counter updates per second.
+ *    Needs atleast 2 CPUs to mean anything.
+ *
+ * Build and run: make run
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "inode.hpp"
+#include "utils/string_arena/string_arena.hpp"
+
+#define NR_BENCH_INODES MAX_IMAP_FILES
+#define BENCH_SECS 2
+
+/*defined in inode.cpp, which is not linked in here*/
+const char EMPTY_UINODE_FILENAME[] = "";
+
+/*fd_info before seek heads moved to perfd_struct*/
+struct legacy_fd_info{
+        int fd;
+        off_t seek_head;
+        int open_flags;
+        bool fadv_seq;
+};
+
+/*struct inode layout before the hot/cold split*/
+struct legacy_inode{
+        ino_t ino;
+        dev_t dev_id;
+        char filename[PATH_MAX];
+        std::mutex uinode_lock;
+        struct legacy_fd_info fdlist[MAX_FD_PER_INODE];
+        int fdlist_index;
+        std::mutex fdlist_lock;
+        bit_array_t *cache_state;
+        ReaderWriterLock cache_rwlock;
+        struct Heap* file_heap;
+        AutoExpandVector<int> *file_heap_node_ids;
+        std::mutex file_heap_lock;
+        int heap_id;
+        bool one_operation_done;
+        unsigned long nr_accesses;
+        unsigned long long int last_access_tstamp;
+        struct trigger *gheap_trigger;
+        unsigned int nr_evictions;
+        bool unlinked;
+        bool marked_unlinked;
+        nlink_t nr_links;
+        std::mutex unlinked_lock;
+
+        legacy_inode(){
+                ino = 0UL;
+                dev_id = 0UL;
+                memset(filename, 0, PATH_MAX);
+                fdlist_index = -1;
+                cache_state = nullptr;
+                memset(fdlist, 0, MAX_FD_PER_INODE*sizeof(struct legacy_fd_info));
+                heap_id = -1;
+                one_operation_done = false;
+                nr_accesses = 1;
+                last_access_tstamp = ticks_now();
+                nr_evictions = 0;
+                gheap_trigger = new trigger;
+                sanitize_struct_trigger(gheap_trigger);
+                gheap_trigger->step = G_HEAP_FREQ;
+                file_heap_node_ids = nullptr;
+                file_heap = nullptr;
+                unlinked = false;
+                marked_unlinked = false;
+                nr_links = 0;
+        }
+};
+
+static long rss_kb(void){
+        long pages = 0, rss = 0;
+        FILE *f = fopen("/proc/self/statm", "r");
+        if(!f){
+                return -1;
+        }
+        if(fscanf(f, "%ld %ld", &pages, &rss) != 2){
+                rss = -1;
+        }
+        fclose(f);
+        return rss * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void make_filename(char *buf, size_t len, int i){
+        snprintf(buf, len, "/var/lib/cassandra/data/ycsb/usertable-2b1f6a40c3e811ee9a1f3b5d1c0e7f21/nb-%d-big-%s.db",
+                        i, (i % 2) ? "Index" : "Data");
+}
+
+static void bench_memory_legacy(void){
+        char name[PATH_MAX];
+        std::vector<struct legacy_inode *> v;
+        long before = rss_kb();
+
+        v.reserve(NR_BENCH_INODES);
+        for(int i = 0; i < NR_BENCH_INODES; i++){
+                struct legacy_inode *u = new struct legacy_inode;
+                make_filename(name, sizeof(name), i);
+                strncpy(u->filename, name, PATH_MAX-1);
+                u->fdlist[0].fd = 3 + i;
+                u->fdlist[1].fd = 4 + i;
+                u->fdlist_index = 1;
+                v.push_back(u);
+        }
+        printf("legacy_inode: sizeof %6zu B, %d uinodes RSS +%ld KB\n",
+                        sizeof(struct legacy_inode), NR_BENCH_INODES, rss_kb() - before);
+}
+
+static void bench_memory_inode(void){
+        char name[PATH_MAX];
+        StringArena arena;
+        std::vector<struct inode *> v;
+        long before = rss_kb();
+
+        v.reserve(NR_BENCH_INODES);
+        for(int i = 0; i < NR_BENCH_INODES; i++){
+                struct inode *u = new struct inode;
+                make_filename(name, sizeof(name), i);
+                u->filename = arena.intern(name);
+                u->fdlist[0].fd = 3 + i;
+                u->fdlist[1].fd = 4 + i;
+                u->fdlist_index = 1;
+                v.push_back(u);
+        }
+        printf("struct inode: sizeof %6zu B, %d uinodes RSS +%ld KB (filename arena %zu KB)\n",
+                        sizeof(struct inode), NR_BENCH_INODES, rss_kb() - before, arena.bytes_reserved() / 1024);
+}
+
+/**
+ * Returns counter updates per second done by nr_counters threads while
+ * nr_lockers threads hammer the locks of the same uinode.
+ */
+template <typename T>
+static double bench_false_sharing(T *u, int nr_lockers, int nr_counters){
+        std::atomic<bool> stop(false);
+        std::atomic<unsigned long> total(0);
+        std::vector<std::thread> threads;
+
+        for(int i = 0; i < nr_lockers; i++){
+                threads.emplace_back([&, i](){
+                        std::mutex &m = (i % 2) ? u->fdlist_lock : u->file_heap_lock;
+                        while(!stop.load(std::memory_order_relaxed)){
+                                m.lock();
+                                m.unlock();
+                        }
+                });
+        }
+        for(int i = 0; i < nr_counters; i++){
+                threads.emplace_back([&](){
+                        unsigned long n = 0;
+                        while(!stop.load(std::memory_order_relaxed)){
+                                /*racy on purpose; same as heap_update*/
+                                *(volatile unsigned long *)&u->nr_accesses += 1;
+                                *(volatile unsigned long long *)&u->last_access_tstamp = n;
+                                n++;
+                        }
+                        total += n;
+                });
+        }
+
+        std::this_thread::sleep_for(std::chrono::seconds(BENCH_SECS));
+        stop = true;
+        for(auto &t : threads){
+                t.join();
+        }
+        return (double)total / BENCH_SECS;
+}
+
+int main(void){
+        int nr_cpus = std::thread::hardware_concurrency();
+        int nr_lockers = nr_cpus > 2 ? nr_cpus / 2 : 1;
+        int nr_counters = nr_cpus > 2 ? nr_cpus - nr_lockers : 1;
+
+        printf("=== memory at %d uinodes ===\n", NR_BENCH_INODES);
+        bench_memory_legacy();
+        bench_memory_inode();
+
+        printf("=== false sharing: %d lock threads, %d counter threads, %ds ===\n",
+                        nr_lockers, nr_counters, BENCH_SECS);
+        struct legacy_inode *l = new struct legacy_inode;
+        struct inode *u = new struct inode;
+        printf("legacy_inode: %.1f M counter updates/s\n", bench_false_sharing(l, nr_lockers, nr_counters) / 1e6);
+        printf("struct inode: %.1f M counter updates/s\n", bench_false_sharing(u, nr_lockers, nr_counters) / 1e6);
+
+        return 0;
+}
@@ -0,0 +1,691 @@
+/**
+ * SSTable like load generator: Cassandra's I/O pattern on local files,
+ * for end to end latency runs with and without LD_PRELOAD of SpeedyIO.
+ *
+ * <dir>/ks/tbl-<32 hex>/nb-<gen>-big-{Data,Index}.db are created, then
+ * for -t seconds:
+ *  - readers (-r) do point reads: a zipfian key (-z theta, scrambled
+ *    over the tables) is a 4K pread of Index.db then one of Data.db
+ *  - a flusher writes a new -f MB table every -F ms with 64K appends
+ *    and fdatasync, like a memtable flush
+ *  - a compactor merges the two smallest tables whenever there are more
+ *    than -n: 256K sequential reads, 256K appends, then unlinks the
+ *    inputs while readers may still have them open
+ *  - a churn thread dups a Data.db fd, preads through the dup and closes
+ *    it, and reopens Data.db by path (ENOENT once compacted away)
+ * Tables are closed by whichever thread drops the last reference.
+ *
+ * Per op latencies go into log-linear (HDR style, ~1.5% precision)
+ * histograms, reported as count, ops/s, p50, p99, p99.9 and max.
+ *
+ * sstable_load [-d dir] [-t secs] [-r readers] [-n tables] [-s table_mb]
+ *              [-f flush_mb] [-F flush_ms] [-z theta] [-c out.csv]
+ * sstable_load -C base.csv new.csv [-T pct]
+ *      compares two -c outputs, exits 1 if a p99 or p99.9 grew by more
+ *      than pct (default 20) percent
+ *
+ * Build: make; make run compares the release library against no preload.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define INDEX_PAGE 4096
+#define DATA_PAGE 4096
+#define FLUSH_CHUNK (64 * 1024)
+#define COMPACT_CHUNK (256 * 1024)
+
+/*one Index.db page per this many Data.db pages*/
+#define PAGES_PER_INDEX_PAGE 64
+
+enum op {
+        OP_POINT_READ = 0,      /*Index.db + Data.db pread*/
+        OP_INDEX_PREAD,
+        OP_DATA_PREAD,
+        OP_COMPACT_READ,
+        OP_COMPACT_WRITE,
+        OP_FLUSH_WRITE,
+        OP_FDATASYNC,
+        OP_UNLINK,
+        OP_DUP_PREAD_CLOSE,
+        OP_OPEN_CLOSE,
+        NR_OPS,
+};
+
+static const char *op_names[NR_OPS] = {
+        "point_read", "index_pread", "data_pread", "compact_read", "compact_write",
+        "flush_write", "fdatasync", "unlink", "dup_pread_close", "open_close",
+};
+
+/*
+ * Log-linear histogram of ns: values below 128 are exact, above that
+ * every power of 2 is split into 64 sub buckets.
+ */
+#define HIST_SUB_BITS 6
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (64 * HIST_SUB)
+
+struct hist {
+        uint64_t counts[HIST_BUCKETS];
+        uint64_t total;
+        uint64_t max;
+};
+
+static inline int hist_index(uint64_t v){
+        int exp;
+
+        if(v < 2 * HIST_SUB){
+                return v;
+        }
+        exp = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+        return (exp + 1) * HIST_SUB + (int)((v >> exp) - HIST_SUB);
+}
+
+/*largest value that lands in bucket idx*/
+static inline uint64_t hist_value(int idx){
+        int exp;
+
+        if(idx < 2 * HIST_SUB){
+                return idx;
+        }
+        exp = idx / HIST_SUB - 1;
+        return (((uint64_t)(idx % HIST_SUB + HIST_SUB) + 1) << exp) - 1;
+}
+
+static inline void hist_add(struct hist *h, uint64_t ns){
+        h->counts[hist_index(ns)]++;
+        h->total++;
+        if(ns > h->max){
+                h->max = ns;
+        }
+}
+
+static void hist_merge(struct hist *to, const struct hist *from){
+        for(int i = 0; i < HIST_BUCKETS; i++){
+                to->counts[i] += from->counts[i];
+        }
+        to->total += from->total;
+        to->max = std::max(to->max, from->max);
+}
+
+static uint64_t hist_percentile(const struct hist *h, double pct){
+        uint64_t want = (uint64_t)ceil(pct / 100.0 * h->total), seen = 0;
+
+        for(int i = 0; i < HIST_BUCKETS; i++){
+                seen += h->counts[i];
+                if(seen >= want && seen){
+                        return std::min(hist_value(i), h->max);
+                }
+        }
+        return h->max;
+}
+
+struct opts {
+        std::string dir;
+        int secs;
+        int nr_readers;
+        int nr_tables;
+        long table_mb;
+        long flush_mb;
+        long flush_ms;
+        double theta;
+        const char *csv;
+};
+
+struct sstable {
+        int gen;
+        std::string data_path;
+        std::string index_path;
+        int data_fd;
+        int index_fd;
+        off_t data_size;
+
+        ~sstable(){
+                if(data_fd >= 0){
+                        close(data_fd);
+                }
+                if(index_fd >= 0){
+                        close(index_fd);
+                }
+        }
+};
+
+static struct opts o;
+static std::string table_dir;
+static std::atomic<bool> stop_run(false);
+static std::atomic<int> next_gen(1);
+static std::atomic<unsigned long> nr_errors(0);
+
+static std::mutex tables_lock;
+static std::vector<std::shared_ptr<struct sstable>> tables;
+
+static inline uint64_t now_ns(){
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*xorshift64*, one per thread*/
+static inline uint64_t next_rand(uint64_t *state){
+        uint64_t x = *state;
+
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        *state = x;
+        return x * 0x2545f4914f6cdd1dULL;
+}
+
+static inline uint64_t mix64(uint64_t x){
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+}
+
+/*YCSB's zipfian generator over [0, n)*/
+struct zipfian {
+        uint64_t n;
+        double theta, alpha, zetan, eta;
+
+        zipfian(uint64_t items, double t) : n(items), theta(t) {
+                double zeta2 = 1.0 + pow(0.5, theta);
+
+                zetan = 0;
+                for(uint64_t i = 1; i <= n; i++){
+                        zetan += 1.0 / pow((double)i, theta);
+                }
+                alpha = 1.0 / (1.0 - theta);
+                eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+        }
+
+        uint64_t next(uint64_t *state) const {
+                double u = (next_rand(state) >> 11) * (1.0 / 9007199254740992.0);
+                double uz = u * zetan;
+                uint64_t v;
+
+                if(uz < 1.0){
+                        return 0;
+                }
+                if(uz < 1.0 + pow(0.5, theta)){
+                        return 1;
+                }
+                v = (uint64_t)(n * pow(eta * u - eta + 1.0, alpha));
+                return v < n ? v : n - 1;
+        }
+};
+
+static bool write_all(int fd, const char *buf, size_t len, struct hist *lat){
+        uint64_t start;
+        ssize_t ret;
+
+        while(len > 0){
+                start = now_ns();
+                ret = write(fd, buf, len);
+                hist_add(lat, now_ns() - start);
+                if(ret <= 0){
+                        if(ret < 0 && errno == EINTR){
+                                continue;
+                        }
+                        return false;
+                }
+                buf += ret;
+                len -= ret;
+        }
+        return true;
+}
+
+/**
+ * Writes a table of data_size bytes with chunk sized appends and adds it.
+ * src, if not null, is read sequentially for the data (compaction).
+ */
+static std::shared_ptr<struct sstable> write_table(off_t data_size, size_t chunk, struct hist *hists, int write_op,
+                const std::vector<std::shared_ptr<struct sstable>> *srcs){
+        std::shared_ptr<struct sstable> t = std::make_shared<struct sstable>();
+        std::vector<char> buf(chunk, 'x');
+        size_t src_idx = 0;
+        off_t done = 0, src_off = 0;
+        int src_fd = -1, fd;
+        uint64_t start;
+        ssize_t ret;
+
+        t->gen = next_gen.fetch_add(1);
+        t->data_path = table_dir + "/nb-" + std::to_string(t->gen) + "-big-Data.db";
+        t->index_path = table_dir + "/nb-" + std::to_string(t->gen) + "-big-Index.db";
+        t->data_fd = -1;
+        t->index_fd = -1;
+        t->data_size = data_size;
+
+        fd = open(t->data_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0){
+                nr_errors++;
+                return nullptr;
+        }
+
+        while(done < data_size){
+                size_t len = std::min((off_t)chunk, data_size - done);
+
+                if(srcs){
+                        /*sequential read of the inputs, one after the other*/
+                        while(src_idx < srcs->size()){
+                                if(src_fd < 0){
+                                        src_fd = open((*srcs)[src_idx]->data_path.c_str(), O_RDONLY);
+                                        src_off = 0;
+                                        if(src_fd < 0){
+                                                nr_errors++;
+                                                src_idx++;
+                                                continue;
+                                        }
+                                }
+                                start = now_ns();
+                                ret = read(src_fd, buf.data(), len);
+                                hist_add(&hists[OP_COMPACT_READ], now_ns() - start);
+                                if(ret > 0){
+                                        src_off += ret;
+                                        len = ret;
+                                        break;
+                                }
+                                close(src_fd);
+                                src_fd = -1;
+                                src_idx++;
+                        }
+                }
+                buf[0] = (char)t->gen;
+                if(!write_all(fd, buf.data(), len, &hists[write_op])){
+                        nr_errors++;
+                        break;
+                }
+                done += len;
+        }
+        if(src_fd >= 0){
+                close(src_fd);
+        }
+
+        start = now_ns();
+        fdatasync(fd);
+        hist_add(&hists[OP_FDATASYNC], now_ns() - start);
+        close(fd);
+
+        /*an Index.db entry per data page*/
+        fd = open(t->index_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0){
+                nr_errors++;
+                return nullptr;
+        }
+        for(off_t i = 0; i < data_size / DATA_PAGE; i += PAGES_PER_INDEX_PAGE){
+                if(!write_all(fd, buf.data(), INDEX_PAGE, &hists[write_op])){
+                        nr_errors++;
+                        break;
+                }
+        }
+        close(fd);
+
+        t->data_fd = open(t->data_path.c_str(), O_RDONLY);
+        t->index_fd = open(t->index_path.c_str(), O_RDONLY);
+        if(t->data_fd < 0 || t->index_fd < 0){
+                nr_errors++;
+                return nullptr;
+        }
+        /*cold start, like a freshly written table on a busy node*/
+        posix_fadvise(t->data_fd, 0, 0, POSIX_FADV_DONTNEED);
+        posix_fadvise(t->index_fd, 0, 0, POSIX_FADV_DONTNEED);
+        return t;
+}
+
+static std::shared_ptr<struct sstable> pick_table(uint64_t key){
+        std::lock_guard<std::mutex> guard(tables_lock);
+
+        if(tables.empty()){
+                return nullptr;
+        }
+        return tables[key % tables.size()];
+}
+
+static void reader(int id, const struct zipfian *zipf, struct hist *hists){
+        uint64_t rnd = mix64(id + 1), key, page, start, mid;
+        char buf[DATA_PAGE];
+        off_t nr_pages;
+
+        while(!stop_run.load(std::memory_order_relaxed)){
+                /*scrambled, so the hot keys are spread over all tables*/
+                key = mix64(zipf->next(&rnd));
+                std::shared_ptr<struct sstable> t = pick_table(key);
+                if(!t){
+                        continue;
+                }
+                nr_pages = t->data_size / DATA_PAGE;
+                page = (key >> 20) % nr_pages;
+
+                start = now_ns();
+                if(pread(t->index_fd, buf, INDEX_PAGE, (page / PAGES_PER_INDEX_PAGE) * INDEX_PAGE) < 0){
+                        nr_errors++;
+                }
+                mid = now_ns();
+                if(pread(t->data_fd, buf, DATA_PAGE, page * DATA_PAGE) < 0){
+                        nr_errors++;
+                }
+                hist_add(&hists[OP_INDEX_PREAD], mid - start);
+                hist_add(&hists[OP_DATA_PREAD], now_ns() - mid);
+                hist_add(&hists[OP_POINT_READ], now_ns() - start);
+        }
+}
+
+static void flusher(struct hist *hists){
+        uint64_t next = now_ns();
+
+        while(!stop_run.load(std::memory_order_relaxed)){
+                next += o.flush_ms * 1000000ULL;
+                std::shared_ptr<struct sstable> t = write_table(o.flush_mb << 20, FLUSH_CHUNK, hists, OP_FLUSH_WRITE, nullptr);
+                if(t){
+                        std::lock_guard<std::mutex> guard(tables_lock);
+                        tables.push_back(t);
+                }
+                while(now_ns() < next && !stop_run.load(std::memory_order_relaxed)){
+                        usleep(1000);
+                }
+        }
+}
+
+static void compactor(struct hist *hists){
+        std::vector<std::shared_ptr<struct sstable>> inputs;
+        off_t size;
+        uint64_t start;
+
+        while(!stop_run.load(std::memory_order_relaxed)){
+                inputs.clear();
+                {
+                        std::lock_guard<std::mutex> guard(tables_lock);
+                        if((int)tables.size() > o.nr_tables){
+                                std::vector<std::shared_ptr<struct sstable>> by_size(tables);
+
+                                std::sort(by_size.begin(), by_size.end(), [](const std::shared_ptr<struct sstable> &a,
+                                                        const std::shared_ptr<struct sstable> &b){
+                                        return a->data_size < b->data_size;
+                                });
+                                inputs.assign(by_size.begin(), by_size.begin() + 2);
+                        }
+                }
+                if(inputs.empty()){
+                        usleep(10000);
+                        continue;
+                }
+
+                /*overwrites are merged away, so a table never outgrows -s*/
+                size = std::min(inputs[0]->data_size + inputs[1]->data_size, (off_t)(o.table_mb << 20));
+                std::shared_ptr<struct sstable> out = write_table(size, COMPACT_CHUNK, hists, OP_COMPACT_WRITE, &inputs);
+
+                {
+                        std::lock_guard<std::mutex> guard(tables_lock);
+                        for(auto &in : inputs){
+                                tables.erase(std::remove(tables.begin(), tables.end(), in), tables.end());
+                        }
+                        if(out){
+                                tables.push_back(out);
+                        }
+                }
+
+                /*readers may still hold them; the last one closes the fds*/
+                for(auto &in : inputs){
+                        start = now_ns();
+                        unlink(in->data_path.c_str());
+                        unlink(in->index_path.c_str());
+                        hist_add(&hists[OP_UNLINK], now_ns() - start);
+                }
+        }
+}
+
+static void churn(struct hist *hists){
+        uint64_t rnd = 0x5eed, start;
+        char buf[DATA_PAGE];
+        unsigned long n = 0;
+        int fd;
+
+        while(!stop_run.load(std::memory_order_relaxed)){
+                std::shared_ptr<struct sstable> t = pick_table(next_rand(&rnd));
+                if(!t){
+                        continue;
+                }
+
+                start = now_ns();
+                fd = dup(t->data_fd);
+                if(fd >= 0){
+                        if(pread(fd, buf, DATA_PAGE, (next_rand(&rnd) % (t->data_size / DATA_PAGE)) * DATA_PAGE) < 0){
+                                nr_errors++;
+                        }
+                        close(fd);
+                }
+                hist_add(&hists[OP_DUP_PREAD_CLOSE], now_ns() - start);
+
+                if(n++ % 8 == 0){
+                        /*races with the compactor's unlink*/
+                        start = now_ns();
+                        fd = open(t->data_path.c_str(), O_RDONLY);
+                        if(fd >= 0){
+                                close(fd);
+                        }
+                        hist_add(&hists[OP_OPEN_CLOSE], now_ns() - start);
+                }
+                usleep(100);
+        }
+}
+
+static void report(const struct hist *hists, double secs){
+        FILE *csv = nullptr;
+
+        if(o.csv){
+                csv = fopen(o.csv, "w");
+                if(!csv){
+                        fprintf(stderr, "%s: %s\n", o.csv, strerror(errno));
+                }else{
+                        fprintf(csv, "op,count,ops_per_s,p50_us,p99_us,p999_us,max_us\n");
+                }
+        }
+
+        printf("%-16s %10s %10s %10s %10s %10s %10s\n", "op", "count", "ops/s", "p50_us", "p99_us", "p99.9_us", "max_us");
+        for(int i = 0; i < NR_OPS; i++){
+                const struct hist *h = &hists[i];
+                double p50 = hist_percentile(h, 50) / 1e3, p99 = hist_percentile(h, 99) / 1e3;
+                double p999 = hist_percentile(h, 99.9) / 1e3, max = h->max / 1e3;
+
+                if(!h->total){
+                        continue;
+                }
+                printf("%-16s %10lu %10.1f %10.1f %10.1f %10.1f %10.1f\n", op_names[i], (unsigned long)h->total,
+                                h->total / secs, p50, p99, p999, max);
+                if(csv){
+                        fprintf(csv, "%s,%lu,%.1f,%.1f,%.1f,%.1f,%.1f\n", op_names[i], (unsigned long)h->total,
+                                        h->total / secs, p50, p99, p999, max);
+                }
+        }
+        if(nr_errors){
+                printf("errors %lu\n", nr_errors.load());
+        }
+        if(csv){
+                fclose(csv);
+        }
+}
+
+struct csv_row {
+        unsigned long count;
+        double p99;
+        double p999;
+};
+
+static bool load_csv(const char *path, std::map<std::string, struct csv_row> *rows){
+        char line[256], name[64];
+        struct csv_row r;
+        double ops, p50, max;
+        FILE *fp = fopen(path, "r");
+
+        if(!fp){
+                fprintf(stderr, "%s: %s\n", path, strerror(errno));
+                return false;
+        }
+        while(fgets(line, sizeof(line), fp)){
+                if(sscanf(line, "%63[^,],%lu,%lf,%lf,%lf,%lf,%lf", name, &r.count, &ops, &p50, &r.p99, &r.p999, &max) == 7){
+                        (*rows)[name] = r;
+                }
+        }
+        fclose(fp);
+        return true;
+}
+
+/*Exit status 1 if a tail grew by more than threshold_pct; ops with < 1000 samples are ignored*/
+static int compare(const char *base_path, const char *new_path, double threshold_pct){
+        std::map<std::string, struct csv_row> base, cur;
+        int ret = 0;
+
+        if(!load_csv(base_path, &base) || !load_csv(new_path, &cur)){
+                return 2;
+        }
+
+        printf("%-16s %10s %10s %8s %10s %10s %8s\n", "op", "base_p99", "new_p99", "change", "base_p99.9", "new_p99.9", "change");
+        for(auto &it : base){
+                auto c = cur.find(it.first);
+                double d99, d999;
+                bool regressed;
+
+                if(c == cur.end()){
+                        continue;
+                }
+                d99 = it.second.p99 > 0 ? 100.0 * (c->second.p99 - it.second.p99) / it.second.p99 : 0;
+                d999 = it.second.p999 > 0 ? 100.0 * (c->second.p999 - it.second.p999) / it.second.p999 : 0;
+                regressed = it.second.count >= 1000 && c->second.count >= 1000 &&
+                        (d99 > threshold_pct || d999 > threshold_pct);
+                printf("%-16s %10.1f %10.1f %7.1f%% %10.1f %10.1f %7.1f%%%s\n", it.first.c_str(), it.second.p99,
+                                c->second.p99, d99, it.second.p999, c->second.p999, d999, regressed ? "  REGRESSED" : "");
+                if(regressed){
+                        ret = 1;
+                }
+        }
+        return ret;
+}
+
+static void usage(const char *prog){
+        fprintf(stderr, "usage: %s [-d dir] [-t secs] [-r readers] [-n tables] [-s table_mb] [-f flush_mb] [-F flush_ms] [-z theta] [-c out.csv]\n"
+                        "       %s -C base.csv new.csv [-T pct]\n", prog, prog);
+}
+
+int main(int argc, char **argv){
+        std::vector<std::thread> threads;
+        std::vector<struct hist> hists;
+        const char *compare_base = nullptr;
+        double threshold_pct = 20;
+        uint64_t start;
+        int opt;
+
+        o.dir = "./sstable_load_data";
+        o.secs = 10;
+        o.nr_readers = 4;
+        o.nr_tables = 8;
+        o.table_mb = 64;
+        o.flush_mb = 8;
+        o.flush_ms = 1000;
+        o.theta = 0.99;
+        o.csv = nullptr;
+
+        while((opt = getopt(argc, argv, "d:t:r:n:s:f:F:z:c:C:T:h")) != -1){
+                switch(opt){
+                case 'd': o.dir = optarg; break;
+                case 't': o.secs = atoi(optarg); break;
+                case 'r': o.nr_readers = atoi(optarg); break;
+                case 'n': o.nr_tables = atoi(optarg); break;
+                case 's': o.table_mb = atol(optarg); break;
+                case 'f': o.flush_mb = atol(optarg); break;
+                case 'F': o.flush_ms = atol(optarg); break;
+                case 'z': o.theta = atof(optarg); break;
+                case 'c': o.csv = optarg; break;
+                case 'C': compare_base = optarg; break;
+                case 'T': threshold_pct = atof(optarg); break;
+                default:
+                        usage(argv[0]);
+                        return opt == 'h' ? 0 : 1;
+                }
+        }
+
+        if(compare_base){
+                if(optind != argc - 1){
+                        usage(argv[0]);
+                        return 2;
+                }
+                return compare(compare_base, argv[optind], threshold_pct);
+        }
+
+        if(o.secs < 1 || o.nr_readers < 1 || o.nr_tables < 2 || o.table_mb < 1 || o.flush_mb < 1 ||
+                        o.flush_ms < 1 || o.theta <= 0 || o.theta >= 1){
+                usage(argv[0]);
+                return 1;
+        }
+
+        /*Cassandra's layout, which the default whitelist matches*/
+        table_dir = o.dir + "/ks";
+        mkdir(o.dir.c_str(), 0755);
+        mkdir(table_dir.c_str(), 0755);
+        table_dir += "/tbl-0123456789abcdef0123456789abcdef";
+        if(mkdir(table_dir.c_str(), 0755) && errno != EEXIST){
+                fprintf(stderr, "%s: %s\n", table_dir.c_str(), strerror(errno));
+                return 1;
+        }
+
+        /*setup writes are not part of the report*/
+        hists.resize(NR_OPS);
+        printf("creating %d tables of %ld MB in %s\n", o.nr_tables, o.table_mb, table_dir.c_str());
+        for(int i = 0; i < o.nr_tables; i++){
+                std::shared_ptr<struct sstable> t = write_table(o.table_mb << 20, FLUSH_CHUNK, hists.data(), OP_FLUSH_WRITE, nullptr);
+                if(!t){
+                        fprintf(stderr, "unable to create a table in %s\n", table_dir.c_str());
+                        return 1;
+                }
+                tables.push_back(t);
+        }
+
+        struct zipfian zipf((uint64_t)o.nr_tables * (o.table_mb << 20) / DATA_PAGE, o.theta);
+
+        hists.assign((o.nr_readers + 3) * NR_OPS, hist());
+        start = now_ns();
+        for(int i = 0; i < o.nr_readers; i++){
+                threads.emplace_back(reader, i, &zipf, &hists[i * NR_OPS]);
+        }
+        threads.emplace_back(flusher, &hists[o.nr_readers * NR_OPS]);
+        threads.emplace_back(compactor, &hists[(o.nr_readers + 1) * NR_OPS]);
+        threads.emplace_back(churn, &hists[(o.nr_readers + 2) * NR_OPS]);
+
+        sleep(o.secs);
+        stop_run = true;
+        for(auto &t : threads){
+                t.join();
+        }
+
+        for(int t = 1; t < o.nr_readers + 3; t++){
+                for(int i = 0; i < NR_OPS; i++){
+                        hist_merge(&hists[i], &hists[t * NR_OPS + i]);
+                }
+        }
+        report(hists.data(), (now_ns() - start) / 1e9);
+
+        for(auto &t : tables){
+                unlink(t->data_path.c_str());
+                unlink(t->index_path.c_str());
+        }
+        tables.clear();
+        return 0;
+}
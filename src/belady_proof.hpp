@@ -0,0 +1,46 @@
+#ifndef _BELADY_PROOF_HPP
+#define _BELADY_PROOF_HPP
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * Structures exchanged between a BELADY_PROOF build of the library and the
+ * cache simulator (tools/cache_sim). Plain C layout since the simulator
+ * dlopens the library and calls these through extern "C" symbols:
+ *
+ * int populate_inodes(struct mock_all_inodes *inode_list);
+ * int *mock_read(struct mock_read_event *event);
+ * struct mock_eviction_item *mock_eviction(void);  caller free()s the item
+ */
+
+struct mock_inode{
+        ino_t ino;
+        dev_t dev_id;
+};
+
+struct mock_all_inodes{
+        int nr_inodes;
+        struct mock_inode *inodes;      /*nr_inodes unique {ino, dev_id} pairs*/
+};
+
+struct mock_read_event{
+        ino_t ino;
+        dev_t dev_id;
+        off_t offset;
+        size_t size;
+        uint64_t timestamp;             /*rdtsc from the trace*/
+};
+
+/**
+ * One portion to evict. offset == 0 and size == 0 is the whole file,
+ * ino == 0 means the policy found no victim.
+ */
+struct mock_eviction_item{
+        ino_t ino;
+        dev_t dev_id;
+        off_t offset;
+        long size;
+};
+
+#endif //_BELADY_PROOF_HPP
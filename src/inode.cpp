@@ -2,11 +2,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <sched.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <limits.h>
 // #include <malloc.h>
 
+#include <algorithm>
 #include <iostream>
 #include <mutex>
 #include <new>
@@ -20,19 +22,32 @@
 #include "prefetch_evict.hpp"
 #include "inode.hpp"
 #include "utils/shim/shim.hpp"
+#include "utils/string_arena/string_arena.hpp"
+
+#ifdef ENABLE_EVICTION_YIELD
+#include "utils/evict_yield/evict_yield.hpp"
+#endif //ENABLE_EVICTION_YIELD
 
 
 struct trigger *nr_unlinks_for_imap_cleanup = nullptr;
 
-//lock for updates to i_map XXX:CHECK IF READERS WRITERS LOCK REQUIRED
-std::mutex i_map_lock;
-struct hashtable *i_map;
+/**
+ * i_map is sharded; each shard has its own lock.
+ * See utils/sharded_map/sharded_map.hpp
+ */
+inode_map_t *i_map;
 std::atomic_flag i_map_init;
 
-/*Required initialization for hashtable*/
-DEFINE_HASHTABLE_INSERT(insert_some, struct key, struct value);
-DEFINE_HASHTABLE_SEARCH(search_some, struct key, struct value);
-DEFINE_HASHTABLE_REMOVE(remove_some, struct key, struct value);
+const char EMPTY_UINODE_FILENAME[] = "";
+
+/**
+ * All uinode filenames live here. It is allocated on first use
+ * and never freed since uinodes may outlive static destructors.
+ */
+static StringArena *get_filename_arena(void){
+        static StringArena *filename_arena = new StringArena();
+        return filename_arena;
+}
 
 
 /**
@@ -47,30 +62,28 @@ static inline uint32_t fold64to32(uint64_t v) {
         return (uint32_t)v ^ (uint32_t)(v >> 32);
 }
 
-static inline unsigned int hashfromkey(void *ky)
+size_t key_hash::operator()(const struct key &k) const
 {
-        struct key *k = (struct key *)ky;
-
         /* --- dev_t -> 32-bit fold --- */
         uint32_t dev_fold;
         #if defined(__SIZEOF_DEV_T__) && (__SIZEOF_DEV_T__ > 4)
         {
-                uint64_t d = (uint64_t)k->dev_id;
+                uint64_t d = (uint64_t)k.dev_id;
                 dev_fold = fold64to32(d);
         }
         #else
-                dev_fold = (uint32_t)k->dev_id;
+                dev_fold = (uint32_t)k.dev_id;
         #endif
 
         /* --- ino_t -> 32-bit fold --- */
         uint32_t ino_fold;
         #if defined(__SIZEOF_INO_T__) && (__SIZEOF_INO_T__ > 4)
         {
-                uint64_t i = (uint64_t)k->ino;    /* ino_t may be 64-bit */
+                uint64_t i = (uint64_t)k.ino;    /* ino_t may be 64-bit */
                 ino_fold = fold64to32(i);
         }
         #else
-                ino_fold = (uint32_t)k->ino;          /* 32-bit (or smaller) ino_t */
+                ino_fold = (uint32_t)k.ino;          /* 32-bit (or smaller) ino_t */
         #endif
 
         /* --- pack into 64 bits and Murmur finalizer --- */
@@ -82,25 +95,29 @@ static inline unsigned int hashfromkey(void *ky)
         x *= 0xc4ceb9fe1a85ec53ULL;
         x ^= x >> 33;
 
-        return (unsigned int)x;  /* 32-bit table expects 32-bit hash */
+        /*all 64 bits are used: high bits pick the shard, low bits the bucket*/
+        return (size_t)x;
 }
 
-static int equalkeys(void *k1, void *k2){
-        struct key *key1 = (struct key *)k1;
-        struct key *key2 = (struct key *)k2;
-
-        return (key1->ino == key2->ino) && (key1->dev_id == key2->dev_id);
-}
+inode_map_t *init_inode_map(void){
+        inode_map_t *map = nullptr;
 
-struct hashtable *init_inode_map(void){
-        return create_hashtable(MAX_IMAP_FILES, hashfromkey, equalkeys);
+        try{
+                map = new inode_map_t(MAX_IMAP_FILES);
+        }catch(std::bad_alloc& e){
+                SPEEDYIO_FPRINTF("%s:ERROR Unable to allocate memory for i_map: %s\n", "SPEEDYIO_ERRCO_0213 %s\n", e.what());
+                map = nullptr;
+        }
+        return map;
 }
 
 
 /**
- * All operations on the i_map hashtable
+ * All operations on the i_map
  *
- * NOTE: i_map_lock management has to be handled by the caller
+ * Each of these take the lock of the shard {ino, dev_id} falls in.
+ * Callers that need a lookup and an insert to be atomic should take
+ * i_map->shard_lock() themselves and use the *_locked functions of i_map.
  */
 
 /*
@@ -111,21 +128,14 @@ struct hashtable *init_inode_map(void){
 int insert_to_hashtable(ino_t ino, dev_t dev_id, void *val){
 
         int ret = false;
-        struct key *key = (struct key*)malloc(sizeof(struct key));
-        struct value *v = (struct value *)malloc(sizeof(struct value));
+        struct key key;
+        struct value v;
 
-        if(!key || !v){
-                SPEEDYIO_FPRINTF("%s:ERROR unable to allocate memory\n", "SPEEDYIO_ERRCO_0089\n");
-                KILLME();
-                free(key);
-                free(v);
-                goto insert_to_hashtable_exit;
-        }
-        key->ino = ino;
-        key->dev_id = dev_id;
-        v->value = val;
+        key.ino = ino;
+        key.dev_id = dev_id;
+        v.value = val;
 
-        if(!insert_some(i_map, key, v)){
+        if(!i_map->insert(key, v)){
                 goto insert_to_hashtable_exit;
         }
 
@@ -137,7 +147,8 @@ insert_to_hashtable_exit:
 
 /*
  * takes the inode number and returns the struct value
- * returns NULL if some error occured
+ * returns NULL if not found.
+ * The returned value is valid until {ino, dev_id} is removed from i_map
  */
 struct value *get_from_hashtable(ino_t ino, dev_t dev_id){
 
@@ -146,7 +157,7 @@ struct value *get_from_hashtable(ino_t ino, dev_t dev_id){
         key.ino = ino;
         key.dev_id = dev_id;
 
-        val = search_some(i_map, &key);
+        val = i_map->find(key);
 
 get_from_hashtable_exit:
         return val;
@@ -154,185 +165,121 @@ get_from_hashtable_exit:
 
 
 /*
- * takes the inode number and removes its value from i_map
- * returns struct value *
- * it is the callers job to free struct value and its contents
+ * takes the inode number and removes it from i_map
+ * returns true if it was found
+ * it is the callers job to free the uinode it pointed to
  */
-struct value *remove_from_hashtable(ino_t ino, dev_t dev_id){
+bool remove_from_hashtable(ino_t ino, dev_t dev_id){
         struct key key;
-        struct value *val = nullptr;
 
         key.ino = ino;
         key.dev_id = dev_id;
 
-        val = remove_some(i_map, &key);
-
-remove_from_hashtable_exit:
-        return val;
+        return i_map->erase(key);
 }
 
 
 /**
  * Cleans uinodes which are not being used by anyone
+ *
+ * i_map is swept one shard at a time; opens of files in other
+ * shards proceed while a shard is being scanned.
  */
 void iter_i_map_and_put_unused(void){
-        int i = 0;
         int nr_uinodes_put = 0;
-        int nr_iterated = 0;
-        struct entry *entry = nullptr;
-        struct value *val = nullptr;
-        struct key *key = nullptr;
-        struct inode *uinode = nullptr;
-        struct inode *val_uinode = nullptr;
+        size_t nr_iterated = 0;
+        std::vector<struct inode *> to_put;
 
         // cprintf("%s:INFO Starting\n", __func__);
 
-continue_iterating:
-        i_map_lock.lock();
-
-        for (; i < i_map->tablelength; i++){
-                entry = i_map->table[i];
-                while (entry){
-                        key = nullptr;
-                        val = nullptr;
-                        uinode = nullptr;
-
-                        nr_iterated += 1;
-                        key = (struct key *)entry->k;
-                        if(!key){
-                                cfprintf(stderr, "%s:ERROR key is nullptr\n", __func__);
-                                goto get_next_entry;
-                        }
-
-                        val = (struct value *)entry->v;
-                        if(!val){
-                                cfprintf(stderr, "%s:ERROR for key->{ino:%lu, dev_id:%lu}, value is nullptr\n",
-                                                __func__, key->ino, key->dev_id);
-                                goto get_next_entry;
-                        }
-
-                        uinode = (struct inode *)val->value;
-                        if(!uinode){
-                                cfprintf(stderr, "%s:ERROR for key->{ino:%lu, dev_id:%lu}, uinode is nullptr\n",
-                                                __func__, key->ino, key->dev_id);
-                                goto get_next_entry;
-                        }
-
-                        // printf("key:{ino:%lu, dev:%lu} file:%s\n", key->ino, key->dev_id, uinode->filename);
-                        if(uinode->unlinked_lock.try_lock()){
-                                if(uinode->is_deleted()){
-                                        /**
-                                         * Since this uinode is_deleted.
-                                         * We can assume the following here since we are holding
-                                         * the uinode->unlinked_lock:
-                                         * 1. It has been completely unlinked, ie. not in the middle of it.
-                                         * 2. It has not been reused.
-                                         * 3. It is not being victimized by the evictor thread.
-                                         *
-                                         * Do some sanity checks before freeing the uinode.
-                                         */
-
-                                        /**
-                                         * nr_links should be == 1 because the final caller to
-                                         * unlink(filename) and close(fd) doesnt update the nr_links to 0.
-                                         */
-                                        if(uinode->nr_links > 1){
-                                                cfprintf(stderr, "%s:UNUSUAL {ino:%lu, dev_id:%lu} is deleted and nr_links:%lu.. Skipping\n",
-                                                        __func__, uinode->ino, uinode->dev_id, uinode->nr_links);
-
-                                                uinode->unlinked_lock.unlock();
-                                                goto get_next_entry;
-                                        }
-
-                                        /**
-                                         * There should be no fds in the fdlist_index.
-                                         * Else the uinode shouldnt have been is_deleted()
-                                         * in the first place.
-                                         */
-                                        if(uinode->fdlist_index >= 0){
-                                                cfprintf(stderr, "%s:UNUSUAL {ino:%lu, dev_id:%lu} is deleted and fdlist_index:%d.. Skipping\n",
-                                                        __func__, uinode->ino, uinode->dev_id, uinode->fdlist_index);
-
-                                                uinode->unlinked_lock.unlock();
-                                                goto get_next_entry;
-                                        }
-                                        goto put_uinode;
-                                }else{
-                                        /**
-                                         * It is a live uinode, not to be put.
-                                         */
-                                        uinode->unlinked_lock.unlock();
-                                        goto get_next_entry;
-                                }
-                        }
+        nr_iterated = i_map->erase_if([&to_put](const struct key &key, struct value &val) -> bool {
+                struct inode *uinode = (struct inode *)val.value;
 
-                        //Ignore this entry if unable to take unlinked_lock
-get_next_entry:
-                        entry = entry->next;
+                if(!uinode){
+                        cfprintf(stderr, "%s:ERROR for key->{ino:%lu, dev_id:%lu}, uinode is nullptr\n",
+                                        "iter_i_map_and_put_unused", key.ino, key.dev_id);
+                        return false;
                 }
-        }
 
-        //Done with all the elements of the i_map.
-        i_map_lock.unlock();
-        goto exit;
+                if(uinode->ino != key.ino || uinode->dev_id != key.dev_id){
+                        cfprintf(stderr, "%s:ERROR different uinode: key:{ino:%lu, dev_id:%lu}, uinode:{ino:%lu, dev_id:%lu}\n",
+                                        "iter_i_map_and_put_unused", key.ino, key.dev_id, uinode->ino, uinode->dev_id);
+                        KILLME();
+                        return false;
+                }
 
-put_uinode:
-        /**
-         * At this point we are holding the following locks:
-         * 1. i_map_lock - imap
-         * 2. uinode->unlinked_lock - this uinode
-         *
-         * Do the following:
-         * 0. Remove this uinode from the i_map, so no one sees this inode anymore
-         * 1. release i_map_lock, so others can work on it
-         * 2. Cleanup this uinode
-         * 3. Increment out nr_uinodes_cleaned counter
-         * 4. Go back to iterating through the imap
-         */
+                // printf("key:{ino:%lu, dev:%lu} file:%s\n", key.ino, key.dev_id, uinode->filename);
 
-        val = remove_from_hashtable(uinode->ino, uinode->dev_id);
-        i_map_lock.unlock();
+                //Ignore this entry if unable to take unlinked_lock
+                if(!uinode->unlinked_lock.try_lock()){
+                        return false;
+                }
 
-        val_uinode = (struct inode*)val->value;
-        if(!val_uinode){
-                cfprintf(stderr, "%s:ERROR got uinode nullptr from return_from_hashtable input: {ino:%lu, dev_id:%lu}\n",
-                                __func__, uinode->ino, uinode->dev_id);
-                KILLME();
-        }
-        if(uinode != val_uinode
-                || uinode->ino != val_uinode->ino
-                || uinode->dev_id != val_uinode->dev_id
-        ){
-                cfprintf(stderr, "%s:ERROR different uinode: remove_from_hashtable input:{ino:%lu, dev_id:%lu}, returned:{ino:%lu, dev_id:%lu}\n",
-                                __func__, uinode->ino, uinode->dev_id, val_uinode->ino, val_uinode->dev_id);
-                KILLME();
-        }
+                if(!uinode->is_deleted()){
+                        /**
+                         * It is a live uinode, not to be put.
+                         */
+                        uinode->unlinked_lock.unlock();
+                        return false;
+                }
 
-        //fprintf(stderr, "%s:INFO freeing uinode for file:%s ino:%d\n", __func__, uinode->filename, uinode->ino);
+                /**
+                 * Since this uinode is_deleted.
+                 * We can assume the following here since we are holding
+                 * the uinode->unlinked_lock:
+                 * 1. It has been completely unlinked, ie. not in the middle of it.
+                 * 2. It has not been reused.
+                 * 3. It is not being victimized by the evictor thread.
+                 *
+                 * Do some sanity checks before freeing the uinode.
+                 */
 
-        delete val_uinode;
-        free(val);
+                /**
+                 * nr_links should be == 1 because the final caller to
+                 * unlink(filename) and close(fd) doesnt update the nr_links to 0.
+                 */
+                if(uinode->nr_links > 1){
+                        cfprintf(stderr, "%s:UNUSUAL {ino:%lu, dev_id:%lu} is deleted and nr_links:%lu.. Skipping\n",
+                                "iter_i_map_and_put_unused", uinode->ino, uinode->dev_id, uinode->nr_links);
 
-        // printf("%s:INFO deleted ino:%lu\n", __func__, val_uinode->ino);
+                        uinode->unlinked_lock.unlock();
+                        return false;
+                }
 
-        nr_uinodes_put += 1;
+                /**
+                 * There should be no fds in the fdlist_index.
+                 * Else the uinode shouldnt have been is_deleted()
+                 * in the first place.
+                 */
+                if(uinode->fdlist_index >= 0){
+                        cfprintf(stderr, "%s:UNUSUAL {ino:%lu, dev_id:%lu} is deleted and fdlist_index:%d.. Skipping\n",
+                                "iter_i_map_and_put_unused", uinode->ino, uinode->dev_id, uinode->fdlist_index);
 
-        val_uinode = nullptr;
-        uinode = nullptr;
-        val = nullptr;
+                        uinode->unlinked_lock.unlock();
+                        return false;
+                }
 
+                /**
+                 * Removed from i_map with its shard lock and unlinked_lock held,
+                 * so no one can find it anymore. It is freed after the sweep.
+                 */
+                uinode->unlinked_lock.unlock();
+                to_put.push_back(uinode);
+                return true;
+        });
 
-        /**
-         * Here we will miss if there are multiple entries in the same bucket
-         * in i_map, but that is fine; we can get that in the next sweep
-         */
-        i += 1;
-        goto continue_iterating;
+        for(struct inode *uinode : to_put){
+                //fprintf(stderr, "%s:INFO freeing uinode for file:%s ino:%d\n", __func__, uinode->filename, uinode->ino);
+#ifdef ENABLE_EVICTION_YIELD
+                yield_forget(uinode->dev_id, uinode->ino);
+#endif //ENABLE_EVICTION_YIELD
+                delete uinode;
+                nr_uinodes_put += 1;
+        }
 
-exit:
         if(nr_iterated > 0)
         {
-                cprintf("%s:INFO nr_uinodes_put:%d out of nr_iterated:%d\n", __func__, nr_uinodes_put, nr_iterated);
+                cprintf("%s:INFO nr_uinodes_put:%d out of nr_iterated:%zu\n", __func__, nr_uinodes_put, nr_iterated);
         }else{
                 cprintf("%s: exiting\n", __func__);
         }
@@ -405,6 +352,7 @@ sleep:
  * uses get_from_hashtable to return the struct inode associated with ino and dev_id
  */
 struct inode *get_uinode_from_hashtable(ino_t ino, dev_t dev_id){
+        struct key key;
         struct value *uinode_exists = nullptr;
         struct inode *uinode = nullptr;
 
@@ -413,9 +361,12 @@ struct inode *get_uinode_from_hashtable(ino_t ino, dev_t dev_id){
                 goto exit_get_uinode_from_hashtable;
         }
 
-        i_map_lock.lock();
+        key.ino = ino;
+        key.dev_id = dev_id;
 
-        uinode_exists = get_from_hashtable(ino, dev_id);
+        i_map->shard_lock(key).lock();
+
+        uinode_exists = i_map->find_locked(key);
         if(uinode_exists){
                 uinode = (struct inode*)uinode_exists->value;
                 if(unlikely(!uinode)){
@@ -433,7 +384,7 @@ struct inode *get_uinode_from_hashtable(ino_t ino, dev_t dev_id){
         }
 
 unlock_and_exit_get_uinode_from_hashtable:
-        i_map_lock.unlock();
+        i_map->shard_lock(key).unlock();
 
 exit_get_uinode_from_hashtable:
         return uinode;
@@ -446,6 +397,11 @@ void alloc_bitmap(struct inode *uinode){
         if(likely(uinode)){
                 uinode->cache_rwlock.lock_write();
 
+                /*with ENABLE_LAZY_PVT_HEAP the first reads of a file race to get here*/
+                if(uinode->cache_state){
+                        goto alloc_bitmap_unlock_exit;
+                }
+
                 uinode->cache_state = BitArrayCreate(NR_BITMAP_BITS);
                 if(unlikely(!uinode->cache_state)){
                         SPEEDYIO_FPRINTF("%s:ERROR Unable to allocate memory for bitmap\n", "SPEEDYIO_ERRCO_0094\n");
@@ -502,10 +458,24 @@ void set_range_bitmap(struct inode *uinode, unsigned long start_bit, unsigned lo
          *
          *TODO:Range Locks for bitmaps if this approximation is not working
          */
+#ifdef ENABLE_LAZY_PVT_HEAP
+set_range_bitmap_retry:
+#endif //ENABLE_LAZY_PVT_HEAP
         uinode->cache_rwlock.lock_read();
         if(likely(uinode->cache_state)){
                 BitArraySetRange(uinode->cache_state, start_bit, num_bits);
         }
+#ifdef ENABLE_LAZY_PVT_HEAP
+        else{
+                /*first read or write of the file*/
+                uinode->cache_rwlock.unlock_read();
+                alloc_bitmap(uinode);
+                if(likely(uinode->cache_state)){
+                        goto set_range_bitmap_retry;
+                }
+                goto set_range_bitmap_exit;
+        }
+#endif //ENABLE_LAZY_PVT_HEAP
         uinode->cache_rwlock.unlock_read();
 
 set_range_bitmap_exit:
@@ -533,6 +503,13 @@ clear_range_bitmap_exit:
 bool clear_full_bitmap(struct inode *uinode){
         bool ret = true;
 
+#ifdef ENABLE_LAZY_PVT_HEAP
+        /*not read or written since it was opened, nothing to clear*/
+        if(likely(uinode) && !uinode->cache_state){
+                goto exit_clear_full_bitmap;
+        }
+#endif //ENABLE_LAZY_PVT_HEAP
+
         if(unlikely(!uinode || !uinode->cache_state)){
                 SPEEDYIO_FPRINTF("%s:ERROR uinode==NULL or uinode->cache_state==NULL", "SPEEDYIO_ERRCO_0095");
                 ret = false;
@@ -658,8 +635,8 @@ bool sanitize_uinode(struct inode *uinode){
         uinode->last_access_tstamp = ticks_now();
         uinode->nr_evictions = 0;
 
-        sanitize_struct_trigger(uinode->gheap_trigger);
-        uinode->gheap_trigger->step = G_HEAP_FREQ;
+        sanitize_struct_trigger(&uinode->gheap_trigger);
+        uinode->gheap_trigger.step = G_HEAP_FREQ;
 
 #ifdef ENABLE_PVT_HEAP
         if(!clear_pvt_heap(uinode)){
@@ -672,13 +649,15 @@ bool sanitize_uinode(struct inode *uinode){
 #endif //ENABLE_EVICTION
 
 #ifdef ENABLE_MINCORE_DEBUG
-        uinode->mmap_addr = nullptr; // Initialize mmap address to nullptr
-        uinode->mmap_fd = -1; // Initialize mmap fd to -1
+        if(uinode->cold){
+                uinode->cold->mmap_addr = nullptr; // Initialize mmap address to nullptr
+                uinode->cold->mmap_fd = -1; // Initialize mmap fd to -1
+        }
 #endif // ENABLE_MINCORE_DEBUG
 
         uinode->ino = 0UL;
         uinode->dev_id = 0UL;
-        memset(uinode->filename, 0, PATH_MAX);
+        set_uinode_filename(uinode, nullptr);
         uinode->unlinked = false;
         uinode->marked_unlinked = false;
         uinode->nr_links = 0;
@@ -722,12 +701,12 @@ exit_update_nr_links:
  * add new if it doesn't exist.
  * returns true if done successfully, else false.
  */
-bool add_fd_to_fdlist(struct inode *uinode, int fd, int open_flags, off_t seek_head){
+bool add_fd_to_fdlist(struct inode *uinode, int fd, int open_flags){
         bool ret = true;
         int i;
 
-        if(fd < 3 || seek_head < 0){
-                SPEEDYIO_FPRINTF("%s:ERROR fd:%d or seek_head:%ld input is insane\n", "SPEEDYIO_ERRCO_0101 %d %ld\n", fd, seek_head);
+        if(fd < 3){
+                SPEEDYIO_FPRINTF("%s:ERROR fd:%d input is insane\n", "SPEEDYIO_ERRCO_0101 %d\n", fd);
                 ret = false;
                 KILLME();
                 goto exit_add_fd_to_fdlist;
@@ -747,8 +726,8 @@ bool add_fd_to_fdlist(struct inode *uinode, int fd, int open_flags, off_t seek_h
                 if(uinode->fdlist[i].fd == fd){
                         /**
                          * Duplicate open for the same file returning the same fd.
-                         * Since two threads with the same fd share the same seek_head
-                         * We should not change anything here.
+                         * Since two threads with the same fd share the same open file
+                         * description, we should not change anything here.
                          */
                         SPEEDYIO_FPRINTF("%s:WARNING same fd:%d being added to {ino:%lu, dev:%lu} again\n", "SPEEDYIO_WARNCO_0006 %d %lu %lu\n", fd, uinode->ino, uinode->dev_id);
                         goto unlock_exit;
@@ -769,10 +748,35 @@ bool add_fd_to_fdlist(struct inode *uinode, int fd, int open_flags, off_t seek_h
                 goto unlock_exit;
         }
 
+        /*fdlist is full; double it*/
+        if(uinode->fdlist_index >= uinode->fdlist_cap){
+                struct fd_info *new_fdlist;
+                int new_cap = uinode->fdlist_cap * 2;
+
+                if(new_cap > MAX_FD_PER_INODE){
+                        new_cap = MAX_FD_PER_INODE;
+                }
+
+                try{
+                        new_fdlist = new struct fd_info[new_cap];
+                }catch(std::bad_alloc& e){
+                        SPEEDYIO_FPRINTF("%s:ERROR unable to grow fdlist to %d for {ino:%lu, dev:%lu}: %s\n", "SPEEDYIO_ERRCO_0214 %d %lu %lu %s\n", new_cap, uinode->ino, uinode->dev_id, e.what());
+                        uinode->fdlist_index -= 1;
+                        ret = false;
+                        goto unlock_exit;
+                }
+
+                memcpy(new_fdlist, uinode->fdlist, uinode->fdlist_cap*sizeof(struct fd_info));
+                if(uinode->fdlist != uinode->fdlist_inline){
+                        delete[] uinode->fdlist;
+                }
+                uinode->fdlist = new_fdlist;
+                uinode->fdlist_cap = new_cap;
+        }
+
         /*all checks done, adding new fd to fdlist*/
         uinode->fdlist[uinode->fdlist_index].fd = fd;
         uinode->fdlist[uinode->fdlist_index].open_flags = open_flags;
-        uinode->fdlist[uinode->fdlist_index].seek_head = seek_head;
         uinode->fdlist[uinode->fdlist_index].fadv_seq = true; //OS assumes a new fd to be sequential
 unlock_exit:
         uinode->fdlist_lock.unlock();
@@ -814,13 +818,11 @@ int remove_fd_from_fdlist(struct inode *uinode, int fd){
                         /*found this fd.*/
                         if(i == uinode->fdlist_index){
                                 uinode->fdlist[i].fd = -1;
-                                uinode->fdlist[i].seek_head = -1;
                                 uinode->fdlist[i].open_flags = -1;
                                 uinode->fdlist[i].fadv_seq = -1;
                         }else{
                                 uinode->fdlist[i].fd = uinode->fdlist[uinode->fdlist_index].fd;
                                 uinode->fdlist[i].open_flags = uinode->fdlist[uinode->fdlist_index].open_flags;
-                                uinode->fdlist[i].seek_head = uinode->fdlist[uinode->fdlist_index].seek_head;
                                 uinode->fdlist[i].fadv_seq = uinode->fdlist[uinode->fdlist_index].fadv_seq;
                         }
                         ret = 1;
@@ -850,7 +852,7 @@ bool clear_uinode_fdlist(struct inode *uinode){
         uinode->fdlist_lock.lock();
         uinode->fdlist_index = -1;
         if(likely(uinode->fdlist)){
-                memset(uinode->fdlist, 0, MAX_FD_PER_INODE*sizeof(struct fd_info));
+                std::fill_n(uinode->fdlist, uinode->fdlist_cap, fd_info());
         }else{
                 SPEEDYIO_FPRINTF("%s:ERROR {ino:%lu, dev:%lu} fdlist is nullptr\n", "SPEEDYIO_ERRCO_0096 %lu %lu\n", uinode->ino, uinode->dev_id);
                 ret = false;
@@ -863,106 +865,6 @@ exit_clear_uinode_fdlist:
         return ret;
 }
 
-/**
- * assuming there has been a read or write, update the seek head of that fd
- * in this uinode. returns the old offset.
- *
- * if set_to == true -> new seek_head = bytes.
- * else seek_head += bytes
- *
- * returned value will be -1 if error.
- * 
- * Note: In 64 bit machines the following is the implementation:
- * 1. off_t - long long int (64 bit)
- * 2. size_t - unsigned long long int (64 bit)
- * 3. ssize_t - long long int (64 bit)
- * So conversion between ssize_t and off_t is okay
- * Conversion of a off_t to size_t is okay
- * Conversion of size_t to off_t is okay only if it < 2^63 - 1
- * else, the value will overflow 
- */
-ssize_t update_fd_seek_pos(struct inode *uinode, int fd, off_t bytes, bool set_to){
-
-        ssize_t ret = -1;
-#ifdef DEBUG_SEEK_POS
-        ssize_t curr_pos;
-        off_t seek_pos;
-#endif
-        int i;
-
-        if(fd < 3){
-                SPEEDYIO_FPRINTF("%s:ERROR fd:%d input is insane\n", "SPEEDYIO_ERRCO_0106 %d\n", fd);
-                goto exit_update_fd_seek_pos;
-        }
-
-        if(!uinode){
-                SPEEDYIO_FPRINTF("%s:ERROR uinode is nullptr\n", "SPEEDYIO_ERRCO_0107\n");
-                goto exit_update_fd_seek_pos;
-        }
-
-        uinode->fdlist_lock.lock();
-        for(i = 0; i <= uinode->fdlist_index; i++){
-                if(uinode->fdlist[i].fd == fd){
-                        ret = uinode->fdlist[i].seek_head;
-
-                        if(set_to){
-                                uinode->fdlist[i].seek_head = bytes;
-                        }else{
-                                /*forward read/write. add bytes.*/
-                                uinode->fdlist[i].seek_head += bytes;
-                        }
-#ifdef DEBUG_SEEK_POS
-                                curr_pos = uinode->fdlist[i].seek_head;
-                                seek_pos = real_lseek(fd, 0, SEEK_CUR);
-                                if(curr_pos != seek_pos){
-                                        SPEEDYIO_FPRINTF("%s:ERROR fd:%d curr_pos:%ld whereas ground truth:%lu\n", "SPEEDYIO_ERRCO_0108 %d %ld %lu\n", fd, curr_pos, seek_pos);
-                                        KILLME();
-                                }
-#endif //DEBUG_SEEK_POS
-                }
-        }
-        uinode->fdlist_lock.unlock();
-
-        if(unlikely(ret == -1)){
-                SPEEDYIO_FPRINTF("%s:ERROR unable to find fd:%d in {ino:%lu, dev:%lu}\n", "SPEEDYIO_ERRCO_0109 %d %lu %lu\n", fd, uinode->ino, uinode->dev_id);
-                goto exit_update_fd_seek_pos;
-        }
-
-        if(unlikely(ret < 0)){
-                ret = -1;
-                SPEEDYIO_FPRINTF("%s:ERROR seek_head has overflown for fd:%d {ino:%lu, dev:%lu} seek_head:%ld\n", "SPEEDYIO_ERRCO_0110 %d %lu %lu %ld\n", fd, uinode->ino, uinode->dev_id,ret);
-                goto exit_update_fd_seek_pos;
-        }
-
-exit_update_fd_seek_pos:
-        return ret;
-}
-
-/*Resets the seek_heads*/
-bool reset_all_fd_seek_pos(struct inode *uinode){
-        bool ret = true;
-        int i;
-
-        if(!uinode){
-                SPEEDYIO_FPRINTF("%s:ERROR uinode is not valid\n", "SPEEDYIO_ERRCO_0111\n");
-                ret = false;
-                goto exit_reset_all_fd_seek_pos;
-        }
-
-        uinode->fdlist_lock.lock();
-        for(i = 0; i <= uinode->fdlist_index; i++){
-                uinode->fdlist[i].seek_head = 0;
-        }
-        uinode->fdlist_lock.unlock();
-
-        debug_printf("%s: {ino:%lu, dev:%lu} reset %d fd's seek_heads to 0\n",
-                        __func__, uinode->ino, uinode->dev_id, i+1);
-
-exit_reset_all_fd_seek_pos:
-        return ret;
-}
-
-
 /**
  * finds the fd in this uinode's fdlist and returns the open flags
  * returns -1 if fd was not found in fdlist
@@ -1083,16 +985,63 @@ exit_set_fadv_on_fd_uinode:
 }
 
 
+/**
+ * Replaces the uinode's filename with an interned copy of filename.
+ * filename == nullptr just drops the old one.
+ * returns false if the new name could not be interned;
+ * the uinode is then left with EMPTY_UINODE_FILENAME.
+ *
+ * The old name's arena slot is reused right away, possibly for another
+ * file's name. Code that acts on the name (opens the file, compares
+ * paths) must read it with get_uinode_filename; a plain read of
+ * uinode->filename is only good for log messages.
+ */
+bool set_uinode_filename(struct inode *uinode, const char *filename){
+        const char *new_filename;
+
+        new_filename = get_filename_arena()->exchange(&uinode->filename, filename, EMPTY_UINODE_FILENAME);
+        return !filename || new_filename;
+}
+
+/**
+ * Copies the uinode's filename into buf; it is either the name before
+ * or after a concurrent set_uinode_filename, never another file's.
+ * Returns false if it did not fit.
+ */
+bool get_uinode_filename(struct inode *uinode, char *buf, size_t size){
+        return get_filename_arena()->copy(&uinode->filename, buf, size) < size;
+}
+
+/**
+ * Returns one of the open fds of this uinode, -1 if none is open.
+ * Used by the evictor which does fadvise on any fd of the file.
+ */
+int get_any_fd_from_uinode(struct inode *uinode){
+        int fd = -1;
+
+        uinode->fdlist_lock.lock();
+        if(uinode->fdlist_index >= 0){
+                fd = uinode->fdlist[0].fd;
+        }
+        uinode->fdlist_lock.unlock();
+
+        return fd;
+}
+
 /**
  * Adds a new uinode to i_map and/or updates an existing uinode with new fd
+ * seek_head_out (if not nullptr) gets the initial seek head for this fd.
  */
-struct inode *add_fd_to_inode(int fd, int open_flags, const char *filename){
+struct inode *add_fd_to_inode(int fd, int open_flags, const char *filename, off_t *seek_head_out){
         ino_t ino;
         dev_t dev_id;
         int err;
         struct stat file_stat;
+        struct key key;
+        imap_lock_t *shard_lock = nullptr;
         struct value *uinode_exists = nullptr;
         struct inode *uinode = nullptr;
+        struct inode *new_uinode = nullptr;
         struct inode *ret = nullptr;
         bool allocated_new_uinode = false;
         off_t seek_head = 0;
@@ -1138,32 +1087,70 @@ struct inode *add_fd_to_inode(int fd, int open_flags, const char *filename){
                 seek_head = 0;
         }
 
+        key.ino = ino;
+        key.dev_id = dev_id;
+        shard_lock = &i_map->shard_lock(key);
+
         /**
-         * XXX: Optimize this very large i_map_lock critical section.
-         *
-         * This is to prevent a potential race condition leading to duplicate entries
-         * in the i_map since many threads could be opening the same file {ino, dev_id}
-         * for the first time together.
+         * The shard lock of {ino, dev_id} is held from the lookup till the
+         * uinode is in i_map, so that many threads opening the same file for
+         * the first time together don't insert duplicates. Opens of files in
+         * other shards are not blocked.
          */
-        i_map_lock.lock();
+lookup_uinode:
+        shard_lock->lock();
 
-        uinode_exists = get_from_hashtable(ino, dev_id);
+        uinode_exists = i_map->find_locked(key);
         if(!uinode_exists){
-alloc_new_uinode:
-                /*Allocating a new uinode*/
-                debug_printf("%s: Allocating new struct uinode for {ino:%lu, dev:%lu}\n", __func__, ino, dev_id);
-                try{
-                        uinode = new struct inode;
-                        allocated_new_uinode = true;
-                }catch(std::bad_alloc& e){
-                        SPEEDYIO_FPRINTF("%s:ERROR Unable to allocate memory for inode: %s\n", "SPEEDYIO_ERRCO_0116 %s\n", e.what());
-                        uinode = nullptr;
-                        goto exit_add_fd_to_inode;
+                if(!new_uinode){
+                        /**
+                         * Allocating and initializing a new uinode (pvt heap, bitmap)
+                         * is done without the shard lock. If someone else inserts
+                         * {ino, dev_id} meanwhile, this one is freed at exit.
+                         */
+                        shard_lock->unlock();
+
+                        debug_printf("%s: Allocating new struct uinode for {ino:%lu, dev:%lu}\n", __func__, ino, dev_id);
+                        try{
+                                new_uinode = new struct inode;
+                        }catch(std::bad_alloc& e){
+                                SPEEDYIO_FPRINTF("%s:ERROR Unable to allocate memory for inode: %s\n", "SPEEDYIO_ERRCO_0116 %s\n", e.what());
+                                new_uinode = nullptr;
+                                goto exit_add_fd_to_inode;
+                        }
+
+#ifdef ENABLE_LAZY_PVT_HEAP
+                        /**
+                         * Most files opened at startup are never read
+                         * before a compaction replaces them. The bitmap
+                         * and pvt heap are allocated at the first
+                         * read or write (set_range_bitmap, update_pvt_heap).
+                         */
+#else
+
+#ifdef ENABLE_PER_INODE_BITMAP
+                        alloc_bitmap(new_uinode);
+#endif //ENABLE_PER_INODE_BITMAP
+
+#if defined(ENABLE_EVICTION) && (defined(ENABLE_PVT_HEAP) || (defined(ENABLE_ONE_LRU) && defined(BELADY_PROOF)))
+                        /*init_pvt_heap names the heap after the ino*/
+                        new_uinode->ino = ino;
+                        new_uinode->dev_id = dev_id;
+                        init_pvt_heap(new_uinode);
+#endif //ENABLE_EVICTION && ENABLE_PVT_HEAP or (ENABLE_ONE_LRU && BELADY_PROOF)
+
+#endif //ENABLE_LAZY_PVT_HEAP
+
+                        goto lookup_uinode;
                 }
 
+                uinode = new_uinode;
+                new_uinode = nullptr;
+                allocated_new_uinode = true;
+
                 /**
                  * Since this is a newly allocated uinode and has not been
-                 * added to the hashtable, no one knows about it; so this
+                 * added to the i_map, no one knows about it; so this
                  * lock doesnt do anything. It is just to keep locking
                  * consistent with older uinodes received from other paths
                  * of this function.
@@ -1176,6 +1163,7 @@ alloc_new_uinode:
         uinode = (struct inode*)uinode_exists->value;
         if(unlikely(!uinode)){
                 SPEEDYIO_FPRINTF("%s:ERROR inode entry exists but no valid uinode {ino:%lu, dev:%lu} for fd:%d\n", "SPEEDYIO_ERRCO_0117 %lu %lu %d\n", ino, dev_id, fd);
+                shard_lock->unlock();
                 goto exit_add_fd_to_inode;
         }
 
@@ -1189,17 +1177,21 @@ retry_lock:
                          * 2. The file is being victimized for eviction
                          * 3. Is being unlinked [check_fdlist_and_unlink]
                          *
-                         * Just retry lock. It should reveal whats up with the
-                         * uinode. If failed MAX_LOCK_RETRIES times, log it.
+                         * 1 and 3 are short, retry the lock. The evictor holds
+                         * unlinked_lock for a whole evict_portions, so after
+                         * MAX_LOCK_RETRIES release the shard lock, let it finish
+                         * and look the uinode up again; it may be gone by then.
                          */
                         nr_unlinked_lock_retries += 1;
 
                         if(nr_unlinked_lock_retries > MAX_LOCK_RETRIES){
-                                cfprintf(stderr, "%s:UNUSUAL THIS SHOULD NOT HAPPEN unable to take unlinked_lock "
-                                        "on undeleted uinode->{ino:%lu, dev_id:%lu}, "
-                                        "passed{ino:%lu, dev_id:%lu}. fd:%d, filename:%s retried %d times\n",
-                                        __func__, uinode->ino, uinode->dev_id, ino, dev_id, fd, filename, nr_unlinked_lock_retries);
-                                KILLME();
+                                debug_fprintf(stderr, "%s:INFO unlinked_lock busy on uinode->{ino:%lu, dev_id:%lu} "
+                                        "fd:%d, filename:%s retried %d times\n",
+                                        __func__, uinode->ino, uinode->dev_id, fd, filename, nr_unlinked_lock_retries);
+                                nr_unlinked_lock_retries = 0;
+                                shard_lock->unlock();
+                                sched_yield();
+                                goto lookup_uinode;
                         }
                         goto retry_lock;
                 }else{
@@ -1208,8 +1200,8 @@ retry_lock:
                          * Which can mean that it is being put [iter_i_map_and_put_unused]
                          *
                          * Ideally this state CANNOT be reached since iter_i_map_and_put_unused
-                         * takes i_map.lock() before starting to scan and the uinode to be put
-                         * is first removed from the i_map before i_map.unlock().
+                         * takes the shard lock before scanning a shard and the uinode to be put
+                         * is removed from the i_map before the shard lock is released.
                          *
                          * For EXT4, inode numbers are not repeated frequently
                          * but for XFS, they are reused aggressively. I have observed
@@ -1283,11 +1275,11 @@ retry_lock:
                         }
 #endif //ENABLE_EVICTION && ENABLE_PVT_HEAP
 
-                        //all existing fds related to this uinode will seek back to 0
-                        if(!reset_all_fd_seek_pos(uinode)){
-                                SPEEDYIO_FPRINTF("%s:ERROR unable to reset_all_fd_seek_pos on existing {ino:%lu, dev:%lu}\n", "SPEEDYIO_ERRCO_0121 %lu %lu\n", uinode->ino, uinode->dev_id);
-                                KILLME();
-                        }
+                        /**
+                         * Seek heads of the other fds are not touched; the kernel
+                         * doesn't move the offset of other open file descriptions
+                         * on O_TRUNC either.
+                         */
                 }
                 goto update_uinode;
         }
@@ -1297,23 +1289,24 @@ populate_full_uinode:
         uinode->dev_id = dev_id;
 
         /*adding filename in uinode*/
-        strncpy(uinode->filename, filename, PATH_MAX-1);
-        uinode->filename[PATH_MAX-1] = '\0';
+        if(!set_uinode_filename(uinode, filename)){
+                SPEEDYIO_FPRINTF("%s:ERROR unable to intern filename for {ino:%lu, dev:%lu}\n", "SPEEDYIO_ERRCO_0215 %lu %lu\n", ino, dev_id);
+        }
 
-        /*if this is a new uinode, we need to allocate heap and bitmap*/
-        if(allocated_new_uinode){
-#ifdef ENABLE_PER_INODE_BITMAP
-                alloc_bitmap(uinode);
-#endif //ENABLE_PER_INODE_BITMAP
+#ifdef ENABLE_CACHE_CLASSES
+        /*new or sanitized uinode, so it is not in any global heap yet*/
+        uinode->cache_class = get_cache_class_id(uinode->filename);
+#endif //ENABLE_CACHE_CLASSES
 
-#if defined(ENABLE_EVICTION) && (defined(ENABLE_PVT_HEAP) || (defined(ENABLE_ONE_LRU) && defined(BELADY_PROOF)))
-                init_pvt_heap(uinode);
-#endif //ENABLE_EVICTION && ENABLE_PVT_HEAP or (ENABLE_ONE_LRU && BELADY_PROOF)
-        }
+#ifdef ENABLE_FILE_ROLE_TIERS
+        uinode->file_role = get_file_role(uinode->filename);
+#endif //ENABLE_FILE_ROLE_TIERS
+
+        /*a new uinode already has its heap and bitmap allocated in lookup_uinode*/
 
 update_uinode:
         /*Add this fd to this uinode's fdlist*/
-        if(!add_fd_to_fdlist(uinode, fd, open_flags, seek_head)){
+        if(!add_fd_to_fdlist(uinode, fd, open_flags)){
                 SPEEDYIO_FPRINTF("%s:ERROR add_fd_to_fdlist fd:%d to {ino:%lu, dev:%lu}\n", "SPEEDYIO_ERRCO_0122 %d %lu %lu\n", fd, uinode->ino, uinode->dev_id);
                 uinode = nullptr;
                 KILLME();
@@ -1330,19 +1323,25 @@ update_uinode:
         update_mmap_fd(uinode);
 #endif // ENABLE_MINCORE_DEBUG
         if(allocated_new_uinode){
-                /**
-                 * TODO: Should check if {ino, dev_id} is already in the hashtable
-                 * to avoid duplicates.
-                 */
-                if(!insert_to_hashtable(ino, dev_id, (void*)uinode)){
-                        SPEEDYIO_FPRINTF("%s:ERROR unable to insert {ino:%lu, dev:%lu} to hashtable\n", "SPEEDYIO_ERRCO_0124 %lu %lu\n", ino, dev_id);
+                /*shard lock is held since the lookup found no {ino, dev_id}*/
+                struct value v;
+                v.value = (void*)uinode;
+                if(!i_map->insert_locked(key, v)){
+                        SPEEDYIO_FPRINTF("%s:ERROR unable to insert {ino:%lu, dev:%lu} to i_map\n", "SPEEDYIO_ERRCO_0124 %lu %lu\n", ino, dev_id);
                         KILLME();
                 }
         }
         uinode->unlinked_lock.unlock();
-        i_map_lock.unlock();
+        shard_lock->unlock();
 
 exit_add_fd_to_inode:
+        if(seek_head_out){
+                *seek_head_out = seek_head;
+        }
+        /*lost the race to insert {ino, dev_id}; no one else has seen this one*/
+        if(new_uinode){
+                delete new_uinode;
+        }
         ret = uinode;
         return ret;
 }
@@ -1364,16 +1363,28 @@ void _dest_pvt_heap(struct inode *uinode){
         }
 
         uinode->file_heap_lock.lock();
+        forget_resident_portions(uinode);
         if(likely(uinode->file_heap)){
                 destroy_pvt_heap(uinode->file_heap);
                 uinode->file_heap = nullptr;
         }
+#ifdef ENABLE_EXTENT_INDEX
+        if(likely(uinode->extents)){
+                delete uinode->extents;
+                uinode->extents = nullptr;
+        }
+#else
         if(likely(uinode->file_heap_node_ids)){
                 uinode->file_heap_node_ids->clear();
                 uinode->file_heap_node_ids->shrink_to_fit();
                 delete uinode->file_heap_node_ids;
                 uinode->file_heap_node_ids = nullptr;
         }
+#endif //ENABLE_EXTENT_INDEX
+#ifdef ENABLE_DIRTY_TRACKING
+        delete uinode->dirty;
+        uinode->dirty = nullptr;
+#endif //ENABLE_DIRTY_TRACKING
         uinode->file_heap_lock.unlock();
 exit_dest_pvt_heap:
         return;
@@ -1385,16 +1396,19 @@ void allocate_mmap(struct inode* uinode) {
         if (uinode == nullptr) {
                 throw std::invalid_argument("Null inode pointer passed to allocate_mmap");
         }
-        if (uinode->mmap_addr != nullptr) {
+        if (uinode->cold == nullptr) {
+                uinode->cold = new struct inode_cold;
+        }
+        if (uinode->cold->mmap_addr != nullptr) {
                 throw std::runtime_error("mmap_addr is already valid");
         }
         if (uinode->fdlist_index < 0) {
                 throw std::runtime_error("No valid fd available for mmap");
         }
 
-        uinode->mmap_fd = uinode->fdlist[0].fd; // Use the first valid fd
+        uinode->cold->mmap_fd = uinode->fdlist[0].fd; // Use the first valid fd
         size_t mmap_length = NR_BITMAP_BITS * PAGESIZE;
-        //printf("mmap_fd = %d, mmap_length = %zu\n", uinode->mmap_fd, mmap_length);
+        //printf("mmap_fd = %d, mmap_length = %zu\n", uinode->cold->mmap_fd, mmap_length);
         int prot_flags = 0;
         if (uinode->fdlist[0].open_flags & O_RDONLY) {
                 prot_flags |= PROT_READ;
@@ -1406,9 +1420,9 @@ void allocate_mmap(struct inode* uinode) {
                 prot_flags |= PROT_READ | PROT_WRITE;
         }
 
-        uinode->mmap_addr = real_mmap(nullptr, mmap_length, prot_flags, MAP_SHARED, uinode->mmap_fd, 0);
-        if (uinode->mmap_addr == MAP_FAILED) {
-                uinode->mmap_addr = nullptr;
+        uinode->cold->mmap_addr = real_mmap(nullptr, mmap_length, prot_flags, MAP_SHARED, uinode->cold->mmap_fd, 0);
+        if (uinode->cold->mmap_addr == MAP_FAILED) {
+                uinode->cold->mmap_addr = nullptr;
                 std::string error_message = "mmap failed: ";
                 error_message += strerror(errno);
                 error_message += " | open_flags: ";
@@ -1439,11 +1453,11 @@ void free_mmap(struct inode* uinode) {
     if (uinode == nullptr) {
         throw std::invalid_argument("Null inode pointer passed to free_mmap");
     }
-    if (uinode->mmap_addr != nullptr) {
+    if (uinode->cold != nullptr && uinode->cold->mmap_addr != nullptr) {
         size_t mmap_length = NR_BITMAP_BITS * PAGESIZE;
-        munmap(uinode->mmap_addr, mmap_length);
-        uinode->mmap_addr = nullptr;
-        uinode->mmap_fd = -1;
+        munmap(uinode->cold->mmap_addr, mmap_length);
+        uinode->cold->mmap_addr = nullptr;
+        uinode->cold->mmap_fd = -1;
     }
 }
 
@@ -1451,13 +1465,13 @@ std::vector<bool> check_mincore(struct inode* uinode) {
     if (uinode == nullptr) {
         throw std::invalid_argument("Null inode pointer passed to check_mincore");
     }
-    if (uinode->mmap_addr == nullptr) {
+    if (uinode->cold == nullptr || uinode->cold->mmap_addr == nullptr) {
         throw std::runtime_error("check_mincore(): mmap not allocated");
     }
     size_t num_pages = NR_BITMAP_BITS;
     std::vector<bool> page_residency(num_pages, false);
     std::vector<unsigned char> mincore_array(num_pages);
-    if (mincore(uinode->mmap_addr, num_pages * PAGESIZE, mincore_array.data()) != 0) {
+    if (mincore(uinode->cold->mmap_addr, num_pages * PAGESIZE, mincore_array.data()) != 0) {
         throw std::runtime_error("mincore failed");
     }
     for (size_t i = 0; i < num_pages; ++i) {
@@ -1478,9 +1492,9 @@ void update_mmap_fd(struct inode* uinode) {
     }
 
     bool fd_still_valid = false;
-    if (uinode->mmap_fd != -1) {
+    if (uinode->cold != nullptr && uinode->cold->mmap_fd != -1) {
         for (int i = 0; i <= uinode->fdlist_index; ++i) {
-            if (uinode->fdlist[i].fd == uinode->mmap_fd) {
+            if (uinode->fdlist[i].fd == uinode->cold->mmap_fd) {
                 fd_still_valid = true;
                 break;
             }
@@ -1513,7 +1527,7 @@ void print_mincore_array(const std::vector<bool>& page_residency_arr, off_t file
     */
 
     // Print the number of entries in i_map
-    size_t i_map_entries = hashtable_count(i_map);
+    size_t i_map_entries = i_map->size();
     std::cout << yellow << "Number of entries in i_map: " << i_map_entries << reset << std::endl;
 
 
@@ -1574,6 +1588,8 @@ void print_mincore_array(const std::vector<bool>& page_residency_arr, off_t file
  * 1. Should not see duplicate {ino, dev_id} pairs.
  */
 int mock_populate_inode_ds(ino_t ino, dev_t dev_id){
+        struct key key;
+        struct value v;
         struct inode *uinode = nullptr;
         struct value *uinode_exists = nullptr;
 
@@ -1593,13 +1609,16 @@ int mock_populate_inode_ds(ino_t ino, dev_t dev_id){
          */
 
 
-        i_map_lock.lock();
+        key.ino = ino;
+        key.dev_id = dev_id;
+
+        i_map->shard_lock(key).lock();
 
-        uinode_exists = get_from_hashtable(ino, dev_id);
+        uinode_exists = i_map->find_locked(key);
         if(uinode_exists){
                 SPEEDYIO_FPRINTF("%s:ERROR uinode already exists for {ino:%lu, dev:%lu}\n", "SPEEDYIO_ERRCO_0127 %lu %lu\n", ino, dev_id);
                 KILLME();
-                i_map_lock.unlock();
+                i_map->shard_lock(key).unlock();
                 goto exit_mock_populate_inode_ds;
         }
 
@@ -1611,7 +1630,7 @@ int mock_populate_inode_ds(ino_t ino, dev_t dev_id){
                 SPEEDYIO_FPRINTF("%s:ERROR Unable to allocate memory for inode: %s\n", "SPEEDYIO_ERRCO_0128 %s\n", e.what());
                 KILLME();
                 uinode = nullptr;
-                i_map_lock.unlock();
+                i_map->shard_lock(key).unlock();
                 goto exit_mock_populate_inode_ds;
         }
 
@@ -1635,14 +1654,15 @@ int mock_populate_inode_ds(ino_t ino, dev_t dev_id){
          * Do these if required
          */
 
-        if(!insert_to_hashtable(ino, dev_id, (void*)uinode)){
-                SPEEDYIO_FPRINTF("%s:ERROR unable to insert {ino:%lu, dev:%lu} to hashtable\n", "SPEEDYIO_ERRCO_0129 %lu %lu\n", ino, dev_id);
+        v.value = (void*)uinode;
+        if(!i_map->insert_locked(key, v)){
+                SPEEDYIO_FPRINTF("%s:ERROR unable to insert {ino:%lu, dev:%lu} to i_map\n", "SPEEDYIO_ERRCO_0129 %lu %lu\n", ino, dev_id);
                 KILLME();
         }
 
-        // printf("%s: number of hashtable_entries:%zu\n", __func__, hashtable_count(i_map));
+        // printf("%s: number of i_map entries:%zu\n", __func__, i_map->size());
 
-        i_map_lock.unlock();
+        i_map->shard_lock(key).unlock();
 
 exit_mock_populate_inode_ds:
         return -1;
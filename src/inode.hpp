@@ -1,30 +1,35 @@
 #ifndef _INODE_HPP
 #define _INODE_HPP
 
+#include <stdlib.h>
 #include <string.h>
 // #include <x86intrin.h>
 
+#include <algorithm>
 #include <atomic>
 #include <mutex>
+#include <new>
 #include <vector>
 
 #include "utils/ticks.h"
-#include "utils/hashtable/hashtable.h"
-#include "utils/hashtable/hashtable_private.h"
 #include "utils/util.hpp"
 #include "utils/bitmap/bitmap.h"
 #include "utils/r_w_lock/readers_writers_lock.hpp"
 #include "utils/vector/auto_expand_vector.hpp"
+#include "utils/sharded_map/sharded_map.hpp"
+#include "utils/latency_tracking/latency_tracking.hpp"
+#include "utils/slab/slab.hpp"
+#include "utils/extent_index/extent_index.hpp"
+#include "utils/dirty_index/dirty_index.hpp"
 #include "utils/trigger/trigger.hpp"
+#include "utils/cache_class/cache_class.hpp"
+#include "utils/file_role/file_role.hpp"
 
 /**
  * total_nr_unlinks is used to trigger iter_i_map_and_put_unused
  */
 extern struct trigger *nr_unlinks_for_imap_cleanup;
 
-extern struct hashtable *i_map;
-extern std::atomic_flag i_map_init;
-
 struct key {
         ino_t  ino;
         dev_t  dev_id;
@@ -34,7 +39,36 @@ struct value {
         void *value;
 };
 
-struct hashtable *init_inode_map(void);
+struct key_hash {
+        size_t operator()(const struct key &k) const;
+};
+
+struct key_equal {
+        bool operator()(const struct key &k1, const struct key &k2) const {
+                return (k1.ino == k2.ino) && (k1.dev_id == k2.dev_id);
+        }
+};
+
+/*hold times of these are binned with LOCK_HOLD_STATS, see benchmarks/hotpath*/
+#ifdef LOCK_HOLD_STATS
+typedef hold_timed_mutex<&imap_shard_lock_hold> imap_lock_t;
+typedef hold_timed_mutex<&unlinked_lock_hold> unlinked_lock_t;
+typedef hold_timed_mutex<&file_heap_lock_hold> file_heap_lock_t;
+typedef hold_timed_mutex<&g_heap_lock_hold> g_heap_lock_t;
+#else
+typedef std::mutex imap_lock_t;
+typedef std::mutex unlinked_lock_t;
+typedef std::mutex file_heap_lock_t;
+typedef std::mutex g_heap_lock_t;
+#endif //LOCK_HOLD_STATS
+
+/*{ino, dev_id} -> struct inode mapping*/
+typedef ShardedMap<struct key, struct value, key_hash, key_equal, NR_IMAP_SHARDS, imap_lock_t> inode_map_t;
+
+extern inode_map_t *i_map;
+extern std::atomic_flag i_map_init;
+
+inode_map_t *init_inode_map(void);
 struct value *get_from_hashtable(ino_t ino, dev_t dev_id);
 struct inode *get_uinode_from_hashtable(ino_t ino, dev_t dev_id);
 void *bg_inode_cleaner(void *arg);
@@ -60,15 +94,21 @@ void print_mincore_array(const std::vector<bool>& page_residency_arr, off_t file
 /*Operations on inode*/
 bool sanitize_uinode(struct inode *uinode);
 bool update_nr_links(struct inode *uinode, nlink_t nlink, bool take_unlinked_lock);
-bool add_fd_to_fdlist(struct inode *uinode, int fd, int open_flags, off_t seek_head);
+bool add_fd_to_fdlist(struct inode *uinode, int fd, int open_flags);
 int remove_fd_from_fdlist(struct inode *uinode, int fd);
 bool clear_uinode_fdlist(struct inode *uinode);
-ssize_t update_fd_seek_pos(struct inode *uinode, int fd, off_t bytes, bool set_to);
-bool reset_all_fd_seek_pos(struct inode *uinode);
 int get_open_flags_from_uinode(struct inode *uinode, int fd);
 bool get_fadv_from_uinode(struct inode *uinode);
 int set_fadv_on_fd_uinode(struct inode *uinode, int fd, bool is_seq);
-struct inode *add_fd_to_inode(int fd, int open_flags, const char *filename);
+struct inode *add_fd_to_inode(int fd, int open_flags, const char *filename, off_t *seek_head);
+int get_any_fd_from_uinode(struct inode *uinode);
+
+/**
+ * uinode filenames are interned; a uinode without one points here.
+ */
+extern const char EMPTY_UINODE_FILENAME[];
+bool set_uinode_filename(struct inode *uinode, const char *filename);
+bool get_uinode_filename(struct inode *uinode, char *buf, size_t size);
 
 
 /*Functions for pvt lru*/
@@ -85,15 +125,12 @@ void _dest_pvt_heap(struct inode *uinode);
 int mock_populate_inode_ds(ino_t ino, dev_t dev_id);
 
 
-/*contains the fd and its corresponding seek head for a file*/
+/**
+ * contains an fd open on a file.
+ * The seek head of the fd is in its perfd_struct (see struct open_file_desc).
+ */
 struct fd_info{
         int fd;
-        /**
-         * The following system calls update the seek_head
-         * read, fread, write, fwrite, lseek
-         * pread and pwrite dont change the seek_head
-         */
-        off_t seek_head;
         int open_flags;
 
         /**
@@ -108,60 +145,60 @@ struct fd_info{
 
         void reset(){
                 fd = 0;
-                seek_head = 0;
                 open_flags = 0;
                 fadv_seq = true;
         }
 
         fd_info(){
                 fd = 0;
-                seek_head = 0;
                 open_flags = 0;
                 fadv_seq = true;
         }
 };
 
-struct inode{
+#ifdef ENABLE_MINCORE_DEBUG
+/**
+ * Debug only state of a uinode. Kept out of struct inode so that
+ * production builds don't pay for it; allocated by allocate_mmap.
+ */
+struct inode_cold{
+        void* mmap_addr; // Pointer to mmap address
+        int mmap_fd;
+
+        inode_cold(){
+                mmap_addr = nullptr;
+                mmap_fd = -1;
+        }
+};
+#endif // ENABLE_MINCORE_DEBUG
+
+/**
+ * Layout of struct inode:
+ * Every group below starts on its own cache line so that threads spinning
+ * on one lock don't invalidate the counters or the other locks.
+ * 1. read mostly: identity and pointers to the per file DS
+ * 2. hot counters: updated on every read/write
+ * 3. file_heap_lock: taken on every read/write
+ * 4. fdlist and fdlist_lock: open, close, lseek
+ * 5. unlink state and unlinked_lock: open, unlink, eviction
+ * 6. rarely used locks
+ *
+ * It is ~576 bytes; it used to be ~7KB with the filename and
+ * MAX_FD_PER_INODE fd_infos embedded.
+ */
+struct alignas(CACHELINE_SIZE) inode{
+        /*1. read mostly*/
         ino_t ino; //inode number
         dev_t dev_id; //device ID
 
-        char filename[PATH_MAX]; //filename of the inode
-
         /**
-         * Different locks defined in the struct inode
-         * are held while performing operations like:
-         * read, write, close, unlink and eviction
-         *
-         * Sometimes, multiple threads working on the same uinode
-         * may interleave these operations especially with the eviction thread
-         * such that the cache state represented by the heap and bitmap
-         * diverge from the actual cache state of the file in the OS.
-         * This was checked with mincore debugging.
-         *
-         * eg. If a read is happening on a portion of file which was elected to be
-         * evicted; interleaving would diverge the cache state.
-         *
-         * To prevent interleaving of these operations, we have introduced
-         * the uinode_lock. It is taken before doing anything in the above
-         * operations and released only after all the work is done.
-         *
-         * Thought with bigger portion sizes, the cache divergence problem should be less
-         * significant; right now its not clear if this lock improves the performance of the library.
-         * Hence it is not enabled by default. ENABLE_UINODE_LOCK enables it.
-         *
-         * XXX: the implementation of holding the lock is messy in read and write syscalls.
-         * To be cleaned.
+         * filename of the inode. Interned in the filename arena,
+         * see set_uinode_filename. Never nullptr.
          */
-        std::mutex uinode_lock;
-
-        struct fd_info fdlist[MAX_FD_PER_INODE];
-        int fdlist_index; //fd_list index. max fdlist_index = (MAX_FD_PER_INODE - 1)
-        std::mutex fdlist_lock; //lock for update to the fdlist
+        const char *filename;
 
         //Enabled with ENABLE_PER_INODE_BITMAP
         bit_array_t *cache_state;
-        ReaderWriterLock cache_rwlock;
-        //TODO: Add interval tree for bitmap
 
         //PVT_HEAP
         /*
@@ -170,17 +207,44 @@ struct inode{
          */
         struct Heap* file_heap;
 
+#ifdef ENABLE_EXTENT_INDEX
+        /*accessed portions as extents, one pvt heap node per extent*/
+        struct extent_index *extents;
+#else
         //stores ids to heap nodes for each file portion
         AutoExpandVector<int> *file_heap_node_ids;
-        std::mutex file_heap_lock;
+#endif //ENABLE_EXTENT_INDEX
 
-        int heap_id; //this is the unique id for the heap node in global heap
-        bool one_operation_done; //false if no read/write operations done; else true
+#ifdef ENABLE_DIRTY_TRACKING
+        /*portions written and not synced yet; under file_heap_lock*/
+        struct dirty_index *dirty;
+#endif //ENABLE_DIRTY_TRACKING
+
+#ifdef ENABLE_MINCORE_DEBUG
+        struct inode_cold *cold;
+#endif // ENABLE_MINCORE_DEBUG
+
+#ifdef ENABLE_CACHE_CLASSES
+        /**
+         * cache class (keyspace/table) of this file, see cache_class.hpp.
+         * Picks the global heap this uinode lives in; only changes while
+         * the uinode is out of the global heap (heap_id < 0).
+         */
+        int cache_class;
+#endif //ENABLE_CACHE_CLASSES
 
-        unsigned long nr_accesses; //number of accesses
+#ifdef ENABLE_FILE_ROLE_TIERS
+        /*sstable component of this file, see file_role.hpp*/
+        enum file_role file_role;
+#endif //ENABLE_FILE_ROLE_TIERS
+
+        /*2. hot counters*/
+        alignas(CACHELINE_SIZE) unsigned long nr_accesses; //number of accesses
         unsigned long long int last_access_tstamp; //time stamp of last access for EVICTION_COMPLEX
 
-        struct trigger *gheap_trigger; //trigger gheap update based on number of read/write syscalls - replacement of nr_accesses
+        struct trigger gheap_trigger; //trigger gheap update based on number of read/write syscalls - replacement of nr_accesses
+
+        int heap_id; //this is the unique id for the heap node in global heap
 
         /*
         * nr_evictions used for EVICTION_COMPLEX.
@@ -188,6 +252,37 @@ struct inode{
         */
         unsigned int nr_evictions; //number of times this inode has been evicted
 
+        bool one_operation_done; //false if no read/write operations done; else true
+
+#ifdef ENABLE_CACHE_CLASSES
+        /*pvt heap portions not evicted. Under file_heap_lock*/
+        long nr_resident_portions;
+#endif //ENABLE_CACHE_CLASSES
+
+#ifdef ENABLE_BUSY_FILES
+        /*application reads of the file in flight, see begin_file_read*/
+        std::atomic<int> nr_reads_in_flight;
+#endif //ENABLE_BUSY_FILES
+
+        /*3. pvt heap lock*/
+        alignas(CACHELINE_SIZE) file_heap_lock_t file_heap_lock;
+
+        /*4. fdlist*/
+        alignas(CACHELINE_SIZE) std::mutex fdlist_lock; //lock for update to the fdlist
+        int fdlist_index; //fd_list index. max fdlist_index = (fdlist_cap - 1)
+
+        /**
+         * Most files have a handful of fds open. fdlist points to fdlist_inline
+         * till more than INLINE_FD_PER_INODE fds are open; then it is moved to
+         * the heap and doubled each time, upto MAX_FD_PER_INODE.
+         * It is only read or written with fdlist_lock held.
+         */
+        int fdlist_cap;
+        struct fd_info *fdlist;
+        struct fd_info fdlist_inline[INLINE_FD_PER_INODE];
+
+        /*5. unlink state*/
+
         /**
          * The linux kernel keeps an unlinked file alive till all its
          * open fds are closed implicitly or explicitly; it also keeps
@@ -222,15 +317,42 @@ struct inode{
          * only instead of getting a segfault.
          * XXX: This will be done later with a background cleanup thread.
          */
+        alignas(CACHELINE_SIZE) unlinked_lock_t unlinked_lock;
         bool unlinked; //actually deleted the inode
         bool marked_unlinked; //unlink called for this inode, not actually deleted yet
         nlink_t nr_links; //keeps track of the number of links for this inode (using st_nlink)
-        std::mutex unlinked_lock;
 
-#ifdef ENABLE_MINCORE_DEBUG
-        void* mmap_addr; // Pointer to mmap address
-        int mmap_fd;
-#endif // ENABLE_MINCORE_DEBUG
+        /*6. rarely used locks*/
+
+        /**
+         * Different locks defined in the struct inode
+         * are held while performing operations like:
+         * read, write, close, unlink and eviction
+         *
+         * Sometimes, multiple threads working on the same uinode
+         * may interleave these operations especially with the eviction thread
+         * such that the cache state represented by the heap and bitmap
+         * diverge from the actual cache state of the file in the OS.
+         * This was checked with mincore debugging.
+         *
+         * eg. If a read is happening on a portion of file which was elected to be
+         * evicted; interleaving would diverge the cache state.
+         *
+         * To prevent interleaving of these operations, we have introduced
+         * the uinode_lock. It is taken before doing anything in the above
+         * operations and released only after all the work is done.
+         *
+         * Thought with bigger portion sizes, the cache divergence problem should be less
+         * significant; right now its not clear if this lock improves the performance of the library.
+         * Hence it is not enabled by default. ENABLE_UINODE_LOCK enables it.
+         *
+         * XXX: the implementation of holding the lock is messy in read and write syscalls.
+         * To be cleaned.
+         */
+        alignas(CACHELINE_SIZE) std::mutex uinode_lock;
+
+        //Enabled with ENABLE_PER_INODE_BITMAP
+        ReaderWriterLock cache_rwlock;
 
         /**
          * Do we really need a lock here ?
@@ -281,15 +403,45 @@ struct inode{
                 return ret;
         }
 
+#ifdef ENABLE_SLAB_ALLOC
+        /*uinodes sit together in slab chunks, aligned to alignof(struct inode)*/
+        static void *operator new(size_t sz){
+                void *p = slab_alloc(&slab_type<struct inode>::cache);
+                if(!p){
+                        throw std::bad_alloc();
+                }
+                return p;
+        }
+
+        static void operator delete(void *p){
+                slab_free(&slab_type<struct inode>::cache, p);
+        }
+#else
+        /*plain new does not honour alignas(CACHELINE_SIZE) before C++17*/
+        static void *operator new(size_t sz){
+                void *p;
+                if(posix_memalign(&p, alignof(struct inode), sz)){
+                        throw std::bad_alloc();
+                }
+                return p;
+        }
+
+        static void operator delete(void *p){
+                free(p);
+        }
+#endif //ENABLE_SLAB_ALLOC
+
         inode(){
                 ino = 0UL;
                 dev_id = 0UL;
 
-                memset(filename, 0, PATH_MAX);
+                filename = EMPTY_UINODE_FILENAME;
 
                 fdlist_index = -1; // This means there are no fds in fdlist
+                fdlist_cap = INLINE_FD_PER_INODE;
+                fdlist = fdlist_inline;
                 cache_state = nullptr;
-                memset(fdlist, 0, MAX_FD_PER_INODE*sizeof(struct fd_info));
+                std::fill_n(fdlist_inline, INLINE_FD_PER_INODE, fd_info());
 
                 unlinked = false;
                 marked_unlinked = false;
@@ -307,19 +459,37 @@ struct inode{
                 last_access_tstamp = ticks_now();
                 nr_evictions = 0;
 
-                gheap_trigger = new trigger;
-                sanitize_struct_trigger(gheap_trigger);
-                gheap_trigger->step = G_HEAP_FREQ;
+                sanitize_struct_trigger(&gheap_trigger);
+                gheap_trigger.step = G_HEAP_FREQ;
 
                 //private heap initialization
+#ifdef ENABLE_EXTENT_INDEX
+                extents = nullptr;
+#else
                 file_heap_node_ids = nullptr;
+#endif //ENABLE_EXTENT_INDEX
+#ifdef ENABLE_DIRTY_TRACKING
+                dirty = nullptr;
+#endif //ENABLE_DIRTY_TRACKING
                 file_heap = nullptr;
 
+#ifdef ENABLE_CACHE_CLASSES
+                cache_class = DEFAULT_CACHE_CLASS;
+                nr_resident_portions = 0;
+#endif //ENABLE_CACHE_CLASSES
+
+#ifdef ENABLE_FILE_ROLE_TIERS
+                file_role = FILE_ROLE_OTHER;
+#endif //ENABLE_FILE_ROLE_TIERS
+
+#ifdef ENABLE_BUSY_FILES
+                nr_reads_in_flight = 0;
+#endif //ENABLE_BUSY_FILES
+
 #endif //ENABLE_EVICTION
 
 #ifdef ENABLE_MINCORE_DEBUG
-                mmap_addr = nullptr; // Initialize mmap address to nullptr
-                mmap_fd = -1; // Initialize mmap fd to -1
+                cold = nullptr;
 #endif // ENABLE_MINCORE_DEBUG
         }
 
@@ -327,7 +497,12 @@ struct inode{
 
                 /*clearing the fdlist*/
                 fdlist_index = -1;
-                memset(fdlist, 0, MAX_FD_PER_INODE*sizeof(struct fd_info));
+                if(fdlist != fdlist_inline){
+                        delete[] fdlist;
+                }
+                fdlist = fdlist_inline;
+                fdlist_cap = INLINE_FD_PER_INODE;
+                std::fill_n(fdlist_inline, INLINE_FD_PER_INODE, fd_info());
 
 #ifdef ENABLE_PER_INODE_BITMAP
                 /*cache_state destroy*/
@@ -350,6 +525,10 @@ struct inode{
                  * Will have to identify if the mmap_fd is
                  * live and the addr is valid etc.
                  */
+#ifdef ENABLE_MINCORE_DEBUG
+                delete cold;
+                cold = nullptr;
+#endif // ENABLE_MINCORE_DEBUG
 
                 unlinked = true;
                 marked_unlinked = true;
@@ -359,7 +538,7 @@ struct inode{
                  * identifying variables are being reset at the end so that
                  * the inode can be identified if error occurs during destruction
                  */
-                memset(filename, 0, PATH_MAX);
+                set_uinode_filename(this, nullptr);
                 ino = 0UL;
                 dev_id = 0UL;
         }
@@ -34,6 +34,8 @@
 #include <sys/mman.h>
 #include <sys/wait.h>
 #include <sys/resource.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
 
 #include "interface.hpp"
 
@@ -41,6 +43,34 @@
 
 #include "utils/parse_config/config.hpp"
 
+#ifdef ENABLE_ADMIN_SOCKET
+#include "utils/admin_socket/admin_socket.hpp"
+#endif
+
+#ifdef ENABLE_STATS_SHM
+#include "utils/stats_shm/stats_shm.hpp"
+#endif
+
+#ifdef ENABLE_TRACE_RING
+#include "utils/trace_ring/trace_ring.hpp"
+#endif
+
+#ifdef ENABLE_SHARDS_MRC
+#include "utils/shards/shards.hpp"
+#endif
+
+#ifdef ENABLE_HOST_COORD
+#include "utils/host_coord/host_coord.hpp"
+#endif
+
+#ifdef ENABLE_EVICTION_YIELD
+#include "utils/evict_yield/evict_yield.hpp"
+#endif
+
+#ifdef ENABLE_MMAP_TRACKING
+#include "utils/mmap_regions/mmap_regions.hpp"
+#endif
+
 #ifdef ENABLE_LICENSE
 #include "utils/licensing/LicenseValidation.h"
 #endif
@@ -52,6 +82,14 @@ bool eviction_thread_created = false;
 pthread_t start_stop_thread;
 #endif
 
+#ifdef ENABLE_ADMIN_SOCKET
+pthread_t admin_socket_thread;
+#endif
+
+#ifdef ENABLE_STATS_SHM
+pthread_t stats_shm_thread;
+#endif
+
 #ifdef ENABLE_SYSTEM_INFO
 pthread_t sysinfo_tid;
 #endif
@@ -133,6 +171,504 @@ void print_speedyio_ascii(void) {
 struct lat_tracker handle_read_latency;
 struct lat_tracker readsyscalls_latency;
 struct lat_tracker get_pfd_latency;
+struct lat_tracker open_latency;
+
+static void print_all_latencies(){
+
+        print_latencies("read_syscalls - whitelisted files only", &readsyscalls_latency);
+
+        print_latencies("handle_read - whitelisted files only", &handle_read_latency);
+
+        print_latencies("get_perfd_struct_fast", &get_pfd_latency);
+
+        print_latencies("open - bookkeeping after the real open", &open_latency);
+
+        print_latencies("update_pvt_heap - in handle_read", &pvt_heap_latency);
+
+        print_latencies("g_pvt_heap - in handle_read", &g_heap_latency);
+
+        print_latencies("heap_update_key ULONG_MAX- in evict_portions", &ulong_heap_update);
+
+#ifdef LOCK_HOLD_STATS
+        print_latencies("i_map shard lock held (ns)", &imap_shard_lock_hold);
+
+        print_latencies("unlinked_lock held (ns)", &unlinked_lock_hold);
+
+        print_latencies("file_heap_lock held (ns)", &file_heap_lock_hold);
+
+        print_latencies("g_heap_lock held (ns)", &g_heap_lock_hold);
+#endif //LOCK_HOLD_STATS
+}
+
+#ifdef ENABLE_ADMIN_SOCKET
+/*
+ * Admin socket commands, see utils/admin_socket/admin_socket.hpp
+ */
+
+static bool parse_admin_long(const char *str, long *val){
+        char *end;
+
+        errno = 0;
+        *val = strtol(str, &end, 10);
+        return !errno && end != str && *end == '\0' && *val >= 0;
+}
+
+static int admin_pause(int argc, char **argv, std::string *reply){
+        stop_speedyio();
+        return 0;
+}
+
+static int admin_resume(int argc, char **argv, std::string *reply){
+        resume_speedyio();
+        return 0;
+}
+
+static int admin_stats(int argc, char **argv, std::string *reply){
+        struct eviction_stats stats;
+        char line[CACHE_CLASS_NAME_LEN + 64];
+
+        get_eviction_stats(&stats);
+
+        snprintf(line, sizeof(line), "paused %d\n", (int)evictor_paused.load());
+        reply->append(line);
+        snprintf(line, sizeof(line), "free_mem_kb %ld\nmin_mem_kb %ld\n", getFreeMemoryKB(), getMinMemoryRequiredKB());
+        reply->append(line);
+        snprintf(line, sizeof(line), "low_mem_watermark_kb %ld\nforced_evict_kb %ld\n",
+                        stats.low_mem_watermark_kb, stats.forced_evict_kb);
+        reply->append(line);
+        snprintf(line, sizeof(line), "files %zu\nevicted_portions %lu\n", stats.nr_files, stats.nr_evicted);
+        reply->append(line);
+
+#ifdef ENABLE_FILE_ROLE_TIERS
+        snprintf(line, sizeof(line), "tier_age_ms %ld\n", get_file_role_tier_age_ms());
+        reply->append(line);
+#endif //ENABLE_FILE_ROLE_TIERS
+
+#ifdef ENABLE_CACHE_CLASSES
+        for(int cls = 0; cls < nr_cache_classes; cls++){
+                snprintf(line, sizeof(line), "class %s %ld\n", get_cache_class_name(cls),
+                                cache_classes[cls].nr_resident.load(std::memory_order_relaxed));
+                reply->append(line);
+        }
+#endif //ENABLE_CACHE_CLASSES
+        return 0;
+}
+
+static int admin_set(int argc, char **argv, std::string *reply){
+        long val;
+
+        if(argc != 3){
+                reply->append("usage: set watermark_kb <kb> | set policy lru|tiered | set tier_age_ms <ms>");
+                return -1;
+        }
+
+        if(!strcmp(argv[1], "watermark_kb")){
+                if(!parse_admin_long(argv[2], &val)){
+                        reply->append("bad watermark_kb");
+                        return -1;
+                }
+                set_eviction_low_mem_watermark(val);
+                return 0;
+        }
+
+#ifdef ENABLE_FILE_ROLE_TIERS
+        if(!strcmp(argv[1], "policy")){
+                if(!strcmp(argv[2], "lru")){
+                        set_file_role_tier_age_ms(0);
+                }else if(!strcmp(argv[2], "tiered")){
+                        set_file_role_tier_age_ms(FILE_ROLE_TIER_AGE_MS);
+                }else{
+                        reply->append("policy is lru or tiered");
+                        return -1;
+                }
+                return 0;
+        }
+        if(!strcmp(argv[1], "tier_age_ms")){
+                if(!parse_admin_long(argv[2], &val)){
+                        reply->append("bad tier_age_ms");
+                        return -1;
+                }
+                set_file_role_tier_age_ms(val);
+                return 0;
+        }
+#endif //ENABLE_FILE_ROLE_TIERS
+
+        reply->append("unknown setting ");
+        reply->append(argv[1]);
+        return -1;
+}
+
+/*Applies to files opened from now on*/
+static int admin_whitelist(int argc, char **argv, std::string *reply){
+        if(argc < 2){
+                reply->append("usage: whitelist <action>:<type>:<pattern> ...");
+                return -1;
+        }
+        if(init_whitelist_rules(argv + 1, argc - 1) < 0){
+                reply->append("malformed rule, whitelist unchanged");
+                return -1;
+        }
+        return 0;
+}
+
+static int admin_evict(int argc, char **argv, std::string *reply){
+        long kb;
+
+        if(argc != 2 || !parse_admin_long(argv[1], &kb)){
+                reply->append("usage: evict <kb>");
+                return -1;
+        }
+        request_eviction_pass(kb);
+        return 0;
+}
+
+#ifdef ENABLE_TRACE_RING
+static int admin_trace(int argc, char **argv, std::string *reply){
+        struct trace_stats stats;
+        char line[PATH_MAX + 64];
+        bool compress = true;
+        const char *dir = nullptr;
+
+        if(argc >= 2 && !strcmp(argv[1], "on")){
+                for(int i = 2; i < argc; i++){
+                        if(!strcmp(argv[i], "raw")){
+                                compress = false;
+                        }else{
+                                dir = argv[i];
+                        }
+                }
+                if(trace_start(dir, compress) < 0){
+                        reply->append("tracing is already on or the trace file could not be created");
+                        return -1;
+                }
+        }else if(argc == 2 && !strcmp(argv[1], "off")){
+                trace_stop();
+        }else if(argc != 1 && !(argc == 2 && !strcmp(argv[1], "status"))){
+                reply->append("usage: trace on [dir] [raw] | trace off | trace status");
+                return -1;
+        }
+
+        get_trace_stats(&stats);
+        snprintf(line, sizeof(line), "tracing %s\nfile %s\n", stats.enabled ? "on" : "off", stats.path);
+        reply->append(line);
+        snprintf(line, sizeof(line), "compressed %d\nrings %d\nrecords %lu\nbytes %lu\ndropped %lu\n",
+                        stats.compressed, stats.nr_rings, stats.nr_records, stats.nr_bytes, stats.nr_dropped);
+        reply->append(line);
+        return 0;
+}
+#endif //ENABLE_TRACE_RING
+
+#ifdef ENABLE_SHARDS_MRC
+/*Estimated LRU hit ratio of the whitelisted reads per cache size*/
+static int admin_mrc(int argc, char **argv, std::string *reply){
+        struct shards_stats stats;
+        unsigned long portion_kb = (1UL << (PAGE_SHIFT + PVT_HEAP_PG_ORDER)) / KB;
+        unsigned long hits = 0;
+        int last_bin = -1;
+        char line[128];
+
+        get_shards_stats(&stats);
+        snprintf(line, sizeof(line), "sample_ppm %u\nportions %lu\nsampled %lu\ndropped %lu\naccesses %lu\ncold %lu\n",
+                        stats.sample_ppm, stats.nr_keys, stats.nr_sampled, stats.nr_dropped, stats.accesses, stats.cold);
+        reply->append(line);
+
+        for(int i = 0; i < NR_POW2_LATENCY_BINS; i++){
+                if(shards_mrc_hist.latencies_bin_ctr[i].load(std::memory_order_relaxed)){
+                        last_bin = i;
+                }
+        }
+        for(int i = 0; i <= last_bin; i++){
+                hits += shards_mrc_hist.latencies_bin_ctr[i].load(std::memory_order_relaxed);
+                snprintf(line, sizeof(line), "cache_kb %lu hit %.2f%%\n", portion_kb << i,
+                                stats.accesses ? 100.0 * hits / stats.accesses : 0.0);
+                reply->append(line);
+        }
+        return 0;
+}
+#endif //ENABLE_SHARDS_MRC
+
+/*Dumps the latency histograms to SpeedyIO's stdout*/
+static int admin_snapshot(int argc, char **argv, std::string *reply){
+        print_all_latencies();
+        fflush(stdout);
+        return 0;
+}
+
+static void init_admin_commands(){
+        admin_register_command("pause", admin_pause, "pause");
+        admin_register_command("resume", admin_resume, "resume");
+        admin_register_command("stats", admin_stats, "stats");
+        admin_register_command("set", admin_set, "set watermark_kb <kb> | set policy lru|tiered | set tier_age_ms <ms>");
+        admin_register_command("whitelist", admin_whitelist, "whitelist <action>:<type>:<pattern> ...");
+        admin_register_command("evict", admin_evict, "evict <kb>");
+        admin_register_command("snapshot", admin_snapshot, "snapshot");
+#ifdef ENABLE_TRACE_RING
+        admin_register_command("trace", admin_trace, "trace on [dir] [raw] | trace off | trace status");
+#endif //ENABLE_TRACE_RING
+#ifdef ENABLE_SHARDS_MRC
+        admin_register_command("mrc", admin_mrc, "mrc");
+#endif //ENABLE_SHARDS_MRC
+}
+#endif //ENABLE_ADMIN_SOCKET
+
+#ifdef ENABLE_STATS_SHM
+/*
+ * Stats published in /dev/shm/speedyio.<pid>, see utils/stats_shm/stats_shm.hpp
+ */
+
+static uint64_t stat_evicted_portions(void *arg){
+        struct eviction_stats stats;
+
+        get_eviction_stats(&stats);
+        return stats.nr_evicted;
+}
+
+static uint64_t stat_evicted_bytes(void *arg){
+        return stat_evicted_portions(arg) << (PAGE_SHIFT + PVT_HEAP_PG_ORDER);
+}
+
+static uint64_t stat_gheap_files(void *arg){
+        struct eviction_stats stats;
+
+        get_eviction_stats(&stats);
+        return stats.nr_files;
+}
+
+static uint64_t stat_pvt_heaps(void *arg){
+        struct eviction_stats stats;
+
+        get_eviction_stats(&stats);
+        return stats.nr_pvt_heaps > 0 ? stats.nr_pvt_heaps : 0;
+}
+
+static uint64_t stat_low_mem_watermark_kb(void *arg){
+        struct eviction_stats stats;
+
+        get_eviction_stats(&stats);
+        return stats.low_mem_watermark_kb;
+}
+
+static uint64_t stat_forced_evict_kb(void *arg){
+        struct eviction_stats stats;
+
+        get_eviction_stats(&stats);
+        return stats.forced_evict_kb;
+}
+
+static uint64_t stat_free_mem_kb(void *arg){
+        long free_kb = getFreeMemoryKB();
+
+        return free_kb > 0 ? free_kb : 0;
+}
+
+static uint64_t stat_min_mem_kb(void *arg){
+        return getMinMemoryRequiredKB();
+}
+
+static uint64_t stat_evictor_paused(void *arg){
+        return evictor_paused.load(std::memory_order_relaxed);
+}
+
+static uint64_t stat_uinodes(void *arg){
+#ifdef MAINTAIN_INODE
+        return i_map ? i_map->size() : 0;
+#else
+        return 0;
+#endif //MAINTAIN_INODE
+}
+
+static uint64_t stat_fds(void *arg){
+        return get_nr_tracked_fds();
+}
+
+#ifdef ENABLE_FILE_ROLE_TIERS
+static uint64_t stat_tier_age_ms(void *arg){
+        return get_file_role_tier_age_ms();
+}
+#endif //ENABLE_FILE_ROLE_TIERS
+
+#ifdef ENABLE_CACHE_CLASSES
+static char class_stat_names[MAX_CACHE_CLASSES][STATS_NAME_LEN];
+
+static uint64_t stat_class_resident_portions(void *arg){
+        long nr = cache_classes[(intptr_t)arg].nr_resident.load(std::memory_order_relaxed);
+
+        return nr > 0 ? nr : 0;
+}
+#endif //ENABLE_CACHE_CLASSES
+
+#ifdef ENABLE_SHARDS_MRC
+static uint64_t stat_mrc(void *arg){
+        struct shards_stats stats;
+
+        get_shards_stats(&stats);
+        switch((intptr_t)arg){
+        case 0:
+                return stats.accesses;
+        case 1:
+                return stats.cold;
+        case 2:
+                return stats.sample_ppm;
+        default:
+                return stats.nr_dropped;
+        }
+}
+#endif //ENABLE_SHARDS_MRC
+
+#ifdef ENABLE_DIRTY_TRACKING
+static uint64_t stat_dirty(void *arg){
+        struct eviction_stats stats;
+
+        get_eviction_stats(&stats);
+        return (intptr_t)arg == 0 ? stats.nr_dirty_deferred : stats.nr_dirty_writebacks;
+}
+#endif //ENABLE_DIRTY_TRACKING
+
+#ifdef ENABLE_BUSY_FILES
+static uint64_t stat_busy_files(void *arg){
+        struct eviction_stats stats;
+
+        get_eviction_stats(&stats);
+        return (intptr_t)arg == 0 ? stats.nr_busy_passed : stats.nr_busy_split;
+}
+#endif //ENABLE_BUSY_FILES
+
+#ifdef ENABLE_HOST_COORD
+static uint64_t stat_host_coord(void *arg){
+        struct host_coord_stats stats;
+
+        get_host_coord_stats(&stats);
+        switch((intptr_t)arg){
+        case 0:
+                return stats.nr_procs;
+        case 1:
+                return stats.leader;
+        case 2:
+                return stats.nr_claims;
+        default:
+                return stats.nr_declined;
+        }
+}
+#endif //ENABLE_HOST_COORD
+
+#ifdef ENABLE_EVICTION_YIELD
+static uint64_t stat_evict_yield(void *arg){
+        struct evict_yield_stats stats;
+
+        get_evict_yield_stats(&stats);
+        switch((intptr_t)arg){
+        case 0:
+                return stats.nr_targeted;
+        case 1:
+                return stats.nr_cached;
+        case 2:
+                return stats.nr_freed;
+        case 3:
+                return stats.nr_poor_files;
+        default:
+                return stats.nr_skipped;
+        }
+}
+#endif //ENABLE_EVICTION_YIELD
+
+#ifdef ENABLE_MMAP_TRACKING
+static uint64_t stat_mmap_regions(void *arg){
+        struct mmap_regions_stats stats;
+
+        get_mmap_regions_stats(&stats);
+        switch((intptr_t)arg){
+        case 0:
+                return stats.nr_regions;
+        case 1:
+                return stats.nr_sampled;
+        case 2:
+                return stats.nr_accessed;
+        case 3:
+                return stats.reclaimed_bytes;
+        default:
+                return stats.idle_tracking;
+        }
+}
+#endif //ENABLE_MMAP_TRACKING
+
+static void init_stats_sources(){
+        stats_register_counter("evicted_portions", STATS_COUNTER, stat_evicted_portions, nullptr);
+        stats_register_counter("evicted_bytes", STATS_COUNTER, stat_evicted_bytes, nullptr);
+        stats_register_counter("gheap_files", STATS_GAUGE, stat_gheap_files, nullptr);
+        stats_register_counter("uinodes", STATS_GAUGE, stat_uinodes, nullptr);
+        /*uinodes - pvt_heaps files were opened but not read or written yet with ENABLE_LAZY_PVT_HEAP*/
+        stats_register_counter("pvt_heaps", STATS_GAUGE, stat_pvt_heaps, nullptr);
+        stats_register_counter("fds", STATS_GAUGE, stat_fds, nullptr);
+        stats_register_counter("free_mem_kb", STATS_GAUGE, stat_free_mem_kb, nullptr);
+        stats_register_counter("min_mem_kb", STATS_GAUGE, stat_min_mem_kb, nullptr);
+        stats_register_counter("low_mem_watermark_kb", STATS_GAUGE, stat_low_mem_watermark_kb, nullptr);
+        stats_register_counter("forced_evict_kb", STATS_GAUGE, stat_forced_evict_kb, nullptr);
+        stats_register_counter("evictor_paused", STATS_GAUGE, stat_evictor_paused, nullptr);
+#ifdef ENABLE_FILE_ROLE_TIERS
+        stats_register_counter("tier_age_ms", STATS_GAUGE, stat_tier_age_ms, nullptr);
+#endif //ENABLE_FILE_ROLE_TIERS
+
+#ifdef ENABLE_CACHE_CLASSES
+        for(intptr_t cls = 0; cls < nr_cache_classes; cls++){
+                snprintf(class_stat_names[cls], STATS_NAME_LEN, "resident_portions.%s", get_cache_class_name(cls));
+                stats_register_counter(class_stat_names[cls], STATS_GAUGE, stat_class_resident_portions, (void *)cls);
+        }
+#endif //ENABLE_CACHE_CLASSES
+
+        /*the histogram count is the number of calls, so these give op rates too*/
+        stats_register_histogram("read_syscalls_us", &readsyscalls_latency);
+        stats_register_histogram("handle_read_us", &handle_read_latency);
+        stats_register_histogram("get_perfd_struct_us", &get_pfd_latency);
+        stats_register_histogram("open_us", &open_latency);
+        stats_register_histogram("update_pvt_heap_us", &pvt_heap_latency);
+        stats_register_histogram("gheap_update_us", &g_heap_latency);
+        stats_register_histogram("evict_heap_update_us", &ulong_heap_update);
+
+#ifdef ENABLE_SHARDS_MRC
+        /*bin i: estimated reads that need an LRU cache of 2^i portions to hit*/
+        stats_register_counter("mrc_accesses", STATS_COUNTER, stat_mrc, (void *)0);
+        stats_register_counter("mrc_cold", STATS_COUNTER, stat_mrc, (void *)1);
+        stats_register_counter("mrc_sample_ppm", STATS_GAUGE, stat_mrc, (void *)2);
+        stats_register_counter("mrc_dropped", STATS_COUNTER, stat_mrc, (void *)3);
+        stats_register_histogram(SHARDS_MRC_HIST_NAME, &shards_mrc_hist);
+#endif //ENABLE_SHARDS_MRC
+
+#ifdef ENABLE_DIRTY_TRACKING
+        stats_register_counter("dirty_deferred_extents", STATS_COUNTER, stat_dirty, (void *)0);
+        stats_register_counter("dirty_writebacks", STATS_COUNTER, stat_dirty, (void *)1);
+#endif //ENABLE_DIRTY_TRACKING
+
+#ifdef ENABLE_BUSY_FILES
+        stats_register_counter("busy_victims_passed", STATS_COUNTER, stat_busy_files, (void *)0);
+        stats_register_counter("busy_split_evictions", STATS_COUNTER, stat_busy_files, (void *)1);
+#endif //ENABLE_BUSY_FILES
+
+#ifdef ENABLE_HOST_COORD
+        /*claims and declined are host wide, the same in every process*/
+        stats_register_counter("host_coord_procs", STATS_GAUGE, stat_host_coord, (void *)0);
+        stats_register_counter("host_coord_leader", STATS_GAUGE, stat_host_coord, (void *)1);
+        stats_register_counter("host_coord_claims", STATS_COUNTER, stat_host_coord, (void *)2);
+        stats_register_counter("host_coord_declined", STATS_COUNTER, stat_host_coord, (void *)3);
+#endif //ENABLE_HOST_COORD
+
+#ifdef ENABLE_EVICTION_YIELD
+        /*the eviction yield is evict_yield_freed_pages / evict_yield_cached_pages*/
+        stats_register_counter("evict_yield_targeted_pages", STATS_COUNTER, stat_evict_yield, (void *)0);
+        stats_register_counter("evict_yield_cached_pages", STATS_COUNTER, stat_evict_yield, (void *)1);
+        stats_register_counter("evict_yield_freed_pages", STATS_COUNTER, stat_evict_yield, (void *)2);
+        stats_register_counter("evict_yield_poor_files", STATS_GAUGE, stat_evict_yield, (void *)3);
+        stats_register_counter("evict_yield_passed_over", STATS_COUNTER, stat_evict_yield, (void *)4);
+#endif //ENABLE_EVICTION_YIELD
+
+#ifdef ENABLE_MMAP_TRACKING
+        stats_register_counter("mmap_regions", STATS_GAUGE, stat_mmap_regions, (void *)0);
+        stats_register_counter("mmap_sampled_portions", STATS_COUNTER, stat_mmap_regions, (void *)1);
+        stats_register_counter("mmap_accessed_portions", STATS_COUNTER, stat_mmap_regions, (void *)2);
+        stats_register_counter("mmap_reclaimed_bytes", STATS_COUNTER, stat_mmap_regions, (void *)3);
+        stats_register_counter("mmap_idle_tracking", STATS_GAUGE, stat_mmap_regions, (void *)4);
+#endif //ENABLE_MMAP_TRACKING
+}
+#endif //ENABLE_STATS_SHM
 
 void init_features(){
 
@@ -157,6 +693,29 @@ void init_features(){
                 printf("  - %s\n", cfg->devices[i]);
         }
 
+        printf("whitelist rules(%zu):\n", cfg->n_whitelist_rules);
+        for (size_t i = 0; i < cfg->n_whitelist_rules; i++){
+                printf("  - %s\n", cfg->whitelist_rules[i]);
+        }
+
+        if(init_whitelist_rules(cfg->whitelist_rules, cfg->n_whitelist_rules) < 0){
+                SPEEDYIO_FPRINTF("%s:ERROR invalid whitelist_rule in config file %s.\n", "SPEEDYIO_ERRCO_0222 %s\n", CFG_FILE_ENV_VAR);
+                KILLME();
+        }
+
+#ifdef ENABLE_CACHE_CLASSES
+        printf("cache classes(%zu):\n", cfg->n_cache_classes);
+        for (size_t i = 0; i < cfg->n_cache_classes; i++){
+                printf("  - %s\n", cfg->cache_classes[i]);
+        }
+
+        /*before init_g_heap, which allocates one global heap per class*/
+        if(init_cache_classes(cfg->cache_classes, cfg->n_cache_classes) < 0){
+                SPEEDYIO_FPRINTF("%s:ERROR invalid cache_class in config file %s.\n", "SPEEDYIO_ERRCO_0226 %s\n", CFG_FILE_ENV_VAR);
+                KILLME();
+        }
+#endif //ENABLE_CACHE_CLASSES
+
         printf("*********************************************************************************\n");
 
 #ifdef ENABLE_LICENSE
@@ -224,6 +783,19 @@ void init_features(){
                 SPEEDYIO_FPRINTF("%s:ERROR in creating start_stop pthread\n", "SPEEDYIO_ERRCO_0004\n");
         }
 #endif //ENABLE_START_STOP
+
+#ifdef ENABLE_ADMIN_SOCKET
+#ifdef GET_SPEEDYIO_OPTIONS
+        if(init_admin_socket(cfg->admin_socket_path) == 0){
+#else
+        if(init_admin_socket(nullptr) == 0){
+#endif //GET_SPEEDYIO_OPTIONS
+                init_admin_commands();
+                if(pthread_create(&admin_socket_thread, NULL, admin_socket_loop, NULL)){
+                        SPEEDYIO_FPRINTF("%s:ERROR in creating admin socket pthread\n", "SPEEDYIO_ERRCO_0236\n");
+                }
+        }
+#endif //ENABLE_ADMIN_SOCKET
 #endif //BELADY_PROOF or DISABLE_CONCURRENT_EVICTION
 #endif //ENABLE_EVICTION
 
@@ -245,6 +817,25 @@ void init_features(){
 
 #endif //MAINTAIN_INODE
 
+#if defined(ENABLE_TRACE_RING) && defined(GET_SPEEDYIO_OPTIONS)
+        if(cfg->trace_dir[0]){
+                trace_start(cfg->trace_dir, !cfg->trace_raw);
+        }
+#endif //ENABLE_TRACE_RING && GET_SPEEDYIO_OPTIONS
+
+#ifdef ENABLE_SHARDS_MRC
+        init_shards(SHARDS_SAMPLE_PPM);
+#endif //ENABLE_SHARDS_MRC
+
+#ifdef ENABLE_STATS_SHM
+        if(init_stats_shm() == 0){
+                init_stats_sources();
+                if(pthread_create(&stats_shm_thread, NULL, stats_shm_publisher, NULL)){
+                        SPEEDYIO_FPRINTF("%s:ERROR in creating stats pthread\n", "SPEEDYIO_ERRCO_0242\n");
+                }
+        }
+#endif //ENABLE_STATS_SHM
+
 }
 
 void construct(){
@@ -276,17 +867,20 @@ void destruct(){
         }
 #endif //ENABLE_EVICTION
 
-        print_latencies("read_syscalls - whitelisted files only", &readsyscalls_latency);
-
-        print_latencies("handle_read - whitelisted files only", &handle_read_latency);
-
-        print_latencies("get_perfd_struct_fast", &get_pfd_latency);
+#ifdef ENABLE_HOST_COORD
+        /*the others stop waiting on this process to reclaim*/
+        host_coord_exit();
+#endif //ENABLE_HOST_COORD
 
-        print_latencies("update_pvt_heap - in handle_read", &pvt_heap_latency);
+        print_all_latencies();
 
-        print_latencies("g_pvt_heap - in handle_read", &g_heap_latency);
+#ifdef ENABLE_STATS_SHM
+        destroy_stats_shm();
+#endif //ENABLE_STATS_SHM
 
-        print_latencies("heap_update_key ULONG_MAX- in evict_portions", &ulong_heap_update);
+#ifdef ENABLE_TRACE_RING
+        trace_stop();
+#endif //ENABLE_TRACE_RING
 
         // Close any open debug log file pointers
         close_debug_log();
@@ -299,12 +893,19 @@ static inline int path_is_dir(const char* p) {
     return (p && lstat(p, &st) == 0 && S_ISDIR(st.st_mode));
 }
 
+static inline int fd_is_dir(int fd) {
+    struct stat st;
+    return (fstat(fd, &st) == 0 && S_ISDIR(st.st_mode));
+}
+
 //OPEN SYSCALLS
 
 void handle_open(struct file_desc file){
         struct thread_args *arg = nullptr;
         struct inode *uinode = nullptr;
+        off_t seek_head = 0;
         bool whitelisted_file = true;
+        enum whitelist_action wl_action = WL_ACTION_NONE;
         std::string open_flags_str;
 #ifdef DEBUG
         std::string flag_str;
@@ -318,7 +919,8 @@ void handle_open(struct file_desc file){
 
         debug_printf("%s: filename:%s\n", __func__, file.filename);
 
-        if(!is_whitelisted(file.filename)){
+        wl_action = get_whitelist_action(file.filename);
+        if(wl_action != WL_ACTION_MANAGE && wl_action != WL_ACTION_MANAGE_NO_FADV_RANDOM){
                 debug_printf("%s: Not handling BLACKLISTED file:%s fd:%d\n",
                         __func__, file.filename, file.fd);
                 whitelisted_file = false;
@@ -357,7 +959,7 @@ void handle_open(struct file_desc file){
         }
 
 #ifdef MAINTAIN_INODE
-        uinode = add_fd_to_inode(file.fd, file.flags, file.filename);
+        uinode = add_fd_to_inode(file.fd, file.flags, file.filename, &seek_head);
         if(!uinode){
                 debug_printf("%s:WARNING Unable to add uinode fd:%d\n", __func__, file.fd);
                 goto handle_open_exit;
@@ -386,7 +988,7 @@ void handle_open(struct file_desc file){
 add_per_fd_ds:
 
 #ifdef PER_FD_DS
-        pfd = add_any_fd_to_perfd_struct(file.fd, file.flags, uinode, whitelisted_file);
+        pfd = add_any_fd_to_perfd_struct(file.fd, file.flags, uinode, whitelisted_file, seek_head);
         if(!pfd){
                 SPEEDYIO_FPRINTF("%s:ERROR Unable to add fd:%d to per_fd_ds\n", "SPEEDYIO_ERRCO_0008 %d\n", file.fd);
                 goto handle_open_exit;
@@ -436,7 +1038,13 @@ handle_open_exit:
          * whenever a file is opened by the program, we do FADV_RANDOM
          * because we dont want the OS to prefetch data items without our knowledge.
          * It reduces the accuracy and correctness of the heap and bitmap.
+         * Only files a manage-without-fadv-random rule opts out keep the
+         * kernel readahead; their pvt heaps miss what it reads in.
          */
+        if(wl_action == WL_ACTION_MANAGE_NO_FADV_RANDOM){
+                goto skip_fadv_random;
+        }
+
         // SPEEDYIO_PRINTF("%s:INFO Calling POSIX_FADV_RANDOM for fd: %d\n", "SPEEDYIO_INFOCO_0005 %d\n", file.fd);
         if(real_posix_fadvise(file.fd, 0, 0, POSIX_FADV_RANDOM) != 0){
                 SPEEDYIO_FPRINTF("%s:ERROR posix_fadvise failed for fd:%d\n", "SPEEDYIO_ERRCO_0009 %d\n", file.fd);
@@ -450,6 +1058,8 @@ handle_open_exit:
         if(uinode){
                 set_fadv_on_fd_uinode(uinode, file.fd, false);
         }
+
+skip_fadv_random:
 // #elif defined(ENABLE_PVT_HEAP)
 // #error "Book keeping pvt_heap will be incorrect if ENABLE_POSIX_FADV_RANDOM_FOR_WHITELISTED_FILES is disabled with ENABLE_PVT_HEAP."
 #endif  // ENABLE_POSIX_FADV_RANDOM_FOR_WHITELISTED_FILES
@@ -467,6 +1077,7 @@ int openat(int dirfd, const char *pathname, int flags, ...){
         struct file_desc file;
         char filebuff[MAX_ABS_PATH_LEN];
         bool changed = false;
+        struct timespec start, end;
 
 #ifdef ENABLE_MINCORE_DEBUG
         /**
@@ -498,31 +1109,61 @@ int openat(int dirfd, const char *pathname, int flags, ...){
          * hence this extra check.
          */
 
-        // if(fd < 3 || (flags & O_DIRECTORY)){
-        if (fd < 3 || (flags & O_DIRECTORY) || path_is_dir(pathname)){
+        if(fd < 3 || (flags & O_DIRECTORY)){
                 goto exit_openat;
         }
 
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+#ifdef ENABLE_FAST_OPEN_CLASSIFY
+        /**
+         * fstat on the fd is far cheaper than the lstat path walk and
+         * also catches symlinks to directories.
+         */
+        if(fd_is_dir(fd)){
+                goto exit_openat_clock;
+        }
+
+        /**
+         * Files that can never be whitelisted (jars, /proc, commitlogs etc.)
+         * are only booked as blacklisted pfds. The raw pathname is as good
+         * as the canonical one for that, so skip resolving it.
+         */
+        if(!is_whitelist_candidate(pathname)){
+                file.filename = pathname;
+                goto handle_file;
+        }
+#else
+        if(path_is_dir(pathname)){
+                goto exit_openat_clock;
+        }
+#endif //ENABLE_FAST_OPEN_CLASSIFY
+
         debug_printf("%s: file:%s, fd:%d\n", __func__, pathname, fd);
 
         /*resolve the symbolic links and create an absolute path*/
         if(!resolve_symlink_and_get_abs_path(dirfd, pathname, filebuff, MAX_ABS_PATH_LEN)){
                 SPEEDYIO_FPRINTF("%s:ERROR when calling resolve_symlink_and_get_abs_path on dirfd:%d, pathname:%s\n", "SPEEDYIO_ERRCO_0010 %d %s\n", dirfd, pathname);
-                goto exit_openat;
+                goto exit_openat_clock;
         }else{
                 debug_printf("%s: pathname:\"%s\" dirfd:%d resolved to \"%s\"\n",
                                 __func__, pathname, dirfd, filebuff);
         }
 
-        file.fd = fd;
-        file.filename = pathname;
         file.filename = filebuff;
+
+handle_file:
+        file.fd = fd;
         if(changed){
                 flags = (flags & ~O_RDWR) | O_WRONLY;
         }
         file.flags = flags;
         handle_open(file);
 
+exit_openat_clock:
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        bin_time_to_pow2_us(start, end, &open_latency);
+
 exit_openat:
         return fd;
 }
@@ -534,6 +1175,7 @@ int open64(const char *pathname, int flags, ...){
         struct file_desc file;
         char filebuff[MAX_ABS_PATH_LEN];
         bool changed = false;
+        struct timespec start, end;
 
 #ifdef ENABLE_MINCORE_DEBUG
         if(flags & O_WRONLY) {
@@ -560,30 +1202,53 @@ int open64(const char *pathname, int flags, ...){
          * hence this extra check.
          */
 
-        // if(fd < 3 || (flags & O_DIRECTORY)){
-        if (fd < 3 || (flags & O_DIRECTORY) || path_is_dir(pathname)){
+        if(fd < 3 || (flags & O_DIRECTORY)){
                 goto exit_open64;
         }
 
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+#ifdef ENABLE_FAST_OPEN_CLASSIFY
+        /*see openat*/
+        if(fd_is_dir(fd)){
+                goto exit_open64_clock;
+        }
+
+        if(!is_whitelist_candidate(pathname)){
+                file.filename = pathname;
+                goto handle_file;
+        }
+#else
+        if(path_is_dir(pathname)){
+                goto exit_open64_clock;
+        }
+#endif //ENABLE_FAST_OPEN_CLASSIFY
+
         debug_printf("%s: file:%s fd:%d\n", __func__, pathname, fd);
 
         /*resolve the symbolic links and create an absolute path*/
         if(!resolve_symlink_and_get_abs_path(AT_FDCWD, pathname, filebuff, MAX_ABS_PATH_LEN)){
                 SPEEDYIO_FPRINTF("%s:ERROR when calling resolve_symlink_and_get_abs_path for pathname:%s\n", "SPEEDYIO_ERRCO_0011 %s\n", pathname);
-                goto exit_open64;
+                goto exit_open64_clock;
         }else{
                 debug_printf("%s: pathname:\"%s\" resolved to \"%s\"\n",
                                 __func__, pathname, filebuff);
         }
 
-        file.fd = fd;
         file.filename = filebuff;
+
+handle_file:
+        file.fd = fd;
         if(changed){
                 flags = (flags & ~O_RDWR) | O_WRONLY;
         }
         file.flags = flags;
         handle_open(file);
 
+exit_open64_clock:
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        bin_time_to_pow2_us(start, end, &open_latency);
+
 exit_open64:
         return fd;
 }
@@ -595,6 +1260,7 @@ int open(const char *pathname, int flags, ...){
         struct file_desc file;
         char filebuff[MAX_ABS_PATH_LEN];
         bool changed = false;
+        struct timespec start, end;
 
 #ifdef ENABLE_MINCORE_DEBUG
         if(flags & O_WRONLY) {
@@ -621,30 +1287,53 @@ int open(const char *pathname, int flags, ...){
          * hence this extra check.
          */
 
-        // if(fd < 3 || (flags & O_DIRECTORY)){
-        if (fd < 3 || (flags & O_DIRECTORY) || path_is_dir(pathname)) {
+        if(fd < 3 || (flags & O_DIRECTORY)){
                 goto exit_open;
         }
 
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+#ifdef ENABLE_FAST_OPEN_CLASSIFY
+        /*see openat*/
+        if(fd_is_dir(fd)){
+                goto exit_open_clock;
+        }
+
+        if(!is_whitelist_candidate(pathname)){
+                file.filename = pathname;
+                goto handle_file;
+        }
+#else
+        if(path_is_dir(pathname)){
+                goto exit_open_clock;
+        }
+#endif //ENABLE_FAST_OPEN_CLASSIFY
+
         debug_printf("%s: file:%s fd:%d\n", __func__,  pathname, fd);
 
         /*resolve the symbolic links and create an absolute path*/
         if(!resolve_symlink_and_get_abs_path(AT_FDCWD, pathname, filebuff, MAX_ABS_PATH_LEN)){
                 SPEEDYIO_FPRINTF("%s:ERROR when calling resolve_symlink_and_get_abs_path for pathname:%s\n", "SPEEDYIO_ERRCO_0012 %s\n", pathname);
-                goto exit_open;
+                goto exit_open_clock;
         }else{
                 debug_printf("%s: pathname:\"%s\" resolved to \"%s\"\n",
                                 __func__, pathname, filebuff);
         }
 
-        file.fd = fd;
         file.filename = filebuff;
+
+handle_file:
+        file.fd = fd;
         if(changed){
                 flags = (flags & ~O_RDWR) | O_WRONLY;
         }
         file.flags = flags;
         handle_open(file);
 
+exit_open_clock:
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        bin_time_to_pow2_us(start, end, &open_latency);
+
 exit_open:
         return fd;
 }
@@ -790,6 +1479,7 @@ bool handle_close(int fd){
         // SPEEDYIO_PRINTF("%s:INFO closing fd:%d, {ino:%lu, dev:%lu}\n", "SPEEDYIO_INFOCO_0006 %d %lu %lu\n", fd, uinode->ino, uinode->dev_id);
 
         pfd->fd_open = false;
+        set_pfd_fdesc(pfd.get(), nullptr);
         /**
          * In a case where a non-regular file is opened
          * with the same fd as one previously used by a
@@ -983,6 +1673,7 @@ std::mutex *handle_unlink(int dirfd, const char* pathname, int unlink_flags){
         struct inode *uinode = nullptr;
         struct value *val = nullptr;
         std::mutex *lock_ret = nullptr;
+        char uinode_name[PATH_MAX];
 
         debug_printf("%s: dirfd:%d, path:%s, flags:%d\n", __func__, dirfd, pathname, unlink_flags);
 
@@ -1110,15 +1801,16 @@ std::mutex *handle_unlink(int dirfd, const char* pathname, int unlink_flags){
                  * If yes, we wont be able to use this filename later for anything.
                  * TODO: See how this can be fixed. Not high priority
                  */
-                if(same_pathnames(uinode->filename, dirfd, pathname) == true){
+                get_uinode_filename(uinode, uinode_name, sizeof(uinode_name));
+                if(same_pathnames(uinode_name, dirfd, pathname) == true){
                         cfprintf(stderr, "%s: WARNING this uinode->filename:%s "
                                 "will not be available anymore for {ino:%lu, dev:%lu}. "
                                 "nr_links:%lu. Skipping marked_unlinked\n",
-                                __func__, uinode->filename, uinode->ino, uinode->dev_id, uinode->nr_links);
+                                __func__, uinode_name, uinode->ino, uinode->dev_id, uinode->nr_links);
 
                 }else{
                         cfprintf(stderr, "%s:WARNING {ino:%lu, dev:%lu} path:%s has nr_links:%lu and is being unlinked. Skipping marked_unlinked\n",
-                                __func__, uinode->ino, uinode->dev_id, uinode->filename, uinode->nr_links);
+                                __func__, uinode->ino, uinode->dev_id, uinode_name, uinode->nr_links);
                 }
         }
 
@@ -1210,36 +1902,69 @@ exit_unlinkat:
 
 //DUP SYSCALLS
 
-/*returns 0 if there is an error*/
+/**
+ * newfd is a dup of oldfd; they share the same open file description.
+ * So for a whitelisted oldfd, newfd gets added to the same uinode and its
+ * pfd shares the open_file_desc (seek head) of oldfd's pfd.
+ *
+ * If newfd was open before (dup2/dup3), it has been implicitly closed;
+ * add_any_fd_to_perfd_struct takes care of that.
+ *
+ * flags can only have O_CLOEXEC which only belongs to newfd.
+ * returns 0 if there is an error
+ */
 int handle_dup(int oldfd, int newfd, int flags){
         int ret = 1;
+        int open_flags;
+        struct inode *uinode = nullptr;
 
         std::shared_ptr<struct perfd_struct> pfd = nullptr;
+        std::shared_ptr<struct perfd_struct> new_pfd = nullptr;
 
-        /**
-         * XXX:TODO
-         * READ THE MAN PAGE OF DUP, DUP2, DUP3 BEFORE IMPLEMENTING THIS
-         * 1. Check if there exists an active pfd (not closed) for oldfd
-         * 2. Check if there exists an active pfd for newfd
-         * 3. Check if flags have something like CLOEXEC for whitelisted files
-         * 4. Duplicate pfd from oldfd to newfd differently
-         * for whitelisted and blacklisted files
-         *
-         * Currently this impl. only throws NOTSUPPORTED error if dup is called for
-         * a whitelisted fd.
-         */
+        //enables per thread ds
+        per_th_d.touchme = true;
 
 #if defined(PER_FD_DS) && defined(MAINTAIN_INODE)
 
+        if(oldfd == newfd || newfd < 3){
+                goto exit_handle_dup;
+        }
+
         pfd = get_perfd_struct_fast(oldfd);
-        if(!pfd){
+        if(!pfd || pfd->is_closed()){
                 goto exit_handle_dup;
         }
 
-        if(!pfd->is_blacklisted()){
-                SPEEDYIO_FPRINTF("%s:NOTSUPPORTED dup/dup2/dup3 called for whitelisted fd:%d\n", "SPEEDYIO_NOTSUPPORTEDCO_0003 %d\n", oldfd);
+        open_flags = (pfd->open_flags & ~O_CLOEXEC) | (flags & O_CLOEXEC);
+
+        if(pfd->is_blacklisted()){
+                new_pfd = add_any_fd_to_perfd_struct(newfd, open_flags, nullptr, false);
+                if(!new_pfd){
+                        ret = 0;
+                }
+                goto exit_handle_dup;
+        }
+
+        uinode = pfd->uinode;
+        if(unlikely(!uinode)){
+                SPEEDYIO_FPRINTF("%s:ERROR no uinode for this whitelisted fd:%d\n", "SPEEDYIO_ERRCO_0217 %d\n", oldfd);
+                ret = 0;
+                goto exit_handle_dup;
+        }
+
+        /*dup2 onto an fd already open on the same file keeps its fdlist entry*/
+        new_pfd = get_perfd_struct_fast(newfd);
+        if(!new_pfd || new_pfd->is_closed() || new_pfd->is_blacklisted() || new_pfd->uinode != uinode){
+                if(!add_fd_to_fdlist(uinode, newfd, open_flags)){
+                        SPEEDYIO_FPRINTF("%s:ERROR add_fd_to_fdlist newfd:%d to {ino:%lu, dev:%lu}\n", "SPEEDYIO_ERRCO_0218 %d %lu %lu\n", newfd, uinode->ino, uinode->dev_id);
+                        ret = 0;
+                        goto exit_handle_dup;
+                }
+        }
+
+        new_pfd = add_any_fd_to_perfd_struct(newfd, open_flags, uinode, true, 0, pfd->fdesc.load(std::memory_order_acquire));
+        if(!new_pfd){
                 ret = 0;
-                KILLME();
                 goto exit_handle_dup;
         }
 #endif //PER_FD_DS && MAINTAIN_INODE
@@ -1313,7 +2038,8 @@ exit_dup3:
 
 //READ SYSCALLS
 
-void handle_read(int fd, off_t offset, size_t size, bool offset_absent){
+void handle_read(int fd, off_t offset, size_t size, bool offset_absent,
+                const struct timespec *syscall_start, const struct timespec *syscall_end){
 
         struct timespec start, end;
         struct timespec get_pfd_start, get_pfd_end;
@@ -1379,9 +2105,9 @@ void handle_read(int fd, off_t offset, size_t size, bool offset_absent){
 
         /*offset is absent for read syscall where OS/glibc maintains it*/
         if(offset_absent){
-                offset = update_fd_seek_pos(uinode, fd, size, false);
+                offset = update_pfd_seek_pos(pfd.get(), size, false);
                 if(offset == -1){
-                        SPEEDYIO_FPRINTF("%s:ERROR while doing update_fd_seek_pos fd:%d {ino:%lu, dev:%lu}\n", "SPEEDYIO_ERRCO_0035 %d %lu %lu\n", fd, uinode->ino, uinode->dev_id);
+                        SPEEDYIO_FPRINTF("%s:ERROR while doing update_pfd_seek_pos fd:%d {ino:%lu, dev:%lu}\n", "SPEEDYIO_ERRCO_0035 %d %lu %lu\n", fd, uinode->ino, uinode->dev_id);
                         KILLME();
                         goto handle_read_exit;
                 }
@@ -1398,6 +2124,14 @@ void handle_read(int fd, off_t offset, size_t size, bool offset_absent){
         log_event_to_file(per_th_d.read_events_fd, event_string);
 #endif // PRINT_READ_EVENTS
 
+#ifdef ENABLE_TRACE_RING
+        trace_io(TRACE_OP_READ, uinode->ino, uinode->dev_id, offset, size, syscall_start, syscall_end);
+#endif //ENABLE_TRACE_RING
+
+#ifdef ENABLE_SHARDS_MRC
+        shards_sample(uinode->ino, uinode->dev_id, offset, size);
+#endif //ENABLE_SHARDS_MRC
+
         /*check if the file is not being read beyond MAX_FILE_SIZE_BYTES*/
         if(offset+size >= MAX_FILE_SIZE_BYTES){
                 SPEEDYIO_FPRINTF("%s:MISCONFIG file offset %ld >= MAX_FILE_SIZE_BYTES for fd:%d, {ino:%lu, dev:%lu}\n", "SPEEDYIO_MISCONFIGCO_0001 %ld %d %lu %lu\n", offset+size, fd, uinode->ino, uinode->dev_id);
@@ -1487,13 +2221,19 @@ ssize_t pread64(int fd, void *data, size_t size, off_t offset){
 #endif
 
 serve_req:
+#ifdef ENABLE_BUSY_FILES
+        struct inode *busy_uinode = begin_file_read(fd);
+#endif //ENABLE_BUSY_FILES
         clock_gettime(CLOCK_MONOTONIC, &start);
         amount_read = real_pread64(fd, data, size, offset);
         clock_gettime(CLOCK_MONOTONIC, &end);
+#ifdef ENABLE_BUSY_FILES
+        end_file_read(busy_uinode);
+#endif //ENABLE_BUSY_FILES
         bin_time_to_pow2_us(start, end, &readsyscalls_latency);
 
         if(amount_read > 0 && fd >= 3){
-                handle_read(fd, offset, size, false);
+                handle_read(fd, offset, size, false, &start, &end);
         }
 
 #if defined(PER_FD_DS) && defined(MAINTAIN_INODE) && defined(ENABLE_UINODE_LOCK)
@@ -1564,15 +2304,21 @@ ssize_t pread(int fd, void *data, size_t size, off_t offset){
 #endif
 
 serve_req:
+#ifdef ENABLE_BUSY_FILES
+        struct inode *busy_uinode = begin_file_read(fd);
+#endif //ENABLE_BUSY_FILES
         clock_gettime(CLOCK_MONOTONIC, &start);
         amount_read = real_pread(fd, data, size, offset);
         clock_gettime(CLOCK_MONOTONIC, &end);
+#ifdef ENABLE_BUSY_FILES
+        end_file_read(busy_uinode);
+#endif //ENABLE_BUSY_FILES
         bin_time_to_pow2_us(start, end, &readsyscalls_latency);
 
         if(amount_read > 0 && fd >= 3){
                 // debug_printf("%s: fd:%d, offset:%ld, size:%ld amt_read:%ld\n",
                 //                 __func__, fd, offset, size, amount_read);
-                handle_read(fd, offset, size, false);
+                handle_read(fd, offset, size, false, &start, &end);
         }
 
 #if defined(PER_FD_DS) && defined(MAINTAIN_INODE) && defined(ENABLE_UINODE_LOCK)
@@ -1645,9 +2391,15 @@ ssize_t read(int fd, void *data, size_t size){
 #endif
 
 serve_req:
+#ifdef ENABLE_BUSY_FILES
+        struct inode *busy_uinode = begin_file_read(fd);
+#endif //ENABLE_BUSY_FILES
         clock_gettime(CLOCK_MONOTONIC, &start);
         amount_read = real_read(fd, data, size);
         clock_gettime(CLOCK_MONOTONIC, &end);
+#ifdef ENABLE_BUSY_FILES
+        end_file_read(busy_uinode);
+#endif //ENABLE_BUSY_FILES
         bin_time_to_pow2_us(start, end, &readsyscalls_latency);
 
 #ifdef DEBUG
@@ -1683,7 +2435,7 @@ serve_req:
                  * it doesnt really change much of our prefetching/eviction
                  * effectiveness because it about the end of file, one incorrect page/portion.
                  */
-                handle_read(fd, 0, size, true);
+                handle_read(fd, 0, size, true, &start, &end);
         }
 
 #if defined(PER_FD_DS) && defined(MAINTAIN_INODE) && defined(ENABLE_UINODE_LOCK)
@@ -1747,12 +2499,40 @@ exit_fread:
 
 //FSYNC
 
+#ifdef ENABLE_DIRTY_TRACKING
+/**
+ * Returns the uinode of a tracked fd, and in seq what has been written
+ * to it so far; once the sync succeeds that is all clean.
+ */
+static struct inode *begin_fd_sync(int fd, std::shared_ptr<struct perfd_struct> &pfd, unsigned long long int *seq){
+        pfd = get_perfd_struct_fast(fd);
+        if(!pfd || pfd->is_blacklisted() || !pfd->uinode){
+                return nullptr;
+        }
+        *seq = begin_dirty_sync(pfd->uinode);
+        return pfd->uinode;
+}
+#endif //ENABLE_DIRTY_TRACKING
+
 extern "C" __attribute__((visibility("default")))
 int fsync(int fd){
         int ret = -1;
+#ifdef ENABLE_DIRTY_TRACKING
+        std::shared_ptr<struct perfd_struct> pfd = nullptr;
+        struct inode *uinode = nullptr;
+        unsigned long long int dirty_seq = 0;
+
+        uinode = begin_fd_sync(fd, pfd, &dirty_seq);
+#endif //ENABLE_DIRTY_TRACKING
 
         ret = real_fsync(fd);
 
+#ifdef ENABLE_DIRTY_TRACKING
+        if(ret == 0 && uinode){
+                end_dirty_sync(uinode, dirty_seq);
+        }
+#endif //ENABLE_DIRTY_TRACKING
+
 exit_fsync:
         return ret;
 }
@@ -1763,10 +2543,21 @@ int fdatasync(int fd){
         int ret = -1;
         std::shared_ptr<struct perfd_struct> pfd = nullptr;
         struct inode *uinode =  nullptr;
+#ifdef ENABLE_DIRTY_TRACKING
+        unsigned long long int dirty_seq = 0;
+
+        uinode = begin_fd_sync(fd, pfd, &dirty_seq);
+#endif //ENABLE_DIRTY_TRACKING
 
 do_real_fdatasync:
         ret = real_fdatasync(fd);
 
+#ifdef ENABLE_DIRTY_TRACKING
+        if(ret == 0 && uinode){
+                end_dirty_sync(uinode, dirty_seq);
+        }
+#endif //ENABLE_DIRTY_TRACKING
+
 exit_fsync:
         return ret;
 }
@@ -1827,9 +2618,21 @@ void handle_write(int fd, off_t offset, ssize_t size, bool offset_absent){
         //debug_printf("%s: fd:%d size of write:%d bytes\n", __func__, fd, size);
 
         if(offset_absent){
-                offset = update_fd_seek_pos(uinode, fd, size, false);
+                if(pfd->open_flags & O_APPEND){
+                        /**
+                         * O_APPEND writes land on the end of file which may have been moved by
+                         * ftruncate or other writers. Ask the kernel where this write ended.
+                         */
+                        offset = real_lseek(fd, 0, SEEK_CUR);
+                        if(offset >= 0){
+                                update_pfd_seek_pos(pfd.get(), offset, true);
+                                offset -= size;
+                        }
+                }else{
+                        offset = update_pfd_seek_pos(pfd.get(), size, false);
+                }
                 if(offset < 0){
-                        SPEEDYIO_FPRINTF("%s:ERROR update_fd_seek_pos returned error for fd:%d {ino:%lu, dev:%lu} size:%ld\n", "SPEEDYIO_ERRCO_0050 %d %lu %lu %ld\n", fd, uinode->ino, uinode->dev_id, size);
+                        SPEEDYIO_FPRINTF("%s:ERROR update_pfd_seek_pos returned error for fd:%d {ino:%lu, dev:%lu} size:%ld\n", "SPEEDYIO_ERRCO_0050 %d %lu %lu %ld\n", fd, uinode->ino, uinode->dev_id, size);
                         KILLME();
                         goto handle_write_exit;
                 }
@@ -1853,6 +2656,10 @@ void handle_write(int fd, off_t offset, ssize_t size, bool offset_absent){
         log_event_to_file(per_th_d.write_events_fd, event_string);
 #endif // PRINT_WRITE_EVENTS
 
+#ifdef ENABLE_TRACE_RING
+        trace_io(TRACE_OP_WRITE, uinode->ino, uinode->dev_id, offset, size, nullptr, nullptr);
+#endif //ENABLE_TRACE_RING
+
 #ifdef ENABLE_PER_INODE_BITMAP
         //update bitmap
         set_range_bitmap(uinode, PG_NR_FROM_OFFSET(offset), BYTES_TO_PG(size));
@@ -1871,6 +2678,13 @@ void handle_write(int fd, off_t offset, ssize_t size, bool offset_absent){
         heap_update(uinode, offset, size, false);
 #endif //ENABLE_EVICTION
 
+#ifdef ENABLE_DIRTY_TRACKING
+        /*O_SYNC and O_DSYNC writes are on disk already, O_DIRECT ones skip the page cache*/
+        if(!(pfd->open_flags & (O_SYNC | O_DSYNC | O_DIRECT))){
+                track_dirty_write(uinode, offset, size);
+        }
+#endif //ENABLE_DIRTY_TRACKING
+
 #endif //PER_FD_DS, MAINTAIN_INODE
 
 handle_write_exit:
@@ -2102,6 +2916,255 @@ exit_write:
 }
 
 
+//VECTORED AND ZERO-COPY SYSCALLS
+
+/**
+ * The vectored calls fill/drain the iovecs back to back from a single
+ * file range, so for bookkeeping they are one read/write of the
+ * summed iov lengths. We use the return value instead of the summed
+ * iov_len since that is exactly what the kernel moved and, for the
+ * calls without an offset, what the file position advanced by.
+ *
+ * preadv2/pwritev2 with offset -1 behave like readv/writev.
+ */
+
+extern "C" __attribute__((visibility("default")))
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt){
+        ssize_t amount_read;
+        struct timespec start, end;
+
+#ifdef ENABLE_BUSY_FILES
+        struct inode *busy_uinode = begin_file_read(fd);
+#endif //ENABLE_BUSY_FILES
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        amount_read = real_readv(fd, iov, iovcnt);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+#ifdef ENABLE_BUSY_FILES
+        end_file_read(busy_uinode);
+#endif //ENABLE_BUSY_FILES
+        bin_time_to_pow2_us(start, end, &readsyscalls_latency);
+
+        if(amount_read > 0 && fd >= 3){
+                handle_read(fd, 0, amount_read, true, &start, &end);
+        }
+
+        return amount_read;
+}
+
+extern "C" __attribute__((visibility("default")))
+ssize_t preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset){
+        ssize_t amount_read;
+        struct timespec start, end;
+
+#ifdef ENABLE_BUSY_FILES
+        struct inode *busy_uinode = begin_file_read(fd);
+#endif //ENABLE_BUSY_FILES
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        amount_read = real_preadv(fd, iov, iovcnt, offset);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+#ifdef ENABLE_BUSY_FILES
+        end_file_read(busy_uinode);
+#endif //ENABLE_BUSY_FILES
+        bin_time_to_pow2_us(start, end, &readsyscalls_latency);
+
+        if(amount_read > 0 && fd >= 3){
+                handle_read(fd, offset, amount_read, false, &start, &end);
+        }
+
+        return amount_read;
+}
+
+extern "C" __attribute__((visibility("default")))
+ssize_t preadv64(int fd, const struct iovec *iov, int iovcnt, off64_t offset){
+        ssize_t amount_read;
+        struct timespec start, end;
+
+#ifdef ENABLE_BUSY_FILES
+        struct inode *busy_uinode = begin_file_read(fd);
+#endif //ENABLE_BUSY_FILES
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        amount_read = real_preadv64(fd, iov, iovcnt, offset);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+#ifdef ENABLE_BUSY_FILES
+        end_file_read(busy_uinode);
+#endif //ENABLE_BUSY_FILES
+        bin_time_to_pow2_us(start, end, &readsyscalls_latency);
+
+        if(amount_read > 0 && fd >= 3){
+                handle_read(fd, offset, amount_read, false, &start, &end);
+        }
+
+        return amount_read;
+}
+
+extern "C" __attribute__((visibility("default")))
+ssize_t preadv2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags){
+        ssize_t amount_read;
+        struct timespec start, end;
+
+#ifdef ENABLE_BUSY_FILES
+        struct inode *busy_uinode = begin_file_read(fd);
+#endif //ENABLE_BUSY_FILES
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        amount_read = real_preadv2(fd, iov, iovcnt, offset, flags);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+#ifdef ENABLE_BUSY_FILES
+        end_file_read(busy_uinode);
+#endif //ENABLE_BUSY_FILES
+        bin_time_to_pow2_us(start, end, &readsyscalls_latency);
+
+        if(amount_read > 0 && fd >= 3){
+                handle_read(fd, offset, amount_read, offset == -1, &start, &end);
+        }
+
+        return amount_read;
+}
+
+extern "C" __attribute__((visibility("default")))
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt){
+        ssize_t amount_written = 0;
+
+        amount_written = real_writev(fd, iov, iovcnt);
+
+        if(amount_written > 0 && fd >= 3){
+                handle_write(fd, 0, amount_written, true);
+        }
+
+        return amount_written;
+}
+
+extern "C" __attribute__((visibility("default")))
+ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset){
+        ssize_t amount_written = 0;
+
+        amount_written = real_pwritev(fd, iov, iovcnt, offset);
+
+        if(amount_written > 0 && fd >= 3){
+                handle_write(fd, offset, amount_written, false);
+        }
+
+        return amount_written;
+}
+
+extern "C" __attribute__((visibility("default")))
+ssize_t pwritev64(int fd, const struct iovec *iov, int iovcnt, off64_t offset){
+        ssize_t amount_written = 0;
+
+        amount_written = real_pwritev64(fd, iov, iovcnt, offset);
+
+        if(amount_written > 0 && fd >= 3){
+                handle_write(fd, offset, amount_written, false);
+        }
+
+        return amount_written;
+}
+
+extern "C" __attribute__((visibility("default")))
+ssize_t pwritev2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags){
+        ssize_t amount_written = 0;
+
+        amount_written = real_pwritev2(fd, iov, iovcnt, offset, flags);
+
+        if(amount_written > 0 && fd >= 3){
+                handle_write(fd, offset, amount_written, offset == -1);
+        }
+
+        return amount_written;
+}
+
+/**
+ * copy_file_range, sendfile and splice move data between two fds
+ * without it ever going through userspace. The pages of the source
+ * still land in the page cache, so they are booked as a read on the
+ * source fd and a write on the destination fd.
+ *
+ * A NULL offset pointer means the kernel used (and advanced) the fd's
+ * file position, which is what offset_absent tracks. A non-NULL one is
+ * advanced by the kernel instead, so we note its value before the call.
+ *
+ * Pipes and sockets on either side are not in the perfd map and are
+ * skipped by handle_read/handle_write.
+ */
+
+extern "C" __attribute__((visibility("default")))
+ssize_t copy_file_range(int fd_in, off64_t *off_in, int fd_out, off64_t *off_out, size_t len, unsigned int flags){
+        ssize_t amount_copied;
+        off64_t in_offset = off_in ? *off_in : 0;
+        off64_t out_offset = off_out ? *off_out : 0;
+
+        amount_copied = real_copy_file_range(fd_in, off_in, fd_out, off_out, len, flags);
+
+        if(amount_copied > 0){
+                if(fd_in >= 3){
+                        handle_read(fd_in, in_offset, amount_copied, !off_in);
+                }
+                if(fd_out >= 3){
+                        handle_write(fd_out, out_offset, amount_copied, !off_out);
+                }
+        }
+
+        return amount_copied;
+}
+
+extern "C" __attribute__((visibility("default")))
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count){
+        ssize_t amount_sent;
+        off_t in_offset = offset ? *offset : 0;
+
+        amount_sent = real_sendfile(out_fd, in_fd, offset, count);
+
+        if(amount_sent > 0){
+                if(in_fd >= 3){
+                        handle_read(in_fd, in_offset, amount_sent, !offset);
+                }
+                /*out_fd is usually a socket; it is a file only since 2.6.33*/
+                if(out_fd >= 3){
+                        handle_write(out_fd, 0, amount_sent, true);
+                }
+        }
+
+        return amount_sent;
+}
+
+extern "C" __attribute__((visibility("default")))
+ssize_t sendfile64(int out_fd, int in_fd, off64_t *offset, size_t count){
+        ssize_t amount_sent;
+        off64_t in_offset = offset ? *offset : 0;
+
+        amount_sent = real_sendfile64(out_fd, in_fd, offset, count);
+
+        if(amount_sent > 0){
+                if(in_fd >= 3){
+                        handle_read(in_fd, in_offset, amount_sent, !offset);
+                }
+                if(out_fd >= 3){
+                        handle_write(out_fd, 0, amount_sent, true);
+                }
+        }
+
+        return amount_sent;
+}
+
+extern "C" __attribute__((visibility("default")))
+ssize_t splice(int fd_in, off64_t *off_in, int fd_out, off64_t *off_out, size_t len, unsigned int flags){
+        ssize_t amount_spliced;
+        off64_t in_offset = off_in ? *off_in : 0;
+        off64_t out_offset = off_out ? *off_out : 0;
+
+        amount_spliced = real_splice(fd_in, off_in, fd_out, off_out, len, flags);
+
+        if(amount_spliced > 0){
+                if(fd_in >= 3){
+                        handle_read(fd_in, in_offset, amount_spliced, !off_in);
+                }
+                if(fd_out >= 3){
+                        handle_write(fd_out, out_offset, amount_spliced, !off_out);
+                }
+        }
+
+        return amount_spliced;
+}
+
 #ifdef CHECK_FOR_FREAD_ERRORS
 /*NOT IMPLEMENTED. Just returns an error if fwrite is used on a whitelisted file*/
 extern "C" __attribute__((visibility("default")))
@@ -2239,6 +3302,12 @@ do_real_ftruncate:
                 goto exit_ftruncate;
         }
 
+        /**
+         * ftruncate doesn't move any fd's offset. The next write on an
+         * O_APPEND fd lands on the new end of file; handle_write asks
+         * the kernel for it.
+         */
+
 exit_ftruncate:
         return ret;
 }
@@ -2284,10 +3353,10 @@ void handle_lseek(int fd, off_t offset, int whence, off_t seek_ret){
                 goto exit_handle_lseek;
         }
 
-        /*update the seek_head for this whitelisted fd*/
-        old_offset = update_fd_seek_pos(uinode, fd, seek_ret, true);
+        /*update the seek_head for this whitelisted fd and its dups*/
+        old_offset = update_pfd_seek_pos(pfd.get(), seek_ret, true);
         if(old_offset < 0){
-                SPEEDYIO_FPRINTF("%s:ERROR while update_fd_seek_pos fd:%d {ino:%lu, dev:%lu} ret:%ld\n", "SPEEDYIO_ERRCO_0064 %d %lu %lu %ld\n", fd, uinode->ino, uinode->dev_id, old_offset);
+                SPEEDYIO_FPRINTF("%s:ERROR while update_pfd_seek_pos fd:%d {ino:%lu, dev:%lu} ret:%ld\n", "SPEEDYIO_ERRCO_0064 %d %lu %lu %ld\n", fd, uinode->ino, uinode->dev_id, old_offset);
                 KILLME();
                 goto exit_handle_lseek;
         }
@@ -2333,7 +3402,10 @@ exit_lseek:
 }
 
 #ifdef CHECK_FOR_FREAD_ERRORS
-/*NOT IMPLEMENTED. Just report an error if whitelisted file calls fseek*/
+/**
+ * fread is still NOTSUPPORTED for whitelisted files; but a fseek on the
+ * stream moves the fd offset, so sync the seek head with the kernel.
+ */
 extern "C" __attribute__((visibility("default")))
 int fseek(FILE *stream, long offset, int whence){
         int ret;
@@ -2355,26 +3427,21 @@ int fseek(FILE *stream, long offset, int whence){
                 goto exit_fseek;
         }
 
-        if(whence != SEEK_SET){
-                goto exit_fseek;
-        }
-
         pfd = get_perfd_struct_fast(fd);
-        if(!pfd){
+        if(!pfd || pfd->is_blacklisted() || pfd->is_closed()){
                 goto exit_fseek;
         }
 
-        if(!pfd->is_blacklisted()){
-                SPEEDYIO_FPRINTF("%s:NOTSUPPORTED on WHITELISTED fd:%d\n", "SPEEDYIO_NOTSUPPORTEDCO_0008 %d\n", fd);
-                KILLME();
-                goto exit_fseek;
-        }
+        update_pfd_seek_pos(pfd.get(), real_lseek(fd, 0, SEEK_CUR), true);
 
 exit_fseek:
         return ret;
 }
 
-/*NOT IMPLEMENTED. Just report an error if whitelisted file calls fseeko*/
+/**
+ * fread is still NOTSUPPORTED for whitelisted files; but a fseeko on the
+ * stream moves the fd offset, so sync the seek head with the kernel.
+ */
 extern "C" __attribute__((visibility("default")))
 int fseeko(FILE *stream, off_t offset, int whence){
         int ret;
@@ -2396,20 +3463,12 @@ int fseeko(FILE *stream, off_t offset, int whence){
                 goto exit_fseeko;
         }
 
-        if(whence != SEEK_SET){
-                goto exit_fseeko;
-        }
-
         pfd = get_perfd_struct_fast(fd);
-        if(!pfd){
+        if(!pfd || pfd->is_blacklisted() || pfd->is_closed()){
                 goto exit_fseeko;
         }
 
-        if(!pfd->is_blacklisted()){
-                SPEEDYIO_FPRINTF("%s:NOTSUPPORTED on WHITELISTED fd:%d\n", "SPEEDYIO_NOTSUPPORTEDCO_0009 %d\n", fd);
-                KILLME();
-                goto exit_fseeko;
-        }
+        update_pfd_seek_pos(pfd.get(), real_lseek(fd, 0, SEEK_CUR), true);
 
 exit_fseeko:
         return ret;
@@ -2727,7 +3786,15 @@ int fcntl(int fd, int cmd, ...)
         if(ret == -1)
                 goto exit_fcntl;
 
-        if(!want_dup_msg && !want_cloexec_msg && !want_odirect_msg)
+        /*ret is the new fd*/
+        if(want_dup_msg){
+                if(!handle_dup(fd, ret, (cmd == F_DUPFD_CLOEXEC) ? O_CLOEXEC : 0)){
+                        SPEEDYIO_FPRINTF("%s:ERROR in handling %s oldfd:%d, newfd:%d\n", "SPEEDYIO_ERRCO_0219 %s %d %d\n", (cmd == F_DUPFD) ? "F_DUPFD" : "F_DUPFD_CLOEXEC", fd, ret);
+                }
+                goto exit_fcntl;
+        }
+
+        if(!want_cloexec_msg && !want_odirect_msg)
                 goto exit_fcntl;
 
         pfd = get_perfd_struct_fast(fd);
@@ -2762,10 +3829,6 @@ int fcntl(int fd, int cmd, ...)
                 goto exit_fcntl;
         }
 
-        if(want_dup_msg){
-                SPEEDYIO_FPRINTF("%s:NOTSUPPORTED %s on whitelisted fd:%d (arg=%d)\n", "SPEEDYIO_NOTSUPPORTEDCO_0015 %s %d %d\n", (cmd == F_DUPFD) ? "F_DUPFD" : "F_DUPFD_CLOEXEC", fd, arg_i);
-                KILLME();
-        }
         /*check comments in check_open_flag_sanity on O_CLOEXEC*/
         // if (want_cloexec_msg) {
         // SPEEDYIO_FPRINTF("%s:NOTSUPPORTED F_SETFD+FD_CLOEXEC on fd:%d\n", "SPEEDYIO_NOTSUPPORTEDCO_0016 %d\n", fd);
@@ -3055,8 +4118,9 @@ skip_fadvise64:
 }
 
 
-int handle_mmap(size_t length, int prot, int flags, int fd, off_t offset){
-        int ret = true;
+/*Returns true if the mapping is of a whitelisted file and is tracked; dev and ino are set then*/
+bool handle_mmap(size_t length, int prot, int flags, int fd, off_t offset, dev_t *dev, ino_t *ino){
+        bool track = false;
         std::string prot_str;
         std::string flags_str;
         std::shared_ptr<struct perfd_struct> pfd = nullptr;
@@ -3092,19 +4156,16 @@ int handle_mmap(size_t length, int prot, int flags, int fd, off_t offset){
         if(pfd->fd != fd){
                 SPEEDYIO_FPRINTF("%s:ERROR pfd->fd:%d doesnt match fd:%d\n", "SPEEDYIO_ERRCO_0082 %d %d\n", pfd->fd, fd);
                 KILLME();
-                ret = true;
                 goto exit_handle_mmap;
         }
 
         if(pfd->is_blacklisted()){
                 // cfprintf(stderr, "%s:INFO fd:%d is blacklisted\n", __func__, fd);
-                ret = true;
                 goto exit_handle_mmap;
         }
 
         if(pfd->is_closed()){
                 SPEEDYIO_FPRINTF("%s:WARNING fd:%d is closed. Skipping\n", "SPEEDYIO_WARNCO_0005 %d\n", fd);
-                ret = true;
                 goto exit_handle_mmap;
         }
 
@@ -3112,17 +4173,25 @@ int handle_mmap(size_t length, int prot, int flags, int fd, off_t offset){
         if(!uinode){
                 SPEEDYIO_FPRINTF("%s:ERROR no uinode for this whitelisted fd:%d\n", "SPEEDYIO_ERRCO_0083 %d\n", fd);
                 KILLME();
-                ret = true;
                 goto exit_handle_mmap;
         }
 
         if(unlikely(uinode->is_deleted())){
                 SPEEDYIO_FPRINTF("%s:ERROR fd:%d {ino:%lu, dev:%lu} is deleted. Skipping\n", "SPEEDYIO_ERRCO_0084 %d %lu %lu\n", fd, uinode->ino, uinode->dev_id);
                 KILLME();
-                ret = true;
                 goto exit_handle_mmap;
         }
 
+#ifdef ENABLE_MMAP_TRACKING
+        /*private writable mappings turn into anonymous memory as they are written, those stay unsupported*/
+        if(!((flags & MAP_PRIVATE) && (prot & PROT_WRITE))){
+                *dev = uinode->dev_id;
+                *ino = uinode->ino;
+                track = true;
+                goto exit_handle_mmap;
+        }
+#endif //ENABLE_MMAP_TRACKING
+
         if (prot & PROT_READ) prot_str += "PROT_READ ";
         if (prot & PROT_WRITE) prot_str += "PROT_WRITE ";
         if (prot & PROT_EXEC) prot_str += "PROT_EXEC ";
@@ -3144,13 +4213,16 @@ int handle_mmap(size_t length, int prot, int flags, int fd, off_t offset){
 #endif //PER_FD_DS && MAINTAIN_INODE
 
 exit_handle_mmap:
-        return ret;
+        return track;
 }
 
 
 extern "C" __attribute__((visibility("default")))
 void *mmap64(void *addr, size_t length, int prot, int flags, int fd, off_t offset){
         void *ret = nullptr;
+        bool track = false;
+        dev_t dev = 0;
+        ino_t ino = 0;
 
         if(fd < 3){
                 goto do_mmap64;
@@ -3158,10 +4230,14 @@ void *mmap64(void *addr, size_t length, int prot, int flags, int fd, off_t offse
 
         // cprintf("%s:INFO called for fd:%d\n", __func__, fd);
 
-        handle_mmap(length, prot, flags, fd, offset);
+        track = handle_mmap(length, prot, flags, fd, offset, &dev, &ino);
 
 do_mmap64:
+#ifdef ENABLE_MMAP_TRACKING
+        ret = mmap_region_map(addr, length, prot, flags, fd, offset, track, dev, ino);
+#else
         ret = real_mmap(addr, length, prot, flags, fd, offset);
+#endif //ENABLE_MMAP_TRACKING
 exit_mmap64:
         return ret;
 }
@@ -3170,6 +4246,9 @@ exit_mmap64:
 extern "C" __attribute__((visibility("default")))
 void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset){
         void *ret = nullptr;
+        bool track = false;
+        dev_t dev = 0;
+        ino_t ino = 0;
 
         if(fd < 3){
                 goto do_mmap;
@@ -3177,15 +4256,40 @@ void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
 
         // cprintf("%s:INFO called for fd:%d\n", __func__, fd);
 
-        handle_mmap(length, prot, flags, fd, offset);
+        track = handle_mmap(length, prot, flags, fd, offset, &dev, &ino);
 
 do_mmap:
+#ifdef ENABLE_MMAP_TRACKING
+        ret = mmap_region_map(addr, length, prot, flags, fd, offset, track, dev, ino);
+#else
         ret = real_mmap(addr, length, prot, flags, fd, offset);
+#endif //ENABLE_MMAP_TRACKING
 
 exit_mmap:
         return ret;
 }
 
+#ifdef ENABLE_MMAP_TRACKING
+/*the evictor madvises tracked ranges, they are forgotten before the addresses can be reused*/
+extern "C" __attribute__((visibility("default")))
+int munmap(void *addr, size_t length){
+        return mmap_region_unmap(addr, length);
+}
+
+extern "C" __attribute__((visibility("default")))
+void *mremap(void *old_address, size_t old_size, size_t new_size, int flags, ...){
+        void *new_address = nullptr;
+        va_list ap;
+
+        if(flags & MREMAP_FIXED){
+                va_start(ap, flags);
+                new_address = va_arg(ap, void *);
+                va_end(ap);
+        }
+        return mmap_region_remap(old_address, old_size, new_size, flags, new_address);
+}
+#endif //ENABLE_MMAP_TRACKING
+
 
 
 /**
@@ -3193,7 +4297,7 @@ exit_mmap:
  * a utility that runs a trace file against Belady's algorithm in a cache simulator.
  * The idea is that if cache hits increase in this cache simulator, we should see it
  * translate to real performance improvements barring other overhead in the library.
- * look at Makefile BELADY.
+ * look at Makefile BELADY and tools/cache_sim. The structures are in belady_proof.hpp.
  * The following functions are directly exposed.
  *
  * The work flow is as follows:
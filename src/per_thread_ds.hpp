@@ -1,5 +1,10 @@
 #ifndef _PER_THREAD_DS_HPP
 #define _PER_THREAD_DS_HPP
+
+#ifdef ENABLE_TRACE_RING
+#include "utils/trace_ring/trace_ring.hpp"
+#endif //ENABLE_TRACE_RING
+
 /*
  * Per-Thread constructors can be made using
  * constructors for thread local objects
@@ -53,6 +58,10 @@ class per_thread_data{
                 if(fd_map){
                         delete fd_map;
                 }
+
+#ifdef ENABLE_TRACE_RING
+                trace_thread_exit();
+#endif //ENABLE_TRACE_RING
         }
 };
 #endif
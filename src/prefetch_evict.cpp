@@ -14,6 +14,7 @@
 #include <cstdlib>
 #include <unordered_map>
 #include <vector>
+#include <new>
 
 #include "prefetch_evict.hpp"
 #include "per_thread_ds.hpp"
@@ -22,6 +23,18 @@
 #include "utils/system_info/system_info.hpp"
 #include "utils/start_stop/start_stop_speedyio.hpp"
 
+#ifdef ENABLE_HOST_COORD
+#include "utils/host_coord/host_coord.hpp"
+#endif //ENABLE_HOST_COORD
+
+#ifdef ENABLE_EVICTION_YIELD
+#include "utils/evict_yield/evict_yield.hpp"
+#endif //ENABLE_EVICTION_YIELD
+
+#ifdef ENABLE_MMAP_TRACKING
+#include "utils/mmap_regions/mmap_regions.hpp"
+#endif //ENABLE_MMAP_TRACKING
+
 #include <iostream>
 #include <set>
 #include <algorithm>
@@ -64,6 +77,13 @@ std::unordered_map<int, std::shared_ptr<struct perfd_struct>> *g_fd_map = nullpt
 std::atomic_flag g_fd_map_init;
 ReaderWriterLock g_fd_map_rwlock;
 
+/*
+ * g_fd_map->size() for stats. The stats thread starts in the library
+ * constructor, possibly before g_fd_map_rwlock is constructed, so it
+ * reads this instead of taking the lock. pfds are never removed.
+ */
+static std::atomic<size_t> nr_tracked_fds(0);
+
 
 /*
  * first_rdtsc is used to subtract from __rdtsc() before saving it.
@@ -73,18 +93,120 @@ ReaderWriterLock g_fd_map_rwlock;
 unsigned long long int first_rdtsc = 0;
 
 
+#if defined(ENABLE_EXTENT_INDEX) && (defined(ENABLE_ONE_LRU) || !defined(EVICTION_LRU))
+#error "ENABLE_EXTENT_INDEX is only implemented for EVICTION_LRU with pvt heaps"
+#endif //ENABLE_EXTENT_INDEX
+
+#if defined(ENABLE_DIRTY_TRACKING) && !defined(ENABLE_EXTENT_INDEX)
+#error "ENABLE_DIRTY_TRACKING needs ENABLE_EXTENT_INDEX"
+#endif //ENABLE_DIRTY_TRACKING
+
 /*
  * This implements the heap of files that need to be evicted in that order
  */
 struct Heap *g_file_heap = nullptr;
 std::atomic_flag g_file_heap_init;
-std::mutex g_heap_lock; //for updates to the global heap
+g_heap_lock_t g_heap_lock; //for updates to the global heap
+
+#ifdef ENABLE_CACHE_CLASSES
+/*
+ * One global heap per cache class, g_class_heaps[DEFAULT_CACHE_CLASS]
+ * is g_file_heap. All of them are updated under g_heap_lock.
+ */
+struct Heap *g_class_heaps[MAX_CACHE_CLASSES];
+#endif //ENABLE_CACHE_CLASSES
+
+/*The global heap this uinode is in*/
+static inline struct Heap *gheap_of(struct inode *uinode){
+#ifdef ENABLE_CACHE_CLASSES
+        return g_class_heaps[uinode->cache_class];
+#else
+        return g_file_heap;
+#endif //ENABLE_CACHE_CLASSES
+}
+
+/*
+ * The global heap key of a uinode whose LRU key is key.
+ * With file role tiers, upper tier files get their age credit added,
+ * see file_role.hpp. ULONG_MAX (everything evicted) and ULONG_MAX - 1
+ * (being written) are kept as they are.
+ */
+static inline unsigned long long int gheap_key(struct inode *uinode, unsigned long long int key){
+#if defined(ENABLE_FILE_ROLE_TIERS) && defined(EVICTION_LRU) && !defined(BELADY_PROOF)
+        unsigned long long int credit;
+
+        if(key >= ULONG_MAX - 1){
+                goto exit_gheap_key;
+        }
+        credit = get_file_role_credit(uinode->file_role);
+        if(unlikely(key >= ULONG_MAX - 2 - credit)){
+                key = ULONG_MAX - 2;
+                goto exit_gheap_key;
+        }
+        key += credit;
+
+exit_gheap_key:
+#endif //ENABLE_FILE_ROLE_TIERS && EVICTION_LRU && !BELADY_PROOF
+        return key;
+}
+
+/*
+ * Counts pvt heap portions read into or evicted from the page cache
+ * against the uinode's cache class. file_heap_lock must be held.
+ */
+static inline void account_resident_portions(struct inode *uinode, long delta){
+#ifdef ENABLE_CACHE_CLASSES
+        uinode->nr_resident_portions += delta;
+        cache_class_account(uinode->cache_class, delta);
+#endif //ENABLE_CACHE_CLASSES
+}
+
+/*
+ * Drops all of the uinode's portions from its cache class, before its
+ * pvt heap is cleared or destroyed. file_heap_lock must be held.
+ */
+void forget_resident_portions(struct inode *uinode){
+#ifdef ENABLE_CACHE_CLASSES
+        account_resident_portions(uinode, -uinode->nr_resident_portions);
+#endif //ENABLE_CACHE_CLASSES
+}
 
 
 struct lat_tracker pvt_heap_latency;
 struct lat_tracker g_heap_latency;
 struct lat_tracker ulong_heap_update;
 
+/*
+ * Set at runtime from the admin socket. The evictor starts evicting
+ * when free memory drops below min required + this.
+ */
+static std::atomic<long> low_mem_watermark_kb(EVICTION_LOW_MEM_WATERMARK);
+
+/*
+ * KB left to evict of a forced eviction pass. The evictor drains it
+ * irrespective of free memory.
+ */
+static std::atomic<long> forced_evict_kb(0);
+
+static std::atomic<unsigned long> nr_evicted_portions(0);
+
+/*uinodes with a pvt heap, i.e. files read or written since they were opened with ENABLE_LAZY_PVT_HEAP*/
+static std::atomic<long> nr_pvt_heaps(0);
+
+#ifdef ENABLE_DIRTY_TRACKING
+/*victim extents put back in the LRU because they were dirty or under writeback*/
+static std::atomic<unsigned long> nr_dirty_deferred(0);
+/*extents the evictor started writeback of*/
+static std::atomic<unsigned long> nr_dirty_writebacks(0);
+#endif //ENABLE_DIRTY_TRACKING
+
+#ifdef ENABLE_BUSY_FILES
+/*busy victims made younger so an idle file about as cold goes first*/
+static std::atomic<unsigned long> nr_busy_passed(0);
+/*evictions of busy files done BUSY_EVICT_CHUNK_KB at a time*/
+static std::atomic<unsigned long> nr_busy_split(0);
+#endif //ENABLE_BUSY_FILES
+
 /*
  * This function reserves MAX_IMAP_FILES*2 for g_fd_map.
  * It was implemented because with gcc 11 + centos 8;
@@ -107,12 +229,57 @@ void init_g_fd_map(){
 }
 
 
+/*returns nullptr if no memory*/
+static struct open_file_desc *alloc_open_file_desc(off_t seek_head){
+        void *p;
+
+#ifdef ENABLE_SLAB_ALLOC
+        p = slab_alloc(&slab_type<struct open_file_desc>::cache);
+#else
+        p = malloc(sizeof(struct open_file_desc));
+#endif //ENABLE_SLAB_ALLOC
+        if(!p){
+                return nullptr;
+        }
+        return new (p) open_file_desc(seek_head);
+}
+
+/**
+ * Drops the reference of one pfd; the last one frees fdesc.
+ * With ENABLE_SLAB_ALLOC the memory stays an open_file_desc, so even an
+ * application read racing with the close of its own fd does not fault.
+ */
+void put_open_file_desc(struct open_file_desc *fdesc){
+        if(!fdesc || fdesc->nr_pfds.fetch_sub(1, std::memory_order_acq_rel) != 1){
+                return;
+        }
+        fdesc->~open_file_desc();
+#ifdef ENABLE_SLAB_ALLOC
+        slab_free(&slab_type<struct open_file_desc>::cache, fdesc);
+#else
+        free(fdesc);
+#endif //ENABLE_SLAB_ALLOC
+}
+
+/**
+ * Points pfd to fdesc (nullptr at close) and drops its reference to the
+ * one it pointed to. fdesc is either fresh or the one of an open fd
+ * being dup'd, which keeps it alive meanwhile.
+ */
+void set_pfd_fdesc(struct perfd_struct *pfd, struct open_file_desc *fdesc){
+        if(fdesc){
+                fdesc->nr_pfds.fetch_add(1, std::memory_order_relaxed);
+        }
+        put_open_file_desc(pfd->fdesc.exchange(fdesc, std::memory_order_acq_rel));
+}
+
 /**
  * adds any fd to g_fd_map. returns a valid pfd if successful, else nullptr
  * this can be called for both for blacklisted and whitelisted fd
  */
 std::shared_ptr<struct perfd_struct> add_any_fd_to_perfd_struct(
-                int fd, int open_flags, struct inode *uinode, bool file_is_whitelisted)
+                int fd, int open_flags, struct inode *uinode, bool file_is_whitelisted,
+                off_t seek_head, struct open_file_desc *fdesc)
 {
 
         std::shared_ptr<struct perfd_struct> pfd;
@@ -181,10 +348,15 @@ std::shared_ptr<struct perfd_struct> add_any_fd_to_perfd_struct(
                         if(file_is_whitelisted && (uinode == pfd->uinode)){
                                 /**
                                  * duplicate fd for the same whitelisted file.
-                                 * Don't do anything
+                                 * Don't do anything; unless it is a dup2 onto this fd
+                                 * which now shares the open file description of oldfd.
                                 */
                                debug_printf("%s: pfd->uinode and passed uinode match for %s file fd:%d\n",
                                         __func__, filetype[file_is_whitelisted], fd);
+                               if(fdesc){
+                                        set_pfd_fdesc(pfd.get(), fdesc);
+                                        pfd->open_flags = open_flags;
+                               }
                                goto exit;
                         }
 
@@ -225,7 +397,11 @@ std::shared_ptr<struct perfd_struct> add_any_fd_to_perfd_struct(
                 /*no pfd. allocate a brand new one*/
 
                 try{
+#ifdef ENABLE_SLAB_ALLOC
+                        pfd = std::allocate_shared<struct perfd_struct>(slab_allocator<struct perfd_struct>());
+#else
                         pfd = std::make_shared<struct perfd_struct>();
+#endif //ENABLE_SLAB_ALLOC
                 }catch (const std::bad_alloc& e){
                         SPEEDYIO_FPRINTF("%s:ERROR Unable to allocate memory for perfd_struct: %s\n", "SPEEDYIO_ERRCO_0155 %s\n", e.what());
                         pfd = nullptr;
@@ -238,17 +414,32 @@ std::shared_ptr<struct perfd_struct> add_any_fd_to_perfd_struct(
         }
 
 update_pfd_data:
+        /**
+         * A fresh open gets its own open file description;
+         * dup passes the one of the old fd.
+         */
+        if(file_is_whitelisted && !fdesc){
+                fdesc = alloc_open_file_desc(seek_head);
+                if(!fdesc){
+                        SPEEDYIO_FPRINTF("%s:ERROR Unable to allocate memory for open_file_desc fd:%d\n", "SPEEDYIO_ERRCO_0216 %d\n", fd);
+                        pfd = nullptr;
+                        goto exit;
+                }
+        }
+
         pfd->fd = fd;
         pfd->open_flags = open_flags;
         pfd->fd_open = true;
 
         if(file_is_whitelisted){
+                set_pfd_fdesc(pfd.get(), fdesc);
                 pfd->ino = uinode->ino;
                 pfd->dev_id = uinode->dev_id;
                 pfd->uinode = uinode;
                 pfd->blacklisted = false;
         }else{
                 //update blacklisted file in pfd
+                set_pfd_fdesc(pfd.get(), nullptr);
                 pfd->uinode = nullptr;
                 pfd->blacklisted = true;
         }
@@ -269,6 +460,7 @@ add_to_fdmap:
                         SPEEDYIO_FPRINTF("%s:ERROR fd:%d already exists in g_fd_map. Unable to insert {ino:%lu, dev:%lu}\n", "SPEEDYIO_ERRCO_0157 %d %lu %lu\n", fd, uinode->ino, uinode->dev_id);
                         KILLME();
                 }else{
+                        nr_tracked_fds.fetch_add(1, std::memory_order_relaxed);
                         if(file_is_whitelisted){
                                 debug_printf("%s: successfully added whitelisted fd:%d {ino:%lu, dev:%lu} to g_fd_map:%p\n",
                                         __func__, fd, uinode->ino, uinode->dev_id, (void*)g_fd_map);
@@ -284,6 +476,68 @@ exit:
 }
 
 
+/**
+ * assuming there has been a read or write, update the seek head of this
+ * whitelisted pfd. returns the old offset.
+ *
+ * if set_to == true -> new seek_head = bytes.
+ * else seek_head += bytes
+ *
+ * returned value will be -1 if error.
+ *
+ * The seek head itself is updated without locks; see struct open_file_desc.
+ *
+ * Note: In 64 bit machines the following is the implementation:
+ * 1. off_t - long long int (64 bit)
+ * 2. size_t - unsigned long long int (64 bit)
+ * 3. ssize_t - long long int (64 bit)
+ * So conversion between ssize_t and off_t is okay
+ * Conversion of a off_t to size_t is okay
+ * Conversion of size_t to off_t is okay only if it < 2^63 - 1
+ * else, the value will overflow
+ */
+ssize_t update_pfd_seek_pos(struct perfd_struct *pfd, off_t bytes, bool set_to){
+        ssize_t ret = -1;
+        struct open_file_desc *fdesc;
+#ifdef DEBUG_SEEK_POS
+        ssize_t curr_pos;
+        off_t seek_pos;
+#endif
+
+        /*the fd is open for this read/write, so fdesc is not freed meanwhile*/
+        fdesc = pfd->fdesc.load(std::memory_order_acquire);
+        if(unlikely(!fdesc)){
+                SPEEDYIO_FPRINTF("%s:ERROR no open_file_desc for fd:%d\n", "SPEEDYIO_ERRCO_0109 %d\n", pfd->fd);
+                goto exit_update_pfd_seek_pos;
+        }
+
+        if(set_to){
+                ret = fdesc->set(bytes);
+        }else{
+                /*forward read/write. add bytes.*/
+                ret = fdesc->advance(bytes);
+        }
+
+#ifdef DEBUG_SEEK_POS
+        curr_pos = fdesc->seek_head.load();
+        seek_pos = real_lseek(pfd->fd, 0, SEEK_CUR);
+        if(curr_pos != seek_pos){
+                SPEEDYIO_FPRINTF("%s:ERROR fd:%d curr_pos:%ld whereas ground truth:%lu\n", "SPEEDYIO_ERRCO_0108 %d %ld %lu\n", pfd->fd, curr_pos, seek_pos);
+                KILLME();
+        }
+#endif //DEBUG_SEEK_POS
+
+        if(unlikely(ret < 0)){
+                SPEEDYIO_FPRINTF("%s:ERROR seek_head has overflown for fd:%d seek_head:%ld\n", "SPEEDYIO_ERRCO_0110 %d %ld\n", pfd->fd, ret);
+                ret = -1;
+                goto exit_update_pfd_seek_pos;
+        }
+
+exit_update_pfd_seek_pos:
+        return ret;
+}
+
+
 std::shared_ptr<struct perfd_struct> get_perfd_data(int fd)
 {
         std::shared_ptr<struct perfd_struct> a;
@@ -300,6 +554,11 @@ get_perfd_data_exit:
         return a;
 }
 
+/*fds in g_fd_map, for stats*/
+size_t get_nr_tracked_fds(){
+        return nr_tracked_fds.load(std::memory_order_relaxed);
+}
+
 
 /*
  * Returns perfd_struct from per_thread_ds or from perfd_ds
@@ -412,6 +671,14 @@ void init_g_heap(){
                 std::string heap_name = std::string("gh");
                 g_file_heap = __heap_init(MAX_IMAP_FILES, heap_name);
 
+#ifdef ENABLE_CACHE_CLASSES
+                g_class_heaps[DEFAULT_CACHE_CLASS] = g_file_heap;
+                for(int cls = 1; cls < nr_cache_classes; cls++){
+                        heap_name = std::string("gh_") + std::to_string(cls);
+                        g_class_heaps[cls] = __heap_init(MAX_IMAP_FILES, heap_name);
+                }
+#endif //ENABLE_CACHE_CLASSES
+
 #ifndef DISABLE_FIRST_RDTSC
                 first_rdtsc = ticks_now();
 #endif //DISABLE_FIRST_RDTSC
@@ -448,7 +715,7 @@ void remove_from_g_heap(struct inode* uinode){
         }
 
         g_heap_lock.lock();
-        heap_delete_key_by_id(g_file_heap, uinode->heap_id);
+        heap_delete_key_by_id(gheap_of(uinode), uinode->heap_id);
         uinode->heap_id = -1;
         g_heap_lock.unlock();
 
@@ -516,7 +783,7 @@ unsigned long long int get_g_priority_val(struct inode *uinode, bool new_node){
         if(unlikely(new_node)){
                 priority_val = 1.0;
         }else{
-                old_priority_val = heap_get_key_by_id(g_file_heap, uinode->heap_id);
+                old_priority_val = heap_get_key_by_id(gheap_of(uinode), uinode->heap_id);
 
                 if(old_priority_val > ADD_TO_KEY_REDUCE_PRIORITY){
                         priority_val = (old_priority_val - ADD_TO_KEY_REDUCE_PRIORITY) + 1;
@@ -584,7 +851,7 @@ void update_g_heap(struct inode* uinode)
                         debug_fprintf(stderr, "%s:UNUSUAL new priority is 0. Should not happen\n", __func__);
                         goto unlock_and_exit;
                 }
-                uinode->heap_id = heap_insert(g_file_heap, new_priority, (void*)uinode);
+                uinode->heap_id = heap_insert(gheap_of(uinode), gheap_key(uinode, new_priority), (void*)uinode);
         }
         /*
          * This if condition will be true if the number of accesses to the file is a multiple of G_HEAP_FREQ
@@ -615,7 +882,7 @@ void update_g_heap(struct inode* uinode)
                         debug_fprintf(stderr, "%s:UNUSUAL new priority is 0. Should not happen\n", __func__);
                         goto unlock_and_exit;
                 }
-                heap_update_key(g_file_heap, uinode->heap_id, new_priority);
+                heap_update_key(gheap_of(uinode), uinode->heap_id, gheap_key(uinode, new_priority));
         }
 
 unlock_and_exit:
@@ -626,7 +893,7 @@ update_g_heap_exit:
 }
 
 
-#ifdef BELADY_PROOF
+#if defined(BELADY_PROOF) && defined(ENABLE_ONE_LRU)
 /**
  * This is the implementation of a flat LRU where each element is a portion of a uinode.
  * The size of portion is defined by PVT_HEAP_PG_ORDER. Only implemented for BELADY_PROOF for now.
@@ -709,7 +976,7 @@ void update_one_heap(struct inode* uinode, off_t offset, size_t size, uint64_t t
 update_one_heap_exit:
         return;
 }
-#endif //BELADY_PROOF
+#endif //BELADY_PROOF && ENABLE_ONE_LRU
 
 
 #if 0
@@ -768,7 +1035,9 @@ void heap_dont_need_update(struct inode* uinode, int fd, off_t offset, size_t si
                 /*Update pvt heap element if and only if there exists a portion id*/
                 if((*uinode->file_heap_node_ids)[portion_nr] >= 0){
 #ifdef EVICTION_LRU
-                        heap_update_key(uinode->file_heap, (*uinode->file_heap_node_ids)[portion_nr], ULONG_MAX);
+                        if(heap_update_key(uinode->file_heap, (*uinode->file_heap_node_ids)[portion_nr], ULONG_MAX) != ULONG_MAX){
+                                account_resident_portions(uinode, -1);
+                        }
 #elif defined(ENABLE_EVICTION)
 #error "ONLY EVICTION_LRU supported for pvt heap"
 #endif
@@ -784,7 +1053,7 @@ void heap_dont_need_update(struct inode* uinode, int fd, off_t offset, size_t si
         uinode->file_heap_lock.unlock();
 
         g_heap_lock.lock();
-        heap_update_key(g_file_heap, uinode->heap_id, new_pvt_heap_min);
+        heap_update_key(gheap_of(uinode), uinode->heap_id, gheap_key(uinode, new_pvt_heap_min));
         g_heap_lock.unlock();
 
 #elif (defined(ENABLE_EVICTION))
@@ -868,23 +1137,23 @@ void heap_update(struct inode* uinode, off_t offset, size_t size, bool from_read
 
                 /*New uinode. insert for the first time*/
                 uinode->one_operation_done = true;
-                uinode->heap_id = heap_insert(g_file_heap, key, (void*)uinode);
+                uinode->heap_id = heap_insert(gheap_of(uinode), gheap_key(uinode, key), (void*)uinode);
                 // SPEEDYIO_PRINTF("%s: heap_insert for {ino:%lu, dev:%lu}, heap_id:%d\n", "SPEEDYIO_OTHERCO_0004 %lu %lu %d\n", uinode->ino, uinode->dev_id, uinode->heap_id);
         }
 #ifdef EVICTION_FREQ
-        else if(heap_get_key_by_id(g_file_heap, uinode->heap_id) > ADD_TO_KEY_REDUCE_PRIORITY){
+        else if(heap_get_key_by_id(gheap_of(uinode), uinode->heap_id) > ADD_TO_KEY_REDUCE_PRIORITY){
                 key = get_min_key(uinode);
                 if(key < 1){
                         SPEEDYIO_FPRINTF("%s:UNUSUAL key is less than 1. This should not happen\n", "SPEEDYIO_UNUSCO_0004\n");
                 }
-                heap_update_key(g_file_heap, uinode->heap_id, key);
+                heap_update_key(gheap_of(uinode), uinode->heap_id, key);
         }
 #endif //EVICTION_FREQ
 
 #ifdef GHEAP_TRIGGER
-        else if( (heap_get_key_by_id(g_file_heap, uinode->heap_id) == ULONG_MAX)  || trigger_check(uinode->gheap_trigger) || !from_read)
+        else if( (heap_get_key_by_id(gheap_of(uinode), uinode->heap_id) == ULONG_MAX)  || trigger_check(&uinode->gheap_trigger) || !from_read)
 #else
-        else if( (heap_get_key_by_id(g_file_heap, uinode->heap_id) == ULONG_MAX)  || ((uinode->nr_accesses % G_HEAP_FREQ) == 0))
+        else if( (heap_get_key_by_id(gheap_of(uinode), uinode->heap_id) == ULONG_MAX)  || ((uinode->nr_accesses % G_HEAP_FREQ) == 0))
 #endif //GHEAP_TRIGGER
         {
 
@@ -919,7 +1188,7 @@ void heap_update(struct inode* uinode, off_t offset, size_t size, bool from_read
 #endif //EVICTION_FREQ && EVICTION_LRU
                 // SPEEDYIO_PRINTF("%s: heap_update_key for {ino:%lu, dev:%lu}, heap_id:%d, key:%lu\n", "SPEEDYIO_OTHERCO_0005 %lu %lu %d\n",
                 //                 uinode->ino, uinode->dev_id, uinode->heap_id, key);
-                heap_update_key(g_file_heap, uinode->heap_id, key);
+                heap_update_key(gheap_of(uinode), uinode->heap_id, gheap_key(uinode, key));
         }
 
         g_heap_lock.unlock();
@@ -953,46 +1222,66 @@ skip_everything:
  * Private Heap implementation
  */
 void init_pvt_heap(struct inode* uinode){
-        unsigned long nr_page_range;
+#ifndef ENABLE_ONE_LRU
+        char heap_name[Heap::NAME_SIZE];
+#endif //ENABLE_ONE_LRU
+
         if(!uinode){
                 SPEEDYIO_FPRINTF("%s:ERROR invalid uinode found\n", "SPEEDYIO_ERRCO_0167\n");
                 goto exit_init_pvt_heap;
         }
 
+        uinode->file_heap_lock.lock();
+#ifdef ENABLE_EXTENT_INDEX
+        if(uinode->file_heap != nullptr || uinode->extents != nullptr){
+#else
         if(uinode->file_heap != nullptr || uinode->file_heap_node_ids != nullptr){
+#endif //ENABLE_EXTENT_INDEX
+#ifndef ENABLE_LAZY_PVT_HEAP
                 SPEEDYIO_FPRINTF("%s:UNUSUAL fileheap for {ino:%lu, dev:%lu} already allocated. Dual init attempted\n", "SPEEDYIO_UNUSCO_0006 %lu %lu\n", uinode->ino, uinode->dev_id);
-                goto exit_init_pvt_heap;
-        }else{
-                debug_printf("%s: fileheap for {ino:%lu, dev:%lu} being allocated\n", __func__, uinode->ino, uinode->dev_id);
-                uinode->file_heap_lock.lock();
+#endif //ENABLE_LAZY_PVT_HEAP
+                /*with ENABLE_LAZY_PVT_HEAP the first reads of a file race to get here*/
+                goto unlock_exit_init_pvt_heap;
+        }
+
+        debug_printf("%s: fileheap for {ino:%lu, dev:%lu} being allocated\n", __func__, uinode->ino, uinode->dev_id);
 #ifndef ENABLE_ONE_LRU
-                std::string heap_name = std::string("ph_") + std::to_string(uinode->ino);
-                uinode->file_heap = __heap_init(NR_PVT_HEAP_ELEMENTS, heap_name);
-                if(unlikely(!uinode->file_heap)){
-                        SPEEDYIO_FPRINTF("%s:ERROR heap_init failed\n", "SPEEDYIO_ERRCO_0168\n");
-                        uinode->file_heap_lock.unlock();
-                        goto exit_init_pvt_heap;
-                }
+        snprintf(heap_name, sizeof(heap_name), "ph_%lu", uinode->ino);
+        uinode->file_heap = heap_init(NR_PVT_HEAP_ELEMENTS, heap_name);
+        if(unlikely(!uinode->file_heap)){
+                SPEEDYIO_FPRINTF("%s:ERROR heap_init failed\n", "SPEEDYIO_ERRCO_0168\n");
+                goto unlock_exit_init_pvt_heap;
+        }
+        nr_pvt_heaps.fetch_add(1, std::memory_order_relaxed);
 #endif //ENABLE_ONE_LRU
 
-                /*
-                 * file_heap_node_ids keeps for each portion_nr in the file
-                 * the corresponding heap id in the pvt heap.
-                 * It has now been allocated using an auto expanding vector with nice properties:
-                 *
-                 * 1. Can be dereferenced etc almost like an array.
-                 * Little to no perf penalty on access/updates
-                 * 2. Auto resizes based on the index that is being used right now.
-                 * (Doubles the size so resizes dont happen often)
-                 * 3. Maintains a default value passed at declaration time.
-                 * We need this because the code requires unused file_heap_node_ids indices to have -1.
-                 * 4. Is implemented as a template, so any variable type can use it. Here we are using it for int.
-                 */
+        /*
+         * file_heap_node_ids keeps for each portion_nr in the file
+         * the corresponding heap id in the pvt heap.
+         * It has now been allocated using an auto expanding vector with nice properties:
+         *
+         * 1. Can be dereferenced etc almost like an array.
+         * Little to no perf penalty on access/updates
+         * 2. Auto resizes based on the index that is being used right now.
+         * (Doubles the size so resizes dont happen often)
+         * 3. Maintains a default value passed at declaration time.
+         * We need this because the code requires unused file_heap_node_ids indices to have -1.
+         * 4. Is implemented as a template, so any variable type can use it. Here we are using it for int.
+         */
 
-                /*all untouched file heap node ids should be -1 since heap node ids start from 0*/
-                uinode->file_heap_node_ids = new AutoExpandVector<int>(MIN_NR_FILE_HEAP_NODES, -1);
-                uinode->file_heap_lock.unlock();
-        }
+#ifdef ENABLE_EXTENT_INDEX
+        /*with the extent index the pvt heap has a node per extent, not per portion*/
+        uinode->extents = new struct extent_index();
+#else
+        /*all untouched file heap node ids should be -1 since heap node ids start from 0*/
+        uinode->file_heap_node_ids = new AutoExpandVector<int>(MIN_NR_FILE_HEAP_NODES, -1);
+#endif //ENABLE_EXTENT_INDEX
+#ifdef ENABLE_DIRTY_TRACKING
+        uinode->dirty = new struct dirty_index();
+#endif //ENABLE_DIRTY_TRACKING
+
+unlock_exit_init_pvt_heap:
+        uinode->file_heap_lock.unlock();
 exit_init_pvt_heap:
         return;
 }
@@ -1011,23 +1300,39 @@ bool clear_pvt_heap(struct inode* uinode){
                 goto exit_clear_pvt_heap;
         }
 
+#ifdef ENABLE_LAZY_PVT_HEAP
+        /*not read or written since it was opened, nothing to clear*/
+        if(!uinode->file_heap){
+                goto exit_clear_pvt_heap;
+        }
+#endif //ENABLE_LAZY_PVT_HEAP
+
         if(!uinode->file_heap){
                 ret = false;
                 SPEEDYIO_FPRINTF("%s:ERROR no file_heap for {ino:%lu, dev:%lu}\n", "SPEEDYIO_ERRCO_0170 %lu %lu\n", uinode->ino, uinode->dev_id);
                 goto exit_clear_pvt_heap;
         }
 
+#ifdef ENABLE_EXTENT_INDEX
+        if(!uinode->extents){
+#else
         if(!uinode->file_heap_node_ids){
+#endif //ENABLE_EXTENT_INDEX
                 ret = false;
                 SPEEDYIO_FPRINTF("%s:ERROR no file_heap_node_ids for {ino:%lu, dev:%lu}\n", "SPEEDYIO_ERRCO_0171 %lu %lu\n", uinode->ino, uinode->dev_id);
                 goto exit_clear_pvt_heap;
         }
 
         uinode->file_heap_lock.lock();
+        forget_resident_portions(uinode);
         heap_clear(uinode->file_heap);
 
+#ifdef ENABLE_EXTENT_INDEX
+        extent_clear(uinode->extents);
+#else
         uinode->file_heap_node_ids->clear();
         uinode->file_heap_node_ids->shrink_to_fit();
+#endif //ENABLE_EXTENT_INDEX
 
         uinode->file_heap_lock.unlock();
 
@@ -1035,6 +1340,86 @@ exit_clear_pvt_heap:
         return ret;
 }
 
+#if defined(ENABLE_DIRTY_TRACKING) || defined(ENABLE_MMAP_TRACKING)
+static uint64_t mono_ns(){
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif //ENABLE_DIRTY_TRACKING || ENABLE_MMAP_TRACKING
+
+#ifdef ENABLE_DIRTY_TRACKING
+
+/*offset, size were written through the page cache*/
+void track_dirty_write(struct inode *uinode, off_t offset, size_t size){
+        size_t portion_order = PAGE_SHIFT + PVT_HEAP_PG_ORDER;
+
+        if(unlikely(size == 0)){
+                return;
+        }
+        uinode->file_heap_lock.lock();
+        if(likely(uinode->dirty)){
+                dirty_mark(uinode->dirty, PORTION_NR_FROM_OFFSET(offset, portion_order),
+                                PORTION_NR_FROM_OFFSET(offset + size - 1, portion_order), mono_ns());
+        }
+        uinode->file_heap_lock.unlock();
+}
+
+unsigned long long int begin_dirty_sync(struct inode *uinode){
+        unsigned long long int seq = 0;
+
+        uinode->file_heap_lock.lock();
+        if(likely(uinode->dirty)){
+                seq = dirty_sync_begin(uinode->dirty);
+        }
+        uinode->file_heap_lock.unlock();
+        return seq;
+}
+
+/*everything written before begin_dirty_sync returned seq is on disk*/
+void end_dirty_sync(struct inode *uinode, unsigned long long int seq){
+        uinode->file_heap_lock.lock();
+        if(likely(uinode->dirty)){
+                dirty_sync_done(uinode->dirty, seq);
+        }
+        uinode->file_heap_lock.unlock();
+}
+#endif //ENABLE_DIRTY_TRACKING
+
+#ifdef ENABLE_BUSY_FILES
+
+struct inode *begin_file_read(int fd){
+        std::shared_ptr<struct perfd_struct> pfd;
+        struct inode *uinode;
+
+        if(fd < 3){
+                return nullptr;
+        }
+        pfd = get_perfd_struct_fast(fd);
+        if(!pfd || pfd->is_blacklisted() || pfd->is_closed()){
+                return nullptr;
+        }
+        /*uinodes are never freed, so it can be used after the pfd is gone*/
+        uinode = pfd->uinode;
+        if(uinode){
+                uinode->nr_reads_in_flight.fetch_add(1, std::memory_order_relaxed);
+        }
+        return uinode;
+}
+
+void end_file_read(struct inode *uinode){
+        if(uinode){
+                uinode->nr_reads_in_flight.fetch_sub(1, std::memory_order_relaxed);
+        }
+}
+
+/*BUSY_MIN_READS reads of the file are in flight right now*/
+bool file_is_busy(struct inode *uinode){
+        return uinode->nr_reads_in_flight.load(std::memory_order_relaxed) >= BUSY_MIN_READS;
+}
+#endif //ENABLE_BUSY_FILES
+
 /*returns the current min key from this uinode's heap*/
 #ifdef BELADY_PROOF
 unsigned long long int update_pvt_heap(struct inode* uinode, off_t offset, size_t size, bool from_read, uint64_t timestamp)
@@ -1051,6 +1436,9 @@ unsigned long long int update_pvt_heap(struct inode* uinode, off_t offset, size_
         size_t portion_sz = 1UL << portion_order;
         off_t first_portion_nr = 0;
         off_t last_portion_nr = 0;
+#ifdef ENABLE_EXTENT_INDEX
+        long nr_new_portions;
+#endif //ENABLE_EXTENT_INDEX
 
         // SPEEDYIO_PRINTF("%s:INFO {ino:%lu, dev:%lu}, offset:%ld, size:%ld portion_sz:%ld first_portion_nr:%ld last_portion_nr:%ld from_read:%d\n", "SPEEDYIO_INFOCO_0017 %lu %lu %ld %ld %ld %ld %ld %d\n", uinode->ino, uinode->dev_id, offset, size, portion_sz, first_portion_nr, last_portion_nr, from_read);
 
@@ -1068,6 +1456,13 @@ unsigned long long int update_pvt_heap(struct inode* uinode, off_t offset, size_
 //         uinode->file_heap_lock.lock();  // CAREFUL: REVERT TO DOING THE UNLOCK INSIDE THE LOOP IN NORMAL FLOW. LOCK NEEDS TO BE OUTSIDE WHILE DOING THIS DEBUGGING
 // #endif // ENABLE_MINCORE_DEBUG
 
+#ifdef ENABLE_LAZY_PVT_HEAP
+        /*first read or write of the file since it was opened*/
+        if(unlikely(uinode && !uinode->file_heap)){
+                init_pvt_heap(uinode);
+        }
+#endif //ENABLE_LAZY_PVT_HEAP
+
         if(unlikely(!uinode || !uinode->file_heap)){
                 SPEEDYIO_FPRINTF("%s:ERROR invalid uinode or fileheap\n", "SPEEDYIO_ERRCO_0172\n");
                 goto exit_update_pvt_heap;
@@ -1154,6 +1549,33 @@ unsigned long long int update_pvt_heap(struct inode* uinode, off_t offset, size_
         // printf("%s: {ino:%lu, dev:%lu}, offset:%ld, size:%ld portion_sz:%ld\n",
         //        __func__, uinode->ino, uinode->dev_id, curr_offset, size_left, portion_sz);
 
+#ifdef ENABLE_EXTENT_INDEX
+        /*one touch of the extent index for the whole range, however many portions it spans*/
+        uinode->file_heap_lock.lock();
+
+        uinode->nr_accesses += 1;
+#ifdef GHEAP_TRIGGER
+        uinode->gheap_trigger.now += 1;
+#endif //GHEAP_TRIGGER
+
+#ifdef BELADY_PROOF
+        portion_key = timestamp;
+#else
+        portion_key = ticks_now() - first_rdtsc;
+#endif //BELADY_PROOF
+
+        nr_new_portions = extent_touch(uinode->extents, uinode->file_heap, first_portion_nr, last_portion_nr, portion_key);
+        if(unlikely(nr_new_portions < 0)){
+                SPEEDYIO_FPRINTF("%s:ERROR heap_insert failed {ino:%lu, dev:%lu} portion_nr:%ld\n", "SPEEDYIO_ERRCO_0174 %lu %lu %ld\n", uinode->ino, uinode->dev_id, first_portion_nr);
+                uinode->file_heap_lock.unlock();
+                KILLME();
+                goto exit_update_pvt_heap;
+        }
+        account_resident_portions(uinode, nr_new_portions);
+
+        current_min = heap_read_min(uinode->file_heap)->key;
+        uinode->file_heap_lock.unlock();
+#else
         for (portion_nr = first_portion_nr; portion_nr <= last_portion_nr; portion_nr++) {  // Insert/update each portion in the heap
 
                 uinode->file_heap_lock.lock();
@@ -1163,21 +1585,13 @@ unsigned long long int update_pvt_heap(struct inode* uinode, off_t offset, size_
                         uinode->nr_accesses += 1;
 
 #ifdef GHEAP_TRIGGER
-                        uinode->gheap_trigger->now += 1;
+                        uinode->gheap_trigger.now += 1;
 #endif //GHEAP_TRIGGER
                 }
 
                 /*check if this portion is already allocated*/
                 if((*uinode->file_heap_node_ids)[portion_nr] == -1){
 
-                        off_t *p_nr = (off_t*)malloc(sizeof(off_t));
-                        if(unlikely(!p_nr)){
-                                SPEEDYIO_FPRINTF("%s:ERROR malloc failed p_nr\n", "SPEEDYIO_ERRCO_0173\n");
-                                uinode->file_heap_lock.unlock();
-                                KILLME();
-                                goto exit_update_pvt_heap;
-                        }
-                        *p_nr = portion_nr;
 #ifdef EVICTION_FREQ
                         portion_key = 1;
                         /*
@@ -1193,7 +1607,7 @@ unsigned long long int update_pvt_heap(struct inode* uinode, off_t offset, size_
 #endif //EVICTION_FREQ and EVICTION_LRU
 
                         (*uinode->file_heap_node_ids)[portion_nr] =
-                                                heap_insert(uinode->file_heap, portion_key, (void*)p_nr);
+                                                heap_insert_data(uinode->file_heap, portion_key, portion_nr);
 
                         if(unlikely((*uinode->file_heap_node_ids)[portion_nr] == -1)){
                                 SPEEDYIO_FPRINTF("%s:ERROR heap_insert failed {ino:%lu, dev:%lu} portion_nr:%ld\n", "SPEEDYIO_ERRCO_0174 %lu %lu %ld\n", uinode->ino, uinode->dev_id, portion_nr);
@@ -1201,6 +1615,7 @@ unsigned long long int update_pvt_heap(struct inode* uinode, off_t offset, size_
                                 KILLME();
                                 goto exit_update_pvt_heap;
                         }
+                        account_resident_portions(uinode, 1);
 
                         // SPEEDYIO_PRINTF("%s:INFO called heap_insert for {ino:%lu, dev:%lu} portion_nr:%ld (*uinode->file_heap_node_ids)[portion_nr]:%d\n", "SPEEDYIO_INFOCO_0018 %lu %lu %ld %d\n", uinode->ino, uinode->dev_id, portion_nr, (*uinode->file_heap_node_ids)[portion_nr]);
 
@@ -1233,12 +1648,16 @@ unsigned long long int update_pvt_heap(struct inode* uinode, off_t offset, size_
 #endif //EVICTION_LRU and BELADY_PROOF
 
                         // SPEEDYIO_PRINTF("%s:INFO calling heap_update_key for {ino:%lu, dev:%lu} portion_nr:%ld uinode->file_heap_node_ids[portion_nr]:%d\n", "SPEEDYIO_INFOCO_0019 %lu %lu %ld %d\n", uinode->ino, uinode->dev_id, portion_nr, (*uinode->file_heap_node_ids)[portion_nr]);
-                        heap_update_key(uinode->file_heap, (*uinode->file_heap_node_ids)[portion_nr], portion_key);
+                        /*an evicted portion is being read in again*/
+                        if(heap_update_key(uinode->file_heap, (*uinode->file_heap_node_ids)[portion_nr], portion_key) == ULONG_MAX){
+                                account_resident_portions(uinode, 1);
+                        }
                 }
 
                 current_min = heap_read_min(uinode->file_heap)->key;
                 uinode->file_heap_lock.unlock();
         }
+#endif //ENABLE_EXTENT_INDEX
 
 // #ifdef ENABLE_MINCORE_DEBUG
 //         if(nr_pvt_heap_calls % 10000 != 0){
@@ -1295,6 +1714,7 @@ void destroy_pvt_heap(struct Heap *pvt_heap){
 
         debug_printf("%s: destroying fileheap\n", __func__);
         heap_destroy(pvt_heap);
+        nr_pvt_heaps.fetch_sub(1, std::memory_order_relaxed);
 
 exit_destroy_pvt_heap:
         return;
@@ -1311,6 +1731,13 @@ unsigned long long int get_min_key(struct inode* uinode){
         }
 
         min = heap_read_min(uinode->file_heap);
+#ifdef ENABLE_EXTENT_INDEX
+        /*evicted extents leave the pvt heap, it is empty once all are evicted*/
+        if(!min){
+                ret = ULONG_MAX;
+                goto unlock_and_return;
+        }
+#endif //ENABLE_EXTENT_INDEX
         if(!min){
                 SPEEDYIO_FPRINTF("%s:ERROR min is NULL {ino:%lu, dev:%lu}\n", "SPEEDYIO_ERRCO_0176 %lu %lu\n", uinode->ino, uinode->dev_id);
                 goto unlock_and_return;
@@ -1324,6 +1751,88 @@ unlock_and_return:
 
 /*Eviction thread functions*/
 
+/**
+ * Returns the global heap to take the next victim file from, or nullptr
+ * if there are too few files to evict from. g_heap_lock must be held.
+ *
+ * With cache classes, classes over their max share are drained first,
+ * then classes over their min share; classes under their min share are
+ * only touched when nothing else is left. Between classes in the same
+ * tier the older LRU file wins, so within a tier this is plain LRU.
+ * Classes whose files are all evicted (min key ULONG_MAX) are skipped.
+ */
+static struct Heap *pick_victim_gheap(){
+        struct Heap *victim_heap = nullptr;
+
+#ifdef ENABLE_CACHE_CLASSES
+        size_t nr_files = 0;
+        int victim_tier = -1;
+        unsigned long long int victim_key = ULONG_MAX;
+
+        for(int cls = 0; cls < nr_cache_classes; cls++){
+                struct Heap *heap = g_class_heaps[cls];
+                struct HeapItem *min;
+                int tier;
+
+                if(unlikely(!heap)){
+                        continue;
+                }
+                nr_files += heap->size;
+
+                min = heap_read_min(heap);
+                if(!min || min->key == ULONG_MAX){
+                        continue;
+                }
+
+                tier = get_cache_class_tier(cls);
+                if(tier > victim_tier || (tier == victim_tier && min->key < victim_key)){
+                        victim_tier = tier;
+                        victim_key = min->key;
+                        victim_heap = heap;
+                }
+        }
+
+        debug_printf("%s: total_nodes:%zu\n", __func__, nr_files);
+
+        if(nr_files < MIN_FILES_REQD_TO_EVICT){
+                victim_heap = nullptr;
+        }
+#else
+        debug_printf("%s: total_nodes:%d\n", __func__, g_file_heap->size);
+
+        if(g_file_heap->size >= MIN_FILES_REQD_TO_EVICT){
+                victim_heap = g_file_heap;
+        }
+#endif //ENABLE_CACHE_CLASSES
+
+        return victim_heap;
+}
+
+#if defined(ENABLE_HOST_COORD) && defined(ENABLE_PVT_HEAP) && !defined(BELADY_PROOF)
+/**
+ * Key of the file get_victim_uinode would pick, in absolute ticks so
+ * that it compares with the keys of other processes. UINT64_MAX if
+ * there is nothing to evict.
+ */
+static uint64_t get_coldest_key(){
+        struct Heap *heap;
+        struct HeapItem *min = nullptr;
+        uint64_t key = UINT64_MAX;
+
+        g_heap_lock.lock();
+        heap = pick_victim_gheap();
+        if(heap){
+                min = heap_read_min(heap);
+        }
+        if(min && min->key != ULONG_MAX){
+                /*capped keys are still evictable, just after everything else*/
+                key = min->key < UINT64_MAX - 1 - first_rdtsc ? min->key + first_rdtsc : UINT64_MAX - 1;
+        }
+        g_heap_lock.unlock();
+        return key;
+}
+#endif //ENABLE_HOST_COORD && ENABLE_PVT_HEAP && !BELADY_PROOF
+
 /**
  * This function returns the file to be evicted
  * returns: the victim inode with unlinked_lock taken.
@@ -1334,18 +1843,28 @@ unlock_and_return:
 struct inode *get_victim_uinode(){
 
         int victim_file_id = -1;
+        struct Heap *victim_heap = nullptr;
         struct HeapItem *victim_file_data = nullptr;
         struct inode *victim_uinode = nullptr;
+#if defined(ENABLE_EVICTION_YIELD) && defined(EVICTION_LRU) && !defined(BELADY_PROOF)
+        int nr_passed_over = 0;
+#endif
+#if defined(ENABLE_BUSY_FILES) && defined(EVICTION_LRU) && !defined(BELADY_PROOF)
+        struct inode *busy_passed[BUSY_MAX_PASSES];
+        int nr_busy = 0;
+        bool passed_before;
+        unsigned long long int now_key;
+#endif
 
         g_heap_lock.lock();
 
-        debug_printf("%s: total_nodes:%d\n", __func__, g_file_heap->size);
-
-        if(unlikely(g_file_heap->size < MIN_FILES_REQD_TO_EVICT)){
+pick_victim:
+        victim_heap = pick_victim_gheap();
+        if(unlikely(!victim_heap)){
                 goto unlock_and_return;
         }
 
-        victim_file_data = heap_read_min(g_file_heap);
+        victim_file_data = heap_read_min(victim_heap);
 
         if(unlikely(!victim_file_data)){
                 SPEEDYIO_FPRINTF("%s:ERROR victim_file_data is NULL\n", "SPEEDYIO_ERRCO_0177\n");
@@ -1366,6 +1885,44 @@ struct inode *get_victim_uinode(){
                 goto unlock_and_return;
         }
 
+#if defined(ENABLE_EVICTION_YIELD) && defined(EVICTION_LRU) && !defined(BELADY_PROOF)
+        /**
+         * Evicting this file freed next to nothing the last few times
+         * (dirty, mapped by someone else, or already dropped). Send it
+         * to the back of the LRU and take the next one.
+         */
+        if(unlikely(nr_passed_over < EVICT_YIELD_MAX_PASSES
+                        && yield_skip_victim(victim_uinode->dev_id, victim_uinode->ino))){
+                heap_update_key(victim_heap, victim_uinode->heap_id, gheap_key(victim_uinode, ticks_now()-first_rdtsc));
+                nr_passed_over++;
+                goto pick_victim;
+        }
+#endif //ENABLE_EVICTION_YIELD && EVICTION_LRU && !BELADY_PROOF
+
+#if defined(ENABLE_BUSY_FILES) && defined(EVICTION_LRU) && !defined(BELADY_PROOF)
+        /**
+         * The file is being read right now; evicting it drops pages the
+         * readers may be about to use and its DONTNEED contends with them
+         * for the mapping. Make it BUSY_COLD_SLACK_PCT of its age younger
+         * and pick again, so an idle file about as cold goes first. If it
+         * comes back up it is still the coldest by that much; evict it.
+         */
+        passed_before = false;
+        for(int i = 0; i < nr_busy; i++){
+                passed_before |= (busy_passed[i] == victim_uinode);
+        }
+        if(nr_busy < BUSY_MAX_PASSES && !passed_before && file_is_busy(victim_uinode)){
+                now_key = ticks_now() - first_rdtsc;
+                if(victim_file_data->key < now_key){
+                        heap_update_key(victim_heap, victim_uinode->heap_id, victim_file_data->key
+                                        + (now_key - victim_file_data->key) * BUSY_COLD_SLACK_PCT / 100);
+                        busy_passed[nr_busy++] = victim_uinode;
+                        nr_busy_passed.fetch_add(1, std::memory_order_relaxed);
+                        goto pick_victim;
+                }
+        }
+#endif //ENABLE_BUSY_FILES && EVICTION_LRU && !BELADY_PROOF
+
         if(!victim_uinode->unlinked_lock.try_lock()){
                 /**
                  * Unable to take unlinked_lock. This can mean:
@@ -1427,7 +1984,7 @@ struct inode *get_victim_uinode(){
          * 3. Marks that this file has been subject to eviction if
          * it surfaces again as a potential victim uinode.
          */
-        heap_update_key(g_file_heap, victim_uinode->heap_id,
+        heap_update_key(victim_heap, victim_uinode->heap_id,
                 victim_file_data->key + ADD_TO_KEY_REDUCE_PRIORITY);
 
 #elif defined(EVICTION_LRU)
@@ -1440,9 +1997,9 @@ struct inode *get_victim_uinode(){
          * pvt_lru updates the value to that uinode's min later which
          * is correct.
          */
-        heap_update_key(g_file_heap, victim_uinode->heap_id, ULONG_MAX);
+        heap_update_key(victim_heap, victim_uinode->heap_id, ULONG_MAX);
 #else //only global Heap
-        heap_update_key(g_file_heap, victim_uinode->heap_id, (ticks_now()-first_rdtsc));
+        heap_update_key(victim_heap, victim_uinode->heap_id, gheap_key(victim_uinode, ticks_now()-first_rdtsc));
 #endif //ENABLE_PVT_HEAP
 
 #elif defined(ENABLE_EVICTION) && defined(ENABLE_PVT_HEAP) && defined(EVICTION_COMPLEX)
@@ -1455,6 +2012,30 @@ unlock_and_return:
 }
 
 
+/*
+ * Opens the uinode's file by name for an eviction that has no fd to use.
+ * The name is copied out of the arena, and the open is refused if the
+ * name now belongs to another file. Returns -1 if it cannot be opened.
+ */
+static int open_uinode_file(struct inode *uinode){
+        char path[PATH_MAX];
+        struct stat st;
+        int fd;
+
+        if(!get_uinode_filename(uinode, path, sizeof(path))){
+                return -1;
+        }
+        fd = real_open(path, O_RDONLY, 0);
+        if(fd == -1){
+                return -1;
+        }
+        if(fstat(fd, &st) != 0 || st.st_ino != uinode->ino || st.st_dev != uinode->dev_id){
+                real_close(fd);
+                return -1;
+        }
+        return fd;
+}
+
 void evict_full_file(struct inode *inode){
         int result;
         int fd;
@@ -1467,9 +2048,9 @@ void evict_full_file(struct inode *inode){
                 SPEEDYIO_FPRINTF("%s:ERROR inode in nullptr\n", "SPEEDYIO_ERRCO_0179\n");
                 goto exit_evict_full_file;
         }
-        fd = inode->fdlist[0].fd;
+        fd = get_any_fd_from_uinode(inode);
         if(unlikely(fd < 3)){
-                fd = real_open(inode->filename, O_RDONLY, 0);
+                fd = open_uinode_file(inode);
                 if(fd == -1){
                         SPEEDYIO_FPRINTF("%s:ERROR failed to open %s\n", "SPEEDYIO_ERRCO_0180 %s\n", inode->filename);
                         goto exit_evict_full_file;
@@ -1485,7 +2066,7 @@ void evict_full_file(struct inode *inode){
 
         if(result != 0){
                 debug_fprintf(stderr, "%s: posix_fadvise failed: %s {ino:%lu, dev:%lu}, fd:%d\n",
-                                __func__, strerror(result), inode->ino, inode->dev_id, inode->fdlist[0]);
+                                __func__, strerror(result), inode->ino, inode->dev_id, fd);
         }
 
         if(opened){
@@ -1496,11 +2077,45 @@ exit_evict_full_file:
         return;
 }
 
-void evict_file_portion(struct inode *uinode, int fd, off_t offset, size_t size){
+#if defined(ENABLE_DIRTY_TRACKING) && !defined(BELADY_PROOF)
+/*sync_file_range on a portion, opens the file if the uinode has no fd*/
+static void sync_file_portion(struct inode *uinode, int fd, off_t offset, size_t size, unsigned int flags){
+        bool opened = false;
+
+        if(fd < 3){
+                fd = open_uinode_file(uinode);
+                if(fd == -1){
+                        goto exit_sync_file_portion;
+                }
+                opened = true;
+        }
+
+        if(sync_file_range(fd, offset, size, flags) != 0){
+                debug_fprintf(stderr, "%s: sync_file_range failed: %s fd:%d\n", __func__, strerror(errno), fd);
+        }
+
+        if(opened){
+                real_close(fd);
+        }
+exit_sync_file_portion:
+        return;
+}
+#endif //ENABLE_DIRTY_TRACKING && !BELADY_PROOF
+
+/**
+ * DONTNEEDs size bytes of the file at offset.
+ * Returns the bytes dropped: with ENABLE_EVICTION_YIELD the clean cached
+ * bytes of the range when cachestat could measure them, else size.
+ */
+size_t evict_file_portion(struct inode *uinode, int fd, off_t offset, size_t size){
         int result;
         int opened = false;
         std::string err;
         off_t end, pos, this_size;
+        size_t dropped = 0;
+#ifdef ENABLE_EVICTION_YIELD
+        long nr_cached, nr_clean;
+#endif
 
 // #ifdef ENABLE_MINCORE_DEBUG
 //         std::vector<bool> mincore_arr;
@@ -1516,7 +2131,7 @@ void evict_file_portion(struct inode *uinode, int fd, off_t offset, size_t size)
         }
 
         if(fd < 3){
-                fd = real_open(uinode->filename, O_RDONLY, 0);
+                fd = open_uinode_file(uinode);
                 if(fd == -1){
                         // cfprintf(stderr, "%s:NOTE failed to open %s ...Skipping\n", __func__, uinode->filename);
                         goto exit_evict_file_portion;
@@ -1534,8 +2149,23 @@ void evict_file_portion(struct inode *uinode, int fd, off_t offset, size_t size)
         usleep(10000);
 #endif //DBG_FADV_SLEEP
 
+        dropped = size;
+
 #ifndef DBG_NO_DONTNEED
 
+#ifdef ENABLE_MMAP_TRACKING
+        /*DONTNEED skips mapped pages; page out this process's mappings of the range first*/
+        mmap_reclaim(uinode->dev_id, uinode->ino, offset, size);
+#endif //ENABLE_MMAP_TRACKING
+
+#ifdef ENABLE_EVICTION_YIELD
+        /*one cachestat per range; the DONTNEED drops the clean pages*/
+        if(yield_measure(fd, offset, size, &nr_cached, &nr_clean)){
+                yield_record(uinode->dev_id, uinode->ino, (long)(size >> PAGE_SHIFT), nr_cached, nr_clean);
+                dropped = (size_t)nr_clean << PAGE_SHIFT;
+        }
+#endif //ENABLE_EVICTION_YIELD
+
         #ifdef SMALLER_FADVISE
                 end = offset + size;
                 for(pos = offset; pos < end; pos += FADV_CHUNK_KB){
@@ -1577,9 +2207,25 @@ void evict_file_portion(struct inode *uinode, int fd, off_t offset, size_t size)
 // #endif //ENABLE_MINCORE_DEBUG
 
 exit_evict_file_portion:
-        return;
+        return dropped;
 }
 
+#ifdef ENABLE_BUSY_FILES
+/**
+ * Evicts a busy file BUSY_EVICT_CHUNK_KB at a time, so each DONTNEED
+ * walks and locks fewer of its pages and its readers get in between.
+ */
+static size_t evict_busy_file_portion(struct inode *uinode, int fd, off_t offset, size_t size){
+        size_t chunk = BUSY_EVICT_CHUNK_KB * KB;
+        size_t dropped = 0;
+
+        for(size_t done = 0; done < size; done += chunk){
+                dropped += evict_file_portion(uinode, fd, offset + done, std::min(chunk, size - done));
+        }
+        nr_busy_split.fetch_add(1, std::memory_order_relaxed);
+        return dropped;
+}
+#endif //ENABLE_BUSY_FILES
 
 /*
  * This function checkes if the current portion of this file is to be evicted
@@ -1625,7 +2271,7 @@ bool keep_evicting_from_this_file(struct inode *victim_inode){
 #endif
 
         g_heap_lock.lock();
-        next_victim = heap_read_min(g_file_heap);
+        next_victim = heap_read_min(gheap_of(victim_inode));
         next_victim_inode = (struct inode*) next_victim->dataptr;
         g_heap_lock.unlock();
 
@@ -1644,7 +2290,7 @@ bool keep_evicting_from_this_file(struct inode *victim_inode){
 
                 /*update the global heap with the current pvt heap min in the victim_inode*/
                 g_heap_lock.lock();
-                heap_update_key(g_file_heap, victim_inode->heap_id, victim_portion_freq);
+                heap_update_key(gheap_of(victim_inode), victim_inode->heap_id, victim_portion_freq);
                 g_heap_lock.unlock();
 
                 //printf("victim_1_freq:%f, victim_2_freq:%f HENCE CHANGING FILE\n", victim_portion_freq, victim_portion_2_freq);
@@ -1659,7 +2305,7 @@ exit:
 }
 
 
-#ifdef BELADY_PROOF
+#if defined(BELADY_PROOF) && defined(ENABLE_ONE_LRU)
 
 /**
  * Eviction event using one lru.
@@ -1719,7 +2365,7 @@ struct mock_eviction_item *evict_from_one_lru(long sz_to_claim_kb)
         }
         return eviction_event;
 }
-#endif //BELADY_PROOF
+#endif //BELADY_PROOF && ENABLE_ONE_LRU
 
 
 void new_evict_file_portion(int fd, off_t offset, size_t size){
@@ -1804,9 +2450,9 @@ long new_evict_portions(long sz_to_claim_kb){
                 goto skip_eviction;
         }
 
-        portion_nr = *(off_t*)victim_portion->dataptr;
+        portion_nr = victim_portion->data;
 
-        fd = victim_inode->fdlist[0].fd;
+        fd = get_any_fd_from_uinode(victim_inode);
 
         size_claimed_kb += portion_sz / KB;
 
@@ -1814,6 +2460,7 @@ long new_evict_portions(long sz_to_claim_kb){
         clock_gettime(CLOCK_MONOTONIC, &start);
 
         heap_update_key(victim_inode->file_heap, victim_portion_id, ULONG_MAX);
+        account_resident_portions(victim_inode, -1);
 
         clock_gettime(CLOCK_MONOTONIC, &end);
         bin_time_to_pow2_us(start, end, &ulong_heap_update);
@@ -1825,7 +2472,7 @@ skip_eviction:
 
 
         g_heap_lock.lock();
-        heap_update_key(g_file_heap, victim_inode->heap_id, last_victim_portion_key);
+        heap_update_key(gheap_of(victim_inode), victim_inode->heap_id, gheap_key(victim_inode, last_victim_portion_key));
         g_heap_lock.unlock();
 
 
@@ -1872,12 +2519,22 @@ long evict_portions(long sz_to_claim_kb)
         unsigned long long int last_victim_portion_key;
         struct HeapItem* victim_portion;
         struct HeapItem* last_victim_portion;
-        long size_claimed_kb = 0;
+        long size_claimed_kb = 0;       /*dropped from the page cache*/
+        long size_picked_kb = 0;        /*of the victim portions*/
         size_t portion_sz = 1UL << (PAGE_SHIFT + PVT_HEAP_PG_ORDER);
         off_t portion_nr;
+        long nr_victim_portions = 1;
         bool exit = false;
         int fd;
         struct timespec start, end;
+#if defined(ENABLE_DIRTY_TRACKING) && !defined(BELADY_PROOF)
+        enum dirty_phase phase;
+        bool wait_writeback = false;
+        int nr_deferred = 0;
+        int wb_fd = -1;
+        off_t wb_offset = 0;
+        size_t wb_size = 0;
+#endif //ENABLE_DIRTY_TRACKING && !BELADY_PROOF
 
 #ifdef BELADY_PROOF
         struct mock_eviction_item *eviction_event = nullptr;
@@ -1928,7 +2585,17 @@ long evict_portions(long sz_to_claim_kb)
                 //get portion from uinode
                 victim_inode->file_heap_lock.lock();
 
+#if defined(ENABLE_DIRTY_TRACKING) && !defined(BELADY_PROOF)
+pick_victim_portion:
+#endif //ENABLE_DIRTY_TRACKING && !BELADY_PROOF
                 victim_portion = heap_read_min(victim_inode->file_heap);
+#ifdef ENABLE_EXTENT_INDEX
+                /*all extents evicted already*/
+                if(!victim_portion){
+                        exit = true;
+                        goto err_unlock_exit;
+                }
+#endif //ENABLE_EXTENT_INDEX
                 if(unlikely(!victim_portion)){
                         SPEEDYIO_FPRINTF("%s:ERROR victim_portion is nullptr {ino:%lu, dev:%lu}\n", "SPEEDYIO_ERRCO_0191 %lu %lu\n", victim_inode->ino, victim_inode->dev_id);
                         exit = true;
@@ -1965,7 +2632,44 @@ long evict_portions(long sz_to_claim_kb)
 
 #endif //EVICTION_FREQ
                 //evict portion
-                portion_nr = *(off_t*)victim_portion->dataptr;
+                portion_nr = victim_portion->data;
+#ifdef ENABLE_EXTENT_INDEX
+                /*the whole extent goes*/
+                nr_victim_portions = extent_nr_portions(victim_inode->extents, portion_nr);
+                if(unlikely(!nr_victim_portions)){
+                        SPEEDYIO_FPRINTF("%s:ERROR no extent at portion_nr:%ld {ino:%lu, dev:%lu}\n", "SPEEDYIO_ERRCO_0254 %ld %lu %lu\n", portion_nr, victim_inode->ino, victim_inode->dev_id);
+                        exit = true;
+                        goto err_unlock_exit;
+                }
+#endif //ENABLE_EXTENT_INDEX
+
+#if defined(ENABLE_DIRTY_TRACKING) && !defined(BELADY_PROOF)
+                phase = dirty_evict_phase(victim_inode->dirty, portion_nr, portion_nr + nr_victim_portions - 1, mono_ns());
+                if(phase == DIRTY_START_WRITEBACK || phase == DIRTY_IN_WRITEBACK){
+                        /**
+                         * DONTNEED would free nothing here. Like the kernel
+                         * does with dirty pages, put it back at the MRU end
+                         * and drop it once it comes around clean.
+                         */
+                        heap_update_key(victim_inode->file_heap, victim_portion_id, ticks_now() - first_rdtsc);
+                        nr_dirty_deferred.fetch_add(1, std::memory_order_relaxed);
+
+                        /*one writeback per call, it is started once the locks are dropped*/
+                        if(phase == DIRTY_START_WRITEBACK){
+                                wb_fd = get_any_fd_from_uinode(victim_inode);
+                                wb_offset = portion_nr * portion_sz;
+                                wb_size = portion_sz * nr_victim_portions;
+                                exit = true;
+                                goto err_unlock_exit;
+                        }
+                        if(++nr_deferred < DIRTY_MAX_DEFERRED){
+                                goto pick_victim_portion;
+                        }
+                        exit = true;
+                        goto err_unlock_exit;
+                }
+                wait_writeback = phase == DIRTY_WRITTEN_BACK;
+#endif //ENABLE_DIRTY_TRACKING && !BELADY_PROOF
 
                 // printf("%s: {ino:%lu, dev:%lu}, portion_nr:%ld, off:%ld, size:%ld freq:%f inode_freq:%f nr_accesses:%ld\n",
                 //         __func__, victim_inode->ino, victim_inode->dev_id, portion_nr, (portion_nr*portion_sz), portion_sz,
@@ -1994,18 +2698,29 @@ long evict_portions(long sz_to_claim_kb)
                 eviction_event->ino = victim_inode->ino;
                 eviction_event->dev_id = victim_inode->dev_id;
                 eviction_event->offset = (portion_nr*portion_sz);
-                eviction_event->size = portion_sz;
+                eviction_event->size = portion_sz * nr_victim_portions;
 #else
 
 #ifndef EVICTOR_OUTSIDE_LOCK
-                evict_file_portion(victim_inode, victim_inode->fdlist[0].fd, (portion_nr*portion_sz), portion_sz);
+#if defined(ENABLE_DIRTY_TRACKING) && !defined(BELADY_PROOF)
+                if(wait_writeback){
+                        sync_file_portion(victim_inode, get_any_fd_from_uinode(victim_inode), (portion_nr*portion_sz), portion_sz * nr_victim_portions,
+                                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+                }
+#endif //ENABLE_DIRTY_TRACKING && !BELADY_PROOF
+#if defined(ENABLE_BUSY_FILES)
+                if(portion_sz * nr_victim_portions > BUSY_EVICT_CHUNK_KB * KB && file_is_busy(victim_inode)){
+                        size_claimed_kb += evict_busy_file_portion(victim_inode, get_any_fd_from_uinode(victim_inode), (portion_nr*portion_sz), portion_sz * nr_victim_portions) / KB;
+                }else
+#endif //ENABLE_BUSY_FILES
+                size_claimed_kb += evict_file_portion(victim_inode, get_any_fd_from_uinode(victim_inode), (portion_nr*portion_sz), portion_sz * nr_victim_portions) / KB;
 #else
-                fd = victim_inode->fdlist[0].fd;
+                fd = get_any_fd_from_uinode(victim_inode);
 #endif //EVICTOR_OUTSIDE_LOCK
 
 #endif //BELADY_PROOF
 
-                size_claimed_kb += portion_sz / KB;
+                size_picked_kb += nr_victim_portions * portion_sz / KB;
 
 #ifndef DBG_DISABLE_DOWHILE_UPDATEKEY
 
@@ -2017,7 +2732,13 @@ long evict_portions(long sz_to_claim_kb)
 #elif EVICTION_LRU
                 clock_gettime(CLOCK_MONOTONIC, &start);
 
+#ifdef ENABLE_EXTENT_INDEX
+                extent_remove(victim_inode->extents, victim_inode->file_heap, portion_nr);
+#else
                 heap_update_key(victim_inode->file_heap, victim_portion_id, ULONG_MAX);
+#endif //ENABLE_EXTENT_INDEX
+                account_resident_portions(victim_inode, -nr_victim_portions);
+                nr_evicted_portions.fetch_add(nr_victim_portions, std::memory_order_relaxed);
 
                 clock_gettime(CLOCK_MONOTONIC, &end);
                 bin_time_to_pow2_us(start, end, &ulong_heap_update);
@@ -2040,7 +2761,7 @@ err_unlock_exit:
         // while(size_claimed_kb < sz_to_claim_kb);
 #elif EVICTION_FREQ
         #error "keep_evicting_from_this_file is not upto date. check floats and other things thoroughly"
-        while(keep_evicting_from_this_file(victim_inode) && (size_claimed_kb < sz_to_claim_kb));
+        while(keep_evicting_from_this_file(victim_inode) && (size_picked_kb < sz_to_claim_kb));
 #else
         /*
          * This is only placed here to remove the compilation errors
@@ -2061,9 +2782,32 @@ err_unlock_exit:
 
 
 #ifdef EVICTOR_OUTSIDE_LOCK
-        evict_file_portion(victim_inode, fd, (portion_nr*portion_sz), portion_sz);
+        /*nothing was picked if the loop exited right away*/
+        if(size_picked_kb > 0){
+#if defined(ENABLE_DIRTY_TRACKING) && !defined(BELADY_PROOF)
+                /*second phase, writeback was started DIRTY_WRITEBACK_MS ago and is mostly done*/
+                if(wait_writeback){
+                        sync_file_portion(victim_inode, fd, (portion_nr*portion_sz), portion_sz * nr_victim_portions,
+                                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+                }
+#endif //ENABLE_DIRTY_TRACKING && !BELADY_PROOF
+#if defined(ENABLE_BUSY_FILES) && !defined(BELADY_PROOF)
+                if(portion_sz * nr_victim_portions > BUSY_EVICT_CHUNK_KB * KB && file_is_busy(victim_inode)){
+                        size_claimed_kb += evict_busy_file_portion(victim_inode, fd, (portion_nr*portion_sz), portion_sz * nr_victim_portions) / KB;
+                }else
+#endif //ENABLE_BUSY_FILES && !BELADY_PROOF
+                size_claimed_kb += evict_file_portion(victim_inode, fd, (portion_nr*portion_sz), portion_sz * nr_victim_portions) / KB;
+        }
 #endif //EVICTOR_OUTSIDE_LOCK
 
+#if defined(ENABLE_DIRTY_TRACKING) && !defined(BELADY_PROOF)
+        /*first phase, the kernel writes it back while the evictor goes on*/
+        if(wb_size > 0){
+                sync_file_portion(victim_inode, wb_fd, wb_offset, wb_size, SYNC_FILE_RANGE_WRITE);
+                nr_dirty_writebacks.fetch_add(1, std::memory_order_relaxed);
+        }
+#endif //ENABLE_DIRTY_TRACKING && !BELADY_PROOF
+
 
 
 #ifdef DBG_ONLY_DOWHILE
@@ -2073,7 +2817,7 @@ err_unlock_exit:
 
         victim_inode->file_heap_lock.lock();
         last_victim_portion = heap_read_min(victim_inode->file_heap);
-        last_victim_portion_key = last_victim_portion->key;
+        last_victim_portion_key = last_victim_portion ? last_victim_portion->key : ULONG_MAX;
 
         // if (last_victim_portion_key == ULONG_MAX) {
         //         auto file_heap_keys = heap_get_all_keys(victim_inode->file_heap);
@@ -2087,7 +2831,7 @@ err_unlock_exit:
         g_heap_lock.lock();
         // SPEEDYIO_PRINTF("%s:INFO global_heap_update_key for {ino:%lu, dev:%lu}, heap_id:%d\n", "SPEEDYIO_INFOCO_0021 %lu %lu %d\n", victim_inode->ino, victim_inode->dev_id, victim_inode->heap_id);
         if(!victim_inode->is_deleted()){
-                heap_update_key(g_file_heap, victim_inode->heap_id, last_victim_portion_key);
+                heap_update_key(gheap_of(victim_inode), victim_inode->heap_id, gheap_key(victim_inode, last_victim_portion_key));
         }else{
                 SPEEDYIO_PRINTF("%s:WARNING victim_inode {ino:%lu, dev:%lu} removed from gheap in the middle of eviction\n", "SPEEDYIO_WARNCO_0008 %lu %lu\n", victim_inode->ino, victim_inode->dev_id);
         }
@@ -2168,6 +2912,33 @@ exit_evict_file:
 }
 
 
+#if defined(ENABLE_MMAP_TRACKING) && !defined(BELADY_PROOF)
+/*Every MMAP_SAMPLE_MS, puts the portions accessed through mappings in the heaps, as reads would*/
+static void sample_mapped_portions(){
+        static uint64_t last_sample_ns = 0;
+        std::vector<struct mmap_access> accessed;
+        struct inode *uinode;
+        uint64_t now = mono_ns();
+
+        if(now - last_sample_ns < MMAP_SAMPLE_MS * 1000000ULL){
+                return;
+        }
+        last_sample_ns = now;
+
+        mmap_sample(&accessed);
+        for(const struct mmap_access &a : accessed){
+                uinode = get_uinode_from_hashtable(a.ino, a.dev);
+                if(!uinode || !uinode->unlinked_lock.try_lock()){
+                        continue;
+                }
+                if(!uinode->is_deleted()){
+                        heap_update(uinode, a.offset, a.size, true);
+                }
+                uinode->unlinked_lock.unlock();
+        }
+}
+#endif //ENABLE_MMAP_TRACKING && !BELADY_PROOF
+
 void *concurrent_eviction(void *arg){
 
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
@@ -2178,6 +2949,16 @@ void *concurrent_eviction(void *arg){
 
         long free_mem_kb;
         long min_mem_reqd_kb;
+        long forced_kb, claimed_kb;
+#if defined(ENABLE_PVT_HEAP) && !defined(BELADY_PROOF)
+        unsigned long nr_evicted;
+#endif //ENABLE_PVT_HEAP && !BELADY_PROOF
+#if defined(ENABLE_HOST_COORD) && defined(ENABLE_PVT_HEAP) && !defined(BELADY_PROOF)
+        long host_kb;
+#endif //ENABLE_HOST_COORD && ENABLE_PVT_HEAP && !BELADY_PROOF
+#ifdef ENABLE_DIRTY_TRACKING
+        unsigned long nr_deferred;
+#endif //ENABLE_DIRTY_TRACKING
 
         unsigned long long int ctr = 0;
 
@@ -2186,6 +2967,20 @@ void *concurrent_eviction(void *arg){
         //SYSTEM monitor bg thread has not been started
         while(getFreeMemoryKB() <= 0){}
 
+#ifdef ENABLE_FILE_ROLE_TIERS
+        /*till this is done all roles are plain LRU*/
+        init_file_role_credits();
+#endif //ENABLE_FILE_ROLE_TIERS
+
+#if defined(ENABLE_HOST_COORD) && defined(ENABLE_PVT_HEAP) && !defined(BELADY_PROOF)
+        /*if this fails host_coord_claim hands back this process's own deficit*/
+        host_coord_init();
+#endif //ENABLE_HOST_COORD && ENABLE_PVT_HEAP && !BELADY_PROOF
+
+#if defined(ENABLE_MMAP_TRACKING) && !defined(BELADY_PROOF)
+        mmap_regions_init();
+#endif //ENABLE_MMAP_TRACKING && !BELADY_PROOF
+
         while(true){
 
 try_again:
@@ -2199,9 +2994,45 @@ try_again:
                 printf("%s: Free Mem:%ld KB, minreqdmem:%ld KB\n", __func__,
                                 getFreeMemoryKB(), getMinMemoryRequiredKB());
                 */
+#if defined(ENABLE_PVT_HEAP) && !defined(BELADY_PROOF)
+                forced_kb = forced_evict_kb.load(std::memory_order_relaxed);
+                if(forced_kb > 0){
+#ifdef ENABLE_DIRTY_TRACKING
+                        nr_deferred = nr_dirty_deferred.load(std::memory_order_relaxed);
+#endif //ENABLE_DIRTY_TRACKING
+                        nr_evicted = nr_evicted_portions.load(std::memory_order_relaxed);
+                        claimed_kb = evict_portions(forced_kb);
+                        if(claimed_kb > 0){
+                                forced_evict_kb.fetch_sub(claimed_kb, std::memory_order_relaxed);
+                        }else if(nr_evicted_portions.load(std::memory_order_relaxed) != nr_evicted){
+                                /*the victim was out of the page cache already, go on to the next*/
+#ifdef ENABLE_DIRTY_TRACKING
+                        }else if(nr_dirty_deferred.load(std::memory_order_relaxed) != nr_deferred){
+                                /*only dirty victims this time, they are evicted once written back*/
+#endif //ENABLE_DIRTY_TRACKING
+                        }else{
+                                /*nothing left to evict, drop the rest of the pass*/
+                                forced_evict_kb.store(0, std::memory_order_relaxed);
+                        }
+                        goto evictor_sleep;
+                }
+#endif //ENABLE_PVT_HEAP
+
                 free_mem_kb = getFreeMemoryKB();
-                min_mem_reqd_kb = getMinMemoryRequiredKB() + EVICTION_LOW_MEM_WATERMARK;
+                min_mem_reqd_kb = getMinMemoryRequiredKB() + low_mem_watermark_kb.load(std::memory_order_relaxed);
 
+#if defined(ENABLE_HOST_COORD) && defined(ENABLE_PVT_HEAP) && !defined(BELADY_PROOF)
+                /**
+                 * All the processes see the same MemFree; the deficit is
+                 * reclaimed once, by the process with the coldest file.
+                 */
+                host_kb = host_coord_claim(free_mem_kb < min_mem_reqd_kb ? min_mem_reqd_kb - free_mem_kb : 0,
+                                get_coldest_key);
+                if(host_kb > 0){
+                        claimed_kb = evict_portions(host_kb);
+                        host_coord_claim_done(claimed_kb);
+                }
+#else //each process evicts its own deficit
                 if(free_mem_kb < min_mem_reqd_kb){
 
 #ifdef DBG_EVICTOR_ONLYSLEEP
@@ -2227,9 +3058,13 @@ try_again:
                         }
 #endif //ENABLE_PVT_HEAP
                 }
+#endif //ENABLE_HOST_COORD && ENABLE_PVT_HEAP && !BELADY_PROOF
 
 evictor_sleep:
                 if (ctr % EVICTOR_SLEEP_FREQ == 0) {
+#if defined(ENABLE_MMAP_TRACKING) && !defined(BELADY_PROOF)
+                        sample_mapped_portions();
+#endif //ENABLE_MMAP_TRACKING && !BELADY_PROOF
                         ts.tv_sec = sleep_milliseconds / 1000;              // Convert milliseconds to seconds
                         ts.tv_nsec = (sleep_milliseconds % 1000) * 1000000L;  // Convert remaining milliseconds to nanoseconds
                         if (nanosleep(&ts, NULL) == -1) {
@@ -2242,6 +3077,49 @@ exit:
         return nullptr;
 }
 
+void set_eviction_low_mem_watermark(long kb){
+        low_mem_watermark_kb.store(kb, std::memory_order_relaxed);
+}
+
+/*Makes the evictor evict about kb KB, even if memory is not low*/
+void request_eviction_pass(long kb){
+        forced_evict_kb.store(kb, std::memory_order_relaxed);
+}
+
+void get_eviction_stats(struct eviction_stats *stats){
+        stats->nr_files = 0;
+
+        g_heap_lock.lock();
+#ifdef ENABLE_CACHE_CLASSES
+        for(int cls = 0; cls < nr_cache_classes; cls++){
+                if(g_class_heaps[cls]){
+                        stats->nr_files += g_class_heaps[cls]->size;
+                }
+        }
+#else
+        if(g_file_heap){
+                stats->nr_files = g_file_heap->size;
+        }
+#endif //ENABLE_CACHE_CLASSES
+        g_heap_lock.unlock();
+
+        stats->nr_evicted = nr_evicted_portions.load(std::memory_order_relaxed);
+        stats->nr_pvt_heaps = nr_pvt_heaps.load(std::memory_order_relaxed);
+#ifdef ENABLE_DIRTY_TRACKING
+        stats->nr_dirty_deferred = nr_dirty_deferred.load(std::memory_order_relaxed);
+        stats->nr_dirty_writebacks = nr_dirty_writebacks.load(std::memory_order_relaxed);
+#endif //ENABLE_DIRTY_TRACKING
+#ifdef ENABLE_BUSY_FILES
+        stats->nr_busy_passed = nr_busy_passed.load(std::memory_order_relaxed);
+        stats->nr_busy_split = nr_busy_split.load(std::memory_order_relaxed);
+#endif //ENABLE_BUSY_FILES
+        stats->low_mem_watermark_kb = low_mem_watermark_kb.load(std::memory_order_relaxed);
+        stats->forced_evict_kb = forced_evict_kb.load(std::memory_order_relaxed);
+        if(stats->forced_evict_kb < 0){
+                stats->forced_evict_kb = 0;
+        }
+}
+
 //TESTING FUNCTIONS
 
 /**
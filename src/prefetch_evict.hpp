@@ -1,16 +1,55 @@
 #ifndef _PREFETCH_EVICT_HPP
 #define _PREFETCH_EVICT_HPP
 
+#include <atomic>
+#include <memory>
+
 #include "inode.hpp"
 #include "utils/shim/shim.hpp"
 #include "utils/events_logger/events_logger.hpp"
 #include "utils/latency_tracking/latency_tracking.hpp"
 
+#ifdef BELADY_PROOF
+#include "belady_proof.hpp"
+#endif //BELADY_PROOF
+
 extern struct lat_tracker pvt_heap_latency;
 extern struct lat_tracker g_heap_latency;
 extern struct lat_tracker ulong_heap_update;
 
 
+/**
+ * Userspace mirror of the kernel's open file description: the seek head
+ * shared by an fd and all its dup()s.
+ *
+ * The following system calls update the seek_head
+ * read, readv, write, writev, lseek
+ * pread and pwrite dont change the seek_head
+ *
+ * It is updated with atomics only, so sequential readers of the same
+ * file don't contend on any uinode lock.
+ */
+struct open_file_desc{
+        std::atomic<off_t> seek_head;
+
+        /*forward read/write. returns the old seek_head*/
+        off_t advance(off_t bytes){
+                return seek_head.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        /*lseek. returns the old seek_head*/
+        off_t set(off_t pos){
+                return seek_head.exchange(pos, std::memory_order_relaxed);
+        }
+
+        /*perfd_structs pointing to it; freed when the last one lets go*/
+        std::atomic<int> nr_pfds;
+
+        open_file_desc(off_t pos) : seek_head(pos), nr_pfds(0) {}
+};
+
+void put_open_file_desc(struct open_file_desc *fdesc);
+
 struct perfd_struct{
 
         ino_t ino; //inode number
@@ -21,6 +60,15 @@ struct perfd_struct{
 
         struct inode *uinode;
 
+        /**
+         * Only valid for whitelisted fds. dup'd fds point to the same one.
+         * It is reset at close and replaced when the fd is reused, while
+         * other threads may be reading it; see set_pfd_fdesc. Readers load
+         * it with acquire and take no reference: it is only freed once no
+         * pfd points to it, ie. after the close of its last fd.
+         */
+        std::atomic<struct open_file_desc *> fdesc;
+
         /*
          * Indicates that the pfd_struct represents
          * a blacklisted file.
@@ -55,6 +103,7 @@ struct perfd_struct{
                 fd = 0;
                 open_flags = 0;
                 uinode = nullptr;
+                fdesc.store(nullptr, std::memory_order_relaxed);
                 blacklisted = false;
                 fd_open = true;
         }
@@ -66,6 +115,7 @@ struct perfd_struct{
                 fd = 0;
                 open_flags = 0;
                 uinode = nullptr;
+                put_open_file_desc(fdesc.exchange(nullptr, std::memory_order_acq_rel));
                 blacklisted = false;
                 fd_open = false;
         }
@@ -88,10 +138,14 @@ struct lru_entry{
 void init_g_fd_map();
 
 std::shared_ptr<struct perfd_struct> add_fd_to_perfd_struct(int, struct inode *);
-std::shared_ptr<struct perfd_struct> add_any_fd_to_perfd_struct(int, int, struct inode *, bool);
+std::shared_ptr<struct perfd_struct> add_any_fd_to_perfd_struct(int, int, struct inode *, bool,
+                off_t seek_head = 0, struct open_file_desc *fdesc = nullptr);
+void set_pfd_fdesc(struct perfd_struct *pfd, struct open_file_desc *fdesc);
 std::shared_ptr<struct perfd_struct> get_perfd_data(int fd);
 std::shared_ptr<struct perfd_struct> get_perfd_data_nolock(int fd);
 std::shared_ptr<struct perfd_struct> get_perfd_struct_fast(int fd);
+ssize_t update_pfd_seek_pos(struct perfd_struct *pfd, off_t bytes, bool set_to);
+size_t get_nr_tracked_fds();
 
 
 void delete_fd(int, bool);
@@ -115,6 +169,27 @@ void update_g_heap(struct inode* uinode);
 
 void* concurrent_eviction(void *arg);
 
+/*Runtime knobs and stats of the evictor, used by the admin socket*/
+struct eviction_stats{
+        size_t nr_files;                /*files in the global heaps*/
+        unsigned long nr_evicted;       /*portions evicted so far*/
+        long nr_pvt_heaps;              /*files with a pvt heap*/
+        long low_mem_watermark_kb;
+        long forced_evict_kb;           /*left of a requested eviction pass*/
+#ifdef ENABLE_DIRTY_TRACKING
+        unsigned long nr_dirty_deferred;        /*victims put back for being dirty*/
+        unsigned long nr_dirty_writebacks;      /*victims the evictor started writeback of*/
+#endif //ENABLE_DIRTY_TRACKING
+#ifdef ENABLE_BUSY_FILES
+        unsigned long nr_busy_passed;   /*busy victims made younger for an idle file*/
+        unsigned long nr_busy_split;    /*evictions of busy files done in chunks*/
+#endif //ENABLE_BUSY_FILES
+};
+
+void set_eviction_low_mem_watermark(long kb);
+void request_eviction_pass(long kb);
+void get_eviction_stats(struct eviction_stats *stats);
+
 /*
  * Operations on pvt heap
  */
@@ -128,12 +203,44 @@ unsigned long long int update_pvt_heap(struct inode* uinode, off_t offset, size_
 #endif
 
 void destroy_pvt_heap(struct Heap *pvt_heap);
+void forget_resident_portions(struct inode *uinode);
 unsigned long long int get_min_key(struct inode* uinode);
 
 void heap_dont_need_update(struct inode* uinode, int fd, off_t offset, size_t size);
 
+/**
+ * Defined in interface.cpp, called by its read wrappers after the real
+ * read. syscall_start and syscall_end bound the real read, for its trace
+ * record; nullptr when the caller did not time it.
+ */
+void handle_read(int fd, off_t offset, size_t size, bool offset_absent,
+                const struct timespec *syscall_start = nullptr, const struct timespec *syscall_end = nullptr);
+
+#ifdef ENABLE_DIRTY_TRACKING
+/*handle_write and fsync/fdatasync tell the evictor which portions are dirty*/
+void track_dirty_write(struct inode *uinode, off_t offset, size_t size);
+unsigned long long int begin_dirty_sync(struct inode *uinode);
+void end_dirty_sync(struct inode *uinode, unsigned long long int seq);
+#endif //ENABLE_DIRTY_TRACKING
+
+#ifdef ENABLE_BUSY_FILES
+/**
+ * The read wrappers count the reads in flight of each file around the
+ * real read: begin_file_read returns the uinode of a whitelisted fd (or
+ * nullptr) to pass to end_file_read once the read has returned.
+ */
+struct inode *begin_file_read(int fd);
+void end_file_read(struct inode *uinode);
+bool file_is_busy(struct inode *uinode);
+#endif //ENABLE_BUSY_FILES
+
 #ifdef BELADY_PROOF
 void heap_update(struct inode* uinode, off_t offset, size_t size, bool from_read, uint64_t timestamp);
+
+/*real I/O of a BELADY_PROOF build has no trace timestamp*/
+static inline void heap_update(struct inode* uinode, off_t offset, size_t size, bool from_read){
+        heap_update(uinode, offset, size, from_read, ticks_now());
+}
 #else
 void heap_update(struct inode* uinode, off_t offset, size_t size, bool from_read);
 #endif //BELADY_PROOF
@@ -149,6 +256,9 @@ struct mock_eviction_item *evict_file(void);
 /*DEBUGGING*/
 void print_full_gheap();
 
+#else
+/*returns the KB reclaimed from the victim of the global heaps*/
+long evict_portions(long sz_to_claim_kb);
 #endif //BELADY_PROOF
 
 #endif
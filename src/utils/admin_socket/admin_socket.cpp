@@ -0,0 +1,397 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/un.h>
+
+#include <new>
+
+#include "admin_socket.hpp"
+#include "utils/util.hpp"
+#include "utils/shim/shim.hpp"
+
+struct admin_command {
+        const char *name;
+        admin_cmd_fn fn;
+        const char *usage;
+};
+
+struct admin_client {
+        int fd;                 /*-1 if the slot is free*/
+        size_t len;             /*bytes in buf*/
+        char buf[ADMIN_LINE_MAX];
+        std::string out;        /*replies not sent yet*/
+        bool close_after;       /*closed once out is sent*/
+        uint32_t events;        /*what epoll waits for*/
+};
+
+static struct admin_command admin_commands[ADMIN_MAX_COMMANDS];
+static int nr_admin_commands = 0;
+
+static int listen_fd = -1;
+static struct admin_client *clients = nullptr;
+
+int admin_register_command(const char *name, admin_cmd_fn fn, const char *usage){
+        if(nr_admin_commands >= ADMIN_MAX_COMMANDS){
+                SPEEDYIO_FPRINTF("%s:ERROR too many admin commands, dropping %s\n", "SPEEDYIO_ERRCO_0227 %s\n", name);
+                return -1;
+        }
+        admin_commands[nr_admin_commands].name = name;
+        admin_commands[nr_admin_commands].fn = fn;
+        admin_commands[nr_admin_commands].usage = usage;
+        nr_admin_commands++;
+        return 0;
+}
+
+static int cmd_help(int argc, char **argv, std::string *reply){
+        for(int i = 0; i < nr_admin_commands; i++){
+                reply->append(admin_commands[i].usage);
+                reply->append("\n");
+        }
+        return 0;
+}
+
+/**
+ * Fills addr for path; see init_admin_socket.
+ * Returns the address length, or 0 if the path is too long.
+ */
+static socklen_t fill_admin_addr(const char *path, struct sockaddr_un *addr){
+        char name[sizeof(addr->sun_path)];
+        size_t len;
+        bool abstract = true;
+
+        memset(addr, 0, sizeof(*addr));
+        addr->sun_family = AF_UNIX;
+
+        if(!path || !*path){
+                snprintf(name, sizeof(name), ADMIN_SOCKET_NAME_FMT, getpid());
+        }else if(path[0] == '@'){
+                snprintf(name, sizeof(name), "%s", path + 1);
+        }else{
+                abstract = false;
+        }
+
+        if(abstract){
+                /*abstract sockets start with a '\0' and are not NUL terminated*/
+                len = strlen(name);
+                if(len + 1 > sizeof(addr->sun_path)){
+                        return 0;
+                }
+                memcpy(addr->sun_path + 1, name, len);
+                return offsetof(struct sockaddr_un, sun_path) + 1 + len;
+        }
+
+        len = strlen(path);
+        if(len + 1 > sizeof(addr->sun_path)){
+                return 0;
+        }
+        memcpy(addr->sun_path, path, len + 1);
+        return offsetof(struct sockaddr_un, sun_path) + len + 1;
+}
+
+/**
+ * A socket file left behind by a dead process is removed. One with
+ * a live listener (eg. the parent of a forked child) is not.
+ */
+static bool remove_stale_socket(const char *path, struct sockaddr_un *addr, socklen_t addr_len){
+        struct stat st;
+        int fd;
+        bool ret = true;
+
+        if(lstat(path, &st) != 0){
+                goto exit_remove_stale_socket;
+        }
+        if(!S_ISSOCK(st.st_mode)){
+                ret = false;
+                goto exit_remove_stale_socket;
+        }
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(fd < 0){
+                ret = false;
+                goto exit_remove_stale_socket;
+        }
+        if(connect(fd, (struct sockaddr *)addr, addr_len) == 0){
+                ret = false;
+        }else{
+                unlink(path);
+        }
+        real_close(fd);
+
+exit_remove_stale_socket:
+        return ret;
+}
+
+int init_admin_socket(const char *path){
+        struct sockaddr_un addr;
+        socklen_t addr_len;
+        int fd = -1;
+
+        addr_len = fill_admin_addr(path, &addr);
+        if(!addr_len){
+                SPEEDYIO_FPRINTF("%s:ERROR admin socket path too long '%s'\n", "SPEEDYIO_ERRCO_0228 %s\n", path);
+                goto err_init_admin_socket;
+        }
+
+        if(addr.sun_path[0] && !remove_stale_socket(addr.sun_path, &addr, addr_len)){
+                SPEEDYIO_FPRINTF("%s:ERROR %s is in use or not a socket\n", "SPEEDYIO_ERRCO_0229 %s\n", addr.sun_path);
+                goto err_init_admin_socket;
+        }
+
+        clients = new (std::nothrow) struct admin_client[ADMIN_MAX_CLIENTS];
+        if(!clients){
+                SPEEDYIO_FPRINTF("%s:ERROR unable to alloc admin clients\n", "SPEEDYIO_ERRCO_0230\n");
+                goto err_init_admin_socket;
+        }
+        for(int i = 0; i < ADMIN_MAX_CLIENTS; i++){
+                clients[i].fd = -1;
+                clients[i].len = 0;
+                clients[i].close_after = false;
+                clients[i].events = 0;
+        }
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(fd < 0){
+                SPEEDYIO_FPRINTF("%s:ERROR socket failed errno:%d\n", "SPEEDYIO_ERRCO_0231 %d\n", errno);
+                goto err_init_admin_socket;
+        }
+
+        if(bind(fd, (struct sockaddr *)&addr, addr_len) != 0 || listen(fd, ADMIN_MAX_CLIENTS) != 0){
+                SPEEDYIO_FPRINTF("%s:ERROR unable to listen on the admin socket errno:%d\n", "SPEEDYIO_ERRCO_0232 %d\n", errno);
+                goto err_init_admin_socket;
+        }
+        if(addr.sun_path[0]){
+                chmod(addr.sun_path, 0600);
+        }
+
+        admin_register_command("help", cmd_help, "help");
+
+        listen_fd = fd;
+        return 0;
+
+err_init_admin_socket:
+        if(fd >= 0){
+                real_close(fd);
+        }
+        delete[] clients;
+        clients = nullptr;
+        return -1;
+}
+
+/*Only the user SpeedyIO runs as and root may send commands*/
+static bool peer_allowed(int fd){
+        struct ucred cred;
+        socklen_t len = sizeof(cred);
+
+        if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0){
+                return false;
+        }
+        return cred.uid == 0 || cred.uid == geteuid();
+}
+
+static void close_client(int epfd, struct admin_client *client){
+        epoll_ctl(epfd, EPOLL_CTL_DEL, client->fd, NULL);
+        real_close(client->fd);
+        client->fd = -1;
+        client->len = 0;
+        client->out.clear();
+        client->close_after = false;
+}
+
+static void accept_clients(int epfd){
+        struct epoll_event ev;
+        int fd, slot;
+
+        while((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0){
+                if(!peer_allowed(fd)){
+                        real_close(fd);
+                        continue;
+                }
+
+                for(slot = 0; slot < ADMIN_MAX_CLIENTS && clients[slot].fd >= 0; slot++);
+                if(slot == ADMIN_MAX_CLIENTS){
+                        /*too many admins at once*/
+                        real_close(fd);
+                        continue;
+                }
+
+                ev.events = EPOLLIN;
+                ev.data.u32 = slot;
+                if(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0){
+                        real_close(fd);
+                        continue;
+                }
+                clients[slot].fd = fd;
+                clients[slot].len = 0;
+                clients[slot].events = EPOLLIN;
+        }
+}
+
+/*Runs one command line and builds its reply*/
+static void run_command(char *line, std::string *reply){
+        char *argv[ADMIN_MAX_ARGS];
+        int argc = 0;
+        char *save = nullptr;
+        char *tok;
+
+        for(tok = strtok_r(line, " \t\r", &save); tok; tok = strtok_r(NULL, " \t\r", &save)){
+                if(argc == ADMIN_MAX_ARGS){
+                        reply->append("ERR too many arguments\n");
+                        return;
+                }
+                argv[argc++] = tok;
+        }
+        if(!argc){
+                return;
+        }
+
+        for(int i = 0; i < nr_admin_commands; i++){
+                if(strcmp(argv[0], admin_commands[i].name)){
+                        continue;
+                }
+                if(admin_commands[i].fn(argc, argv, reply) == 0){
+                        reply->append("OK\n");
+                }else{
+                        reply->insert(0, "ERR ");
+                        reply->append("\n");
+                }
+                return;
+        }
+        reply->append("ERR unknown command, try help\n");
+}
+
+/**
+ * Sends as much of client->out as the socket takes. While some of it is
+ * left, epoll waits for EPOLLOUT instead of EPOLLIN, so a client that
+ * does not read its replies is not served more commands.
+ * Returns false if the client is to be closed.
+ */
+static bool flush_client(int epfd, unsigned int slot){
+        struct admin_client *client = &clients[slot];
+        struct epoll_event ev;
+        size_t sent = 0;
+        ssize_t nr;
+
+        while(sent < client->out.size()){
+                nr = send(client->fd, client->out.data() + sent, client->out.size() - sent, MSG_NOSIGNAL);
+                if(nr < 0){
+                        if(errno == EINTR){
+                                continue;
+                        }
+                        if(errno == EAGAIN){
+                                break;
+                        }
+                        return false;
+                }
+                sent += nr;
+        }
+        client->out.erase(0, sent);
+
+        if(client->out.empty() && client->close_after){
+                return false;
+        }
+
+        ev.events = client->out.empty() ? EPOLLIN : EPOLLOUT;
+        ev.data.u32 = slot;
+        if(ev.events != client->events){
+                if(epoll_ctl(epfd, EPOLL_CTL_MOD, client->fd, &ev) != 0){
+                        return false;
+                }
+                client->events = ev.events;
+        }
+        return true;
+}
+
+/**
+ * Reads what the client sent and runs every complete line.
+ * Returns false if the client is to be closed.
+ */
+static bool serve_client(int epfd, unsigned int slot){
+        struct admin_client *client = &clients[slot];
+        std::string reply;
+        char *line, *nl;
+        ssize_t nr;
+
+        nr = recv(client->fd, client->buf + client->len, ADMIN_LINE_MAX - client->len, 0);
+        if(nr <= 0){
+                return nr < 0 && (errno == EAGAIN || errno == EINTR);
+        }
+        client->len += nr;
+
+        line = client->buf;
+        while((nl = (char *)memchr(line, '\n', client->len - (line - client->buf)))){
+                *nl = '\0';
+                reply.clear();
+                run_command(line, &reply);
+                client->out.append(reply);
+                line = nl + 1;
+        }
+
+        client->len -= line - client->buf;
+        memmove(client->buf, line, client->len);
+
+        if(client->len == ADMIN_LINE_MAX){
+                client->out.append("ERR line too long\n");
+                client->close_after = true;
+        }
+        return flush_client(epfd, slot);
+}
+
+void *admin_socket_loop(void *arg){
+        struct epoll_event ev, events[ADMIN_MAX_CLIENTS + 1];
+        int epfd, nr;
+
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+
+        if(listen_fd < 0){
+                goto exit_admin_socket_loop;
+        }
+
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        if(epfd < 0){
+                SPEEDYIO_FPRINTF("%s:ERROR epoll_create1 failed errno:%d\n", "SPEEDYIO_ERRCO_0233 %d\n", errno);
+                goto exit_admin_socket_loop;
+        }
+
+        /*clients use their slot, the listening socket ADMIN_MAX_CLIENTS*/
+        ev.events = EPOLLIN;
+        ev.data.u32 = ADMIN_MAX_CLIENTS;
+        if(epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev) != 0){
+                SPEEDYIO_FPRINTF("%s:ERROR epoll_ctl failed errno:%d\n", "SPEEDYIO_ERRCO_0234 %d\n", errno);
+                real_close(epfd);
+                goto exit_admin_socket_loop;
+        }
+
+        while(true){
+                /*epoll_wait is a cancellation point*/
+                nr = epoll_wait(epfd, events, ADMIN_MAX_CLIENTS + 1, -1);
+                if(nr < 0){
+                        if(errno == EINTR){
+                                continue;
+                        }
+                        SPEEDYIO_FPRINTF("%s:ERROR epoll_wait failed errno:%d\n", "SPEEDYIO_ERRCO_0235 %d\n", errno);
+                        break;
+                }
+
+                for(int i = 0; i < nr; i++){
+                        unsigned int slot = events[i].data.u32;
+
+                        if(slot == ADMIN_MAX_CLIENTS){
+                                accept_clients(epfd);
+                        }else if(!(clients[slot].out.empty() ? serve_client(epfd, slot) : flush_client(epfd, slot))){
+                                close_client(epfd, &clients[slot]);
+                        }
+                }
+        }
+
+exit_admin_socket_loop:
+        return NULL;
+}
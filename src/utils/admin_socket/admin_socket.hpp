@@ -0,0 +1,43 @@
+#ifndef _ADMIN_SOCKET_HPP
+#define _ADMIN_SOCKET_HPP
+
+#include <string>
+
+/**
+ * Local admin control socket.
+ *
+ * A unix stream socket served by one thread running an epoll loop.
+ * Only processes of the same user (or root) may connect.
+ *
+ * The protocol is line based: one command per line, words separated by
+ * blanks. The reply is zero or more lines of text followed by a line
+ * "OK" or "ERR <reason>". eg.
+ *   $ echo pause | socat - ABSTRACT-CONNECT:speedyio.<pid>
+ *   OK
+ *
+ * Commands are registered by the rest of SpeedyIO with
+ * admin_register_command before the thread is started. "help" lists them.
+ */
+
+/**
+ * Handles one command; argv[0] is the command name.
+ * Appends its output to reply, or the reason on an error.
+ * Returns 0 on success, -1 on an error.
+ */
+typedef int (*admin_cmd_fn)(int argc, char **argv, std::string *reply);
+
+/*Not thread safe, call before admin_socket_loop runs*/
+int admin_register_command(const char *name, admin_cmd_fn fn, const char *usage);
+
+/**
+ * Creates the listening socket. path is a filesystem path, or
+ * "@<name>" for an abstract socket. nullptr or "" listens on the
+ * abstract ADMIN_SOCKET_NAME_FMT % pid.
+ * Returns 0 on success, -1 on an error.
+ */
+int init_admin_socket(const char *path);
+
+/*The admin thread*/
+void *admin_socket_loop(void *arg);
+
+#endif //_ADMIN_SOCKET_HPP
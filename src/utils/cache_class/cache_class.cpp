@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "cache_class.hpp"
+
+struct cache_class cache_classes[MAX_CACHE_CLASSES];
+int nr_cache_classes = 1;
+
+/*sum of nr_resident over all classes*/
+static std::atomic<long> nr_resident_total(0);
+
+/*Cassandra table dirs are <table>-<uuid without dashes>*/
+#define TABLE_ID_LEN 32
+
+static bool is_table_dir(const char *comp, size_t len){
+        if(len <= TABLE_ID_LEN + 1 || comp[len - TABLE_ID_LEN - 1] != '-'){
+                return false;
+        }
+        for(size_t i = len - TABLE_ID_LEN; i < len; i++){
+                if(!isxdigit((unsigned char)comp[i])){
+                        return false;
+                }
+        }
+        return true;
+}
+
+/**
+ * Finds keyspace and table in a Cassandra data path:
+ *   <data_dir>/<ks>/<table>-<uuid>/nb-1-big-Data.db
+ *   <data_dir>/<ks>/<table>-<uuid>/.<index>/nb-1-big-Data.db
+ *   <data_dir>/<ks>/<table>-<uuid>/snapshots/<tag>/nb-1-big-Data.db
+ * Falls back to <ks>/<table>/<file> for table dirs without a uuid.
+ * Returns false if the path has too few components.
+ */
+static bool parse_ks_table(const char *path, const char **ks, size_t *ks_len,
+                const char **table, size_t *table_len){
+        const char *comp[64];
+        size_t comp_len[64];
+        int nr_comp = 0;
+        const char *p = path;
+        bool ret = false;
+
+        while(*p && nr_comp < 64){
+                const char *end;
+                while(*p == '/'){
+                        p++;
+                }
+                if(!*p){
+                        break;
+                }
+                end = strchr(p, '/');
+                if(!end){
+                        end = p + strlen(p);
+                }
+                comp[nr_comp] = p;
+                comp_len[nr_comp] = end - p;
+                nr_comp++;
+                p = end;
+        }
+
+        /*the last component is the file itself*/
+        for(int i = nr_comp - 2; i >= 1; i--){
+                if(is_table_dir(comp[i], comp_len[i])){
+                        *ks = comp[i - 1];
+                        *ks_len = comp_len[i - 1];
+                        *table = comp[i];
+                        *table_len = comp_len[i] - TABLE_ID_LEN - 1;
+                        ret = true;
+                        goto exit_parse_ks_table;
+                }
+        }
+
+        if(nr_comp >= 3){
+                *ks = comp[nr_comp - 3];
+                *ks_len = comp_len[nr_comp - 3];
+                *table = comp[nr_comp - 2];
+                *table_len = comp_len[nr_comp - 2];
+                ret = true;
+        }
+
+exit_parse_ks_table:
+        return ret;
+}
+
+int get_cache_class_id(const char *filename){
+        const char *ks, *table;
+        size_t ks_len, table_len, name_len;
+        int ks_class = DEFAULT_CACHE_CLASS;
+
+        if(nr_cache_classes <= 1 || !filename){
+                goto exit_default;
+        }
+
+        if(!parse_ks_table(filename, &ks, &ks_len, &table, &table_len)){
+                goto exit_default;
+        }
+
+        /*"ks.table" beats "ks"*/
+        for(int i = 1; i < nr_cache_classes; i++){
+                const char *name = cache_classes[i].name;
+                name_len = strlen(name);
+
+                if(name_len < ks_len || strncmp(name, ks, ks_len)){
+                        continue;
+                }
+                if(name_len == ks_len){
+                        ks_class = i;
+                }else if(name[ks_len] == '.' && name_len == ks_len + 1 + table_len
+                                && !strncmp(name + ks_len + 1, table, table_len)){
+                        return i;
+                }
+        }
+        return ks_class;
+
+exit_default:
+        return DEFAULT_CACHE_CLASS;
+}
+
+void cache_class_account(int cls, long delta){
+        cache_classes[cls].nr_resident.fetch_add(delta, std::memory_order_relaxed);
+        nr_resident_total.fetch_add(delta, std::memory_order_relaxed);
+}
+
+enum cache_class_tier get_cache_class_tier(int cls){
+        long total = nr_resident_total.load(std::memory_order_relaxed);
+        long mine = cache_classes[cls].nr_resident.load(std::memory_order_relaxed);
+
+        if(mine <= 0 || total <= 0){
+                return CACHE_CLASS_PROTECTED;
+        }
+        if(mine * 100 > cache_classes[cls].max_share * total){
+                return CACHE_CLASS_OVER_MAX;
+        }
+        if(mine * 100 > cache_classes[cls].min_share * total){
+                return CACHE_CLASS_WITHIN_SHARE;
+        }
+        return CACHE_CLASS_PROTECTED;
+}
+
+/*class 0 has no name till init_cache_classes runs*/
+const char *get_cache_class_name(int cls){
+        if(cls == DEFAULT_CACHE_CLASS && !cache_classes[cls].name[0]){
+                return "default";
+        }
+        return cache_classes[cls].name;
+}
+
+/*"name:min:max" -> cls. Returns false if malformed*/
+static bool parse_cache_class_spec(const char *spec, struct cache_class *cls){
+        const char *colon = strchr(spec, ':');
+        char *end;
+        long min_share, max_share;
+        size_t name_len;
+
+        if(!colon){
+                return false;
+        }
+        name_len = colon - spec;
+        if(name_len == 0 || name_len >= CACHE_CLASS_NAME_LEN || memchr(spec, '/', name_len)){
+                return false;
+        }
+
+        min_share = strtol(colon + 1, &end, 10);
+        if(end == colon + 1 || *end != ':'){
+                return false;
+        }
+        max_share = strtol(end + 1, &end, 10);
+        if(*end != '\0' || min_share < 0 || min_share > max_share || max_share > 100){
+                return false;
+        }
+
+        memcpy(cls->name, spec, name_len);
+        cls->name[name_len] = '\0';
+        cls->min_share = min_share;
+        cls->max_share = max_share;
+        return true;
+}
+
+int init_cache_classes(char *const *specs, size_t nr_specs){
+        struct cache_class parsed;
+        int ret = 0;
+        int sum_min_share = 0;
+
+        strcpy(cache_classes[DEFAULT_CACHE_CLASS].name, "default");
+        cache_classes[DEFAULT_CACHE_CLASS].min_share = 0;
+        cache_classes[DEFAULT_CACHE_CLASS].max_share = 100;
+        nr_cache_classes = 1;
+
+        for(size_t i = 0; i < nr_specs; i++){
+                int cls;
+
+                if(!parse_cache_class_spec(specs[i], &parsed)){
+                        SPEEDYIO_FPRINTF("%s:ERROR malformed cache_class '%s'\n", "SPEEDYIO_ERRCO_0223 %s\n", specs[i]);
+                        ret = -1;
+                        goto exit_init_cache_classes;
+                }
+
+                if(!strcmp(parsed.name, "default")){
+                        cls = DEFAULT_CACHE_CLASS;
+                }else if(nr_cache_classes < MAX_CACHE_CLASSES){
+                        cls = nr_cache_classes++;
+                }else{
+                        SPEEDYIO_FPRINTF("%s:ERROR more than %d cache classes\n", "SPEEDYIO_ERRCO_0224 %d\n", MAX_CACHE_CLASSES);
+                        ret = -1;
+                        goto exit_init_cache_classes;
+                }
+
+                strcpy(cache_classes[cls].name, parsed.name);
+                cache_classes[cls].min_share = parsed.min_share;
+                cache_classes[cls].max_share = parsed.max_share;
+        }
+
+        for(int i = 0; i < nr_cache_classes; i++){
+                sum_min_share += cache_classes[i].min_share;
+        }
+        if(sum_min_share > 100){
+                SPEEDYIO_FPRINTF("%s:ERROR cache_class min shares add upto %d%%\n", "SPEEDYIO_ERRCO_0225 %d\n", sum_min_share);
+                ret = -1;
+        }
+
+exit_init_cache_classes:
+        return ret;
+}
@@ -0,0 +1,71 @@
+#ifndef _CACHE_CLASS_HPP
+#define _CACHE_CLASS_HPP
+
+#include <stddef.h>
+
+#include <atomic>
+
+#include "utils/util.hpp"
+
+/**
+ * Cache classes partition the page cache managed by SpeedyIO between
+ * Cassandra keyspaces/tables.
+ *
+ * Each whitelisted file is put in a class when its uinode is populated,
+ * from its data path <data_dir>/<ks>/<table>-<uuid>/... . Tables without
+ * a configured class go to class 0 ("default").
+ *
+ * Each class has a min and max share (percent) of the portions resident
+ * in the page cache across all classes. The evictor takes victims from
+ * classes over their max share first, then from classes over their min
+ * share, and only touches classes under their min share when nothing
+ * else is left. Within a tier victims are chosen in plain LRU order.
+ */
+
+#define DEFAULT_CACHE_CLASS 0
+
+enum cache_class_tier {
+        CACHE_CLASS_PROTECTED = 0,      /*at or under its min share*/
+        CACHE_CLASS_WITHIN_SHARE,       /*between its min and max share*/
+        CACHE_CLASS_OVER_MAX,           /*over its max share, evicted first*/
+};
+
+struct alignas(CACHELINE_SIZE) cache_class {
+        char name[CACHE_CLASS_NAME_LEN];        /*"default", "ks" or "ks.table"*/
+        int min_share;
+        int max_share;
+
+        /*portions of this class's files resident in the page cache*/
+        std::atomic<long> nr_resident;
+
+        /*
+         * constexpr so that cache_classes[] is initialized statically, before
+         * init_cache_classes runs from SpeedyIO's constructor.
+         */
+        constexpr cache_class() : name{}, min_share(0), max_share(100), nr_resident(0) {}
+};
+
+extern struct cache_class cache_classes[MAX_CACHE_CLASSES];
+extern int nr_cache_classes;
+
+/**
+ * Parses the cache_class config entries, "<ks>[.<table>]:<min%>:<max%>".
+ * "default" sets the shares of class 0.
+ * Returns 0 on success, -1 if an entry is malformed.
+ */
+int init_cache_classes(char *const *specs, size_t nr_specs);
+
+/*Returns the class id for a canonical whitelisted filename*/
+int get_cache_class_id(const char *filename);
+
+/**
+ * Adds delta resident portions to class cls.
+ * Called when a pvt heap portion is read in or evicted.
+ */
+void cache_class_account(int cls, long delta);
+
+enum cache_class_tier get_cache_class_tier(int cls);
+
+const char *get_cache_class_name(int cls);
+
+#endif //_CACHE_CLASS_HPP
@@ -0,0 +1,79 @@
+#include "catch_amalgamated.hpp"
+
+#include <string>
+
+#include "utils/cache_class/cache_class.hpp"
+
+#define DATA_PATH(ks, tbl) "/data/" ks "/" tbl "-0123456789abcdef0123456789abcdef/nb-1-big-Data.db"
+
+static char *specs[] = {
+        (char *)"ks1:0:50",
+        (char *)"ks1.hot:30:100",
+        (char *)"default:0:40",
+};
+
+TEST_CASE("Everything is default without classes", "[cache_class][default]"){
+        REQUIRE(init_cache_classes(nullptr, 0) == 0);
+        REQUIRE(nr_cache_classes == 1);
+
+        CHECK(get_cache_class_id(DATA_PATH("ks1", "tbl")) == DEFAULT_CACHE_CLASS);
+        CHECK(get_cache_class_id("Data.db") == DEFAULT_CACHE_CLASS);
+        CHECK(std::string(get_cache_class_name(DEFAULT_CACHE_CLASS)) == "default");
+}
+
+TEST_CASE("Malformed classes are rejected", "[cache_class][malformed]"){
+        char *min_over_max[] = {(char *)"a:60:50"};
+        char *no_shares[] = {(char *)"a"};
+        char *too_much[] = {(char *)"a:60:100", (char *)"b:50:100"};
+
+        CHECK(init_cache_classes(min_over_max, 1) == -1);
+        CHECK(init_cache_classes(no_shares, 1) == -1);
+
+        /*the min shares add upto more than 100%*/
+        CHECK(init_cache_classes(too_much, 2) == -1);
+}
+
+TEST_CASE("Files go to the class of their table or keyspace", "[cache_class][classify]"){
+        REQUIRE(init_cache_classes(specs, 3) == 0);
+        REQUIRE(nr_cache_classes == 3);
+
+        CHECK(get_cache_class_id(DATA_PATH("ks1", "tbl")) == 1);
+        CHECK(get_cache_class_id(DATA_PATH("ks1", "hot")) == 2);
+        CHECK(get_cache_class_id("/data/ks1/hot/nb-1-big-Data.db") == 2);
+
+        /*secondary indexes and snapshots stay with their table*/
+        CHECK(get_cache_class_id("/data/ks1/hot-0123456789abcdef0123456789abcdef/.hot_idx/nb-1-big-Data.db") == 2);
+        CHECK(get_cache_class_id("/data/ks1/hot-0123456789abcdef0123456789abcdef/snapshots/t1/nb-1-big-Data.db") == 2);
+
+        CHECK(get_cache_class_id(DATA_PATH("ks1", "hotter")) == 1);
+        CHECK(get_cache_class_id(DATA_PATH("ks2", "hot")) == DEFAULT_CACHE_CLASS);
+        CHECK(get_cache_class_id("Data.db") == DEFAULT_CACHE_CLASS);
+
+        /*"default" sets the shares of class 0*/
+        CHECK(cache_classes[DEFAULT_CACHE_CLASS].max_share == 40);
+        CHECK(std::string(get_cache_class_name(2)) == "ks1.hot");
+}
+
+TEST_CASE("Tier from the resident share", "[cache_class][tiers]"){
+        REQUIRE(init_cache_classes(specs, 3) == 0);
+
+        /*60 of 100 resident portions in default, over its 40% max*/
+        cache_class_account(DEFAULT_CACHE_CLASS, 60);
+        cache_class_account(1, 25);
+        cache_class_account(2, 15);
+
+        CHECK(get_cache_class_tier(DEFAULT_CACHE_CLASS) == CACHE_CLASS_OVER_MAX);
+        CHECK(get_cache_class_tier(1) == CACHE_CLASS_WITHIN_SHARE);
+        CHECK(get_cache_class_tier(2) == CACHE_CLASS_PROTECTED);
+
+        /*ks1.hot's portions evicted, ks1 at 45 of 105*/
+        cache_class_account(2, -15);
+        cache_class_account(1, 20);
+        CHECK(get_cache_class_tier(1) == CACHE_CLASS_WITHIN_SHARE);
+        /*and at all of them once default's are evicted*/
+        cache_class_account(DEFAULT_CACHE_CLASS, -60);
+        CHECK(get_cache_class_tier(1) == CACHE_CLASS_OVER_MAX);
+        CHECK(get_cache_class_tier(DEFAULT_CACHE_CLASS) == CACHE_CLASS_PROTECTED);
+
+        cache_class_account(1, -45);
+}
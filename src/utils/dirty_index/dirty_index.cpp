@@ -0,0 +1,68 @@
+#include "dirty_index.hpp"
+
+#define WRITEBACK_NS (DIRTY_WRITEBACK_MS * 1000000ULL)
+#define EXPIRE_NS (DIRTY_EXPIRE_MS * 1000000ULL)
+
+void dirty_mark(struct dirty_index *idx, off_t first, off_t last, uint64_t now_ns){
+        idx->seq++;
+        for(off_t p = first; p <= last; p++){
+                idx->portions[p] = {idx->seq, now_ns, 0};
+        }
+}
+
+unsigned long long int dirty_sync_begin(struct dirty_index *idx){
+        return idx->seq;
+}
+
+void dirty_sync_done(struct dirty_index *idx, unsigned long long int seq){
+        std::map<off_t, struct dirty_portion>::iterator it = idx->portions.begin();
+
+        while(it != idx->portions.end()){
+                if(it->second.seq <= seq){
+                        it = idx->portions.erase(it);
+                }else{
+                        ++it;
+                }
+        }
+}
+
+enum dirty_phase dirty_evict_phase(struct dirty_index *idx, off_t first, off_t last, uint64_t now_ns){
+        std::map<off_t, struct dirty_portion>::iterator it, end;
+        enum dirty_phase phase = DIRTY_CLEAN;
+
+        it = idx->portions.lower_bound(first);
+        end = idx->portions.upper_bound(last);
+        while(it != end){
+                struct dirty_portion *d = &it->second;
+
+                if(now_ns - d->dirty_ns > EXPIRE_NS){
+                        it = idx->portions.erase(it);
+                        continue;
+                }
+                if(d->writeback_ns == 0){
+                        phase = DIRTY_START_WRITEBACK;
+                }else if(now_ns - d->writeback_ns < WRITEBACK_NS){
+                        if(phase != DIRTY_START_WRITEBACK){
+                                phase = DIRTY_IN_WRITEBACK;
+                        }
+                }else if(phase == DIRTY_CLEAN){
+                        phase = DIRTY_WRITTEN_BACK;
+                }
+                ++it;
+        }
+
+        switch(phase){
+        case DIRTY_START_WRITEBACK:
+                /*one writeback for the whole range, the portions already under it included*/
+                for(it = idx->portions.lower_bound(first); it != end; ++it){
+                        it->second.writeback_ns = now_ns;
+                }
+                break;
+        case DIRTY_WRITTEN_BACK:
+                idx->portions.erase(idx->portions.lower_bound(first), end);
+                break;
+        default:
+                break;
+        }
+        return phase;
+}
@@ -0,0 +1,95 @@
+#ifndef _DIRTY_INDEX_HPP
+#define _DIRTY_INDEX_HPP
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <map>
+
+#ifdef ENABLE_SLAB_ALLOC
+#include "../slab/slab.hpp"
+#endif //ENABLE_SLAB_ALLOC
+
+/**
+ * Portions of a file written through SpeedyIO and not synced since.
+ *
+ * DONTNEED skips dirty pages and pages under writeback, so evicting a
+ * freshly written range (a flush or a compaction output) frees nothing.
+ * The evictor does such ranges in two phases instead:
+ * 1. it starts writeback of the range (SYNC_FILE_RANGE_WRITE, does not
+ *    wait) and puts the range back in the LRU.
+ * 2. when the range is the victim again, at least DIRTY_WRITEBACK_MS
+ *    later, it waits for whatever writeback is left and DONTNEEDs it.
+ *
+ * fsync/fdatasync clean the portions written before they started. A
+ * portion dirty for longer than DIRTY_EXPIRE_MS has been written back by
+ * the kernel's flushers (vm.dirty_expire_centisecs) and is forgotten.
+ *
+ * Not thread safe; the uinode's file_heap_lock protects it.
+ */
+
+/*least time between starting writeback of a range and dropping it*/
+#ifndef DIRTY_WRITEBACK_MS
+#define DIRTY_WRITEBACK_MS 100
+#endif
+
+/*most victims one evict_portions call puts back for being under writeback*/
+#ifndef DIRTY_MAX_DEFERRED
+#define DIRTY_MAX_DEFERRED 8
+#endif
+
+/*kernel default of vm.dirty_expire_centisecs*/
+#ifndef DIRTY_EXPIRE_MS
+#define DIRTY_EXPIRE_MS 30000
+#endif
+
+struct dirty_portion {
+        unsigned long long int seq;     /*write that last dirtied it*/
+        uint64_t dirty_ns;              /*CLOCK_MONOTONIC of that write*/
+        uint64_t writeback_ns;          /*when the evictor started writeback, 0 if it did not*/
+};
+
+struct dirty_index {
+        std::map<off_t, struct dirty_portion> portions;
+        unsigned long long int seq;     /*of the last write*/
+
+        dirty_index() : seq(0) {}
+
+#ifdef ENABLE_SLAB_ALLOC
+        /*one per file read, allocated with its pvt heap*/
+        static void *operator new(size_t sz){
+                void *p = slab_alloc(&slab_type<struct dirty_index>::cache);
+                if(!p){
+                        throw std::bad_alloc();
+                }
+                return p;
+        }
+
+        static void operator delete(void *p){
+                slab_free(&slab_type<struct dirty_index>::cache, p);
+        }
+#endif //ENABLE_SLAB_ALLOC
+};
+
+enum dirty_phase {
+        DIRTY_CLEAN,                    /*nothing dirty in the range, DONTNEED it*/
+        DIRTY_START_WRITEBACK,          /*start writeback of the range, evict it later*/
+        DIRTY_IN_WRITEBACK,             /*writeback started less than DIRTY_WRITEBACK_MS ago*/
+        DIRTY_WRITTEN_BACK,             /*wait for writeback of the range, then DONTNEED it*/
+};
+
+/*Portions first to last were written at now_ns*/
+void dirty_mark(struct dirty_index *idx, off_t first, off_t last, uint64_t now_ns);
+
+/*Called before fsync/fdatasync; pass the result to dirty_sync_done once it succeeds*/
+unsigned long long int dirty_sync_begin(struct dirty_index *idx);
+void dirty_sync_done(struct dirty_index *idx, unsigned long long int seq);
+
+/**
+ * Which phase the eviction of portions first to last is in. Marks the
+ * dirty portions as under writeback with DIRTY_START_WRITEBACK, and
+ * forgets the range with DIRTY_WRITTEN_BACK.
+ */
+enum dirty_phase dirty_evict_phase(struct dirty_index *idx, off_t first, off_t last, uint64_t now_ns);
+
+#endif //_DIRTY_INDEX_HPP
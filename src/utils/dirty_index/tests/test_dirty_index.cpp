@@ -0,0 +1,61 @@
+#include "catch_amalgamated.hpp"
+
+#include "utils/dirty_index/dirty_index.hpp"
+
+#define MS 1000000ULL
+
+TEST_CASE("A written range goes through both phases before it is dropped", "[dirty_index][phases]"){
+        struct dirty_index idx;
+        uint64_t now = 1000 * MS;
+
+        REQUIRE(dirty_evict_phase(&idx, 0, 15, now) == DIRTY_CLEAN);
+
+        dirty_mark(&idx, 4, 5, now);
+        CHECK(dirty_evict_phase(&idx, 0, 3, now) == DIRTY_CLEAN);
+        CHECK(dirty_evict_phase(&idx, 0, 15, now) == DIRTY_START_WRITEBACK);
+        CHECK(dirty_evict_phase(&idx, 0, 15, now + 1 * MS) == DIRTY_IN_WRITEBACK);
+        CHECK(dirty_evict_phase(&idx, 0, 15, now + DIRTY_WRITEBACK_MS * MS) == DIRTY_WRITTEN_BACK);
+
+        /*forgotten once written back*/
+        CHECK(idx.portions.empty());
+        CHECK(dirty_evict_phase(&idx, 0, 15, now + DIRTY_WRITEBACK_MS * MS) == DIRTY_CLEAN);
+}
+
+TEST_CASE("A write during writeback restarts it", "[dirty_index][rewrite]"){
+        struct dirty_index idx;
+        uint64_t now = 1000 * MS;
+
+        dirty_mark(&idx, 0, 0, now);
+        dirty_mark(&idx, 1, 1, now);
+        REQUIRE(dirty_evict_phase(&idx, 0, 1, now) == DIRTY_START_WRITEBACK);
+
+        dirty_mark(&idx, 1, 1, now + 50 * MS);
+        CHECK(dirty_evict_phase(&idx, 0, 1, now + 200 * MS) == DIRTY_START_WRITEBACK);
+
+        /*the whole range waits again*/
+        CHECK(dirty_evict_phase(&idx, 0, 1, now + 250 * MS) == DIRTY_IN_WRITEBACK);
+        CHECK(dirty_evict_phase(&idx, 0, 1, now + 400 * MS) == DIRTY_WRITTEN_BACK);
+}
+
+TEST_CASE("fsync cleans what was written before it began", "[dirty_index][sync]"){
+        struct dirty_index idx;
+        unsigned long long int seq;
+        uint64_t now = 1000 * MS;
+
+        dirty_mark(&idx, 0, 7, now);
+        seq = dirty_sync_begin(&idx);
+        dirty_mark(&idx, 8, 9, now);
+        dirty_sync_done(&idx, seq);
+
+        CHECK(dirty_evict_phase(&idx, 0, 7, now) == DIRTY_CLEAN);
+        CHECK(dirty_evict_phase(&idx, 8, 9, now) == DIRTY_START_WRITEBACK);
+}
+
+TEST_CASE("The kernel flushes old dirty pages on its own", "[dirty_index][expire]"){
+        struct dirty_index idx;
+        uint64_t now = 1000 * MS;
+
+        dirty_mark(&idx, 0, 3, now);
+        CHECK(dirty_evict_phase(&idx, 0, 3, now + (DIRTY_EXPIRE_MS + 1) * MS) == DIRTY_CLEAN);
+        CHECK(idx.portions.empty());
+}
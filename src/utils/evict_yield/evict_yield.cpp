@@ -0,0 +1,154 @@
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "evict_yield.hpp"
+#include "utils/util.hpp"
+
+#ifndef SYS_cachestat
+#define SYS_cachestat 451
+#endif
+
+/*uapi linux/mman.h, not in older headers*/
+struct yield_cachestat_range {
+        uint64_t off;
+        uint64_t len;
+};
+
+struct yield_cachestat {
+        uint64_t nr_cache;
+        uint64_t nr_dirty;
+        uint64_t nr_writeback;
+        uint64_t nr_evicted;
+        uint64_t nr_recently_evicted;
+};
+
+struct yield_file {
+        unsigned int nr_poor;           /*poor evictions in a row*/
+        unsigned int nr_skips;          /*times passed over since the last try*/
+};
+
+static std::mutex yield_lock;
+static std::map<std::pair<dev_t, ino_t>, struct yield_file> yield_files;
+static std::atomic<unsigned long> nr_files(0);        /*yield_files.size(), read without the lock*/
+static std::atomic<unsigned long> nr_poor_files(0);
+
+/*set once the kernel turns out not to have cachestat*/
+static std::atomic<bool> no_cachestat(false);
+
+static std::atomic<unsigned long> nr_targeted(0);
+static std::atomic<unsigned long> nr_cached(0);
+static std::atomic<unsigned long> nr_freed(0);
+static std::atomic<unsigned long> nr_skipped(0);
+
+bool yield_measure(int fd, off_t offset, size_t size, long *cached, long *clean){
+        struct yield_cachestat_range range = {(uint64_t)offset, (uint64_t)size};
+        struct yield_cachestat cs;
+
+        if(no_cachestat.load(std::memory_order_relaxed)){
+                return false;
+        }
+        if(syscall(SYS_cachestat, fd, &range, &cs, 0) != 0){
+                if((errno == ENOSYS || errno == EPERM) && !no_cachestat.exchange(true)){
+                        SPEEDYIO_PRINTF("%s:INFO cachestat unavailable (errno %d), not measuring eviction yield\n", "SPEEDYIO_INFOCO_0031 %d\n", errno);
+                }
+                return false;
+        }
+        *cached = (long)cs.nr_cache;
+        /*dirty and writeback pages are counted in nr_cache too*/
+        *clean = (long)(cs.nr_cache - std::min(cs.nr_cache, cs.nr_dirty + cs.nr_writeback));
+        return true;
+}
+
+void yield_record(dev_t dev, ino_t ino, long nr_pages, long nr_cached_pages, long nr_dropped){
+        bool poor = nr_dropped * 100 < EVICT_YIELD_POOR_PCT * nr_cached_pages || nr_cached_pages == 0;
+        std::map<std::pair<dev_t, ino_t>, struct yield_file>::iterator it;
+
+        nr_targeted.fetch_add(nr_pages, std::memory_order_relaxed);
+        nr_cached.fetch_add(nr_cached_pages, std::memory_order_relaxed);
+        nr_freed.fetch_add(nr_dropped, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> guard(yield_lock);
+
+        it = yield_files.find(std::make_pair(dev, ino));
+        if(!poor){
+                if(it != yield_files.end()){
+                        if(it->second.nr_poor >= EVICT_YIELD_POOR_STREAK){
+                                nr_poor_files.fetch_sub(1, std::memory_order_relaxed);
+                        }
+                        yield_files.erase(it);
+                        nr_files.store(yield_files.size(), std::memory_order_relaxed);
+                }
+                return;
+        }
+
+        if(it == yield_files.end()){
+                if(yield_files.size() >= EVICT_YIELD_MAX_FILES){
+                        return;
+                }
+                it = yield_files.insert(std::make_pair(std::make_pair(dev, ino), yield_file())).first;
+                nr_files.store(yield_files.size(), std::memory_order_relaxed);
+        }
+        it->second.nr_poor += 1;
+        if(it->second.nr_poor == EVICT_YIELD_POOR_STREAK){
+                nr_poor_files.fetch_add(1, std::memory_order_relaxed);
+        }
+}
+
+bool yield_skip_victim(dev_t dev, ino_t ino){
+        std::map<std::pair<dev_t, ino_t>, struct yield_file>::iterator it;
+
+        /*the common case, every file yields*/
+        if(nr_poor_files.load(std::memory_order_relaxed) == 0){
+                return false;
+        }
+
+        std::lock_guard<std::mutex> guard(yield_lock);
+
+        it = yield_files.find(std::make_pair(dev, ino));
+        if(it == yield_files.end() || it->second.nr_poor < EVICT_YIELD_POOR_STREAK){
+                return false;
+        }
+        if(it->second.nr_skips >= EVICT_YIELD_RETRY_SKIPS){
+                /*try it again; still poor and it is passed over again*/
+                it->second.nr_skips = 0;
+                return false;
+        }
+        it->second.nr_skips += 1;
+        nr_skipped.fetch_add(1, std::memory_order_relaxed);
+        return true;
+}
+
+void yield_forget(dev_t dev, ino_t ino){
+        std::map<std::pair<dev_t, ino_t>, struct yield_file>::iterator it;
+
+        if(nr_files.load(std::memory_order_relaxed) == 0){
+                return;
+        }
+
+        std::lock_guard<std::mutex> guard(yield_lock);
+
+        it = yield_files.find(std::make_pair(dev, ino));
+        if(it == yield_files.end()){
+                return;
+        }
+        if(it->second.nr_poor >= EVICT_YIELD_POOR_STREAK){
+                nr_poor_files.fetch_sub(1, std::memory_order_relaxed);
+        }
+        yield_files.erase(it);
+        nr_files.store(yield_files.size(), std::memory_order_relaxed);
+}
+
+void get_evict_yield_stats(struct evict_yield_stats *stats){
+        stats->nr_targeted = nr_targeted.load(std::memory_order_relaxed);
+        stats->nr_cached = nr_cached.load(std::memory_order_relaxed);
+        stats->nr_freed = nr_freed.load(std::memory_order_relaxed);
+        stats->nr_poor_files = nr_poor_files.load(std::memory_order_relaxed);
+        stats->nr_skipped = nr_skipped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,75 @@
+#ifndef _EVICT_YIELD_HPP
+#define _EVICT_YIELD_HPP
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * How much page cache each eviction actually frees.
+ *
+ * A DONTNEED that frees nothing still costs the evictor a victim pick
+ * and a syscall, and leaves the deficit where it was: the pages are
+ * dirty or under writeback, mapped by another process, or the kernel
+ * dropped them already. The evictor takes one cachestat(2) of the range
+ * just before the DONTNEED; its clean cached pages are the ones the
+ * DONTNEED drops, and what the eviction reports as freed. Pages mapped
+ * by another process are counted as dropped though they stay.
+ *
+ * An eviction is poor if it freed less than EVICT_YIELD_POOR_PCT of the
+ * pages that were cached (or nothing was cached). After
+ * EVICT_YIELD_POOR_STREAK poor evictions in a row a file is passed over
+ * as the victim, upto EVICT_YIELD_RETRY_SKIPS times, then it gets
+ * another try. One good eviction clears its record.
+ *
+ * Kernels without cachestat (before 6.5) measure nothing and skip nothing.
+ */
+
+#ifndef EVICT_YIELD_POOR_PCT
+#define EVICT_YIELD_POOR_PCT 10
+#endif
+
+#ifndef EVICT_YIELD_POOR_STREAK
+#define EVICT_YIELD_POOR_STREAK 3
+#endif
+
+#ifndef EVICT_YIELD_RETRY_SKIPS
+#define EVICT_YIELD_RETRY_SKIPS 8
+#endif
+
+/*most files passed over in one victim pick*/
+#ifndef EVICT_YIELD_MAX_PASSES
+#define EVICT_YIELD_MAX_PASSES 4
+#endif
+
+/*most files with a record; evictions of other files are counted but not recorded*/
+#ifndef EVICT_YIELD_MAX_FILES
+#define EVICT_YIELD_MAX_FILES 4096
+#endif
+
+/**
+ * Pages of fd from offset to offset+size in the page cache, and of
+ * those the ones neither dirty nor under writeback.
+ * Returns false if it could not be measured.
+ */
+bool yield_measure(int fd, off_t offset, size_t size, long *nr_cached, long *nr_clean);
+
+/*An eviction of nr_pages of the file found nr_cached of them cached and dropped nr_dropped*/
+void yield_record(dev_t dev, ino_t ino, long nr_pages, long nr_cached, long nr_dropped);
+
+/*true if the evictor should pass over the file this time*/
+bool yield_skip_victim(dev_t dev, ino_t ino);
+
+/*The file is gone, drop its record*/
+void yield_forget(dev_t dev, ino_t ino);
+
+struct evict_yield_stats {
+        unsigned long nr_targeted;      /*pages of the evicted ranges*/
+        unsigned long nr_cached;        /*of those, cached before the DONTNEED*/
+        unsigned long nr_freed;         /*of those, clean and so dropped by it*/
+        unsigned long nr_poor_files;    /*files passed over right now*/
+        unsigned long nr_skipped;       /*times a file was passed over*/
+};
+
+void get_evict_yield_stats(struct evict_yield_stats *stats);
+
+#endif //_EVICT_YIELD_HPP
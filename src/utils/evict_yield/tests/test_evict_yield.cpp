@@ -0,0 +1,112 @@
+#include "catch_amalgamated.hpp"
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "utils/evict_yield/evict_yield.hpp"
+
+/*the records are process wide, each test case uses its own inodes*/
+
+/*512 pages cached, 12 of them clean*/
+static void poor_evictions(dev_t dev, ino_t ino, int n){
+        for(int i = 0; i < n; i++){
+                yield_record(dev, ino, 512, 512, 12);
+        }
+}
+
+static unsigned long nr_poor_files(){
+        struct evict_yield_stats stats;
+
+        get_evict_yield_stats(&stats);
+        return stats.nr_poor_files;
+}
+
+TEST_CASE("A file is passed over only after a streak of poor evictions", "[evict_yield][streak]"){
+        poor_evictions(1, 10, EVICT_YIELD_POOR_STREAK - 1);
+        REQUIRE_FALSE(yield_skip_victim(1, 10));
+
+        poor_evictions(1, 10, 1);
+        REQUIRE(yield_skip_victim(1, 10));
+        CHECK_FALSE(yield_skip_victim(1, 11));
+        CHECK_FALSE(yield_skip_victim(2, 10));
+        CHECK(nr_poor_files() == 1);
+
+        yield_forget(1, 10);
+        CHECK(nr_poor_files() == 0);
+        CHECK_FALSE(yield_skip_victim(1, 10));
+}
+
+TEST_CASE("A poor file gets another try every EVICT_YIELD_RETRY_SKIPS picks", "[evict_yield][retry]"){
+        int nr_skips = 0;
+
+        poor_evictions(1, 20, EVICT_YIELD_POOR_STREAK);
+        while(yield_skip_victim(1, 20)){
+                nr_skips++;
+        }
+        CHECK(nr_skips == EVICT_YIELD_RETRY_SKIPS);
+
+        /*still poor, passed over again*/
+        CHECK(yield_skip_victim(1, 20));
+
+        /*the retry dropped what was cached*/
+        yield_record(1, 20, 512, 100, 100);
+        CHECK_FALSE(yield_skip_victim(1, 20));
+        CHECK(nr_poor_files() == 0);
+}
+
+TEST_CASE("Nothing cached is poor, dropping what little was cached is not", "[evict_yield][poor]"){
+        poor_evictions(1, 30, EVICT_YIELD_POOR_STREAK - 1);
+        yield_record(1, 30, 512, 4, 4);
+        yield_record(1, 30, 512, 0, 0);
+        CHECK_FALSE(yield_skip_victim(1, 30));
+        yield_forget(1, 30);
+
+        for(int i = 0; i < EVICT_YIELD_POOR_STREAK; i++){
+                yield_record(1, 31, 512, 0, 0);
+        }
+        CHECK(yield_skip_victim(1, 31));
+        yield_forget(1, 31);
+}
+
+TEST_CASE("The stats add up the recorded evictions", "[evict_yield][stats]"){
+        struct evict_yield_stats before, after;
+
+        get_evict_yield_stats(&before);
+        yield_record(1, 40, 512, 300, 200);
+        yield_forget(1, 40);
+        get_evict_yield_stats(&after);
+
+        CHECK(after.nr_targeted - before.nr_targeted == 512);
+        CHECK(after.nr_cached - before.nr_cached == 300);
+        CHECK(after.nr_freed - before.nr_freed == 200);
+}
+
+TEST_CASE("cachestat of a file just written", "[evict_yield][measure]"){
+        char path[] = "/tmp/test_evict_yield.XXXXXX";
+        char buf[4096] = {0};
+        long cached = -1, clean = -1;
+        int fd = mkstemp(path);
+
+        REQUIRE(fd >= 0);
+        unlink(path);
+        for(int i = 0; i < 16; i++){
+                REQUIRE(write(fd, buf, sizeof(buf)) == sizeof(buf));
+        }
+
+        if(!yield_measure(fd, 0, 16 * 4096, &cached, &clean)){
+                WARN("no cachestat (kernel before 6.5), not measured");
+                close(fd);
+                return;
+        }
+        CHECK(cached == 16);
+        CHECK(clean >= 0);
+        CHECK(clean <= cached);
+
+        /*written back, every cached page is clean*/
+        REQUIRE(fdatasync(fd) == 0);
+        REQUIRE(yield_measure(fd, 8 * 4096, 4 * 4096, &cached, &clean));
+        CHECK(cached == 4);
+        CHECK(clean == 4);
+        close(fd);
+}
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <iterator>
+
+#include "extent_index.hpp"
+#include "../util.hpp"
+
+/*
+ * Puts [first, last] in the index with key. Nothing in the index
+ * overlaps it. reuse_id, if not -1, is the heap item of an extent the
+ * range covered; it is given to the new extent instead of a new item.
+ */
+static long add_extent(struct extent_index *idx, struct Heap *heap, off_t first, off_t last,
+                unsigned long long int key, int reuse_id){
+        std::map<off_t, struct extent>::iterator stream;
+        int id;
+
+        /*sequential stream, extend the extent touched last*/
+        if(idx->stream_first >= 0 && last - idx->stream_first < EXTENT_MAX_PORTIONS){
+                stream = idx->extents.find(idx->stream_first);
+                if(stream != idx->extents.end() && stream->second.last == first - 1){
+                        stream->second.last = last;
+                        heap_update_key(heap, stream->second.id, key);
+                        if(reuse_id >= 0){
+                                heap_delete_key_by_id(heap, reuse_id);
+                        }
+                        return 0;
+                }
+        }
+
+        if(reuse_id >= 0){
+                id = reuse_id;
+                heap_update_data(heap, id, first);
+                heap_update_key(heap, id, key);
+        }else{
+                id = heap_insert_data(heap, key, first);
+                if(unlikely(id < 0)){
+                        return -1;
+                }
+        }
+        idx->extents[first] = {last, id};
+        idx->stream_first = first;
+        return 0;
+}
+
+/*extent_touch for a range of upto EXTENT_MAX_PORTIONS portions*/
+static long touch_range(struct extent_index *idx, struct Heap *heap, off_t first, off_t last,
+                unsigned long long int key){
+        std::map<off_t, struct extent>::iterator it;
+        struct extent e;
+        off_t e_first;
+        long newly = last - first + 1;
+        int reuse_id = -1;
+        int id;
+
+        /*the first extent ending at or after first*/
+        it = idx->extents.upper_bound(first);
+        if(it != idx->extents.begin() && std::prev(it)->second.last >= first){
+                --it;
+        }
+
+        while(it != idx->extents.end() && it->first <= last){
+                e_first = it->first;
+                e = it->second;
+                newly -= std::min(e.last, last) - std::max(e_first, first) + 1;
+                it = idx->extents.erase(it);
+
+                if(e_first < first){
+                        /*left piece keeps the item*/
+                        idx->extents[e_first] = {first - 1, e.id};
+                        if(e.last > last){
+                                id = heap_insert_data(heap, heap_get_key_by_id(heap, e.id), last + 1);
+                                if(unlikely(id < 0)){
+                                        return -1;
+                                }
+                                idx->extents[last + 1] = {e.last, id};
+                        }
+                }else if(e.last > last){
+                        /*right piece keeps the item*/
+                        heap_update_data(heap, e.id, last + 1);
+                        idx->extents[last + 1] = {e.last, e.id};
+                        if(idx->stream_first == e_first){
+                                idx->stream_first = last + 1;
+                        }
+                }else if(reuse_id < 0){
+                        reuse_id = e.id;
+                }else{
+                        heap_delete_key_by_id(heap, e.id);
+                }
+        }
+
+        if(add_extent(idx, heap, first, last, key, reuse_id) < 0){
+                return -1;
+        }
+        idx->nr_portions += newly;
+        return newly;
+}
+
+long extent_touch(struct extent_index *idx, struct Heap *heap, off_t first, off_t last, unsigned long long int key){
+        long newly = 0, ret;
+        off_t end;
+
+        if(unlikely(!idx || !heap || first < 0 || last < first)){
+                SPEEDYIO_FPRINTF("%s:ERROR invalid extent [%ld, %ld]\n", "SPEEDYIO_ERRCO_0253 %ld %ld\n", first, last);
+                return -1;
+        }
+
+        for(; first <= last; first = end + 1){
+                end = std::min(last, first + EXTENT_MAX_PORTIONS - 1);
+                ret = touch_range(idx, heap, first, end, key);
+                if(unlikely(ret < 0)){
+                        return -1;
+                }
+                newly += ret;
+        }
+        return newly;
+}
+
+long extent_remove(struct extent_index *idx, struct Heap *heap, off_t first){
+        std::map<off_t, struct extent>::iterator it;
+        long nr;
+
+        it = idx->extents.find(first);
+        if(unlikely(it == idx->extents.end())){
+                return 0;
+        }
+        nr = it->second.last - first + 1;
+        heap_delete_key_by_id(heap, it->second.id);
+        idx->extents.erase(it);
+
+        if(idx->stream_first == first){
+                idx->stream_first = -1;
+        }
+        idx->nr_portions -= nr;
+        return nr;
+}
+
+long extent_nr_portions(struct extent_index *idx, off_t first){
+        std::map<off_t, struct extent>::iterator it;
+
+        it = idx->extents.find(first);
+        if(it == idx->extents.end()){
+                return 0;
+        }
+        return it->second.last - first + 1;
+}
+
+void extent_clear(struct extent_index *idx){
+        idx->extents.clear();
+        idx->stream_first = -1;
+        idx->nr_portions = 0;
+}
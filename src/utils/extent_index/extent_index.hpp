@@ -0,0 +1,88 @@
+#ifndef _EXTENT_INDEX_HPP
+#define _EXTENT_INDEX_HPP
+
+#include <sys/types.h>
+
+#include <map>
+
+#include "../heaps/binary_heap/heap.hpp"
+#ifdef ENABLE_SLAB_ALLOC
+#include "../slab/slab.hpp"
+#endif //ENABLE_SLAB_ALLOC
+
+/*
+ * An extent never grows beyond this many portions by coalescing, and
+ * touches larger than this are cut into extents of this size. It is
+ * the most the evictor claims from a file at once.
+ */
+#ifndef EXTENT_MAX_PORTIONS
+#define EXTENT_MAX_PORTIONS 16
+#endif
+
+struct extent {
+        off_t last;     /*last portion_nr of the extent, inclusive*/
+        int id;         /*its item in the pvt heap*/
+};
+
+/**
+ * extent_index
+ * - Keeps the accessed portions of a file as non overlapping extents
+ *   [first, last] of portion_nrs, keyed by first. Each extent has one
+ *   item in the file's pvt heap with the key (LRU timestamp) of its last
+ *   access and the extent's first portion_nr as HeapItem::data.
+ * - A touch of [first, last] splits the extents it overlaps, drops the
+ *   ones it covers and adds one extent for the range; so a 16MB read
+ *   costs a couple of map and heap operations, not one per portion.
+ * - A touch that starts right after the extent touched before it (a
+ *   sequential stream) extends that extent instead, upto
+ *   EXTENT_MAX_PORTIONS.
+ * - Evicted extents are removed, the index only has resident portions.
+ *
+ * Both the index and its heap are under the uinode's file_heap_lock.
+ */
+struct extent_index {
+        std::map<off_t, struct extent> extents;
+        off_t stream_first;     /*first of the extent touched last, -1 if none*/
+        long nr_portions;       /*portions in all extents*/
+
+        extent_index(){
+                stream_first = -1;
+                nr_portions = 0;
+        }
+
+#ifdef ENABLE_SLAB_ALLOC
+        /*one per file read, allocated with its pvt heap*/
+        static void *operator new(size_t sz){
+                void *p = slab_alloc(&slab_type<struct extent_index>::cache);
+                if(!p){
+                        throw std::bad_alloc();
+                }
+                return p;
+        }
+
+        static void operator delete(void *p){
+                slab_free(&slab_type<struct extent_index>::cache, p);
+        }
+#endif //ENABLE_SLAB_ALLOC
+};
+
+/**
+ * Marks portions [first, last] accessed with key.
+ * Returns the number of portions that were not in the index before,
+ * -1 if the heap is full.
+ */
+long extent_touch(struct extent_index *idx, struct Heap *heap, off_t first, off_t last, unsigned long long int key);
+
+/**
+ * Removes the extent starting at first and its heap item.
+ * Returns the number of portions in it, 0 if there is no such extent.
+ */
+long extent_remove(struct extent_index *idx, struct Heap *heap, off_t first);
+
+/*Number of portions in the extent starting at first, 0 if none*/
+long extent_nr_portions(struct extent_index *idx, off_t first);
+
+/*Forgets all extents; the caller clears the heap*/
+void extent_clear(struct extent_index *idx);
+
+#endif //_EXTENT_INDEX_HPP
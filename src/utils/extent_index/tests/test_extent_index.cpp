@@ -0,0 +1,136 @@
+#include "catch_amalgamated.hpp"
+
+#include <stdlib.h>
+
+#include <vector>
+
+#include "utils/extent_index/extent_index.hpp"
+
+#define NR_PORTIONS 512
+#define NR_OPS 200000
+
+/*
+ * model[p] is the key of the last touch of portion p, 0 if not resident.
+ * Every resident portion is in exactly one extent, whose key is at least
+ * the portion's (a stream extent takes the key of its newest touch).
+ * Returns a description of the first mismatch, nullptr if none.
+ */
+static const char *check_model(struct extent_index *idx, struct Heap *heap, std::vector<unsigned long long> &model){
+        std::vector<int> covered(NR_PORTIONS, 0);
+        long nr_resident = 0;
+        off_t prev_last = -1;
+
+        for(auto &e : idx->extents){
+                if(e.first <= prev_last){
+                        return "extents overlap";
+                }
+                if(e.second.last - e.first + 1 > EXTENT_MAX_PORTIONS){
+                        return "extent too long";
+                }
+                prev_last = e.second.last;
+                for(off_t p = e.first; p <= e.second.last; p++){
+                        covered[p]++;
+                        if(!model[p] || heap_get_key_by_id(heap, e.second.id) < model[p]){
+                                return "extent key older than its portion";
+                        }
+                }
+        }
+        for(int p = 0; p < NR_PORTIONS; p++){
+                if(model[p]){
+                        nr_resident++;
+                }
+                if(covered[p] != (model[p] ? 1 : 0)){
+                        return model[p] ? "resident portion not in one extent" : "evicted portion in an extent";
+                }
+        }
+        if(idx->nr_portions != nr_resident){
+                return "nr_portions";
+        }
+        if(heap->size != idx->extents.size()){
+                return "not one heap item per extent";
+        }
+        return nullptr;
+}
+
+/*Evicts the coldest extent like evict_portions does*/
+static long evict_one(struct extent_index *idx, struct Heap *heap, std::vector<unsigned long long> &model){
+        HeapItem *min = heap_read_min(heap);
+        off_t first;
+        long nr;
+
+        if(!min){
+                return 0;
+        }
+        first = min->data;
+        nr = extent_nr_portions(idx, first);
+        REQUIRE(nr > 0);
+        REQUIRE(extent_remove(idx, heap, first) == nr);
+        for(off_t p = first; p < first + nr; p++){
+                model[p] = 0;
+        }
+        return nr;
+}
+
+TEST_CASE("Sequential reads coalesce into the longest extents", "[extent_index][sequential]"){
+        struct Heap *heap = heap_init(NR_PORTIONS, "test");
+        struct extent_index idx;
+        std::vector<unsigned long long> model(NR_PORTIONS, 0);
+        unsigned long long key = 1;
+
+        /*16MB reads over a 1GB file*/
+        for(off_t first = 0; first < NR_PORTIONS; first += 8){
+                for(off_t p = first; p < first + 8; p++){
+                        model[p] = key;
+                }
+                REQUIRE(extent_touch(&idx, heap, first, first + 7, key++) == 8);
+        }
+        REQUIRE(check_model(&idx, heap, model) == nullptr);
+        CHECK(idx.extents.size() == NR_PORTIONS / EXTENT_MAX_PORTIONS);
+
+        /*the start of the scan is the coldest, evicted whole*/
+        REQUIRE(heap_read_min(heap)->data == 0);
+        CHECK(evict_one(&idx, heap, model) == EXTENT_MAX_PORTIONS);
+        CHECK(check_model(&idx, heap, model) == nullptr);
+        heap_destroy(heap);
+}
+
+TEST_CASE("Random touches and evictions keep the index consistent", "[extent_index][random]"){
+        struct Heap *heap = heap_init(NR_PORTIONS, "test");
+        struct extent_index idx;
+        std::vector<unsigned long long> model(NR_PORTIONS, 0);
+        unsigned long long key = 1;
+        long want;
+
+        srand(42);
+        for(int op = 0; op < NR_OPS; op++){
+                if(rand() % 8 == 0){
+                        evict_one(&idx, heap, model);
+                }else{
+                        off_t first = rand() % NR_PORTIONS;
+                        off_t last = first + (rand() % 4 == 0 ? rand() % 64 : rand() % 3);
+
+                        if(last >= NR_PORTIONS){
+                                last = NR_PORTIONS - 1;
+                        }
+                        want = 0;
+                        for(off_t p = first; p <= last; p++){
+                                want += !model[p];
+                                model[p] = key;
+                        }
+                        /*returns the portions that were not resident*/
+                        REQUIRE(extent_touch(&idx, heap, first, last, key) == want);
+                        key++;
+                }
+                if(op % 1000 == 0){
+                        INFO("op " << op);
+                        REQUIRE(check_model(&idx, heap, model) == nullptr);
+                }
+        }
+        REQUIRE(check_model(&idx, heap, model) == nullptr);
+
+        while(evict_one(&idx, heap, model));
+        CHECK(check_model(&idx, heap, model) == nullptr);
+        CHECK(idx.extents.empty());
+        CHECK(heap->size == 0);
+        heap_destroy(heap);
+}
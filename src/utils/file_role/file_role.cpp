@@ -0,0 +1,124 @@
+#include <string.h>
+#include <time.h>
+
+#include <atomic>
+
+#include "file_role.hpp"
+#include "utils/util.hpp"
+#include "utils/ticks.h"
+
+/*ticks_now() is sampled over this long to find its rate*/
+#define FILE_ROLE_CALIBRATE_MS 10
+
+struct role_component {
+        const char *name;
+        enum file_role role;
+};
+
+static const struct role_component role_components[] = {
+        {"Data.db",             FILE_ROLE_DATA},
+        {"Index.db",            FILE_ROLE_INDEX},
+        {"Partitions.db",       FILE_ROLE_PARTITIONS},
+        {"Rows.db",             FILE_ROLE_ROWS},
+        {"Summary.db",          FILE_ROLE_SUMMARY},
+        {"Filter.db",           FILE_ROLE_FILTER},
+        {"CompressionInfo.db",  FILE_ROLE_COMPRESSION_INFO},
+};
+
+/*indexed by enum file_role*/
+static const int role_tiers[NR_FILE_ROLES] = {
+        0,      /*FILE_ROLE_OTHER*/
+        0,      /*FILE_ROLE_DATA*/
+        1,      /*FILE_ROLE_INDEX*/
+        1,      /*FILE_ROLE_PARTITIONS*/
+        1,      /*FILE_ROLE_ROWS*/
+        /*small, and needed before any read of the sstable's Data.db*/
+        2,      /*FILE_ROLE_SUMMARY*/
+        2,      /*FILE_ROLE_FILTER*/
+        2,      /*FILE_ROLE_COMPRESSION_INFO*/
+};
+
+static std::atomic<unsigned long long int> role_credits[NR_FILE_ROLES];
+static std::atomic<long> tier_age_ms(FILE_ROLE_TIER_AGE_MS);
+
+/*0 till init_file_role_credits is done*/
+static std::atomic<unsigned long long int> ticks_per_ms(0);
+
+enum file_role get_file_role(const char *filename){
+        const char *base, *component;
+
+        if(!filename){
+                goto exit_other;
+        }
+
+        base = strrchr(filename, '/');
+        base = base ? base + 1 : filename;
+
+        /*nb-1-big-Data.db, the component follows the last '-'*/
+        component = strrchr(base, '-');
+        component = component ? component + 1 : base;
+
+        for(size_t i = 0; i < sizeof(role_components) / sizeof(role_components[0]); i++){
+                if(!strcmp(component, role_components[i].name)){
+                        return role_components[i].role;
+                }
+        }
+
+exit_other:
+        return FILE_ROLE_OTHER;
+}
+
+int get_file_role_tier(enum file_role role){
+        return role_tiers[role];
+}
+
+unsigned long long int get_file_role_credit(enum file_role role){
+        return role_credits[role].load(std::memory_order_relaxed);
+}
+
+static unsigned long long int mono_ns(){
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void set_role_credits(){
+        unsigned long long int tpm = ticks_per_ms.load(std::memory_order_relaxed);
+        long ms = tier_age_ms.load(std::memory_order_relaxed);
+
+        for(int role = 0; role < NR_FILE_ROLES; role++){
+                role_credits[role].store(role_tiers[role] * ms * tpm, std::memory_order_relaxed);
+        }
+}
+
+void init_file_role_credits(){
+        struct timespec ts;
+        unsigned long long int ticks_start, ns_start, elapsed_ns;
+
+        ticks_start = ticks_now();
+        ns_start = mono_ns();
+
+        ts.tv_sec = 0;
+        ts.tv_nsec = FILE_ROLE_CALIBRATE_MS * 1000000L;
+        nanosleep(&ts, NULL);
+
+        elapsed_ns = mono_ns() - ns_start;
+        if(unlikely(elapsed_ns == 0)){
+                goto exit_init_file_role_credits;
+        }
+        ticks_per_ms.store((ticks_now() - ticks_start) * 1000000ULL / elapsed_ns, std::memory_order_relaxed);
+        set_role_credits();
+
+exit_init_file_role_credits:
+        return;
+}
+
+void set_file_role_tier_age_ms(long ms){
+        tier_age_ms.store(ms, std::memory_order_relaxed);
+        set_role_credits();
+}
+
+long get_file_role_tier_age_ms(){
+        return tier_age_ms.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,55 @@
+#ifndef _FILE_ROLE_HPP
+#define _FILE_ROLE_HPP
+
+#include <stddef.h>
+
+/**
+ * Role of a whitelisted file, from its SSTable component name
+ * (nb-1-big-<Component>.db).
+ *
+ * Roles are grouped into tiers. A miss in an upper tier costs more:
+ * an Index.db or Partitions.db miss adds a random read to every lookup
+ * going through it, a cold Data.db portion costs one read.
+ *
+ * Eviction is still LRU, but the global heap key of a file is its
+ * pvt heap min plus an age credit of tier * FILE_ROLE_TIER_AGE_MS.
+ * Lower tiers are drained first, and an upper tier file that has not
+ * been touched for longer than its credit is evicted like any other.
+ */
+enum file_role {
+        FILE_ROLE_OTHER = 0,            /*not an SSTable component, eg. .sst*/
+        FILE_ROLE_DATA,
+        FILE_ROLE_INDEX,
+        FILE_ROLE_PARTITIONS,
+        FILE_ROLE_ROWS,
+        FILE_ROLE_SUMMARY,
+        FILE_ROLE_FILTER,
+        FILE_ROLE_COMPRESSION_INFO,
+        NR_FILE_ROLES
+};
+
+enum file_role get_file_role(const char *filename);
+
+/*0 is the lowest tier, evicted first*/
+int get_file_role_tier(enum file_role role);
+
+/**
+ * Age credit of role in ticks_now() units. 0 for every role till
+ * init_file_role_credits is done.
+ */
+unsigned long long int get_file_role_credit(enum file_role role);
+
+/**
+ * Measures the ticks_now() rate and sets the age credits.
+ * Sleeps for a few ms, call it from a background thread.
+ */
+void init_file_role_credits();
+
+/**
+ * Sets the age credit per tier at runtime, 0 makes eviction plain LRU.
+ * Applied right away if the credits are already calibrated.
+ */
+void set_file_role_tier_age_ms(long ms);
+long get_file_role_tier_age_ms();
+
+#endif //_FILE_ROLE_HPP
@@ -0,0 +1,45 @@
+#include "catch_amalgamated.hpp"
+
+#include "utils/file_role/file_role.hpp"
+
+TEST_CASE("Role from the SSTable component name", "[file_role][roles]"){
+        CHECK(get_file_role("/data/ks/tbl-0123/nb-1-big-Data.db") == FILE_ROLE_DATA);
+        CHECK(get_file_role("/data/ks/tbl-0123/nb-1-big-Index.db") == FILE_ROLE_INDEX);
+        CHECK(get_file_role("/data/ks/tbl-0123/da-7-bti-Partitions.db") == FILE_ROLE_PARTITIONS);
+        CHECK(get_file_role("/data/ks/tbl-0123/da-7-bti-Rows.db") == FILE_ROLE_ROWS);
+        CHECK(get_file_role("/data/ks/tbl-0123/nb-1-big-Summary.db") == FILE_ROLE_SUMMARY);
+        CHECK(get_file_role("/data/ks/tbl-0123/nb-1-big-Filter.db") == FILE_ROLE_FILTER);
+        CHECK(get_file_role("/data/ks/tbl-0123/nb-1-big-CompressionInfo.db") == FILE_ROLE_COMPRESSION_INFO);
+        CHECK(get_file_role("/data/ks/tbl-0123/nb-1-big-TOC.txt") == FILE_ROLE_OTHER);
+
+        /*only the last path component counts*/
+        CHECK(get_file_role("/data/ks/Index.db-dir/000123.sst") == FILE_ROLE_OTHER);
+        CHECK(get_file_role("Data.db") == FILE_ROLE_DATA);
+        CHECK(get_file_role(nullptr) == FILE_ROLE_OTHER);
+}
+
+TEST_CASE("Lower tiers are evicted first", "[file_role][tiers]"){
+        CHECK(get_file_role_tier(FILE_ROLE_OTHER) == 0);
+        CHECK(get_file_role_tier(FILE_ROLE_DATA) == 0);
+        CHECK(get_file_role_tier(FILE_ROLE_INDEX) > get_file_role_tier(FILE_ROLE_DATA));
+        CHECK(get_file_role_tier(FILE_ROLE_PARTITIONS) == get_file_role_tier(FILE_ROLE_INDEX));
+        CHECK(get_file_role_tier(FILE_ROLE_SUMMARY) > get_file_role_tier(FILE_ROLE_INDEX));
+}
+
+TEST_CASE("Age credits once calibrated", "[file_role][credits]"){
+        long age_ms = get_file_role_tier_age_ms();
+
+        /*plain LRU till the tick rate is measured*/
+        REQUIRE(get_file_role_credit(FILE_ROLE_INDEX) == 0);
+
+        init_file_role_credits();
+        CHECK(get_file_role_credit(FILE_ROLE_DATA) == 0);
+        CHECK(get_file_role_credit(FILE_ROLE_INDEX) > 0);
+        CHECK(get_file_role_credit(FILE_ROLE_FILTER) == 2 * get_file_role_credit(FILE_ROLE_INDEX));
+
+        /*changed at runtime*/
+        set_file_role_tier_age_ms(0);
+        CHECK(get_file_role_credit(FILE_ROLE_FILTER) == 0);
+        set_file_role_tier_age_ms(age_ms);
+        CHECK(get_file_role_credit(FILE_ROLE_INDEX) > 0);
+}
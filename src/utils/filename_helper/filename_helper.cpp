@@ -10,9 +10,100 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <sys/stat.h>
+
+#include <mutex>
+
 #include "filename_helper.hpp"
 #include "utils/util.hpp"
 
+/**
+ * Small direct-mapped cache of dirfd -> absolute directory path.
+ *
+ * Resolving a dirfd costs a readlink on /proc/self/fd/<dirfd> for every
+ * openat. Apps that walk a data directory reuse the same dirfd for all
+ * the files in it, so we remember the path along with the {dev, ino} of
+ * the directory. A hit is confirmed with a single fstat on the dirfd,
+ * which also catches a dirfd that was closed (possibly by closedir, which
+ * we dont interpose) and reused for another directory.
+ *
+ * XXX: a directory renamed while its dirfd is cached keeps the old path
+ * until it is evicted from the cache.
+ */
+struct dirfd_cache_entry{
+    int dirfd;
+    dev_t dev_id;
+    ino_t ino;
+    char path[MAX_ABS_PATH_LEN];
+    std::mutex lock;
+
+    dirfd_cache_entry(){
+        dirfd = -1;
+        dev_id = 0;
+        ino = 0;
+        path[0] = '\0';
+    }
+};
+
+static struct dirfd_cache_entry dirfd_cache[DIRFD_CACHE_SLOTS];
+
+/**
+ * Writes the absolute path of the directory dirfd into outbuf.
+ * returns true if successful else false
+ */
+bool get_dirfd_path(int dirfd, char *outbuf, size_t outbuf_sz){
+    bool ret = false;
+    struct stat st;
+    struct dirfd_cache_entry *entry = nullptr;
+    char fd_path[64];
+    ssize_t len;
+
+    if(dirfd < 0 || !outbuf || outbuf_sz == 0){
+        SPEEDYIO_FPRINTF("%s:ERROR bad input dirfd:%d\n", "SPEEDYIO_ERRCO_0211 %d\n", dirfd);
+        goto exit;
+    }
+
+    if(fstat(dirfd, &st) == -1){
+        SPEEDYIO_FPRINTF("%s:ERROR could not fstat dirfd:%d (%s)\n", "SPEEDYIO_ERRCO_0212 %d %s\n", dirfd, strerror(errno));
+        goto exit;
+    }
+
+    entry = &dirfd_cache[dirfd % DIRFD_CACHE_SLOTS];
+
+    entry->lock.lock();
+    if(entry->dirfd == dirfd && entry->dev_id == st.st_dev && entry->ino == st.st_ino
+            && strlen(entry->path) < outbuf_sz){
+        strcpy(outbuf, entry->path);
+        entry->lock.unlock();
+        ret = true;
+        goto exit;
+    }
+    entry->lock.unlock();
+
+    snprintf(fd_path, sizeof(fd_path), "/proc/self/fd/%d", dirfd);
+    len = readlink(fd_path, outbuf, outbuf_sz - 1);
+    if(len == -1){
+        SPEEDYIO_FPRINTF("%s:ERROR could not readlink for dirfd:%d (%s)\n", "SPEEDYIO_ERRCO_0137 %d %s\n", dirfd, strerror(errno));
+        goto exit;
+    }
+    outbuf[len] = '\0';
+    ret = true;
+
+    if(!S_ISDIR(st.st_mode) || len >= MAX_ABS_PATH_LEN){
+        goto exit;
+    }
+
+    entry->lock.lock();
+    entry->dirfd = dirfd;
+    entry->dev_id = st.st_dev;
+    entry->ino = st.st_ino;
+    memcpy(entry->path, outbuf, len + 1);
+    entry->lock.unlock();
+
+exit:
+    return ret;
+}
+
 /**
  * The problem we are trying to solve here are twofold:
  * 1. for a given pathname we dont know if it is a softlink to some target file.
@@ -30,11 +121,9 @@
  */
 bool resolve_symlink_and_get_abs_path(int dirfd, const char *orig_pathname, char *outbuf, size_t outbuf_sz){
     bool ret = false;
-    char *fd_path = nullptr;
     char *dir_path = nullptr;
     char *combined_path = nullptr;
     char *resolved_path = nullptr;
-    ssize_t len;
     size_t dir_len;
     size_t file_len;
 
@@ -80,7 +169,6 @@ bool resolve_symlink_and_get_abs_path(int dirfd, const char *orig_pathname, char
     // ------------------------------------------------------------------
     // 2. If 'orig_pathname' is relative, resolve dirfd → absolute path
     // ------------------------------------------------------------------
-    // Allocate a buffer to hold "/proc/self/fd/<dirfd>"
     // Allocate a buffer for the directory path
     dir_path = (char *)malloc(MAX_ABS_PATH_LEN);
     if(!dir_path){
@@ -95,21 +183,9 @@ bool resolve_symlink_and_get_abs_path(int dirfd, const char *orig_pathname, char
         }
     }else{
         /*there is a valid dirfd*/
-        // Allocate a buffer to hold "/proc/self/fd/<dirfd>"
-        fd_path = (char *)malloc(64);
-        if(!fd_path){
-            SPEEDYIO_FPRINTF("%s:ERROR could not allocate fd_path\n", "SPEEDYIO_ERRCO_0136\n");
-            goto exit;
-        }
-        snprintf(fd_path, 64, "/proc/self/fd/%d", dirfd);
-
-        // Resolve the directory path from the dirfd
-        len = readlink(fd_path, dir_path, MAX_ABS_PATH_LEN - 1);
-        if(len == -1){
-            SPEEDYIO_FPRINTF("%s:ERROR could not readlink for dirfd:%d (%s)\n", "SPEEDYIO_ERRCO_0137 %d %s\n", dirfd, strerror(errno));
+        if(!get_dirfd_path(dirfd, dir_path, MAX_ABS_PATH_LEN)){
             goto exit;
         }
-        dir_path[len] = '\0';
     }
 
     // Allocate buffer for combining dir_path + "/" + orig_pathname
@@ -157,7 +233,6 @@ exit:
     if (resolved_path)  free(resolved_path);
     if (combined_path)  free(combined_path);
     if (dir_path)       free(dir_path);
-    if (fd_path)        free(fd_path);
     return ret;
 }
 
@@ -194,14 +269,9 @@ bool get_abs_path(int dirfd, const char *orig_pathname, char *outbuf, size_t out
             if (!getcwd(dir_path, sizeof(dir_path)))
                 return false;  // getcwd failed
         } else {
-            // Read the absolute directory path from /proc/self/fd/<dirfd>
-            char proc_path[64];
-            snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", dirfd);
-
-            ssize_t len = readlink(proc_path, dir_path, sizeof(dir_path) - 1);
-            if (len < 0)
-                return false;  // readlink failed
-            dir_path[len] = '\0';
+            // Absolute directory path of dirfd, from the dirfd cache or /proc/self/fd/<dirfd>
+            if (!get_dirfd_path(dirfd, dir_path, sizeof(dir_path)))
+                return false;
         }
 
         // Combine the two with a slash in between
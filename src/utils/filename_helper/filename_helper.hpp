@@ -3,7 +3,13 @@
 
 #include <stddef.h>
 
+/*Number of dirfds whose absolute paths are cached*/
+#ifndef DIRFD_CACHE_SLOTS
+#define DIRFD_CACHE_SLOTS 16
+#endif
+
 bool resolve_symlink_and_get_abs_path(int, const char *, char *, size_t);
 bool get_abs_path(int, const char *, char *, size_t);
+bool get_dirfd_path(int, char *, size_t);
 
 #endif
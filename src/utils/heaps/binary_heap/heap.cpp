@@ -121,7 +121,7 @@ void heap_clear(Heap *H)
 //------------------------------------------------------------------
 // heap_insert
 //------------------------------------------------------------------
-int heap_insert(Heap* H, unsigned long long int key, void* dataptr)
+static int insert_item(Heap* H, HeapItem item)
 {
     if (!H) {
         SPEEDYIO_FPRINTF("%s:ERROR H==NULL, insert attempted on a null heap\n", "SPEEDYIO_ERRCO_0198\n");
@@ -132,12 +132,13 @@ int heap_insert(Heap* H, unsigned long long int key, void* dataptr)
         KILLME();
     }
 
-    // 1) create the new item
-    HeapItem item;
-    item.key = key;
-    item.dataptr = dataptr;
+    // 1) give the new item its id. Heaps that delete and insert a lot
+    // (extent_index) run through ids; they wrap around, skipping live ones
+    while (H->id2index.count(H->next_id)) {
+        H->next_id = (H->next_id == std::numeric_limits<int>::max()) ? 0 : H->next_id + 1;
+    }
     item.id = H->next_id;
-    H->next_id += 1;
+    H->next_id = (H->next_id == std::numeric_limits<int>::max()) ? 0 : H->next_id + 1;
     // 2) put it at the end
     H->storage.push_back(item);
     H->size++;
@@ -152,10 +153,26 @@ int heap_insert(Heap* H, unsigned long long int key, void* dataptr)
     return item.id;
 }
 
+int heap_insert(Heap* H, unsigned long long int key, void* dataptr)
+{
+    HeapItem item;
+    item.key = key;
+    item.dataptr = dataptr;
+    return insert_item(H, item);
+}
+
+int heap_insert_data(Heap* H, unsigned long long int key, long long data)
+{
+    HeapItem item;
+    item.key = key;
+    item.data = data;
+    return insert_item(H, item);
+}
+
 //------------------------------------------------------------------
 // heap_update_key
 //------------------------------------------------------------------
-void heap_update_key(Heap* H, int id, unsigned long long int newKey)
+unsigned long long int heap_update_key(Heap* H, int id, unsigned long long int newKey)
 {
     if (!H) {
         SPEEDYIO_FPRINTF("%s:ERROR H==NULL, called on a null heap\n", "SPEEDYIO_ERRCO_0200\n");
@@ -180,6 +197,25 @@ void heap_update_key(Heap* H, int id, unsigned long long int newKey)
         bubble_down(H, idx);
     }
     // else equal => do nothing
+
+    return oldKey;
+}
+
+//------------------------------------------------------------------
+// heap_update_data
+//------------------------------------------------------------------
+void heap_update_data(Heap* H, int id, long long data)
+{
+    if (!H) {
+        SPEEDYIO_FPRINTF("%s:ERROR H==NULL, called on a null heap\n", "SPEEDYIO_ERRCO_0200\n");
+        KILLME();
+    }
+    auto it = H->id2index.find(id);
+    if (it == H->id2index.end()) {
+        SPEEDYIO_FPRINTF("%s:ERROR %s invalid id=%d\n", "SPEEDYIO_ERRCO_0201 %s %d\n", H->heap_name, id);
+        KILLME();
+    }
+    H->storage[it->second].data = data;
 }
 
 //------------------------------------------------------------------
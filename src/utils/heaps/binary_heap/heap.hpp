@@ -7,10 +7,15 @@
 #include <unordered_map>
 #include <cstddef>
 
+#ifdef ENABLE_SLAB_ALLOC
+#include "../../slab/slab.hpp"
+#endif
+
 /**
  * The user data is stored in a simple struct:
  *    key      = the "priority" (we do a min-heap by key)
  *    dataptr  = arbitrary user pointer
+ *    data     = or a small payload stored inline (heap_insert_data)
  *    id       = a unique ID to identify this item
  *
  * We only need 'id' internally for update-key lookups, but
@@ -18,7 +23,10 @@
  */
 struct HeapItem {
     unsigned long long int       key;
-    void*       dataptr;
+    union {
+        void*       dataptr;
+        long long   data;
+    };
     int         id;
 };
 
@@ -40,6 +48,21 @@ struct Heap {
     int next_id;
     static const std::size_t NAME_SIZE = 64;  // Maximum length for the name (including null terminator)
     char heap_name[NAME_SIZE];
+
+#ifdef ENABLE_SLAB_ALLOC
+    // There is a pvt heap per file read; keep them in slab chunks
+    static void* operator new(std::size_t sz) {
+        void* p = slab_alloc(&slab_type<Heap>::cache);
+        if (!p) {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+
+    static void operator delete(void* p) {
+        slab_free(&slab_type<Heap>::cache, p);
+    }
+#endif
 };
 
 /**
@@ -65,13 +88,25 @@ void heap_clear(Heap *H);
  */
 int heap_insert(Heap* H, unsigned long long int key, void* dataptr);
 
+/**
+ * Same as heap_insert with 'data' stored inline in the item
+ * instead of behind a pointer. Read it back from HeapItem::data.
+ */
+int heap_insert_data(Heap* H, unsigned long long int key, long long data);
+
 /**
  * Update the key of the item with a given 'id' to 'newKey'.
  *   - If newKey < oldKey, the item might bubble up.
  *   - If newKey > oldKey, the item might bubble down.
- * No return value.
+ * Returns the key the item had before.
+ */
+unsigned long long int heap_update_key(Heap* H, int id, unsigned long long int newKey);
+
+/**
+ * Replace the inline data of the item with the given id.
+ * The key and the item's place in the heap stay the same.
  */
-void heap_update_key(Heap* H, int id, unsigned long long int newKey);
+void heap_update_data(Heap* H, int id, long long data);
 
 /**
  * Remove the element with the given id
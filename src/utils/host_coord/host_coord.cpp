@@ -0,0 +1,406 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <atomic>
+
+#include "host_coord.hpp"
+#include "utils/util.hpp"
+#include "utils/shim/shim.hpp"
+
+#define LEASE_NS (HOST_COORD_LEASE_MS * 1000000ULL)
+#define SETTLE_NS (HOST_COORD_SETTLE_MS * 1000000ULL)
+#define BACKOFF_NS (HOST_COORD_BACKOFF_MS * 1000000ULL)
+
+/*how long to wait for the creator of the segment to initialize it*/
+#define INIT_WAIT_MS 1000
+
+static struct host_coord_segment *seg = nullptr;
+static int my_slot = -1;
+static pid_t my_pid = 0;
+static bool exited = false;
+
+/*when this process last took the segment lock*/
+static uint64_t last_sync_ns = 0;
+
+/*this process's last claim evicted nothing; till then it publishes no coldest key*/
+static uint64_t backoff_until_ns = 0;
+
+static uint64_t mono_ns(){
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*heartbeats are written by other processes, they can be a bit after now*/
+static bool expired(uint64_t then, uint64_t now){
+        return now > then && now - then > LEASE_NS;
+}
+
+static bool lock_segment(){
+        int ret = pthread_mutex_lock(&seg->lock);
+
+        /*the holder died; the slots are still consistent, its own one gets reaped*/
+        if(unlikely(ret == EOWNERDEAD)){
+                pthread_mutex_consistent(&seg->lock);
+                ret = 0;
+        }
+        if(unlikely(ret != 0)){
+                SPEEDYIO_FPRINTF("%s:ERROR host_coord lock failed ret:%d\n", "SPEEDYIO_ERRCO_0257 %d\n", ret);
+                return false;
+        }
+        return true;
+}
+
+static void unlock_segment(){
+        pthread_mutex_unlock(&seg->lock);
+}
+
+static bool slot_alive(struct host_coord_slot *slot, uint64_t now){
+        if(slot->pid == 0){
+                return false;
+        }
+        if(expired(slot->heartbeat_ns, now)){
+                return false;
+        }
+        return kill(slot->pid, 0) == 0 || errno != ESRCH;
+}
+
+/*Takes a free slot for this process. Segment lock held*/
+static bool take_slot(uint64_t now){
+        for(int i = 0; i < HOST_COORD_MAX_PROCS; i++){
+                struct host_coord_slot *slot = &seg->slots[i];
+
+                if(slot->pid != 0 && slot_alive(slot, now)){
+                        continue;
+                }
+                memset(slot, 0, sizeof(*slot));
+                slot->pid = my_pid;
+                slot->heartbeat_ns = now;
+                slot->coldest_key = UINT64_MAX;
+                my_slot = i;
+                return true;
+        }
+        my_slot = -1;
+        return false;
+}
+
+/*Leader work: frees the slots of processes that died or stopped heartbeating. Segment lock held*/
+static void lead(uint64_t now){
+        for(int i = 0; i < HOST_COORD_MAX_PROCS; i++){
+                struct host_coord_slot *slot = &seg->slots[i];
+
+                if(slot->pid != 0 && slot->pid != my_pid && !slot_alive(slot, now)){
+                        memset(slot, 0, sizeof(*slot));
+                }
+        }
+}
+
+/*Takes the leader lease if it is free or ran out. Segment lock held*/
+static void try_lead(uint64_t now){
+        if(seg->leader != my_pid && seg->leader != 0 && !expired(seg->leader_heartbeat_ns, now)){
+                return;
+        }
+        seg->leader = my_pid;
+        seg->leader_heartbeat_ns = now;
+        lead(now);
+}
+
+static int open_segment(bool *created){
+        int fd;
+
+        *created = false;
+        fd = shm_open(HOST_COORD_NAME, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+        if(fd >= 0){
+                *created = true;
+                if(real_ftruncate(fd, sizeof(struct host_coord_segment)) != 0){
+                        SPEEDYIO_FPRINTF("%s:ERROR ftruncate %s failed errno:%d\n", "SPEEDYIO_ERRCO_0258 %s %d\n", HOST_COORD_NAME, errno);
+                        real_close(fd);
+                        shm_unlink(HOST_COORD_NAME);
+                        return -1;
+                }
+                return fd;
+        }
+        if(errno != EEXIST){
+                return -1;
+        }
+        return shm_open(HOST_COORD_NAME, O_RDWR | O_CLOEXEC, 0);
+}
+
+static bool init_segment(struct host_coord_segment *s){
+        pthread_mutexattr_t attr;
+        bool ret = false;
+
+        if(pthread_mutexattr_init(&attr) != 0){
+                return false;
+        }
+        if(pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0 &&
+                        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) == 0 &&
+                        pthread_mutex_init(&s->lock, &attr) == 0){
+                ret = true;
+        }
+        pthread_mutexattr_destroy(&attr);
+        if(!ret){
+                return false;
+        }
+
+        s->version = HOST_COORD_VERSION;
+        s->size = sizeof(struct host_coord_segment);
+
+        /*others check magic last*/
+        std::atomic_thread_fence(std::memory_order_release);
+        __atomic_store_n(&s->magic, HOST_COORD_MAGIC, __ATOMIC_RELAXED);
+        return true;
+}
+
+/*Maps the segment; initializes it if created, otherwise waits for its creator to*/
+static bool segment_ready(int fd, bool created, struct host_coord_segment **s){
+        struct timespec ts = {0, 1000000L};
+        struct stat st;
+        void *addr;
+
+        for(int waited = 0; ; waited++){
+                if(fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(struct host_coord_segment)){
+                        break;
+                }
+                if(waited >= INIT_WAIT_MS){
+                        return false;
+                }
+                nanosleep(&ts, NULL);
+        }
+
+        addr = real_mmap(NULL, sizeof(struct host_coord_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(addr == MAP_FAILED){
+                SPEEDYIO_FPRINTF("%s:ERROR mmap %s failed errno:%d\n", "SPEEDYIO_ERRCO_0259 %s %d\n", HOST_COORD_NAME, errno);
+                return false;
+        }
+        *s = (struct host_coord_segment *)addr;
+
+        if(created && !init_segment(*s)){
+                goto err_segment_ready;
+        }
+        for(int waited = 0; __atomic_load_n(&(*s)->magic, __ATOMIC_RELAXED) != HOST_COORD_MAGIC; waited++){
+                if(waited >= INIT_WAIT_MS){
+                        goto err_segment_ready;
+                }
+                nanosleep(&ts, NULL);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if((*s)->version != HOST_COORD_VERSION || (*s)->size != sizeof(struct host_coord_segment)){
+                goto err_segment_ready;
+        }
+        return true;
+
+err_segment_ready:
+        munmap(addr, sizeof(struct host_coord_segment));
+        *s = nullptr;
+        return false;
+}
+
+bool host_coord_init(){
+        struct host_coord_segment *s = nullptr;
+        bool created;
+        bool ready;
+        int fd;
+
+        fd = open_segment(&created);
+        if(fd < 0){
+                SPEEDYIO_PRINTF("%s:INFO cannot open " HOST_COORD_NAME " (errno %d), evicting without host coordination\n", "SPEEDYIO_INFOCO_0028 %d\n", errno);
+                return false;
+        }
+
+        ready = segment_ready(fd, created, &s);
+        real_close(fd);
+
+        if(!ready){
+                if(created){
+                        shm_unlink(HOST_COORD_NAME);
+                }
+                /*a creator that died before it set magic leaves a segment nobody can use*/
+                SPEEDYIO_PRINTF("%s:INFO " HOST_COORD_NAME " is not usable, evicting without host coordination\n", "SPEEDYIO_INFOCO_0029\n");
+                return false;
+        }
+
+        seg = s;
+        my_pid = getpid();
+        if(!lock_segment()){
+                goto err_host_coord_init;
+        }
+        if(!take_slot(mono_ns())){
+                unlock_segment();
+                SPEEDYIO_PRINTF("%s:INFO more than %d processes in " HOST_COORD_NAME ", evicting without host coordination\n", "SPEEDYIO_INFOCO_0030 %d\n", HOST_COORD_MAX_PROCS);
+                goto err_host_coord_init;
+        }
+        unlock_segment();
+        return true;
+
+err_host_coord_init:
+        munmap(seg, sizeof(struct host_coord_segment));
+        seg = nullptr;
+        return false;
+}
+
+/**
+ * The lock is only taken when this process or another has a deficit, or
+ * every quarter lease to keep the leader lease and reap dead slots.
+ * Otherwise the pass only refreshes this process's heartbeat, and the
+ * coldest key is not looked up.
+ */
+long host_coord_claim(long deficit_kb, uint64_t (*coldest_key)()){
+        struct host_coord_slot *slot;
+        int64_t host_deficit_kb = 0, claimed_kb = 0;
+        uint64_t key, min_key = UINT64_MAX;
+        uint64_t now;
+        long grant_kb = 0;
+
+        if(!seg){
+                return deficit_kb;
+        }
+
+        now = mono_ns();
+
+        if(likely(my_slot >= 0 && deficit_kb <= 0 && now - last_sync_ns < LEASE_NS / 4 &&
+                        __atomic_load_n(&seg->deficit_kb, __ATOMIC_RELAXED) <= 0)){
+                slot = &seg->slots[my_slot];
+                if(likely(__atomic_load_n(&slot->pid, __ATOMIC_RELAXED) == my_pid)){
+                        __atomic_store_n(&slot->deficit_kb, 0, __ATOMIC_RELAXED);
+                        __atomic_store_n(&slot->heartbeat_ns, now, __ATOMIC_RELAXED);
+                        return 0;
+                }
+        }
+
+        /*not under the segment lock, this takes g_heap_lock*/
+        key = now < backoff_until_ns ? UINT64_MAX : coldest_key();
+
+        if(unlikely(!lock_segment())){
+                return deficit_kb;
+        }
+        last_sync_ns = now;
+
+        if(unlikely(exited)){
+                goto exit_host_coord_claim;
+        }
+
+        /*reaped while this process was paused or stuck*/
+        if(unlikely(my_slot < 0 || seg->slots[my_slot].pid != my_pid)){
+                if(!take_slot(now)){
+                        grant_kb = deficit_kb;
+                        goto exit_host_coord_claim;
+                }
+        }
+        slot = &seg->slots[my_slot];
+        slot->heartbeat_ns = now;
+        slot->coldest_key = key;
+        slot->deficit_kb = deficit_kb > 0 ? deficit_kb : 0;
+
+        try_lead(now);
+
+        for(int i = 0; i < HOST_COORD_MAX_PROCS; i++){
+                struct host_coord_slot *s = &seg->slots[i];
+
+                if(s->pid == 0 || expired(s->heartbeat_ns, now)){
+                        continue;
+                }
+                if(s->claim_done_ns && now > s->claim_done_ns && now - s->claim_done_ns > SETTLE_NS){
+                        s->claim_kb = 0;
+                        s->claim_done_ns = 0;
+                }
+                if(s->deficit_kb > host_deficit_kb){
+                        host_deficit_kb = s->deficit_kb;
+                }
+                claimed_kb += s->claim_kb;
+                if(s->coldest_key < min_key){
+                        min_key = s->coldest_key;
+                }
+        }
+
+        /*tells the others to come and check*/
+        __atomic_store_n(&seg->deficit_kb, host_deficit_kb, __ATOMIC_RELAXED);
+
+        if(host_deficit_kb - claimed_kb <= 0){
+                goto exit_host_coord_claim;
+        }
+        if(slot->coldest_key == UINT64_MAX || slot->coldest_key > min_key){
+                seg->nr_declined++;
+                goto exit_host_coord_claim;
+        }
+
+        grant_kb = host_deficit_kb - claimed_kb;
+        if(grant_kb > HOST_COORD_CLAIM_KB){
+                grant_kb = HOST_COORD_CLAIM_KB;
+        }
+        slot->claim_kb += grant_kb;
+        slot->claim_done_ns = 0;
+        seg->nr_claims++;
+
+exit_host_coord_claim:
+        unlock_segment();
+        return grant_kb;
+}
+
+void host_coord_claim_done(long claimed_kb){
+        struct host_coord_slot *slot;
+
+        if(!seg || my_slot < 0 || !lock_segment()){
+                return;
+        }
+        if(claimed_kb <= 0){
+                /*its coldest file is still the coldest, let the next process have a go*/
+                backoff_until_ns = mono_ns() + BACKOFF_NS;
+        }
+        slot = &seg->slots[my_slot];
+        if(slot->pid == my_pid){
+                /*only what was evicted has to settle*/
+                if(claimed_kb < slot->claim_kb){
+                        slot->claim_kb = claimed_kb > 0 ? claimed_kb : 0;
+                }
+                slot->claim_done_ns = mono_ns();
+        }
+        unlock_segment();
+}
+
+/**
+ * Called from destruct; the evictor thread may still be running, so
+ * the segment stays mapped and host_coord_claim stops coordinating.
+ */
+void host_coord_exit(){
+        if(!seg || !lock_segment()){
+                return;
+        }
+        exited = true;
+        if(my_slot >= 0 && seg->slots[my_slot].pid == my_pid){
+                memset(&seg->slots[my_slot], 0, sizeof(seg->slots[my_slot]));
+        }
+        if(seg->leader == my_pid){
+                seg->leader = 0;
+        }
+        unlock_segment();
+}
+
+void get_host_coord_stats(struct host_coord_stats *stats){
+        uint64_t now = mono_ns();
+
+        memset(stats, 0, sizeof(*stats));
+        if(!seg){
+                return;
+        }
+        /*racy reads, these are only for the stats*/
+        for(int i = 0; i < HOST_COORD_MAX_PROCS; i++){
+                if(__atomic_load_n(&seg->slots[i].pid, __ATOMIC_RELAXED) != 0 &&
+                                !expired(__atomic_load_n(&seg->slots[i].heartbeat_ns, __ATOMIC_RELAXED), now)){
+                        stats->nr_procs++;
+                }
+        }
+        stats->leader = __atomic_load_n(&seg->leader, __ATOMIC_RELAXED) == my_pid;
+        stats->nr_claims = __atomic_load_n(&seg->nr_claims, __ATOMIC_RELAXED);
+        stats->nr_declined = __atomic_load_n(&seg->nr_declined, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,124 @@
+#ifndef _HOST_COORD_HPP
+#define _HOST_COORD_HPP
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+/**
+ * Host wide eviction coordination between SpeedyIO processes.
+ *
+ * Every process's evictor sees the same MemFree; without this, two
+ * preloaded processes both reclaim the whole deficit at the same time.
+ * They share /dev/shm/speedyio_host instead:
+ * - every evictor keeps a slot with a heartbeat and the key of its
+ *   coldest file (absolute TSC ticks, comparable across processes).
+ * - the leader, the process holding the leader lease, publishes the host
+ *   deficit and clears the slots of processes that died or stopped
+ *   heartbeating. Any process takes over once the lease runs out.
+ * - an evictor only reclaims if its coldest key is the coldest of the
+ *   live slots, and then claims upto HOST_COORD_CLAIM_KB of the deficit
+ *   not claimed by anyone yet. A claim counts against the deficit till
+ *   HOST_COORD_SETTLE_MS after it is done, so MemFree can catch up.
+ * - an evictor whose claim evicted nothing publishes no coldest key for
+ *   HOST_COORD_BACKOFF_MS, so the next coldest process claims instead.
+ *
+ * So the deficit is reclaimed once, from the coldest data on the host.
+ * Processes of other users, or with a different segment layout, cannot
+ * open the segment and evict on their own as before.
+ *
+ * The segment lock is a process shared robust mutex; it is only taken
+ * by the evictor threads, never on the read/write path.
+ */
+
+/*overridden by the tests, so they do not join the processes on the host*/
+#ifndef HOST_COORD_NAME
+#define HOST_COORD_NAME "/speedyio_host"
+#endif
+#define HOST_COORD_MAGIC 0x54534f484f495353ULL    /*"SSIOHOST"*/
+#define HOST_COORD_VERSION 1
+
+#define HOST_COORD_MAX_PROCS 32
+
+/*a slot or the leader is dead if its heartbeat is older than this*/
+#ifndef HOST_COORD_LEASE_MS
+#define HOST_COORD_LEASE_MS 500
+#endif
+
+/*how long a finished claim still counts against the deficit*/
+#ifndef HOST_COORD_SETTLE_MS
+#define HOST_COORD_SETTLE_MS 50
+#endif
+
+/*how long an evictor whose claim evicted nothing leaves the deficit to others*/
+#ifndef HOST_COORD_BACKOFF_MS
+#define HOST_COORD_BACKOFF_MS 1000
+#endif
+
+/*most one evictor claims at once*/
+#ifndef HOST_COORD_CLAIM_KB
+#define HOST_COORD_CLAIM_KB (64 * 1024)
+#endif
+
+struct host_coord_slot {
+        int32_t pid;                    /*0 if free*/
+        uint32_t reserved;
+        uint64_t heartbeat_ns;          /*CLOCK_MONOTONIC*/
+        uint64_t coldest_key;           /*UINT64_MAX if nothing to evict*/
+        int64_t deficit_kb;             /*what this process would reclaim on its own*/
+        int64_t claim_kb;               /*being reclaimed or settling*/
+        uint64_t claim_done_ns;         /*0 while the claim is in progress*/
+};
+
+struct host_coord_segment {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t size;                  /*sizeof(struct host_coord_segment)*/
+
+        pthread_mutex_t lock;           /*for everything below*/
+
+        int32_t leader;                 /*pid, 0 if none*/
+        uint32_t reserved;
+        uint64_t leader_heartbeat_ns;
+        int64_t deficit_kb;             /*largest deficit of the live slots, as last seen by the leader*/
+
+        uint64_t nr_claims;
+        uint64_t nr_declined;           /*times an evictor left the deficit to a colder process*/
+
+        struct host_coord_slot slots[HOST_COORD_MAX_PROCS];
+};
+
+/**
+ * Maps the segment, creating it if this is the first process, and
+ * takes a slot. Returns false if this process has to evict on its own.
+ * Call from the evictor thread.
+ */
+bool host_coord_init();
+
+/**
+ * Called by the evictor every pass. deficit_kb is what this process
+ * would reclaim on its own (0 if memory is not low). coldest_key gives
+ * the key of its coldest file in absolute ticks, UINT64_MAX if nothing
+ * is left to evict; it is only called when the segment lock is taken.
+ *
+ * Returns the KB this process should reclaim now; 0 if there is nothing
+ * to do or a colder process will do it.
+ */
+long host_coord_claim(long deficit_kb, uint64_t (*coldest_key)());
+
+/*Called once the KB from host_coord_claim are reclaimed; claimed_kb is what evict_portions claimed*/
+void host_coord_claim_done(long claimed_kb);
+
+/*Frees this process's slot, and the leader lease if it holds it*/
+void host_coord_exit();
+
+struct host_coord_stats {
+        unsigned long nr_procs;
+        bool leader;
+        unsigned long nr_claims;        /*host wide*/
+        unsigned long nr_declined;      /*host wide*/
+};
+
+void get_host_coord_stats(struct host_coord_stats *stats);
+
+#endif //_HOST_COORD_HPP
@@ -0,0 +1,238 @@
+#include "catch_amalgamated.hpp"
+
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <vector>
+
+#include "utils/host_coord/host_coord.hpp"
+
+/*
+ * Built with HOST_COORD_NAME "/speedyio_host_test", HOST_COORD_LEASE_MS
+ * 100 and HOST_COORD_BACKOFF_MS 100. The module keeps its slot per
+ * process, so every evictor is a forked child: it reports what it saw
+ * over a pipe and the checks are done here.
+ */
+
+struct child {
+        pid_t pid;
+        int from_child;         /*results, as longs*/
+        int to_child;           /*go ahead*/
+};
+
+/*key of the coldest file of the child, set before it claims*/
+static uint64_t child_key = UINT64_MAX;
+
+static uint64_t coldest_key(){
+        return child_key;
+}
+
+static void sleep_ms(long ms){
+        struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+
+        nanosleep(&ts, NULL);
+}
+
+static void report(int fd, long val){
+        if(write(fd, &val, sizeof(val)) != sizeof(val)){
+                _exit(1);
+        }
+}
+
+static void wait_go(int fd){
+        char c;
+
+        if(read(fd, &c, 1) != 1){
+                _exit(1);
+        }
+}
+
+static bool is_leader(){
+        struct host_coord_stats stats;
+
+        get_host_coord_stats(&stats);
+        return stats.leader;
+}
+
+static long nr_procs(){
+        struct host_coord_stats stats;
+
+        get_host_coord_stats(&stats);
+        return stats.nr_procs;
+}
+
+/*Forks a child running fn(results, go); it exits without tearing down Catch*/
+template <typename F>
+static struct child start_child(F fn){
+        struct child c = {-1, -1, -1};
+        int results[2], go[2];
+
+        REQUIRE(pipe(results) == 0);
+        REQUIRE(pipe(go) == 0);
+
+        c.pid = fork();
+        REQUIRE(c.pid >= 0);
+        if(c.pid == 0){
+                close(results[0]);
+                close(go[1]);
+                fn(results[1], go[0]);
+                _exit(0);
+        }
+        close(results[1]);
+        close(go[0]);
+        c.from_child = results[0];
+        c.to_child = go[1];
+        return c;
+}
+
+static long next_result(struct child &c){
+        long val = -1;
+
+        REQUIRE(read(c.from_child, &val, sizeof(val)) == sizeof(val));
+        return val;
+}
+
+static void let_go(struct child &c){
+        REQUIRE(write(c.to_child, "g", 1) == 1);
+}
+
+static void finish_child(struct child &c){
+        int status = -1;
+
+        close(c.to_child);
+        close(c.from_child);
+        REQUIRE(waitpid(c.pid, &status, 0) == c.pid);
+        CHECK(WIFEXITED(status));
+        CHECK(WEXITSTATUS(status) == 0);
+}
+
+TEST_CASE("Only the process with the coldest file claims the deficit", "[host_coord][coldest]"){
+        std::vector<struct child> children;
+        uint64_t keys[] = {100, 200};
+        long nr_declined;
+
+        shm_unlink(HOST_COORD_NAME);
+
+        for(uint64_t key : keys){
+                children.push_back(start_child([key](int results, int go){
+                        struct host_coord_stats stats;
+
+                        child_key = key;
+                        report(results, host_coord_init());
+
+                        /*publishes the key*/
+                        report(results, host_coord_claim(0, coldest_key));
+
+                        wait_go(go);
+                        report(results, host_coord_claim(1000, coldest_key));
+                        get_host_coord_stats(&stats);
+                        report(results, stats.nr_declined);
+                        host_coord_exit();
+                }));
+                REQUIRE(next_result(children.back()) == 1);
+                REQUIRE(next_result(children.back()) == 0);
+        }
+
+        /*the warmer one first, it leaves the deficit to the colder one*/
+        let_go(children[1]);
+        CHECK(next_result(children[1]) == 0);
+        nr_declined = next_result(children[1]);
+        CHECK(nr_declined == 1);
+
+        let_go(children[0]);
+        CHECK(next_result(children[0]) == 1000);
+        CHECK(next_result(children[0]) == nr_declined);
+
+        for(auto &c : children){
+                finish_child(c);
+        }
+        shm_unlink(HOST_COORD_NAME);
+}
+
+TEST_CASE("A claim counts till it settles, one that evicted nothing backs off", "[host_coord][settle]"){
+        struct child c;
+
+        shm_unlink(HOST_COORD_NAME);
+
+        c = start_child([](int results, int go){
+                (void)go;
+                child_key = 100;
+                report(results, host_coord_init());
+
+                report(results, host_coord_claim(1000, coldest_key));
+                /*still being reclaimed*/
+                report(results, host_coord_claim(1000, coldest_key));
+
+                host_coord_claim_done(1000);
+                report(results, host_coord_claim(1000, coldest_key));
+                sleep_ms(HOST_COORD_SETTLE_MS + 20);
+                report(results, host_coord_claim(1000, coldest_key));
+
+                /*evicted nothing, not the coldest till the backoff is over*/
+                host_coord_claim_done(0);
+                sleep_ms(HOST_COORD_SETTLE_MS + 20);
+                report(results, host_coord_claim(1000, coldest_key));
+                sleep_ms(HOST_COORD_BACKOFF_MS);
+                report(results, host_coord_claim(1000, coldest_key));
+                host_coord_exit();
+        });
+
+        REQUIRE(next_result(c) == 1);
+        CHECK(next_result(c) == 1000);
+        CHECK(next_result(c) == 0);
+        CHECK(next_result(c) == 0);
+        CHECK(next_result(c) == 1000);
+        CHECK(next_result(c) == 0);
+        CHECK(next_result(c) == 1000);
+
+        finish_child(c);
+        shm_unlink(HOST_COORD_NAME);
+}
+
+TEST_CASE("A stuck leader loses its lease and its slot", "[host_coord][lease]"){
+        struct child stuck, taker;
+
+        shm_unlink(HOST_COORD_NAME);
+
+        /*leads, then stops heartbeating without exiting*/
+        stuck = start_child([](int results, int go){
+                child_key = 100;
+                report(results, host_coord_init());
+                report(results, host_coord_claim(0, coldest_key));
+                report(results, is_leader());
+                wait_go(go);
+        });
+        REQUIRE(next_result(stuck) == 1);
+        REQUIRE(next_result(stuck) == 0);
+        REQUIRE(next_result(stuck) == 1);
+
+        taker = start_child([](int results, int go){
+                (void)go;
+                child_key = 200;
+                report(results, host_coord_init());
+                report(results, host_coord_claim(0, coldest_key));
+                report(results, is_leader());
+                report(results, nr_procs());
+
+                sleep_ms(HOST_COORD_LEASE_MS + 50);
+                report(results, host_coord_claim(0, coldest_key));
+                report(results, is_leader());
+                report(results, nr_procs());
+                host_coord_exit();
+        });
+        REQUIRE(next_result(taker) == 1);
+        CHECK(next_result(taker) == 0);
+        CHECK(next_result(taker) == 0);
+        CHECK(next_result(taker) == 2);
+
+        CHECK(next_result(taker) == 0);
+        CHECK(next_result(taker) == 1);
+        CHECK(next_result(taker) == 1);
+
+        finish_child(taker);
+        let_go(stuck);
+        finish_child(stuck);
+        shm_unlink(HOST_COORD_NAME);
+}
@@ -1,6 +1,13 @@
 #include <stdio.h>
 #include "latency_tracking.hpp"
 
+#ifdef LOCK_HOLD_STATS
+struct lat_tracker imap_shard_lock_hold;
+struct lat_tracker unlinked_lock_hold;
+struct lat_tracker file_heap_lock_hold;
+struct lat_tracker g_heap_lock_hold;
+#endif //LOCK_HOLD_STATS
+
 
 // Convert difference between two timespecs to nanoseconds
 int64_t timespec_diff_ns(struct timespec start, struct timespec end) {
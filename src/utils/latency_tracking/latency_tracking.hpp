@@ -5,6 +5,7 @@
 
 #include <cstdint>
 #include <atomic>
+#include <mutex>
 
 #define NR_POW2_LATENCY_BINS 32
 
@@ -24,5 +25,52 @@ struct lat_tracker{
     }
 };
 
+/**
+ * A std::mutex that bins the ns it is held for into *tracker.
+ * LOCK_HOLD_STATS builds swap it in for the i_map shard locks, the
+ * uinode unlinked_lock and file_heap_lock and g_heap_lock.
+ */
+template <struct lat_tracker *tracker>
+class hold_timed_mutex {
+public:
+    void lock(){
+        mtx.lock();
+        locked_at = now_ns();
+    }
+
+    bool try_lock(){
+        if(!mtx.try_lock()){
+            return false;
+        }
+        locked_at = now_ns();
+        return true;
+    }
+
+    void unlock(){
+        uint64_t held = now_ns() - locked_at;
+
+        mtx.unlock();
+        bin_to_pow2((int)held, tracker);
+    }
+
+private:
+    static uint64_t now_ns(){
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    std::mutex mtx;
+    uint64_t locked_at;
+};
+
+#ifdef LOCK_HOLD_STATS
+/*ns the locks are held for, in pow2 bins*/
+extern struct lat_tracker imap_shard_lock_hold;
+extern struct lat_tracker unlinked_lock_hold;
+extern struct lat_tracker file_heap_lock_hold;
+extern struct lat_tracker g_heap_lock_hold;
+#endif //LOCK_HOLD_STATS
 
 #endif //_LATENCY_TRACKING_HPP
\ No newline at end of file
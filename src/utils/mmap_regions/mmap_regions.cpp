@@ -0,0 +1,508 @@
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "mmap_regions.hpp"
+#include "utils/util.hpp"
+#include "utils/shim/shim.hpp"
+
+#ifndef MADV_COLD
+#define MADV_COLD 20
+#endif
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT 21
+#endif
+
+#define PAGEMAP_PRESENT (1ULL << 63)
+#define PAGEMAP_PFN_MASK ((1ULL << 55) - 1)
+
+/*nr_resident of a portion not sampled yet*/
+#define NEVER_SAMPLED UINT32_MAX
+
+#define PAGES_PER_PORTION (1UL << PVT_HEAP_PG_ORDER)
+
+/*the kernel maps and unmaps whole pages*/
+#define PAGE_END(x) (((uintptr_t)(x) + (1UL << PAGE_SHIFT) - 1) & ~((1UL << PAGE_SHIFT) - 1))
+
+struct mmap_region {
+        uintptr_t start;
+        size_t length;
+        off_t offset;                   /*file offset mapped at start*/
+        dev_t dev;
+        ino_t ino;
+        /*resident pages of each portion it maps at the last sample, the first is offset's portion*/
+        std::vector<uint32_t> nr_resident;
+        /*
+         * The evictor samples and advises a pinned region without the
+         * table lock. A pinned region is not removed, split or moved.
+         */
+        unsigned int pins = 0;
+        /*being unmapped or replaced; not pinned again*/
+        bool unmapping = false;
+};
+
+static std::mutex regions_lock;
+static std::condition_variable regions_unpinned;
+static std::map<uintptr_t, struct mmap_region> regions;        /*by start*/
+static std::multimap<std::pair<dev_t, ino_t>, uintptr_t> file_regions;
+static std::atomic<unsigned long> nr_regions(0);       /*regions.size(), read without the lock*/
+
+/*where the next sample starts*/
+static uintptr_t cursor_start = 0;
+static size_t cursor_portion = 0;
+
+/*-1 unless idle page tracking works*/
+static int pagemap_fd = -1;
+static int page_idle_fd = -1;
+
+static std::atomic<int> pageout_advice(MADV_PAGEOUT);
+
+static std::atomic<unsigned long> nr_sampled(0);
+static std::atomic<unsigned long> nr_accessed(0);
+static std::atomic<unsigned long> reclaimed_bytes(0);
+
+static inline uintptr_t region_end(const struct mmap_region *r){
+        return r->start + r->length;
+}
+
+static inline off_t first_portion(const struct mmap_region *r){
+        return r->offset >> PVT_HEAP_PG_SHIFT;
+}
+
+static void insert_locked(struct mmap_region &&r){
+        uintptr_t start = r.start;
+        std::pair<dev_t, ino_t> file = std::make_pair(r.dev, r.ino);
+
+        regions[start] = std::move(r);
+        file_regions.insert(std::make_pair(file, start));
+        nr_regions.store(regions.size(), std::memory_order_relaxed);
+}
+
+static void erase_locked(std::map<uintptr_t, struct mmap_region>::iterator it){
+        std::pair<dev_t, ino_t> file = std::make_pair(it->second.dev, it->second.ino);
+        std::multimap<std::pair<dev_t, ino_t>, uintptr_t>::iterator f;
+
+        for(f = file_regions.lower_bound(file); f != file_regions.end() && f->first == file; ++f){
+                if(f->second == it->first){
+                        file_regions.erase(f);
+                        break;
+                }
+        }
+        regions.erase(it);
+        nr_regions.store(regions.size(), std::memory_order_relaxed);
+}
+
+/*The part of r from address lo to hi as a region of its own*/
+static struct mmap_region slice(const struct mmap_region *r, uintptr_t lo, uintptr_t hi){
+        struct mmap_region s;
+        off_t skip;
+
+        s.start = lo;
+        s.length = hi - lo;
+        s.offset = r->offset + (off_t)(lo - r->start);
+        s.dev = r->dev;
+        s.ino = r->ino;
+        skip = first_portion(&s) - first_portion(r);
+        s.nr_resident.assign(r->nr_resident.begin() + skip,
+                        r->nr_resident.begin() + skip + (((s.offset + s.length - 1) >> PVT_HEAP_PG_SHIFT) - first_portion(&s) + 1));
+        return s;
+}
+
+/*Forgets the tracked ranges from lo to hi; the parts of a region outside it stay*/
+static void remove_range_locked(uintptr_t lo, uintptr_t hi){
+        std::map<uintptr_t, struct mmap_region>::iterator it;
+        struct mmap_region r;
+
+        it = regions.upper_bound(lo);
+        if(it != regions.begin()){
+                --it;
+        }
+        while(it != regions.end() && it->first < hi){
+                if(region_end(&it->second) <= lo){
+                        ++it;
+                        continue;
+                }
+                r = std::move(it->second);
+                erase_locked(it);
+                if(r.start < lo){
+                        insert_locked(slice(&r, r.start, lo));
+                }
+                if(hi < region_end(&r)){
+                        insert_locked(slice(&r, hi, region_end(&r)));
+                }
+                it = regions.upper_bound(r.start);
+        }
+}
+
+static void add_locked(uintptr_t start, size_t length, off_t offset, dev_t dev, ino_t ino){
+        struct mmap_region r;
+
+        r.start = start;
+        r.length = length;
+        r.offset = offset;
+        r.dev = dev;
+        r.ino = ino;
+        r.nr_resident.assign(((offset + length - 1) >> PVT_HEAP_PG_SHIFT) - (offset >> PVT_HEAP_PG_SHIFT) + 1, NEVER_SAMPLED);
+        insert_locked(std::move(r));
+}
+
+static void unpin_locked(struct mmap_region *r){
+        if(--r->pins == 0 && r->unmapping){
+                regions_unpinned.notify_all();
+        }
+}
+
+/*
+ * Waits until no region from lo to hi is pinned, so the caller can unmap
+ * or replace the range. The regions are marked so they are not pinned
+ * again meanwhile.
+ */
+static void wait_unpinned_locked(std::unique_lock<std::mutex> &guard, uintptr_t lo, uintptr_t hi){
+        std::map<uintptr_t, struct mmap_region>::iterator it;
+        bool pinned;
+
+        do{
+                pinned = false;
+                it = regions.upper_bound(lo);
+                if(it != regions.begin()){
+                        --it;
+                }
+                for(; it != regions.end() && it->first < hi; ++it){
+                        if(region_end(&it->second) <= lo){
+                                continue;
+                        }
+                        it->second.unmapping = true;
+                        pinned = pinned || it->second.pins > 0;
+                }
+                if(pinned){
+                        regions_unpinned.wait(guard);
+                }
+        }while(pinned);
+}
+
+/*The syscall failed, the regions from lo to hi stay*/
+static void cancel_unmapping_locked(uintptr_t lo, uintptr_t hi){
+        std::map<uintptr_t, struct mmap_region>::iterator it;
+
+        it = regions.upper_bound(lo);
+        if(it != regions.begin()){
+                --it;
+        }
+        for(; it != regions.end() && it->first < hi; ++it){
+                it->second.unmapping = false;
+        }
+}
+
+void mmap_regions_init(){
+        uint64_t entry = 0;
+        volatile char probe = 0;
+
+        page_idle_fd = real_open("/sys/kernel/mm/page_idle/bitmap", O_RDWR, 0);
+        if(page_idle_fd < 0){
+                goto no_idle_tracking;
+        }
+        pagemap_fd = real_open("/proc/self/pagemap", O_RDONLY, 0);
+        if(pagemap_fd < 0){
+                goto no_idle_tracking;
+        }
+
+        /*PFNs read as 0 without CAP_SYS_ADMIN*/
+        probe = 1;
+        if(real_pread(pagemap_fd, &entry, sizeof(entry), ((uintptr_t)&probe >> PAGE_SHIFT) * sizeof(entry)) != sizeof(entry)
+                        || !(entry & PAGEMAP_PRESENT) || !(entry & PAGEMAP_PFN_MASK)){
+                goto no_idle_tracking;
+        }
+        return;
+
+no_idle_tracking:
+        SPEEDYIO_PRINTF("%s:INFO no idle page tracking, mmap accesses are seen on page faults only\n", "SPEEDYIO_INFOCO_0032\n");
+        if(page_idle_fd >= 0){
+                real_close(page_idle_fd);
+                page_idle_fd = -1;
+        }
+        if(pagemap_fd >= 0){
+                real_close(pagemap_fd);
+                pagemap_fd = -1;
+        }
+}
+
+void *mmap_region_map(void *addr, size_t length, int prot, int flags, int fd, off_t offset,
+                bool track, dev_t dev, ino_t ino){
+        void *ret;
+
+        /*a MAP_FIXED mapping replaces whatever was there*/
+        if(!track && (!(flags & MAP_FIXED) || nr_regions.load(std::memory_order_relaxed) == 0)){
+                return real_mmap(addr, length, prot, flags, fd, offset);
+        }
+
+        std::unique_lock<std::mutex> guard(regions_lock);
+
+        if(flags & MAP_FIXED){
+                wait_unpinned_locked(guard, (uintptr_t)addr, PAGE_END((uintptr_t)addr + length));
+        }
+        ret = real_mmap(addr, length, prot, flags, fd, offset);
+        if(ret == MAP_FAILED || length == 0){
+                if(flags & MAP_FIXED){
+                        cancel_unmapping_locked((uintptr_t)addr, PAGE_END((uintptr_t)addr + length));
+                }
+                return ret;
+        }
+        remove_range_locked((uintptr_t)ret, PAGE_END((uintptr_t)ret + length));
+        if(track){
+                add_locked((uintptr_t)ret, length, offset, dev, ino);
+        }
+        return ret;
+}
+
+int mmap_region_unmap(void *addr, size_t length){
+        int ret;
+
+        if(nr_regions.load(std::memory_order_relaxed) == 0){
+                return real_munmap(addr, length);
+        }
+
+        std::unique_lock<std::mutex> guard(regions_lock);
+
+        wait_unpinned_locked(guard, (uintptr_t)addr, PAGE_END((uintptr_t)addr + length));
+        ret = real_munmap(addr, length);
+        if(ret == 0){
+                remove_range_locked((uintptr_t)addr, PAGE_END((uintptr_t)addr + length));
+        }else{
+                cancel_unmapping_locked((uintptr_t)addr, PAGE_END((uintptr_t)addr + length));
+        }
+        return ret;
+}
+
+void *mmap_region_remap(void *old_address, size_t old_size, size_t new_size, int flags, void *new_address){
+        std::map<uintptr_t, struct mmap_region>::iterator it;
+        bool moved = false;
+        struct mmap_region r;
+        void *ret;
+
+        if(nr_regions.load(std::memory_order_relaxed) == 0){
+                return real_mremap(old_address, old_size, new_size, flags, new_address);
+        }
+
+        std::unique_lock<std::mutex> guard(regions_lock);
+
+        /*without MREMAP_FIXED the kernel only grows or moves into unmapped space*/
+        wait_unpinned_locked(guard, (uintptr_t)old_address, PAGE_END((uintptr_t)old_address + old_size));
+        if(flags & MREMAP_FIXED){
+                wait_unpinned_locked(guard, (uintptr_t)new_address, PAGE_END((uintptr_t)new_address + new_size));
+        }
+        ret = real_mremap(old_address, old_size, new_size, flags, new_address);
+        if(ret == MAP_FAILED){
+                cancel_unmapping_locked((uintptr_t)old_address, PAGE_END((uintptr_t)old_address + old_size));
+                if(flags & MREMAP_FIXED){
+                        cancel_unmapping_locked((uintptr_t)new_address, PAGE_END((uintptr_t)new_address + new_size));
+                }
+                return ret;
+        }
+
+        /*only a region starting at old_address is followed to its new place*/
+        it = regions.find((uintptr_t)old_address);
+        if(it != regions.end()){
+                r = it->second;
+                moved = true;
+        }
+        remove_range_locked((uintptr_t)old_address, PAGE_END((uintptr_t)old_address + old_size));
+        remove_range_locked((uintptr_t)ret, PAGE_END((uintptr_t)ret + new_size));
+        if(moved){
+                add_locked((uintptr_t)ret, new_size, r.offset, r.dev, r.ino);
+        }
+        return ret;
+}
+
+/*true if any of upto MMAP_IDLE_SAMPLES resident pages was touched since the last sample; marks them idle again*/
+static bool touched_since_last_sample(uintptr_t addr, unsigned long nr_pages, const unsigned char *vec, unsigned long nr_resident){
+        uint64_t entries[PAGES_PER_PORTION];
+        uint64_t pfn, word;
+        unsigned long step, i, seen = 0;
+        bool touched = false;
+        ssize_t nr_read;
+
+        nr_read = real_pread(pagemap_fd, entries, nr_pages * sizeof(uint64_t), (addr >> PAGE_SHIFT) * sizeof(uint64_t));
+        if(nr_read != (ssize_t)(nr_pages * sizeof(uint64_t))){
+                return false;
+        }
+
+        step = nr_resident > MMAP_IDLE_SAMPLES ? nr_resident / MMAP_IDLE_SAMPLES : 1;
+        for(i = 0; i < nr_pages; i++){
+                if(!(vec[i] & 1) || (seen++ % step) != 0){
+                        continue;
+                }
+                if(!(entries[i] & PAGEMAP_PRESENT)){
+                        continue;
+                }
+                pfn = entries[i] & PAGEMAP_PFN_MASK;
+                if(real_pread(page_idle_fd, &word, sizeof(word), (pfn / 64) * sizeof(word)) != sizeof(word)){
+                        continue;
+                }
+                if(!(word & (1ULL << (pfn % 64)))){
+                        touched = true;
+                }
+                word = 1ULL << (pfn % 64);
+                if(real_pwrite(page_idle_fd, &word, sizeof(word), (pfn / 64) * sizeof(word)) != sizeof(word)){
+                        continue;
+                }
+        }
+        return touched;
+}
+
+/*Samples portion i of r; returns true if it was accessed*/
+static bool sample_portion(struct mmap_region *r, size_t i, off_t *lo, off_t *hi){
+        unsigned char vec[PAGES_PER_PORTION];
+        unsigned long nr_pages, nr_resident = 0;
+        uint32_t last;
+        uintptr_t addr;
+        bool accessed;
+
+        *lo = std::max(r->offset, (first_portion(r) + (off_t)i) << PVT_HEAP_PG_SHIFT);
+        *hi = std::min(r->offset + (off_t)r->length, (first_portion(r) + (off_t)i + 1) << PVT_HEAP_PG_SHIFT);
+        addr = r->start + (uintptr_t)(*lo - r->offset);
+        nr_pages = ((unsigned long)(*hi - *lo) + (1UL << PAGE_SHIFT) - 1) >> PAGE_SHIFT;
+
+        if(mincore((void *)addr, (size_t)(*hi - *lo), vec) != 0){
+                return false;
+        }
+        for(unsigned long p = 0; p < nr_pages; p++){
+                nr_resident += vec[p] & 1;
+        }
+
+        last = r->nr_resident[i];
+        r->nr_resident[i] = (uint32_t)nr_resident;
+        accessed = nr_resident > (last == NEVER_SAMPLED ? 0 : last);
+        if(pagemap_fd >= 0 && nr_resident > 0){
+                /*marks the sampled pages idle on the first sample too*/
+                accessed = touched_since_last_sample(addr, nr_pages, vec, nr_resident) || accessed;
+        }
+        return accessed;
+}
+
+void mmap_sample(std::vector<struct mmap_access> *accessed){
+        std::map<uintptr_t, struct mmap_region>::iterator it;
+        unsigned long budget = MMAP_SAMPLE_PORTIONS, nr = 0;
+        struct mmap_region *r;
+        size_t i, nr_visited;
+        off_t lo, hi;
+
+        if(nr_regions.load(std::memory_order_relaxed) == 0){
+                return;
+        }
+
+        std::unique_lock<std::mutex> guard(regions_lock);
+
+        it = regions.lower_bound(cursor_start);
+        if(it == regions.end() || it->first != cursor_start){
+                cursor_portion = 0;
+        }
+        for(nr_visited = 0; nr_visited < regions.size() && budget > 0; nr_visited++){
+                if(it == regions.end()){
+                        it = regions.begin();
+                }
+                r = &it->second;
+                i = (it->first == cursor_start) ? cursor_portion : 0;
+                if(r->unmapping){
+                        goto next_region;
+                }
+
+                /*the mincore and pagemap reads of a region do not hold up maps of others*/
+                r->pins++;
+                guard.unlock();
+                for(; i < r->nr_resident.size() && budget > 0; i++, budget--){
+                        nr++;
+                        if(!sample_portion(r, i, &lo, &hi)){
+                                continue;
+                        }
+                        nr_accessed.fetch_add(1, std::memory_order_relaxed);
+                        /*neighbouring portions go in as one range, like a large read*/
+                        if(!accessed->empty() && accessed->back().dev == r->dev && accessed->back().ino == r->ino
+                                        && accessed->back().offset + (off_t)accessed->back().size == lo){
+                                accessed->back().size += (size_t)(hi - lo);
+                        }else{
+                                accessed->push_back({r->dev, r->ino, lo, (size_t)(hi - lo)});
+                        }
+                }
+                guard.lock();
+                unpin_locked(r);
+
+                if(budget == 0 && i < r->nr_resident.size()){
+                        cursor_start = it->first;
+                        cursor_portion = i;
+                        break;
+                }
+next_region:
+                cursor_portion = 0;
+                ++it;
+                cursor_start = (it == regions.end()) ? 0 : it->first;
+        }
+        nr_sampled.fetch_add(nr, std::memory_order_relaxed);
+}
+
+size_t mmap_reclaim(dev_t dev, ino_t ino, off_t offset, size_t size){
+        std::pair<dev_t, ino_t> file = std::make_pair(dev, ino);
+        std::multimap<std::pair<dev_t, ino_t>, uintptr_t>::iterator f;
+        std::vector<struct mmap_region *> pinned;
+        struct mmap_region *r;
+        off_t lo, hi;
+        size_t done = 0;
+        int advice;
+
+        if(nr_regions.load(std::memory_order_relaxed) == 0){
+                return 0;
+        }
+
+        std::unique_lock<std::mutex> guard(regions_lock);
+
+        for(f = file_regions.lower_bound(file); f != file_regions.end() && f->first == file; ++f){
+                r = &regions.find(f->second)->second;
+                if(r->unmapping || std::max(offset, r->offset) >= std::min(offset + (off_t)size, r->offset + (off_t)r->length)){
+                        continue;
+                }
+                r->pins++;
+                pinned.push_back(r);
+        }
+        if(pinned.empty()){
+                return 0;
+        }
+
+        /*the pageouts do not hold up maps and unmaps of other regions*/
+        guard.unlock();
+        for(struct mmap_region *p : pinned){
+                lo = std::max(offset, p->offset);
+                hi = std::min(offset + (off_t)size, p->offset + (off_t)p->length);
+                advice = pageout_advice.load(std::memory_order_relaxed);
+                if(real_madvise((void *)(p->start + (uintptr_t)(lo - p->offset)), (size_t)(hi - lo), advice) != 0){
+                        if(errno == EINVAL && advice == MADV_PAGEOUT){
+                                /*before 5.4; the pages go to the inactive list instead*/
+                                pageout_advice.store(MADV_COLD, std::memory_order_relaxed);
+                                real_madvise((void *)(p->start + (uintptr_t)(lo - p->offset)), (size_t)(hi - lo), MADV_COLD);
+                        }
+                }
+                done += (size_t)(hi - lo);
+        }
+        guard.lock();
+        for(struct mmap_region *p : pinned){
+                unpin_locked(p);
+        }
+
+        reclaimed_bytes.fetch_add(done, std::memory_order_relaxed);
+        return done;
+}
+
+void get_mmap_regions_stats(struct mmap_regions_stats *stats){
+        stats->nr_regions = nr_regions.load(std::memory_order_relaxed);
+        stats->nr_sampled = nr_sampled.load(std::memory_order_relaxed);
+        stats->nr_accessed = nr_accessed.load(std::memory_order_relaxed);
+        stats->reclaimed_bytes = reclaimed_bytes.load(std::memory_order_relaxed);
+        stats->idle_tracking = pagemap_fd >= 0;
+}
@@ -0,0 +1,90 @@
+#ifndef _MMAP_REGIONS_HPP
+#define _MMAP_REGIONS_HPP
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <vector>
+
+/**
+ * Mappings of whitelisted files (Cassandra's disk_access_mode mmap and
+ * mmap_index_only).
+ *
+ * Reads through a mapping never reach read(), so the evictor does not
+ * see them, and DONTNEED skips mapped pages. For these files:
+ * - mmap/munmap/mremap keep a table of the mapped ranges. Only mappings
+ *   of whitelisted fds are tracked; other mappings only take the table
+ *   lock if they could replace a tracked one (MAP_FIXED, mremap).
+ * - every MMAP_SAMPLE_MS the evictor samples upto MMAP_SAMPLE_PORTIONS
+ *   mapped portions, round robin. A portion was accessed if more of it
+ *   is resident than at the last sample (mincore), or, with idle page
+ *   tracking (/sys/kernel/mm/page_idle, needs CAP_SYS_ADMIN for the PFNs
+ *   in /proc/self/pagemap), if any of MMAP_IDLE_SAMPLES of its resident
+ *   pages was touched since the last sample. Accessed portions go in
+ *   the heaps as reads would.
+ * - evicting a portion MADV_PAGEOUTs (MADV_COLD before 5.4) the mapped
+ *   ranges of it before the DONTNEED.
+ *
+ * Without idle page tracking a portion that stays resident is only seen
+ * on its first sample, so it ages out even if hot; it is seen again as
+ * soon as it faults back in after the PAGEOUT.
+ *
+ * The evictor pins the regions it samples or advises and works on them
+ * without the table lock. munmap, mremap and MAP_FIXED mmap wait for the
+ * pins on the regions they replace, so the evictor never advises an
+ * address range that was unmapped and reused, and maps of other ranges
+ * do not wait for it.
+ */
+
+#ifndef MMAP_SAMPLE_MS
+#define MMAP_SAMPLE_MS 1000
+#endif
+
+/*most portions sampled every MMAP_SAMPLE_MS*/
+#ifndef MMAP_SAMPLE_PORTIONS
+#define MMAP_SAMPLE_PORTIONS 4096
+#endif
+
+/*resident pages of a portion whose idle bits are checked*/
+#ifndef MMAP_IDLE_SAMPLES
+#define MMAP_IDLE_SAMPLES 8
+#endif
+
+/*A range of a file accessed through a mapping*/
+struct mmap_access {
+        dev_t dev;
+        ino_t ino;
+        off_t offset;
+        size_t size;
+};
+
+/*Opens the idle page tracking files. Call from the thread that samples*/
+void mmap_regions_init();
+
+/**
+ * mmap, munmap and mremap, keeping the table up to date. track is true
+ * if the mapping is of a whitelisted file (dev, ino) and should be
+ * sampled.
+ */
+void *mmap_region_map(void *addr, size_t length, int prot, int flags, int fd, off_t offset,
+                bool track, dev_t dev, ino_t ino);
+int mmap_region_unmap(void *addr, size_t length);
+void *mmap_region_remap(void *old_address, size_t old_size, size_t new_size, int flags, void *new_address);
+
+/*Samples the next portions, appends the accessed ranges to accessed*/
+void mmap_sample(std::vector<struct mmap_access> *accessed);
+
+/*Pages out the mapped ranges of the file from offset to offset+size. Returns the bytes advised*/
+size_t mmap_reclaim(dev_t dev, ino_t ino, off_t offset, size_t size);
+
+struct mmap_regions_stats {
+        unsigned long nr_regions;
+        unsigned long nr_sampled;       /*portions*/
+        unsigned long nr_accessed;      /*sampled portions that were accessed*/
+        unsigned long reclaimed_bytes;  /*advised out by mmap_reclaim*/
+        bool idle_tracking;
+};
+
+void get_mmap_regions_stats(struct mmap_regions_stats *stats);
+
+#endif //_MMAP_REGIONS_HPP
@@ -0,0 +1,132 @@
+#include "catch_amalgamated.hpp"
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "utils/mmap_regions/mmap_regions.hpp"
+
+#define MB (1UL << 20)
+
+/*opens the idle page tracking files once for the whole binary*/
+static void init_once(){
+        static bool done = (mmap_regions_init(), true);
+
+        (void)done;
+}
+
+static unsigned long nr_regions(){
+        struct mmap_regions_stats stats;
+
+        get_mmap_regions_stats(&stats);
+        return stats.nr_regions;
+}
+
+static int make_file(size_t size){
+        char path[] = "/tmp/test_mmap_regions.XXXXXX";
+        int fd = mkstemp(path);
+
+        REQUIRE(fd >= 0);
+        unlink(path);
+        REQUIRE(ftruncate(fd, size) == 0);
+        return fd;
+}
+
+TEST_CASE("Unmapping part of a region keeps the rest tracked", "[mmap_regions][split]"){
+        init_once();
+        int fd = make_file(8 * MB);
+        char *p = (char *)mmap_region_map(NULL, 8 * MB, PROT_READ, MAP_SHARED, fd, 0, true, 1, 10);
+
+        REQUIRE(p != MAP_FAILED);
+        REQUIRE(nr_regions() == 1);
+
+        REQUIRE(mmap_region_unmap(p + 2 * MB, 2 * MB) == 0);
+        CHECK(nr_regions() == 2);
+
+        /*the unmapped part is not advised, other files have nothing mapped*/
+        CHECK(mmap_reclaim(1, 10, 0, 8 * MB) == 6 * MB);
+        CHECK(mmap_reclaim(1, 10, 5 * MB, 1 * MB) == 1 * MB);
+        CHECK(mmap_reclaim(1, 11, 0, 8 * MB) == 0);
+
+        REQUIRE(mmap_region_unmap(p, 8 * MB) == 0);
+        CHECK(nr_regions() == 0);
+        close(fd);
+}
+
+TEST_CASE("A MAP_FIXED mapping over a tracked one replaces it", "[mmap_regions][fixed]"){
+        init_once();
+        int fd = make_file(4 * MB);
+        char *p = (char *)mmap_region_map(NULL, 4 * MB, PROT_READ, MAP_SHARED, fd, 0, true, 1, 20);
+
+        REQUIRE(p != MAP_FAILED);
+        REQUIRE(mmap_region_map(p, 1 * MB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0, false, 0, 0) == p);
+        CHECK(nr_regions() == 1);
+        CHECK(mmap_reclaim(1, 20, 0, 4 * MB) == 3 * MB);
+
+        REQUIRE(mmap_region_unmap(p, 4 * MB) == 0);
+        CHECK(nr_regions() == 0);
+        close(fd);
+}
+
+TEST_CASE("Faulted in portions are seen accessed once", "[mmap_regions][sample]"){
+        init_once();
+        int fd = make_file(8 * MB);
+        volatile char *p = (volatile char *)mmap_region_map(NULL, 8 * MB, PROT_READ, MAP_SHARED, fd, 0, true, 1, 30);
+        std::vector<struct mmap_access> accessed;
+        char c = 0;
+
+        REQUIRE(p != MAP_FAILED);
+
+        /*no fault around, only what is touched is read in*/
+        madvise((void *)p, 8 * MB, MADV_RANDOM);
+        for(size_t i = 2 * MB; i < 6 * MB; i += 4096){
+                c += p[i];
+        }
+        (void)c;
+
+        /*neighbouring portions are one range*/
+        mmap_sample(&accessed);
+        REQUIRE(accessed.size() == 1);
+        CHECK(accessed[0].offset == (off_t)(2 * MB));
+        CHECK(accessed[0].size == 4 * MB);
+
+        accessed.clear();
+        mmap_sample(&accessed);
+        CHECK(accessed.empty());
+
+        REQUIRE(mmap_region_unmap((void *)p, 8 * MB) == 0);
+        close(fd);
+}
+
+TEST_CASE("Mapping and unmapping while the evictor samples and pages out", "[mmap_regions][concurrent]"){
+        init_once();
+        int fd = make_file(4 * MB);
+        std::atomic<bool> stop(false);
+        std::thread evictor([&](){
+                std::vector<struct mmap_access> accessed;
+
+                while(!stop.load()){
+                        mmap_reclaim(1, 40, 0, 4 * MB);
+                        accessed.clear();
+                        mmap_sample(&accessed);
+                }
+        });
+        bool ok = true;
+
+        for(int i = 0; i < 2000 && ok; i++){
+                char *p = (char *)mmap_region_map(NULL, 4 * MB, PROT_READ, MAP_SHARED, fd, 0, true, 1, 40);
+
+                ok = p != MAP_FAILED && mmap_region_unmap(p + 1 * MB, 1 * MB) == 0 && mmap_region_unmap(p, 4 * MB) == 0;
+        }
+        stop.store(true);
+        evictor.join();
+
+        CHECK(ok);
+        CHECK(nr_regions() == 0);
+        close(fd);
+}
@@ -26,6 +26,9 @@ struct AppCfg {
     /* scalars */
     char       start_stop_path[PATH_MAX];
     char       licensekeys_path[PATH_MAX];
+    char       admin_socket_path[PATH_MAX];   /* "@name" for an abstract socket */
+    char       trace_dir[PATH_MAX];           /* starts I/O tracing at startup if set */
+    int        trace_raw;                     /* trace without compression */
 
     /* new */
     net_addr_t server;          /* OPT_ADDR */
@@ -33,6 +36,8 @@ struct AppCfg {
 
     /* lists */
     char      *devices [MAX_DEVICES];   size_t n_devices;
+    char      *whitelist_rules [MAX_WHITELIST_RULES];   size_t n_whitelist_rules;
+    char      *cache_classes [MAX_CACHE_CLASS_SPECS];   size_t n_cache_classes;
 };
 
 extern struct AppCfg *cfg;
\ No newline at end of file
@@ -40,6 +40,8 @@ int get_config(){
 
         /* temporary list sinks */
         str_list_sink_t devices_sink  = {cfg->devices, MAX_DEVICES, &cfg->n_devices};
+        str_list_sink_t whitelist_sink = {cfg->whitelist_rules, MAX_WHITELIST_RULES, &cfg->n_whitelist_rules};
+        str_list_sink_t cache_class_sink = {cfg->cache_classes, MAX_CACHE_CLASS_SPECS, &cfg->n_cache_classes};
 
         option_spec_t spec[] = {
                 /* key, type, dest, dest_sz, min, max, flags, seen */
@@ -47,13 +49,18 @@ int get_config(){
 #ifdef ENABLE_LICENSE
                 {"licensekey_dir", OPT_PATH, cfg->licensekeys_path, sizeof(cfg->licensekeys_path), 0, 0, OPTF_PATH_MUST_BE_DIR | OPTF_REQUIRED, 0},
 #endif //ENABLE_LICENSE
+                {"admin_socket", OPT_STR, cfg->admin_socket_path, sizeof(cfg->admin_socket_path), 0, 0, OPTF_OPTIONAL, 0},
+                {"trace_dir", OPT_PATH, cfg->trace_dir, sizeof(cfg->trace_dir), 0, 0, OPTF_PATH_MUST_BE_DIR | OPTF_OPTIONAL, 0},
+                {"trace_raw", OPT_BOOL, &cfg->trace_raw, 0, 0, 0, OPTF_OPTIONAL, 0},
 
                 /* address and URL */
                 {"server", OPT_ADDR, &cfg->server, 0, 0, 0, OPTF_OPTIONAL, 0},
                 {"api_base", OPT_URL, cfg->api_base, sizeof(cfg->api_base), 0, 0, OPTF_OPTIONAL, 0},
 
                 /* arrays */
-                {"devices", OPT_STR_LIST, &devices_sink, 0, 0, 0, OPTF_OPTIONAL, 0}
+                {"devices", OPT_STR_LIST, &devices_sink, 0, 0, 0, OPTF_OPTIONAL, 0},
+                {"whitelist_rule", OPT_STR_LIST, &whitelist_sink, 0, 0, 0, OPTF_OPTIONAL, 0},
+                {"cache_class", OPT_STR_LIST, &cache_class_sink, 0, 0, 0, OPTF_OPTIONAL, 0}
         };
 
         if(!env || !*env){
@@ -720,9 +727,24 @@ int config_load_schema(const char *filename,
                 char *key = trim(p);
                 char *val = trim(eq + 1);
 
-                /* top-level quote handling; qflag: 0 none, 1 single, 2 double */
+                option_spec_t *os = find_spec(spec, nspec, key);
+                if (!os) {
+                        if (!allow_unknown) {
+                                fprintf(stderr, "%s:%d: unknown key '%s'\n", filename, lineno, key);
+                                rc = -1; break;
+                        }
+                        continue;
+                }
+
+                /*
+                 * top-level quote handling; qflag: 0 none, 1 single, 2 double
+                 * Lists keep their quotes, they are handled per item so that
+                 * key = 'a', 'b' does not drop everything after 'a'.
+                 */
                 unsigned char qflag = 0;
-                if (*val == '"' || *val == '\'') {
+                int is_list = (os->type == OPT_STR_LIST || os->type == OPT_INT_LIST ||
+                                os->type == OPT_PATH_LIST);
+                if (!is_list && (*val == '"' || *val == '\'')) {
                         char quote = *val;
                         qflag = (quote == '"') ? 2 : 1;
                         char *q = val + 1;
@@ -742,15 +764,6 @@ int config_load_schema(const char *filename,
                         val = trim(val);
                 }
 
-                option_spec_t *os = find_spec(spec, nspec, key);
-                if (!os) {
-                        if (!allow_unknown) {
-                                fprintf(stderr, "%s:%d: unknown key '%s'\n", filename, lineno, key);
-                                rc = -1; break;
-                        }
-                        continue;
-                }
-
                 if (assign_value(os, val, qflag, lineno, filename) != 0) { rc = -1; break; }
                 os->seen = 1;
         }
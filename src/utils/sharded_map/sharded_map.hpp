@@ -0,0 +1,141 @@
+#pragma once
+
+#include <stdlib.h>
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+/**
+ * ShardedMap<K, V, Hash, KeyEqual, NR_SHARDS, Lock>
+ * - A hash map split into NR_SHARDS independent std::unordered_maps,
+ *   each guarded by its own mutex on its own cache line.
+ * - A key always lives in the shard picked by its hash, so operations
+ *   on keys in different shards never contend on the same lock.
+ * - Plain find/insert/erase take the shard lock themselves.
+ * - Compound operations (eg. lookup-or-insert without duplicates) take
+ *   shard_lock(key) and use the *_locked variants.
+ * - erase_if() walks one shard at a time, so a full sweep only ever
+ *   blocks the keys of the shard being scanned.
+ *
+ * Pointers returned by find are stable until that key is erased
+ * (std::unordered_map never moves nodes on rehash).
+ *
+ * NR_SHARDS must be a power of 2. Lock is anything with lock/unlock,
+ * std::mutex by default.
+ *
+ * Example:
+ *   ShardedMap<int, void *, std::hash<int>> m(1024);
+ *   m.insert(1, ptr);
+ *   void **v = m.find(1);
+ */
+template <typename K, typename V, typename Hash,
+          typename KeyEqual = std::equal_to<K>, std::size_t NR_SHARDS = 64,
+          typename Lock = std::mutex>
+class ShardedMap {
+    static_assert(NR_SHARDS && !(NR_SHARDS & (NR_SHARDS - 1)), "NR_SHARDS must be a power of 2");
+
+public:
+    using size_type = std::size_t;
+    using map_type  = std::unordered_map<K, V, Hash, KeyEqual>;
+
+    explicit ShardedMap(size_type expected_entries = 0) {
+        for (size_type i = 0; i < NR_SHARDS; i++)
+            shards_[i].map.reserve(expected_entries / NR_SHARDS + 1);
+    }
+
+    ShardedMap(const ShardedMap &) = delete;
+    ShardedMap &operator=(const ShardedMap &) = delete;
+
+    // plain new does not honour alignas(64) of the shards before C++17
+    static void *operator new(std::size_t sz) {
+        void *p;
+        if (posix_memalign(&p, alignof(ShardedMap), sz))
+            throw std::bad_alloc();
+        return p;
+    }
+
+    static void operator delete(void *p) { free(p); }
+
+    Lock &shard_lock(const K &key) { return shard_of(key).lock; }
+
+    // Caller must hold shard_lock(key)
+    V *find_locked(const K &key) {
+        map_type &m = shard_of(key).map;
+        auto it = m.find(key);
+        return (it == m.end()) ? nullptr : &it->second;
+    }
+
+    // Caller must hold shard_lock(key). Returns false if key already exists.
+    bool insert_locked(const K &key, const V &val) {
+        return shard_of(key).map.emplace(key, val).second;
+    }
+
+    // Caller must hold shard_lock(key). Returns false if key was not found.
+    bool erase_locked(const K &key) {
+        return shard_of(key).map.erase(key) > 0;
+    }
+
+    V *find(const K &key) {
+        std::lock_guard<Lock> guard(shard_lock(key));
+        return find_locked(key);
+    }
+
+    bool insert(const K &key, const V &val) {
+        std::lock_guard<Lock> guard(shard_lock(key));
+        return insert_locked(key, val);
+    }
+
+    bool erase(const K &key) {
+        std::lock_guard<Lock> guard(shard_lock(key));
+        return erase_locked(key);
+    }
+
+    /**
+     * Calls pred(key, val) on every entry, shard by shard with only that
+     * shard's lock held, and erases the entries for which it returns true.
+     * Returns the number of entries visited.
+     */
+    template <typename Pred>
+    size_type erase_if(Pred pred) {
+        size_type nr_visited = 0;
+        for (size_type i = 0; i < NR_SHARDS; i++) {
+            std::lock_guard<Lock> guard(shards_[i].lock);
+            map_type &m = shards_[i].map;
+            for (auto it = m.begin(); it != m.end(); ) {
+                nr_visited++;
+                if (pred(it->first, it->second))
+                    it = m.erase(it);
+                else
+                    ++it;
+            }
+        }
+        return nr_visited;
+    }
+
+    // Approximate when other threads are inserting/erasing concurrently
+    size_type size() {
+        size_type total = 0;
+        for (size_type i = 0; i < NR_SHARDS; i++) {
+            std::lock_guard<Lock> guard(shards_[i].lock);
+            total += shards_[i].map.size();
+        }
+        return total;
+    }
+
+private:
+    struct alignas(64) Shard {
+        Lock lock;
+        map_type map;
+    };
+
+    Shard &shard_of(const K &key) {
+        size_type h = Hash()(key);
+        // fold the high bits in so shard choice and bucket choice differ
+        return shards_[(h ^ (h >> 32)) & (NR_SHARDS - 1)];
+    }
+
+    Shard shards_[NR_SHARDS];
+};
@@ -0,0 +1,130 @@
+#include "catch_amalgamated.hpp"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils/sharded_map/sharded_map.hpp"
+
+#define NR_THREADS 8
+#define NR_KEYS 20000
+
+typedef ShardedMap<long, long, std::hash<long>> map_t;
+
+TEST_CASE("find, insert and erase", "[sharded_map][basic]"){
+        map_t m(1024);
+
+        REQUIRE(m.find(1) == nullptr);
+        REQUIRE(m.insert(1, 10));
+        REQUIRE_FALSE(m.insert(1, 11));
+        REQUIRE(m.find(1) != nullptr);
+        CHECK(*m.find(1) == 10);
+        CHECK(m.size() == 1);
+
+        REQUIRE(m.erase(1));
+        REQUIRE_FALSE(m.erase(1));
+        CHECK(m.find(1) == nullptr);
+        CHECK(m.size() == 0);
+}
+
+TEST_CASE("Pointers from find survive rehashes", "[sharded_map][stable]"){
+        map_t m;
+        long *first;
+
+        REQUIRE(m.insert(0, 0));
+        first = m.find(0);
+        for(long k = 1; k < NR_KEYS; k++){
+                REQUIRE(m.insert(k, k));
+        }
+        CHECK(m.find(0) == first);
+        CHECK(m.size() == NR_KEYS);
+}
+
+TEST_CASE("erase_if visits every entry once", "[sharded_map][erase_if]"){
+        map_t m;
+
+        for(long k = 0; k < NR_KEYS; k++){
+                m.insert(k, k * 2);
+        }
+        CHECK(m.erase_if([](const long &k, long &v){ return v != k * 2 || k % 2; }) == NR_KEYS);
+        CHECK(m.size() == NR_KEYS / 2);
+        CHECK(m.find(3) == nullptr);
+        CHECK(m.find(4) != nullptr);
+}
+
+TEST_CASE("Heap allocated maps honour the shard alignment", "[sharded_map][align]"){
+        map_t *m = new map_t(1024);
+
+        CHECK(((uintptr_t)m & 63) == 0);
+        m->insert(1, 1);
+        delete m;
+}
+
+TEST_CASE("Lookup-or-insert under the shard lock from many threads", "[sharded_map][concurrent]"){
+        map_t m;
+        std::atomic<long> nr_inserted(0);
+        std::atomic<long> nr_erased(0);
+        std::atomic<long> nr_bad(0);
+        std::atomic<bool> stop(false);
+        std::vector<std::thread> threads;
+
+        /*every thread tries to add every key; exactly one wins each*/
+        for(int t = 0; t < NR_THREADS; t++){
+                threads.emplace_back([&, t](){
+                        for(long i = 0; i < NR_KEYS; i++){
+                                long k = (i + t * 997) % NR_KEYS;
+                                std::lock_guard<std::mutex> guard(m.shard_lock(k));
+
+                                if(m.find_locked(k)){
+                                        continue;
+                                }
+                                if(m.insert_locked(k, k)){
+                                        nr_inserted++;
+                                }else{
+                                        nr_bad++;
+                                }
+                        }
+                });
+        }
+        /*a sweep over all the shards while they insert, like the uinode cleanup*/
+        std::thread sweeper([&](){
+                while(!stop.load(std::memory_order_relaxed)){
+                        m.erase_if([&](const long &k, long &v){
+                                if(v != k){
+                                        nr_bad++;
+                                }
+                                return false;
+                        });
+                }
+        });
+        for(auto &th : threads){
+                th.join();
+        }
+        stop.store(true);
+        sweeper.join();
+
+        CHECK(nr_bad.load() == 0);
+        CHECK(nr_inserted.load() == NR_KEYS);
+        CHECK(m.size() == NR_KEYS);
+
+        /*and erased by many threads, each key once*/
+        threads.clear();
+        for(int t = 0; t < NR_THREADS; t++){
+                threads.emplace_back([&](){
+                        for(long k = 0; k < NR_KEYS; k++){
+                                if(m.erase(k)){
+                                        nr_erased++;
+                                }
+                        }
+                });
+        }
+        for(auto &th : threads){
+                th.join();
+        }
+        CHECK(nr_erased.load() == NR_KEYS);
+        CHECK(m.size() == 0);
+}
@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "shards.hpp"
+
+std::atomic<uint32_t> shards_threshold(0);
+struct lat_tracker shards_mrc_hist;
+
+/*
+ * Sampled hashes wait in one of two buffers till the thread swaps them.
+ * All zero, so statically initialized.
+ */
+static pthread_mutex_t shards_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t sample_buf[2][SHARDS_BUF_ENTRIES];
+static int active_buf = 0;
+static unsigned int nr_pending = 0;
+
+static std::atomic<unsigned long> nr_dropped(0);
+static std::atomic<unsigned long> nr_sampled(0);
+static std::atomic<unsigned long> nr_keys(0);
+static std::atomic<unsigned long> est_accesses(0);
+static std::atomic<unsigned long> est_cold(0);
+
+#define SHARDS_TREE_SIZE (4 * SHARDS_MAX_KEYS)
+
+/*
+ * Stack distance state, only touched by the shards thread.
+ * A Fenwick tree over access times has a 1 at the latest access of every
+ * tracked portion; the distinct portions since a portion's last access
+ * are the ones marked after it.
+ */
+struct shards_state {
+        std::unordered_map<uint64_t, uint32_t> last_access;
+        std::vector<int32_t> tree;
+        uint32_t clock;
+        double hist[NR_POW2_LATENCY_BINS];
+        double accesses;
+        double cold;
+};
+
+static struct shards_state *state = nullptr;
+static pthread_t shards_thread;
+
+static void tree_add(uint32_t pos, int32_t val){
+        for(size_t i = pos + 1; i < state->tree.size(); i += i & -i){
+                state->tree[i] += val;
+        }
+}
+
+/*marks in [0, pos)*/
+static long tree_prefix(uint32_t pos){
+        long sum = 0;
+
+        for(size_t i = pos; i > 0; i -= i & -i){
+                sum += state->tree[i];
+        }
+        return sum;
+}
+
+/*Renumbers the tracked portions 0..n-1 in access order when the clock runs out*/
+static void compact(){
+        std::vector<std::pair<uint32_t, uint64_t>> live;
+
+        live.reserve(state->last_access.size());
+        for(auto &it : state->last_access){
+                live.push_back(std::make_pair(it.second, it.first));
+        }
+        std::sort(live.begin(), live.end());
+
+        std::fill(state->tree.begin(), state->tree.end(), 0);
+        for(uint32_t i = 0; i < live.size(); i++){
+                state->last_access[live[i].second] = i;
+                tree_add(i, 1);
+        }
+        state->clock = live.size();
+}
+
+/*Halves the sampling rate and forgets the portions it no longer samples*/
+static void lower_rate(){
+        uint32_t threshold = shards_threshold.load(std::memory_order_relaxed) / 2;
+
+        if(threshold == 0){
+                return;
+        }
+        shards_threshold.store(threshold, std::memory_order_relaxed);
+
+        for(auto it = state->last_access.begin(); it != state->last_access.end();){
+                if((it->first & SHARDS_MODULUS_MASK) >= threshold){
+                        tree_add(it->second, -1);
+                        it = state->last_access.erase(it);
+                }else{
+                        it++;
+                }
+        }
+}
+
+static void process_sample(uint64_t hash){
+        uint32_t threshold = shards_threshold.load(std::memory_order_relaxed);
+        double weight, size;
+        long dist;
+        int bin;
+
+        /*sampled before the rate was lowered*/
+        if((hash & SHARDS_MODULUS_MASK) >= threshold){
+                return;
+        }
+        weight = (double)(1UL << SHARDS_MODULUS_BITS) / threshold;
+
+        auto it = state->last_access.find(hash);
+        if(it != state->last_access.end()){
+                dist = tree_prefix(state->clock) - tree_prefix(it->second + 1);
+                tree_add(it->second, -1);
+
+                /*an LRU cache of size portions is the smallest that hits*/
+                size = dist * weight + 1;
+                bin = size <= 1 ? 0 : (int)ceil(log2(size));
+                if(bin >= NR_POW2_LATENCY_BINS){
+                        bin = NR_POW2_LATENCY_BINS - 1;
+                }
+                state->hist[bin] += weight;
+        }else{
+                state->cold += weight;
+        }
+        state->accesses += weight;
+
+        if(state->clock == SHARDS_TREE_SIZE){
+                compact();
+        }
+        state->last_access[hash] = state->clock;
+        tree_add(state->clock, 1);
+        state->clock++;
+
+        if(state->last_access.size() > SHARDS_MAX_KEYS){
+                lower_rate();
+        }
+}
+
+static void publish(){
+        for(int i = 0; i < NR_POW2_LATENCY_BINS; i++){
+                shards_mrc_hist.latencies_bin_ctr[i].store(llround(state->hist[i]), std::memory_order_relaxed);
+        }
+        est_accesses.store(llround(state->accesses), std::memory_order_relaxed);
+        est_cold.store(llround(state->cold), std::memory_order_relaxed);
+        nr_keys.store(state->last_access.size(), std::memory_order_relaxed);
+}
+
+static void *shards_worker(void *arg){
+        struct timespec ts;
+        unsigned int nr;
+        int buf;
+
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+
+        ts.tv_sec = SHARDS_PROCESS_MS / 1000;
+        ts.tv_nsec = (SHARDS_PROCESS_MS % 1000) * 1000000L;
+
+        while(true){
+                /*nanosleep is a cancellation point*/
+                nanosleep(&ts, NULL);
+
+                pthread_mutex_lock(&shards_lock);
+                buf = active_buf;
+                nr = nr_pending;
+                active_buf ^= 1;
+                nr_pending = 0;
+                pthread_mutex_unlock(&shards_lock);
+
+                if(nr == 0){
+                        continue;
+                }
+
+                pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+                for(unsigned int i = 0; i < nr; i++){
+                        process_sample(sample_buf[buf][i]);
+                }
+                nr_sampled.fetch_add(nr, std::memory_order_relaxed);
+                publish();
+                pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        }
+        return NULL;
+}
+
+void __shards_record(uint64_t hash){
+        pthread_mutex_lock(&shards_lock);
+        if(nr_pending < SHARDS_BUF_ENTRIES){
+                sample_buf[active_buf][nr_pending++] = hash;
+        }else{
+                nr_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        pthread_mutex_unlock(&shards_lock);
+}
+
+/*A forked child has no shards thread; it does not sample*/
+static void shards_atfork_child(){
+        shards_threshold.store(0, std::memory_order_relaxed);
+        pthread_mutex_init(&shards_lock, NULL);
+        nr_pending = 0;
+}
+
+int init_shards(unsigned long sample_ppm){
+        uint32_t threshold;
+
+        if(sample_ppm == 0 || sample_ppm > 1000000){
+                SPEEDYIO_FPRINTF("%s:ERROR invalid sample_ppm:%lu\n", "SPEEDYIO_ERRCO_0247 %lu\n", sample_ppm);
+                return -1;
+        }
+
+        if(state){
+                return 0;
+        }
+
+        try{
+                state = new struct shards_state;
+                state->tree.assign(SHARDS_TREE_SIZE + 1, 0);
+                state->last_access.reserve(SHARDS_MAX_KEYS + 1);
+        }catch(std::bad_alloc &e){
+                SPEEDYIO_FPRINTF("%s:ERROR unable to alloc shards state: %s\n", "SPEEDYIO_ERRCO_0248 %s\n", e.what());
+                delete state;
+                state = nullptr;
+                return -1;
+        }
+        state->clock = 0;
+        memset(state->hist, 0, sizeof(state->hist));
+        state->accesses = 0;
+        state->cold = 0;
+
+        if(pthread_create(&shards_thread, NULL, shards_worker, NULL)){
+                SPEEDYIO_FPRINTF("%s:ERROR in creating shards pthread\n", "SPEEDYIO_ERRCO_0249\n");
+                delete state;
+                state = nullptr;
+                return -1;
+        }
+        pthread_atfork(NULL, NULL, shards_atfork_child);
+
+        threshold = (sample_ppm << SHARDS_MODULUS_BITS) / 1000000;
+        shards_threshold.store(threshold ? threshold : 1, std::memory_order_relaxed);
+        return 0;
+}
+
+void get_shards_stats(struct shards_stats *stats){
+        uint32_t threshold = shards_threshold.load(std::memory_order_relaxed);
+
+        stats->sample_ppm = ((uint64_t)threshold * 1000000) >> SHARDS_MODULUS_BITS;
+        stats->nr_keys = nr_keys.load(std::memory_order_relaxed);
+        stats->nr_sampled = nr_sampled.load(std::memory_order_relaxed);
+        stats->nr_dropped = nr_dropped.load(std::memory_order_relaxed);
+        stats->accesses = est_accesses.load(std::memory_order_relaxed);
+        stats->cold = est_cold.load(std::memory_order_relaxed);
+}
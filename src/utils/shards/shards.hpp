@@ -0,0 +1,90 @@
+#ifndef _SHARDS_HPP
+#define _SHARDS_HPP
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+
+#include "utils/util.hpp"
+#include "utils/latency_tracking/latency_tracking.hpp"
+
+/**
+ * Online miss ratio curve of the whitelisted reads, estimated with
+ * spatially hashed sampling (SHARDS, Waldspurger et al. FAST'15).
+ *
+ * Every {ino, dev, portion} read is hashed; it is sampled if the low
+ * SHARDS_MODULUS_BITS of the hash are below shards_threshold, so the same
+ * portions are always sampled and a sampled portion is seen on every
+ * access. A background thread runs the sampled accesses through a stack
+ * distance tree every SHARDS_PROCESS_MS; a distance over a sample at rate
+ * R is 1/R distances over all portions.
+ *
+ * The curve is kept as pow2 bins like struct lat_tracker: bin i has the
+ * estimated accesses that hit in an LRU cache of 2^i portions but not of
+ * 2^(i-1). When more than SHARDS_MAX_KEYS portions are tracked the rate
+ * is halved and the portions no longer sampled are dropped.
+ */
+
+/*histogram name in the stats segment, tools/speedyio_top draws it as a curve*/
+#define SHARDS_MRC_HIST_NAME "mrc_cache_portions"
+
+#define SHARDS_MODULUS_BITS 24
+#define SHARDS_MODULUS_MASK ((1UL << SHARDS_MODULUS_BITS) - 1)
+
+/*read path threshold, 0 when sampling is off*/
+extern std::atomic<uint32_t> shards_threshold;
+
+/*estimated accesses per cache size, see above*/
+extern struct lat_tracker shards_mrc_hist;
+
+struct shards_stats {
+        uint32_t sample_ppm;            /*current sampling rate*/
+        unsigned long nr_keys;          /*sampled portions tracked*/
+        unsigned long nr_sampled;       /*sampled accesses processed*/
+        unsigned long nr_dropped;       /*sampled accesses lost to a full buffer*/
+        unsigned long accesses;         /*estimated accesses*/
+        unsigned long cold;             /*estimated first accesses*/
+};
+
+/**
+ * Starts sampling at sample_ppm per million portions and the thread
+ * that processes the samples.
+ * Returns 0 on success, -1 on an error.
+ */
+int init_shards(unsigned long sample_ppm);
+
+void get_shards_stats(struct shards_stats *stats);
+
+void __shards_record(uint64_t hash);
+
+static inline uint64_t shards_hash(ino_t ino, dev_t dev, uint64_t portion){
+        uint64_t h = (ino ^ ((uint64_t)dev << 40) ^ (portion * 0x9e3779b97f4a7c15ULL));
+
+        /*murmur3 finalizer*/
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+}
+
+/*Called from handle_read, a hash and a compare per portion read*/
+static inline void shards_sample(ino_t ino, dev_t dev, off_t offset, size_t size){
+        uint64_t first = offset >> (PAGE_SHIFT + PVT_HEAP_PG_ORDER);
+        uint64_t last = (offset + size - 1) >> (PAGE_SHIFT + PVT_HEAP_PG_ORDER);
+        uint64_t h;
+
+        if(unlikely(size == 0)){
+                return;
+        }
+        for(uint64_t portion = first; portion <= last; portion++){
+                h = shards_hash(ino, dev, portion);
+                if(unlikely((h & SHARDS_MODULUS_MASK) < shards_threshold.load(std::memory_order_relaxed))){
+                        __shards_record(h);
+                }
+        }
+}
+
+#endif //_SHARDS_HPP
@@ -0,0 +1,135 @@
+#include "catch_amalgamated.hpp"
+
+#include <time.h>
+
+#include <thread>
+#include <vector>
+
+#include "utils/shards/shards.hpp"
+
+/*
+ * Built with SHARDS_MAX_KEYS 4096 and SHARDS_PROCESS_MS 10. The sampler
+ * is process wide and cannot be stopped: the test cases look at how the
+ * stats move, and the one that halves the rate comes last.
+ */
+
+#define PORTION_SZ (1UL << (PAGE_SHIFT + PVT_HEAP_PG_ORDER))
+#define NR_THREADS 8
+
+static void sleep_ms(long ms){
+        struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+
+        nanosleep(&ts, NULL);
+}
+
+/*Waits till the shards thread has processed or dropped nr accesses since before*/
+static bool wait_processed(const struct shards_stats &before, unsigned long nr, struct shards_stats *after){
+        for(int waited = 0; waited < 2000; waited += 10){
+                get_shards_stats(after);
+                if((after->nr_sampled - before.nr_sampled) + (after->nr_dropped - before.nr_dropped) >= nr){
+                        /*published with the histogram at the end of a batch*/
+                        sleep_ms(2 * SHARDS_PROCESS_MS);
+                        get_shards_stats(after);
+                        return true;
+                }
+                sleep_ms(10);
+        }
+        return false;
+}
+
+TEST_CASE("The same portions are always sampled", "[shards][hash]"){
+        CHECK(shards_hash(42, 2049, 7) == shards_hash(42, 2049, 7));
+        CHECK(shards_hash(42, 2049, 7) != shards_hash(42, 2049, 8));
+        CHECK(shards_hash(42, 2049, 7) != shards_hash(42, 2050, 7));
+        CHECK(shards_hash(42, 2049, 7) != shards_hash(43, 2049, 7));
+}
+
+TEST_CASE("Sampling rates outside (0, 1000000] ppm are rejected", "[shards][init]"){
+        CHECK(init_shards(0) == -1);
+        CHECK(init_shards(1000001) == -1);
+}
+
+TEST_CASE("A cyclic scan hits in a cache the size of the scan", "[shards][mrc]"){
+        const unsigned long nr_portions = 256;
+        struct shards_stats before, after;
+        unsigned long hits_before;
+
+        /*every portion sampled, each access counts once*/
+        REQUIRE(init_shards(1000000) == 0);
+        get_shards_stats(&before);
+        REQUIRE(before.sample_ppm == 1000000);
+        hits_before = shards_mrc_hist.latencies_bin_ctr[8].load();
+
+        shards_sample(100, 2049, 0, nr_portions * PORTION_SZ);
+        shards_sample(100, 2049, 0, nr_portions * PORTION_SZ);
+        REQUIRE(wait_processed(before, 2 * nr_portions, &after));
+
+        REQUIRE(after.nr_dropped == before.nr_dropped);
+        CHECK(after.nr_sampled - before.nr_sampled == 2 * nr_portions);
+        CHECK(after.accesses - before.accesses == 2 * nr_portions);
+        CHECK(after.cold - before.cold == nr_portions);
+        CHECK(after.nr_keys - before.nr_keys == nr_portions);
+
+        /*255 other portions between two accesses: a hit in 256 portions, bin 8*/
+        CHECK(shards_mrc_hist.latencies_bin_ctr[8].load() - hits_before == nr_portions);
+}
+
+TEST_CASE("Readers in many threads lose no sampled access", "[shards][concurrent]"){
+        const unsigned long nr_portions = 64, nr_passes = 200;
+        struct shards_stats before, after;
+        std::vector<std::thread> threads;
+
+        REQUIRE(init_shards(1000000) == 0);
+        get_shards_stats(&before);
+
+        /*each thread rereads its own file a portion at a time*/
+        for(int t = 0; t < NR_THREADS; t++){
+                threads.emplace_back([t, nr_portions, nr_passes](){
+                        for(unsigned long pass = 0; pass < nr_passes; pass++){
+                                for(unsigned long p = 0; p < nr_portions; p++){
+                                        shards_sample(200 + t, 2049, p * PORTION_SZ, 4096);
+                                }
+                        }
+                });
+        }
+        for(auto &th : threads){
+                th.join();
+        }
+        REQUIRE(wait_processed(before, NR_THREADS * nr_portions * nr_passes, &after));
+
+        /*processed or counted as dropped, never lost*/
+        CHECK((after.nr_sampled - before.nr_sampled) + (after.nr_dropped - before.nr_dropped) == NR_THREADS * nr_portions * nr_passes);
+
+        /*a thread that only ran once the buffer was full has all its accesses dropped*/
+        CHECK(after.nr_keys - before.nr_keys <= NR_THREADS * nr_portions);
+        if(after.nr_dropped == before.nr_dropped){
+                CHECK(after.nr_keys - before.nr_keys == NR_THREADS * nr_portions);
+        }
+}
+
+TEST_CASE("The rate halves when too many portions are tracked", "[shards][rate]"){
+        struct shards_stats before, after;
+
+        REQUIRE(init_shards(1000000) == 0);
+        get_shards_stats(&before);
+
+        /*in batches that fit the sample buffer*/
+        for(unsigned long first = 0; first < 2 * SHARDS_MAX_KEYS; first += SHARDS_BUF_ENTRIES / 2){
+                shards_sample(300, 2049, first * PORTION_SZ, (SHARDS_BUF_ENTRIES / 2) * PORTION_SZ);
+                sleep_ms(4 * SHARDS_PROCESS_MS);
+        }
+        /*fewer of them are sampled once the rate is lowered, wait for the rate instead*/
+        for(int waited = 0; waited < 2000; waited += 10){
+                get_shards_stats(&after);
+                if(after.sample_ppm < before.sample_ppm){
+                        break;
+                }
+                sleep_ms(10);
+        }
+        sleep_ms(2 * SHARDS_PROCESS_MS);
+        get_shards_stats(&after);
+
+        CHECK(after.sample_ppm < before.sample_ppm);
+        CHECK(after.nr_keys <= SHARDS_MAX_KEYS);
+        CHECK(after.nr_keys > 0);
+}
@@ -11,6 +11,9 @@
 #include <errno.h>
 #include <time.h>
 
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+
 #include <cstdint>
 
 /*The following are the intercepted function definitions*/
@@ -52,6 +55,20 @@ typedef ssize_t (*real_pwrite64_t)(int, const void *, size_t, off64_t);
 typedef size_t (*real_fwrite_t)(const void *, size_t, 
                 size_t,FILE *);
 
+typedef ssize_t (*real_readv_t)(int, const struct iovec *, int);
+typedef ssize_t (*real_preadv_t)(int, const struct iovec *, int, off_t);
+typedef ssize_t (*real_preadv64_t)(int, const struct iovec *, int, off64_t);
+typedef ssize_t (*real_preadv2_t)(int, const struct iovec *, int, off_t, int);
+typedef ssize_t (*real_writev_t)(int, const struct iovec *, int);
+typedef ssize_t (*real_pwritev_t)(int, const struct iovec *, int, off_t);
+typedef ssize_t (*real_pwritev64_t)(int, const struct iovec *, int, off64_t);
+typedef ssize_t (*real_pwritev2_t)(int, const struct iovec *, int, off_t, int);
+
+typedef ssize_t (*real_copy_file_range_t)(int, off64_t *, int, off64_t *, size_t, unsigned int);
+typedef ssize_t (*real_sendfile_t)(int, int, off_t *, size_t);
+typedef ssize_t (*real_sendfile64_t)(int, int, off64_t *, size_t);
+typedef ssize_t (*real_splice_t)(int, off64_t *, int, off64_t *, size_t, unsigned int);
+
 typedef int (*real_fclose_t)(FILE *);
 typedef int (*real_close_t)(int);
 typedef uid_t (*real_getuid_t)(void);
@@ -75,6 +92,8 @@ typedef int (*real_fsync_t)(int);
 typedef int (*real_fdatasync_t)(int);
 
 typedef void *(*real_mmap_t)(void *, size_t, int, int, int, off_t);
+typedef int (*real_munmap_t)(void *, size_t);
+typedef void *(*real_mremap_t)(void *, size_t, size_t, int, ...);
 
 real_fopen_t fopen_ptr = NULL;
 real_open_t open_ptr = NULL;
@@ -114,6 +133,20 @@ real_pwrite64_t pwrite64_ptr = NULL;
 real_fread_t fread_ptr = NULL;
 real_fwrite_t fwrite_ptr = NULL;
 
+real_readv_t readv_ptr = NULL;
+real_preadv_t preadv_ptr = NULL;
+real_preadv64_t preadv64_ptr = NULL;
+real_preadv2_t preadv2_ptr = NULL;
+real_writev_t writev_ptr = NULL;
+real_pwritev_t pwritev_ptr = NULL;
+real_pwritev64_t pwritev64_ptr = NULL;
+real_pwritev2_t pwritev2_ptr = NULL;
+
+real_copy_file_range_t copy_file_range_ptr = NULL;
+real_sendfile_t sendfile_ptr = NULL;
+real_sendfile64_t sendfile64_ptr = NULL;
+real_splice_t splice_ptr = NULL;
+
 real_fclose_t fclose_ptr = NULL;
 real_close_t close_ptr = NULL;
 
@@ -128,6 +161,8 @@ real_fsync_t fsync_ptr = NULL;
 real_fdatasync_t fdatasync_ptr = NULL;
 
 real_mmap_t mmap_ptr = NULL;
+real_munmap_t munmap_ptr = NULL;
+real_mremap_t mremap_ptr = NULL;
 
 /*Advise calls*/
 real_posix_fadvise_t posix_fadvise_ptr = NULL;
@@ -178,6 +213,20 @@ void link_shim_functions(void){
         fwrite_ptr = (real_fwrite_t)dlsym(RTLD_NEXT, "fwrite");
         fgets_ptr = (real_fgets_t)dlsym(RTLD_NEXT, "fgets");
 
+        readv_ptr = (real_readv_t)dlsym(RTLD_NEXT, "readv");
+        preadv_ptr = (real_preadv_t)dlsym(RTLD_NEXT, "preadv");
+        preadv64_ptr = (real_preadv64_t)dlsym(RTLD_NEXT, "preadv64");
+        preadv2_ptr = (real_preadv2_t)dlsym(RTLD_NEXT, "preadv2");
+        writev_ptr = (real_writev_t)dlsym(RTLD_NEXT, "writev");
+        pwritev_ptr = (real_pwritev_t)dlsym(RTLD_NEXT, "pwritev");
+        pwritev64_ptr = (real_pwritev64_t)dlsym(RTLD_NEXT, "pwritev64");
+        pwritev2_ptr = (real_pwritev2_t)dlsym(RTLD_NEXT, "pwritev2");
+
+        copy_file_range_ptr = (real_copy_file_range_t)dlsym(RTLD_NEXT, "copy_file_range");
+        sendfile_ptr = (real_sendfile_t)dlsym(RTLD_NEXT, "sendfile");
+        sendfile64_ptr = (real_sendfile64_t)dlsym(RTLD_NEXT, "sendfile64");
+        splice_ptr = (real_splice_t)dlsym(RTLD_NEXT, "splice");
+
         close_ptr = ((real_close_t)dlsym(RTLD_NEXT, "close"));
         fclose_ptr = ((real_fclose_t)dlsym(RTLD_NEXT, "fclose"));
 
@@ -200,6 +249,8 @@ void link_shim_functions(void){
         fdatasync_ptr = (real_fdatasync_t)dlsym(RTLD_NEXT, "fdatasync");
 
         mmap_ptr = (real_mmap_t)dlsym(RTLD_NEXT, "mmap");
+        munmap_ptr = (real_munmap_t)dlsym(RTLD_NEXT, "munmap");
+        mremap_ptr = (real_mremap_t)dlsym(RTLD_NEXT, "mremap");
 
         return;
 }
@@ -397,6 +448,82 @@ size_t real_fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream){
         return ((real_fwrite_t)fwrite_ptr)(ptr, size, nmemb, stream);
 }
 
+/*Vectored read/write functions*/
+
+ssize_t real_readv(int fd, const struct iovec *iov, int iovcnt){
+        if(!readv_ptr)
+                readv_ptr = (real_readv_t)dlsym(RTLD_NEXT, "readv");
+        return ((real_readv_t)readv_ptr)(fd, iov, iovcnt);
+}
+
+ssize_t real_preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset){
+        if(!preadv_ptr)
+                preadv_ptr = (real_preadv_t)dlsym(RTLD_NEXT, "preadv");
+        return ((real_preadv_t)preadv_ptr)(fd, iov, iovcnt, offset);
+}
+
+ssize_t real_preadv64(int fd, const struct iovec *iov, int iovcnt, off64_t offset){
+        if(!preadv64_ptr)
+                preadv64_ptr = (real_preadv64_t)dlsym(RTLD_NEXT, "preadv64");
+        return ((real_preadv64_t)preadv64_ptr)(fd, iov, iovcnt, offset);
+}
+
+ssize_t real_preadv2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags){
+        if(!preadv2_ptr)
+                preadv2_ptr = (real_preadv2_t)dlsym(RTLD_NEXT, "preadv2");
+        return ((real_preadv2_t)preadv2_ptr)(fd, iov, iovcnt, offset, flags);
+}
+
+ssize_t real_writev(int fd, const struct iovec *iov, int iovcnt){
+        if(!writev_ptr)
+                writev_ptr = (real_writev_t)dlsym(RTLD_NEXT, "writev");
+        return ((real_writev_t)writev_ptr)(fd, iov, iovcnt);
+}
+
+ssize_t real_pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset){
+        if(!pwritev_ptr)
+                pwritev_ptr = (real_pwritev_t)dlsym(RTLD_NEXT, "pwritev");
+        return ((real_pwritev_t)pwritev_ptr)(fd, iov, iovcnt, offset);
+}
+
+ssize_t real_pwritev64(int fd, const struct iovec *iov, int iovcnt, off64_t offset){
+        if(!pwritev64_ptr)
+                pwritev64_ptr = (real_pwritev64_t)dlsym(RTLD_NEXT, "pwritev64");
+        return ((real_pwritev64_t)pwritev64_ptr)(fd, iov, iovcnt, offset);
+}
+
+ssize_t real_pwritev2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags){
+        if(!pwritev2_ptr)
+                pwritev2_ptr = (real_pwritev2_t)dlsym(RTLD_NEXT, "pwritev2");
+        return ((real_pwritev2_t)pwritev2_ptr)(fd, iov, iovcnt, offset, flags);
+}
+
+/*Zero-copy functions*/
+
+ssize_t real_copy_file_range(int fd_in, off64_t *off_in, int fd_out, off64_t *off_out, size_t len, unsigned int flags){
+        if(!copy_file_range_ptr)
+                copy_file_range_ptr = (real_copy_file_range_t)dlsym(RTLD_NEXT, "copy_file_range");
+        return ((real_copy_file_range_t)copy_file_range_ptr)(fd_in, off_in, fd_out, off_out, len, flags);
+}
+
+ssize_t real_sendfile(int out_fd, int in_fd, off_t *offset, size_t count){
+        if(!sendfile_ptr)
+                sendfile_ptr = (real_sendfile_t)dlsym(RTLD_NEXT, "sendfile");
+        return ((real_sendfile_t)sendfile_ptr)(out_fd, in_fd, offset, count);
+}
+
+ssize_t real_sendfile64(int out_fd, int in_fd, off64_t *offset, size_t count){
+        if(!sendfile64_ptr)
+                sendfile64_ptr = (real_sendfile64_t)dlsym(RTLD_NEXT, "sendfile64");
+        return ((real_sendfile64_t)sendfile64_ptr)(out_fd, in_fd, offset, count);
+}
+
+ssize_t real_splice(int fd_in, off64_t *off_in, int fd_out, off64_t *off_out, size_t len, unsigned int flags){
+        if(!splice_ptr)
+                splice_ptr = (real_splice_t)dlsym(RTLD_NEXT, "splice");
+        return ((real_splice_t)splice_ptr)(fd_in, off_in, fd_out, off_out, len, flags);
+}
+
 /*Close functions*/
 
 int real_fclose(FILE *stream){
@@ -507,6 +634,18 @@ void *real_mmap(void *addr, size_t length, int prot, int flags, int fd, off_t of
         return ((real_mmap_t)mmap_ptr)(addr, length, prot, flags, fd, offset);
 }
 
+int real_munmap(void *addr, size_t length){
+        if(!munmap_ptr)
+                munmap_ptr = (real_munmap_t)dlsym(RTLD_NEXT, "munmap");
+        return ((real_munmap_t)munmap_ptr)(addr, length);
+}
+
+void *real_mremap(void *old_address, size_t old_size, size_t new_size, int flags, void *new_address){
+        if(!mremap_ptr)
+                mremap_ptr = (real_mremap_t)dlsym(RTLD_NEXT, "mremap");
+        return ((real_mremap_t)mremap_ptr)(old_address, old_size, new_size, flags, new_address);
+}
+
 uid_t real_getuid(){
         return ((real_getuid_t)dlsym(RTLD_NEXT, "getuid"))();
 }
@@ -3,6 +3,8 @@
 
 #include <cstdint>
 
+#include <sys/uio.h>
+
 void link_shim_functions(void);
 
 int real_openat(int dirfd, const char *pathname, int flags, mode_t mode);
@@ -42,6 +44,20 @@ ssize_t real_pwrite64(int fd, const void *data, size_t size, off64_t offset);
 char *real_fgets( char *str, int num, FILE *stream);
 size_t real_fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream);
 
+ssize_t real_readv(int fd, const struct iovec *iov, int iovcnt);
+ssize_t real_preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+ssize_t real_preadv64(int fd, const struct iovec *iov, int iovcnt, off64_t offset);
+ssize_t real_preadv2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags);
+ssize_t real_writev(int fd, const struct iovec *iov, int iovcnt);
+ssize_t real_pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+ssize_t real_pwritev64(int fd, const struct iovec *iov, int iovcnt, off64_t offset);
+ssize_t real_pwritev2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags);
+
+ssize_t real_copy_file_range(int fd_in, off64_t *off_in, int fd_out, off64_t *off_out, size_t len, unsigned int flags);
+ssize_t real_sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+ssize_t real_sendfile64(int out_fd, int in_fd, off64_t *offset, size_t count);
+ssize_t real_splice(int fd_in, off64_t *off_in, int fd_out, off64_t *off_out, size_t len, unsigned int flags);
+
 int real_fclose(FILE *stream);
 int real_close(int fd);
 
@@ -66,5 +82,8 @@ int real_fsync(int fd);
 int real_fdatasync(int fd);
 
 void *real_mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset);
+int real_munmap(void *addr, size_t length);
+/*new_address is only used with MREMAP_FIXED*/
+void *real_mremap(void *old_address, size_t old_size, size_t new_size, int flags, void *new_address);
 
 #endif // _SHIM_HPP
@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "slab.hpp"
+#include "../util.hpp"
+
+/*
+ * A free object holds the next free object of its batch and, if it is the
+ * first of a batch in the depot, the next batch and the batch length.
+ */
+struct slab_free_obj {
+        struct slab_free_obj *next;
+        struct slab_free_obj *next_batch;
+        size_t nr;
+};
+
+/*Per thread magazine of one cache. Zero initialized, no constructor*/
+struct slab_magazine {
+        struct slab_free_obj *head;
+        size_t nr;
+};
+
+static __thread struct slab_magazine magazines[SLAB_MAX_CACHES];
+
+/*set once the thread's magazines are flushed at thread exit, later frees skip them*/
+static __thread bool magazines_flushed;
+
+static struct slab_cache *caches[SLAB_MAX_CACHES];
+static std::atomic<int> nr_caches(0);
+static std::atomic<size_t> bytes_reserved(0);
+
+static pthread_once_t slab_once = PTHREAD_ONCE_INIT;
+static pthread_key_t slab_key;
+
+static size_t obj_stride(struct slab_cache *cache){
+        size_t sz = cache->obj_size;
+
+        if(sz < sizeof(struct slab_free_obj)){
+                sz = sizeof(struct slab_free_obj);
+        }
+        return (sz + cache->align - 1) & ~(cache->align - 1);
+}
+
+/*Caller holds cache->lock*/
+static void depot_push(struct slab_cache *cache, struct slab_free_obj *head, size_t nr){
+        head->nr = nr;
+        head->next_batch = (struct slab_free_obj *)cache->depot;
+        cache->depot = head;
+}
+
+/*Gives the magazines of an exiting thread back to the depots*/
+static void slab_thread_exit(void *arg){
+        struct slab_magazine *mag;
+        int nr = nr_caches.load();
+
+        for(int i = 0; i < nr; i++){
+                mag = &magazines[i];
+                if(mag->nr){
+                        pthread_mutex_lock(&caches[i]->lock);
+                        depot_push(caches[i], mag->head, mag->nr);
+                        pthread_mutex_unlock(&caches[i]->lock);
+                        mag->head = nullptr;
+                        mag->nr = 0;
+                }
+        }
+        magazines_flushed = true;
+}
+
+/*The child has only the forking thread, whoever held a depot lock is gone*/
+static void slab_atfork_child(){
+        int nr = nr_caches.load();
+
+        for(int i = 0; i < nr; i++){
+                pthread_mutex_init(&caches[i]->lock, NULL);
+        }
+}
+
+static void slab_init_once(){
+        if(pthread_key_create(&slab_key, slab_thread_exit)){
+                SPEEDYIO_FPRINTF("%s:ERROR unable to create slab pthread key\n", "SPEEDYIO_ERRCO_0250\n");
+        }
+        pthread_atfork(NULL, NULL, slab_atfork_child);
+}
+
+/*Lets the thread exit hand the magazines back, even if they were flushed once*/
+static inline void register_thread(){
+        if(!pthread_getspecific(slab_key)){
+                pthread_setspecific(slab_key, (void *)1);
+        }
+}
+
+/*Gives the cache its magazine index the first time it is used*/
+static int cache_id(struct slab_cache *cache){
+        int id = cache->id.load(std::memory_order_acquire);
+
+        if(likely(id >= 0)){
+                return id;
+        }
+
+        pthread_once(&slab_once, slab_init_once);
+
+        pthread_mutex_lock(&cache->lock);
+        id = cache->id.load(std::memory_order_relaxed);
+        if(id < 0){
+                id = nr_caches.load();
+                if(id >= SLAB_MAX_CACHES){
+                        SPEEDYIO_FPRINTF("%s:ERROR more than SLAB_MAX_CACHES:%d slab caches\n", "SPEEDYIO_ERRCO_0251 %d\n", SLAB_MAX_CACHES);
+                        pthread_mutex_unlock(&cache->lock);
+                        KILLME();
+                        return -1;
+                }
+                caches[id] = cache;
+                nr_caches.store(id + 1);
+                cache->id.store(id, std::memory_order_release);
+        }
+        pthread_mutex_unlock(&cache->lock);
+        return id;
+}
+
+/*Carves a batch of upto SLAB_MAG_SIZE objects. Caller holds cache->lock*/
+static struct slab_free_obj *carve_batch(struct slab_cache *cache, size_t *nr){
+        size_t stride = obj_stride(cache);
+        struct slab_free_obj *head = nullptr, *obj;
+        void *chunk;
+
+        if(cache->bump_left < stride){
+                if(posix_memalign(&chunk, SLAB_CHUNK_SIZE, SLAB_CHUNK_SIZE)){
+                        SPEEDYIO_FPRINTF("%s:ERROR unable to allocate a slab chunk of %lu bytes\n", "SPEEDYIO_ERRCO_0252 %lu\n", SLAB_CHUNK_SIZE);
+                        return nullptr;
+                }
+#ifdef SLAB_THP
+                madvise(chunk, SLAB_CHUNK_SIZE, MADV_HUGEPAGE);
+#endif //SLAB_THP
+                cache->bump = (char *)chunk;
+                cache->bump_left = SLAB_CHUNK_SIZE;
+                cache->nr_chunks += 1;
+                bytes_reserved.fetch_add(SLAB_CHUNK_SIZE, std::memory_order_relaxed);
+        }
+
+        /*in address order, so a batch hands out neighbouring objects*/
+        *nr = 0;
+        while(*nr < SLAB_MAG_SIZE && cache->bump_left >= stride){
+                obj = (struct slab_free_obj *)(cache->bump + cache->bump_left - stride);
+                obj->next = head;
+                head = obj;
+                cache->bump_left -= stride;
+                *nr += 1;
+        }
+        return head;
+}
+
+void *slab_alloc(struct slab_cache *cache){
+        struct slab_magazine *mag;
+        struct slab_free_obj *obj;
+        int id = cache_id(cache);
+
+        if(unlikely(id < 0)){
+                return nullptr;
+        }
+        mag = &magazines[id];
+
+        if(unlikely(!mag->nr)){
+                pthread_mutex_lock(&cache->lock);
+                if(cache->depot){
+                        obj = (struct slab_free_obj *)cache->depot;
+                        cache->depot = obj->next_batch;
+                        mag->nr = obj->nr;
+                }else{
+                        obj = carve_batch(cache, &mag->nr);
+                }
+                pthread_mutex_unlock(&cache->lock);
+
+                if(unlikely(!obj)){
+                        mag->nr = 0;
+                        return nullptr;
+                }
+                mag->head = obj;
+                register_thread();
+        }
+
+        obj = mag->head;
+        mag->head = obj->next;
+        mag->nr -= 1;
+        return obj;
+}
+
+void slab_free(struct slab_cache *cache, void *p){
+        struct slab_free_obj *obj = (struct slab_free_obj *)p;
+        struct slab_free_obj *batch, *last;
+        struct slab_magazine *mag;
+        int id;
+
+        if(!p){
+                return;
+        }
+        id = cache->id.load(std::memory_order_acquire);
+        mag = &magazines[id];
+
+        /*frees after the thread's exit handler go straight to the depot*/
+        if(unlikely(magazines_flushed)){
+                obj->next = nullptr;
+                pthread_mutex_lock(&cache->lock);
+                depot_push(cache, obj, 1);
+                pthread_mutex_unlock(&cache->lock);
+                return;
+        }
+
+        obj->next = mag->head;
+        mag->head = obj;
+        mag->nr += 1;
+        if(unlikely(mag->nr == 1)){
+                register_thread();
+        }
+
+        if(unlikely(mag->nr >= 2 * SLAB_MAG_SIZE)){
+                /*the most recently freed half stays, the rest goes to the depot*/
+                last = mag->head;
+                for(int i = 1; i < SLAB_MAG_SIZE; i++){
+                        last = last->next;
+                }
+                batch = last->next;
+                last->next = nullptr;
+
+                pthread_mutex_lock(&cache->lock);
+                depot_push(cache, batch, mag->nr - SLAB_MAG_SIZE);
+                pthread_mutex_unlock(&cache->lock);
+                mag->nr = SLAB_MAG_SIZE;
+        }
+}
+
+size_t slab_bytes_reserved(){
+        return bytes_reserved.load(std::memory_order_relaxed);
+}
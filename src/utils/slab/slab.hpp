@@ -0,0 +1,120 @@
+#ifndef _SLAB_HPP
+#define _SLAB_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include <atomic>
+#include <new>
+
+/*
+ * Objects are carved out of chunks of this size, aligned to it.
+ */
+#ifndef SLAB_CHUNK_SIZE
+#define SLAB_CHUNK_SIZE (2UL * 1024 * 1024)
+#endif
+
+/*
+ * Free objects a thread moves to or from the depot at once.
+ * A thread caches upto 2 * SLAB_MAG_SIZE free objects per cache.
+ */
+#ifndef SLAB_MAG_SIZE
+#define SLAB_MAG_SIZE 64
+#endif
+
+#define SLAB_MAX_CACHES 16
+
+/**
+ * slab_cache
+ * - A fixed size object cache for the library's own small allocations
+ *   (struct inode, perfd_struct, open_file_desc), so that they sit
+ *   together in SLAB_CHUNK_SIZE chunks instead of being scattered over
+ *   the glibc arenas of the application. With SLAB_THP the chunks are
+ *   madvise(MADV_HUGEPAGE)d.
+ * - Every thread keeps a magazine of free objects per cache; alloc and
+ *   free only touch it. Batches of SLAB_MAG_SIZE objects move between
+ *   the magazines and the cache's depot under the depot lock.
+ * - Freed objects are reused, chunks are never given back to the OS.
+ *
+ * Caches are constant initialized (SLAB_CACHE_INIT), so they can be used
+ * before the library's constructor runs.
+ *
+ * Example:
+ *   static struct slab_cache foo_cache = SLAB_CACHE_INIT(sizeof(struct foo), alignof(struct foo));
+ *   void *p = slab_alloc(&foo_cache);
+ *   slab_free(&foo_cache, p);
+ */
+struct slab_cache {
+        size_t obj_size;
+        size_t align;
+        std::atomic<int> id;            /*index of the per thread magazine, -1 till first use*/
+        pthread_mutex_t lock;           /*for everything below*/
+        void *depot;                    /*batches of free objects*/
+        char *bump;                     /*uncarved part of the newest chunk*/
+        size_t bump_left;
+        unsigned long nr_chunks;
+};
+
+#define SLAB_CACHE_INIT(size, alignment) \
+        { (size), (alignment), {-1}, PTHREAD_MUTEX_INITIALIZER, nullptr, nullptr, 0, 0 }
+
+/*Returns nullptr if no memory*/
+void *slab_alloc(struct slab_cache *cache);
+void slab_free(struct slab_cache *cache, void *obj);
+
+/*bytes of chunks allocated by all caches*/
+size_t slab_bytes_reserved();
+
+/*One cache per type T, for slab_allocator and operator new*/
+template <typename T>
+struct slab_type {
+        static struct slab_cache cache;
+};
+
+template <typename T>
+struct slab_cache slab_type<T>::cache = SLAB_CACHE_INIT(sizeof(T), alignof(T) > 16 ? alignof(T) : 16);
+
+/**
+ * std allocator on slab_type<T>::cache, for std::allocate_shared:
+ *   std::allocate_shared<struct foo>(slab_allocator<struct foo>());
+ * puts the object and its refcounts in one slab object.
+ */
+template <typename T>
+struct slab_allocator {
+        typedef T value_type;
+
+        slab_allocator() noexcept {}
+
+        template <typename U>
+        slab_allocator(const slab_allocator<U> &) noexcept {}
+
+        T *allocate(size_t n){
+                void *p;
+
+                if(n != 1){
+                        throw std::bad_alloc();
+                }
+                p = slab_alloc(&slab_type<T>::cache);
+                if(!p){
+                        throw std::bad_alloc();
+                }
+                return static_cast<T *>(p);
+        }
+
+        void deallocate(T *p, size_t n) noexcept {
+                slab_free(&slab_type<T>::cache, p);
+        }
+};
+
+template <typename T, typename U>
+bool operator==(const slab_allocator<T> &, const slab_allocator<U> &){
+        return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const slab_allocator<T> &, const slab_allocator<U> &){
+        return false;
+}
+
+#endif //_SLAB_HPP
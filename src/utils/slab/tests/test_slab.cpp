@@ -0,0 +1,118 @@
+#include "catch_amalgamated.hpp"
+
+#include <string.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "utils/slab/slab.hpp"
+
+#define NR_THREADS 8
+#define NR_OBJS 10000
+
+struct alignas(64) obj64 {
+        char payload[200];
+};
+
+struct small {
+        int a;
+};
+
+TEST_CASE("Objects are aligned, distinct and keep their contents", "[slab][alloc_free]"){
+        std::vector<struct obj64 *> objs;
+        std::set<uintptr_t> seen;
+        size_t reserved;
+
+        for(int i = 0; i < NR_OBJS; i++){
+                struct obj64 *o = (struct obj64 *)slab_alloc(&slab_type<struct obj64>::cache);
+
+                REQUIRE(o != nullptr);
+                REQUIRE(((uintptr_t)o & 63) == 0);
+                REQUIRE(seen.insert((uintptr_t)o).second);
+                memset(o->payload, i & 0xff, sizeof(o->payload));
+                objs.push_back(o);
+        }
+        for(int i = 0; i < NR_OBJS; i++){
+                REQUIRE(objs[i]->payload[0] == (char)(i & 0xff));
+                REQUIRE(objs[i]->payload[199] == (char)(i & 0xff));
+        }
+        for(auto o : objs){
+                slab_free(&slab_type<struct obj64>::cache, o);
+        }
+
+        /*freed objects are handed out again*/
+        reserved = slab_bytes_reserved();
+        for(int i = 0; i < NR_OBJS; i++){
+                objs[i] = (struct obj64 *)slab_alloc(&slab_type<struct obj64>::cache);
+        }
+        CHECK(slab_bytes_reserved() == reserved);
+        for(auto o : objs){
+                slab_free(&slab_type<struct obj64>::cache, o);
+        }
+}
+
+TEST_CASE("Objects freed by other threads, threads exiting in between", "[slab][threads]"){
+        std::vector<std::thread> threads;
+        std::vector<std::vector<struct obj64 *>> objs(NR_THREADS);
+        std::atomic<int> nr_bad(0);
+        size_t reserved = 0;
+
+        for(int round = 0; round < 2; round++){
+                for(int t = 0; t < NR_THREADS; t++){
+                        threads.emplace_back([t, &objs](){
+                                for(int i = 0; i < NR_OBJS; i++){
+                                        struct obj64 *o = (struct obj64 *)slab_alloc(&slab_type<struct obj64>::cache);
+                                        o->payload[0] = t;
+                                        objs[t].push_back(o);
+                                }
+                        });
+                }
+                for(auto &th : threads){
+                        th.join();
+                }
+                threads.clear();
+
+                /*each thread frees the objects of the next one*/
+                for(int t = 0; t < NR_THREADS; t++){
+                        threads.emplace_back([t, &objs, &nr_bad](){
+                                auto &theirs = objs[(t + 1) % NR_THREADS];
+                                for(auto o : theirs){
+                                        if(o->payload[0] != (t + 1) % NR_THREADS){
+                                                nr_bad++;
+                                        }
+                                        slab_free(&slab_type<struct obj64>::cache, o);
+                                }
+                                theirs.clear();
+                        });
+                }
+                for(auto &th : threads){
+                        th.join();
+                }
+                threads.clear();
+                REQUIRE(nr_bad.load() == 0);
+
+                /*the exited threads handed their magazines back, round 2 needs no new chunks*/
+                if(round == 0){
+                        reserved = slab_bytes_reserved();
+                }else{
+                        CHECK(slab_bytes_reserved() == reserved);
+                }
+        }
+}
+
+TEST_CASE("allocate_shared through slab_allocator", "[slab][shared]"){
+        std::vector<std::shared_ptr<struct small>> ptrs;
+
+        for(int i = 0; i < NR_OBJS; i++){
+                ptrs.push_back(std::allocate_shared<struct small>(slab_allocator<struct small>()));
+                ptrs.back()->a = i;
+        }
+        for(int i = 0; i < NR_OBJS; i++){
+                REQUIRE(ptrs[i]->a == i);
+        }
+        ptrs.clear();
+}
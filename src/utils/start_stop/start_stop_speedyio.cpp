@@ -7,7 +7,7 @@
 
 pthread_mutex_t evictor_pause_lock = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t evictor_pause_cond = PTHREAD_COND_INITIALIZER;
-bool evictor_paused = false;
+std::atomic<bool> evictor_paused(false);
 
 /**
  * Does not return while evictor_paused remains true
@@ -6,9 +6,12 @@
 #include <stdbool.h>
 #include <unistd.h>
 
+#include <atomic>
+
 extern pthread_mutex_t evictor_pause_lock;
 extern pthread_cond_t evictor_pause_cond;
-extern bool evictor_paused;
+/*written under evictor_pause_lock, read without it by the evictor and the stats*/
+extern std::atomic<bool> evictor_paused;
 
 void evictor_is_paused();
 void resume_speedyio();
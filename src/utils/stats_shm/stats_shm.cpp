@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <dirent.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "stats_shm.hpp"
+#include "utils/util.hpp"
+#include "utils/shim/shim.hpp"
+
+struct stats_counter_src {
+        const char *name;
+        enum stats_kind kind;
+        stats_read_fn fn;
+        void *arg;
+};
+
+struct stats_histogram_src {
+        const char *name;
+        struct lat_tracker *tracker;
+};
+
+static struct stats_counter_src counter_srcs[MAX_STATS_COUNTERS];
+static int nr_counter_srcs = 0;
+
+static struct stats_histogram_src histogram_srcs[MAX_STATS_HISTOGRAMS];
+static int nr_histogram_srcs = 0;
+
+static struct stats_segment *segment = nullptr;
+static char segment_name[64];
+
+int stats_register_counter(const char *name, enum stats_kind kind, stats_read_fn fn, void *arg){
+        if(nr_counter_srcs >= MAX_STATS_COUNTERS){
+                SPEEDYIO_FPRINTF("%s:ERROR too many stats counters, dropping %s\n", "SPEEDYIO_ERRCO_0237 %s\n", name);
+                return -1;
+        }
+        counter_srcs[nr_counter_srcs].name = name;
+        counter_srcs[nr_counter_srcs].kind = kind;
+        counter_srcs[nr_counter_srcs].fn = fn;
+        counter_srcs[nr_counter_srcs].arg = arg;
+        nr_counter_srcs++;
+        return 0;
+}
+
+int stats_register_histogram(const char *name, struct lat_tracker *tracker){
+        if(nr_histogram_srcs >= MAX_STATS_HISTOGRAMS){
+                SPEEDYIO_FPRINTF("%s:ERROR too many stats histograms, dropping %s\n", "SPEEDYIO_ERRCO_0238 %s\n", name);
+                return -1;
+        }
+        histogram_srcs[nr_histogram_srcs].name = name;
+        histogram_srcs[nr_histogram_srcs].tracker = tracker;
+        nr_histogram_srcs++;
+        return 0;
+}
+
+static uint64_t mono_ns(){
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Processes that _exit (eg. dash) or are killed never run destruct and
+ * leave their segment behind; every new process clears those.
+ */
+static void remove_stale_segments(){
+        char name[64];
+        struct dirent *ent;
+        DIR *dir;
+        char *end;
+        long pid;
+
+        dir = opendir(STATS_SHM_DIR);
+        if(!dir){
+                return;
+        }
+        while((ent = readdir(dir))){
+                if(strncmp(ent->d_name, STATS_SHM_PREFIX, strlen(STATS_SHM_PREFIX))){
+                        continue;
+                }
+                pid = strtol(ent->d_name + strlen(STATS_SHM_PREFIX), &end, 10);
+                if(*end || pid <= 0 || kill(pid, 0) == 0 || errno != ESRCH){
+                        continue;
+                }
+                snprintf(name, sizeof(name), STATS_SHM_NAME_FMT, (int)pid);
+                shm_unlink(name);
+        }
+        closedir(dir);
+}
+
+int init_stats_shm(){
+        int fd = -1;
+        void *addr;
+
+        remove_stale_segments();
+
+        snprintf(segment_name, sizeof(segment_name), STATS_SHM_NAME_FMT, getpid());
+
+        fd = shm_open(segment_name, O_CREAT | O_RDWR | O_TRUNC | O_CLOEXEC, 0600);
+        if(fd < 0){
+                SPEEDYIO_FPRINTF("%s:ERROR shm_open %s failed errno:%d\n", "SPEEDYIO_ERRCO_0239 %s %d\n", segment_name, errno);
+                goto err_init_stats_shm;
+        }
+        if(real_ftruncate(fd, sizeof(struct stats_segment)) != 0){
+                SPEEDYIO_FPRINTF("%s:ERROR ftruncate %s failed errno:%d\n", "SPEEDYIO_ERRCO_0240 %s %d\n", segment_name, errno);
+                goto err_init_stats_shm;
+        }
+
+        addr = real_mmap(NULL, sizeof(struct stats_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(addr == MAP_FAILED){
+                SPEEDYIO_FPRINTF("%s:ERROR mmap %s failed errno:%d\n", "SPEEDYIO_ERRCO_0241 %s %d\n", segment_name, errno);
+                goto err_init_stats_shm;
+        }
+        real_close(fd);
+
+        /*a fresh segment is all zeroes, seq included*/
+        segment = (struct stats_segment *)addr;
+        segment->version = STATS_SHM_VERSION;
+        segment->size = sizeof(struct stats_segment);
+        segment->pid = getpid();
+        segment->publish_ms = STATS_PUBLISH_MS;
+        segment->start_ns = mono_ns();
+
+        /*readers check magic last*/
+        std::atomic_thread_fence(std::memory_order_release);
+        segment->magic = STATS_SHM_MAGIC;
+        return 0;
+
+err_init_stats_shm:
+        if(fd >= 0){
+                real_close(fd);
+                shm_unlink(segment_name);
+        }
+        return -1;
+}
+
+static void publish_stats(){
+        uint64_t seq = segment->seq.load(std::memory_order_relaxed);
+
+        segment->seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for(int i = 0; i < nr_counter_srcs; i++){
+                segment->counters[i].value = counter_srcs[i].fn(counter_srcs[i].arg);
+        }
+        for(int i = 0; i < nr_histogram_srcs; i++){
+                for(int bin = 0; bin < NR_POW2_LATENCY_BINS; bin++){
+                        segment->histograms[i].bins[bin] =
+                                histogram_srcs[i].tracker->latencies_bin_ctr[bin].load(std::memory_order_relaxed);
+                }
+        }
+        segment->publish_ns = mono_ns();
+
+        segment->seq.store(seq + 2, std::memory_order_release);
+}
+
+void *stats_shm_publisher(void *arg){
+        struct timespec ts;
+
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+
+        if(!segment){
+                goto exit_stats_shm_publisher;
+        }
+
+        /*names don't change after startup, write them once*/
+        for(int i = 0; i < nr_counter_srcs; i++){
+                snprintf(segment->counters[i].name, STATS_NAME_LEN, "%s", counter_srcs[i].name);
+                segment->counters[i].kind = counter_srcs[i].kind;
+        }
+        for(int i = 0; i < nr_histogram_srcs; i++){
+                snprintf(segment->histograms[i].name, STATS_NAME_LEN, "%s", histogram_srcs[i].name);
+        }
+        segment->nr_counters = nr_counter_srcs;
+        segment->nr_histograms = nr_histogram_srcs;
+
+        ts.tv_sec = STATS_PUBLISH_MS / 1000;
+        ts.tv_nsec = (STATS_PUBLISH_MS % 1000) * 1000000L;
+
+        while(true){
+                publish_stats();
+
+                /*nanosleep is a cancellation point*/
+                nanosleep(&ts, NULL);
+        }
+
+exit_stats_shm_publisher:
+        return NULL;
+}
+
+void destroy_stats_shm(){
+        /*a forked child shares the parent's segment*/
+        if(segment && segment->pid == getpid()){
+                shm_unlink(segment_name);
+        }
+}
@@ -0,0 +1,88 @@
+#ifndef _STATS_SHM_HPP
+#define _STATS_SHM_HPP
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "utils/latency_tracking/latency_tracking.hpp"
+
+/**
+ * Live stats of a SpeedyIO process in /dev/shm/speedyio.<pid>.
+ *
+ * Counters and latency histograms are registered at startup. A
+ * publisher thread copies them into the segment every STATS_PUBLISH_MS,
+ * so the hot paths keep updating their own atomics and never make a
+ * syscall for stats.
+ *
+ * The publisher is the only writer; readers (tools/speedyio_top) use
+ * the seqlock: seq is odd while a copy is in progress, and a snapshot is
+ * consistent only if seq was even and unchanged across the copy.
+ */
+
+#define STATS_SHM_DIR "/dev/shm"
+#define STATS_SHM_PREFIX "speedyio."
+#define STATS_SHM_NAME_FMT "/" STATS_SHM_PREFIX "%d"
+#define STATS_SHM_MAGIC 0x5354415453494f53ULL       /*"SIOSTATS"*/
+#define STATS_SHM_VERSION 1
+
+#define STATS_NAME_LEN 48
+#define MAX_STATS_COUNTERS 64
+#define MAX_STATS_HISTOGRAMS 16
+
+enum stats_kind {
+        STATS_COUNTER = 0,      /*only goes up, readers show its rate*/
+        STATS_GAUGE,
+};
+
+struct stats_counter {
+        char name[STATS_NAME_LEN];
+        uint32_t kind;
+        uint32_t reserved;
+        uint64_t value;
+};
+
+/*bins as in struct lat_tracker: bin i counts (2^(i-1), 2^i] us, bin 0 upto 1us*/
+struct stats_histogram {
+        char name[STATS_NAME_LEN];
+        uint64_t bins[NR_POW2_LATENCY_BINS];
+};
+
+struct stats_segment {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t size;                  /*sizeof(struct stats_segment)*/
+        int32_t pid;
+        uint32_t publish_ms;
+
+        std::atomic<uint64_t> seq;
+
+        /*CLOCK_MONOTONIC ns; a reader computes rates from these*/
+        uint64_t start_ns;
+        uint64_t publish_ns;
+
+        uint32_t nr_counters;
+        uint32_t nr_histograms;
+        struct stats_counter counters[MAX_STATS_COUNTERS];
+        struct stats_histogram histograms[MAX_STATS_HISTOGRAMS];
+};
+
+typedef uint64_t (*stats_read_fn)(void *arg);
+
+/*Not thread safe, call before stats_shm_publisher runs*/
+int stats_register_counter(const char *name, enum stats_kind kind, stats_read_fn fn, void *arg);
+int stats_register_histogram(const char *name, struct lat_tracker *tracker);
+
+/**
+ * Creates and maps /dev/shm/speedyio.<pid>.
+ * Returns 0 on success, -1 on an error.
+ */
+int init_stats_shm();
+
+/*The publisher thread*/
+void *stats_shm_publisher(void *arg);
+
+/*Removes the segment, only from the process that created it*/
+void destroy_stats_shm();
+
+#endif //_STATS_SHM_HPP
@@ -0,0 +1,160 @@
+#include <stdlib.h>
+
+#include <new>
+
+#include "string_arena.hpp"
+
+/*FNV-1a over the string*/
+size_t StringArena::cstr_hash::operator()(const char *s) const {
+        uint64_t h = 14695981039346656037ULL;
+        while (*s) {
+                h ^= (unsigned char)*s++;
+                h *= 1099511628211ULL;
+        }
+        return (size_t)h;
+}
+
+StringArena::StringArena()
+        : bump(nullptr), bump_left(0) {}
+
+StringArena::~StringArena() {
+        for (char *chunk : chunks)
+                free(chunk);
+}
+
+/*lock must be held. Throws std::bad_alloc*/
+char *StringArena::alloc_slot(size_t slot_sz) {
+        size_t cls = slot_sz / STRING_ARENA_SLOT_ALIGN;
+        char *slot;
+
+        if (cls < free_slots.size() && !free_slots[cls].empty()) {
+                slot = free_slots[cls].back();
+                free_slots[cls].pop_back();
+                return slot;
+        }
+
+        if (bump_left < slot_sz) {
+                size_t chunk_sz = slot_sz > STRING_ARENA_CHUNK_SZ ? slot_sz : STRING_ARENA_CHUNK_SZ;
+                char *chunk = (char *)malloc(chunk_sz);
+                if (!chunk)
+                        throw std::bad_alloc();
+                chunks.push_back(chunk);
+                /*the tail of the older chunk is wasted*/
+                bump = chunk;
+                bump_left = chunk_sz;
+        }
+
+        slot = bump;
+        bump += slot_sz;
+        bump_left -= slot_sz;
+        return slot;
+}
+
+/**
+ * Returns the arena copy of str, taking a reference on it.
+ * Returns nullptr if str is nullptr or memory could not be allocated.
+ */
+const char *StringArena::intern(const char *str) {
+        std::lock_guard<std::mutex> guard(lock);
+        return intern_locked(str);
+}
+
+/*lock must be held*/
+const char *StringArena::intern_locked(const char *str) {
+        char *slot = nullptr;
+        size_t len, slot_sz;
+
+        if (!str)
+                return nullptr;
+
+        auto it = refs.find(str);
+        if (it != refs.end()) {
+                it->second += 1;
+                return it->first;
+        }
+
+        len = strlen(str) + 1;
+        slot_sz = (len + STRING_ARENA_SLOT_ALIGN - 1) & ~(STRING_ARENA_SLOT_ALIGN - 1);
+
+        try {
+                slot = alloc_slot(slot_sz);
+                memcpy(slot, str, len);
+                refs.emplace(slot, 1);
+        } catch (std::bad_alloc &e) {
+                return nullptr;
+        }
+        return slot;
+}
+
+/**
+ * Drops a reference taken by intern. The slot is reused once
+ * the last reference is gone. Strings not from this arena are ignored.
+ */
+void StringArena::release(const char *str) {
+        std::lock_guard<std::mutex> guard(lock);
+        release_locked(str);
+}
+
+/*lock must be held*/
+void StringArena::release_locked(const char *str) {
+        size_t len, slot_sz, cls;
+
+        if (!str)
+                return;
+
+        auto it = refs.find(str);
+        if (it == refs.end() || it->first != str)
+                return;
+
+        if (--it->second > 0)
+                return;
+
+        len = strlen(str) + 1;
+        slot_sz = (len + STRING_ARENA_SLOT_ALIGN - 1) & ~(STRING_ARENA_SLOT_ALIGN - 1);
+        cls = slot_sz / STRING_ARENA_SLOT_ALIGN;
+
+        refs.erase(it);
+        try {
+                if (cls >= free_slots.size())
+                        free_slots.resize(cls + 1);
+                free_slots[cls].push_back((char *)str);
+        } catch (std::bad_alloc &e) {
+                /*slot is leaked till the arena is destroyed*/
+        }
+}
+
+const char *StringArena::exchange(const char **where, const char *str, const char *fallback) {
+        const char *old, *cur;
+
+        std::lock_guard<std::mutex> guard(lock);
+
+        old = *where;
+        cur = intern_locked(str);
+        *where = cur ? cur : fallback;
+        release_locked(old);
+        return cur;
+}
+
+size_t StringArena::copy(const char *const *where, char *buf, size_t size) {
+        size_t len;
+
+        std::lock_guard<std::mutex> guard(lock);
+
+        len = strlen(*where);
+        if (size > 0) {
+                size_t n = len < size - 1 ? len : size - 1;
+                memcpy(buf, *where, n);
+                buf[n] = '\0';
+        }
+        return len;
+}
+
+size_t StringArena::nr_strings() {
+        std::lock_guard<std::mutex> guard(lock);
+        return refs.size();
+}
+
+size_t StringArena::bytes_reserved() {
+        std::lock_guard<std::mutex> guard(lock);
+        return chunks.size() * STRING_ARENA_CHUNK_SZ;
+}
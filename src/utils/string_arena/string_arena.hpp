@@ -0,0 +1,91 @@
+#ifndef _STRING_ARENA_HPP
+#define _STRING_ARENA_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Size of each chunk the arena carves strings out of.
+ */
+#ifndef STRING_ARENA_CHUNK_SZ
+#define STRING_ARENA_CHUNK_SZ (64UL * 1024)
+#endif
+
+/*
+ * Strings are stored in slots rounded up to this granularity.
+ * Released slots are reused by strings of the same size class.
+ */
+#define STRING_ARENA_SLOT_ALIGN 16UL
+
+/**
+ * StringArena
+ * - Interns NUL terminated strings into large shared chunks.
+ * - The same string interned twice returns the same pointer; it is
+ *   refcounted and its slot goes back to a per size class free list
+ *   when the last reference is released.
+ * - Returned pointers are stable till the matching release(). A
+ *   released slot is reused right away for another string; a pointer
+ *   that can be released by another thread must only be read through
+ *   copy(), and replaced through exchange().
+ *
+ * Used for struct inode filenames: 50k uinodes with ~120 byte
+ * Cassandra paths take ~6MB here instead of 200MB of char[PATH_MAX].
+ *
+ * Example:
+ *   StringArena arena;
+ *   const char *a = arena.intern("/data/ks/tbl/nb-1-big-Data.db");
+ *   arena.release(a);
+ */
+class StringArena {
+public:
+        StringArena();
+        ~StringArena();
+
+        StringArena(const StringArena &) = delete;
+        StringArena &operator=(const StringArena &) = delete;
+
+        const char *intern(const char *str);
+        void release(const char *str);
+
+        /**
+         * *where = intern(str), or fallback if str is nullptr or could not
+         * be interned, then releases the old *where. Under the arena lock,
+         * so a concurrent copy() of *where gets either name whole.
+         * Returns the interned string or nullptr.
+         */
+        const char *exchange(const char **where, const char *str, const char *fallback);
+
+        /*Copies *where into buf (truncated to size) under the arena lock. Returns strlen(*where)*/
+        size_t copy(const char *const *where, char *buf, size_t size);
+
+        size_t nr_strings();
+        size_t bytes_reserved();
+
+private:
+        struct cstr_hash {
+                size_t operator()(const char *s) const;
+        };
+        struct cstr_equal {
+                bool operator()(const char *a, const char *b) const {
+                        return strcmp(a, b) == 0;
+                }
+        };
+
+        char *alloc_slot(size_t slot_sz);
+        const char *intern_locked(const char *str);
+        void release_locked(const char *str);
+
+        std::mutex lock;
+        std::unordered_map<const char *, uint32_t, cstr_hash, cstr_equal> refs;
+        std::vector<char *> chunks;
+        std::vector<std::vector<char *>> free_slots; //indexed by slot_sz / STRING_ARENA_SLOT_ALIGN
+        char *bump;
+        size_t bump_left;
+};
+
+#endif //_STRING_ARENA_HPP
@@ -0,0 +1,152 @@
+#include "catch_amalgamated.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/string_arena/string_arena.hpp"
+
+#define NR_THREADS 8
+
+static const char *data_path = "/data/ks/tbl-0123456789abcdef0123456789abcdef/nb-1-big-Data.db";
+static const char *index_path = "/data/ks/tbl-0123456789abcdef0123456789abcdef/nb-1-big-Index.db";
+
+TEST_CASE("The same string interned twice is the same pointer", "[string_arena][intern]"){
+        StringArena arena;
+        std::string copy(data_path);
+        const char *a = arena.intern(data_path);
+        const char *b = arena.intern(copy.c_str());
+        const char *c = arena.intern(index_path);
+
+        REQUIRE(a != nullptr);
+        REQUIRE(c != nullptr);
+        CHECK(a != data_path);
+        CHECK(strcmp(a, data_path) == 0);
+        CHECK(a == b);
+        CHECK(a != c);
+        CHECK(strcmp(c, index_path) == 0);
+        CHECK(arena.nr_strings() == 2);
+        CHECK(arena.intern(nullptr) == nullptr);
+
+        arena.release(a);
+        arena.release(b);
+        arena.release(c);
+        CHECK(arena.nr_strings() == 0);
+}
+
+TEST_CASE("A slot is reused once its last reference is released", "[string_arena][release]"){
+        StringArena arena;
+        const char *a = arena.intern(data_path);
+        const char *other;
+
+        REQUIRE(arena.intern(data_path) == a);
+
+        /*one reference left*/
+        arena.release(a);
+        REQUIRE(arena.nr_strings() == 1);
+        CHECK(strcmp(a, data_path) == 0);
+
+        /*an equal string that is not from the arena is ignored*/
+        arena.release(data_path);
+        REQUIRE(arena.nr_strings() == 1);
+
+        arena.release(a);
+        REQUIRE(arena.nr_strings() == 0);
+
+        /*same size class*/
+        other = arena.intern(index_path);
+        CHECK(other == a);
+        arena.release(other);
+}
+
+TEST_CASE("Strings are carved out of shared chunks", "[string_arena][chunks]"){
+        StringArena arena;
+        std::vector<const char *> names;
+        char name[128];
+        size_t bytes = 0;
+
+        for(int i = 0; i < 50000; i++){
+                snprintf(name, sizeof(name), "/data/ks/tbl-0123456789abcdef0123456789abcdef/nb-%d-big-Data.db", i);
+                names.push_back(arena.intern(name));
+                REQUIRE(names.back() != nullptr);
+                bytes += strlen(name) + 1;
+        }
+        CHECK(arena.nr_strings() == 50000);
+
+        /*rounded upto STRING_ARENA_SLOT_ALIGN, the tail of each chunk wasted*/
+        CHECK(arena.bytes_reserved() >= bytes);
+        CHECK(arena.bytes_reserved() <= 2 * bytes + STRING_ARENA_CHUNK_SZ);
+
+        for(auto n : names){
+                arena.release(n);
+        }
+        CHECK(arena.nr_strings() == 0);
+}
+
+TEST_CASE("exchange and copy", "[string_arena][exchange]"){
+        StringArena arena;
+        const char *where = "fallback";
+        char buf[16];
+
+        REQUIRE(arena.exchange(&where, data_path, "fallback") == where);
+        CHECK(strcmp(where, data_path) == 0);
+
+        /*truncated, returns the whole length*/
+        CHECK(arena.copy(&where, buf, sizeof(buf)) == strlen(data_path));
+        CHECK(std::string(buf) == std::string(data_path, sizeof(buf) - 1));
+
+        /*the old string is released*/
+        REQUIRE(arena.exchange(&where, index_path, "fallback") == where);
+        CHECK(arena.nr_strings() == 1);
+
+        REQUIRE(arena.exchange(&where, nullptr, "fallback") == nullptr);
+        CHECK(strcmp(where, "fallback") == 0);
+        CHECK(arena.nr_strings() == 0);
+}
+
+TEST_CASE("copy of a name that other threads keep replacing", "[string_arena][concurrent]"){
+        StringArena arena;
+        const char *where = arena.intern(data_path);
+        std::atomic<bool> stop(false);
+        std::atomic<long> nr_torn(0);
+        std::vector<std::thread> threads;
+
+        /*renamers; each intern/release also recycles the slot of the old name*/
+        for(int t = 0; t < NR_THREADS / 2; t++){
+                threads.emplace_back([&, t](){
+                        for(int i = 0; i < 20000; i++){
+                                arena.exchange(&where, (i + t) % 2 ? index_path : data_path, "fallback");
+                                arena.release(arena.intern((i + t) % 2 ? data_path : index_path));
+                        }
+                });
+        }
+        /*readers get either name whole*/
+        for(int t = 0; t < NR_THREADS / 2; t++){
+                threads.emplace_back([&](){
+                        char buf[256];
+
+                        while(!stop.load(std::memory_order_relaxed)){
+                                arena.copy(&where, buf, sizeof(buf));
+                                if(strcmp(buf, data_path) && strcmp(buf, index_path)){
+                                        nr_torn++;
+                                }
+                        }
+                });
+        }
+        for(int t = 0; t < NR_THREADS / 2; t++){
+                threads[t].join();
+        }
+        stop.store(true);
+        for(int t = NR_THREADS / 2; t < NR_THREADS; t++){
+                threads[t].join();
+        }
+
+        CHECK(nr_torn.load() == 0);
+        CHECK(arena.nr_strings() == 1);
+        arena.release(where);
+        CHECK(arena.nr_strings() == 0);
+}
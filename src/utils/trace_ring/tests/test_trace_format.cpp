@@ -0,0 +1,72 @@
+#include "catch_amalgamated.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "utils/trace_ring/trace_format.hpp"
+
+/*Encodes in, decodes it back and checks that a block missing its last byte does not decode*/
+static void roundtrip(const std::vector<struct trace_record> &in){
+        std::vector<uint8_t> buf(TRACE_MAX_ENCODED_BYTES(in.size()));
+        std::vector<struct trace_record> out(in.size());
+        size_t len = trace_encode_block(in.data(), in.size(), buf.data());
+
+        REQUIRE(len <= buf.size());
+        REQUIRE(trace_decode_block(buf.data(), len, out.data(), out.size()));
+        REQUIRE(memcmp(in.data(), out.data(), in.size() * sizeof(struct trace_record)) == 0);
+        if(len){
+                REQUIRE_FALSE(trace_decode_block(buf.data(), len - 1, out.data(), out.size()));
+        }
+}
+
+TEST_CASE("Sequential reads of one file", "[trace_format][sequential]"){
+        std::vector<struct trace_record> seq;
+        struct trace_record r;
+
+        memset(&r, 0, sizeof(r));
+        r.tsc = 123456789012345ULL;
+        r.ino = 4242;
+        r.dev = 2049;
+        r.tid = 777;
+        srand(42);
+        for(int i = 0; i < 8192; i++){
+                r.tsc += 2000 + rand() % 5000;
+                r.offset = (int64_t)i * 4096;
+                r.size = 4096;
+                r.latency_ns = rand() % 100000;
+                r.op = (i % 16) ? TRACE_OP_READ : TRACE_OP_WRITE;
+                seq.push_back(r);
+        }
+        roundtrip(seq);
+
+        /*the deltas of a sequential stream encode to a fraction of the raw records*/
+        std::vector<uint8_t> buf(TRACE_MAX_ENCODED_BYTES(seq.size()));
+        CHECK(trace_encode_block(seq.data(), seq.size(), buf.data()) < seq.size() * sizeof(struct trace_record) / 2);
+}
+
+TEST_CASE("Fields jumping between their limits", "[trace_format][extremes]"){
+        std::vector<struct trace_record> extremes;
+        struct trace_record r;
+
+        memset(&r, 0, sizeof(r));
+        extremes.push_back(r);
+        r.tsc = UINT64_MAX;
+        r.ino = UINT64_MAX;
+        r.dev = UINT64_MAX;
+        r.offset = INT64_MAX;
+        r.size = UINT32_MAX;
+        r.latency_ns = UINT32_MAX;
+        r.tid = UINT32_MAX;
+        r.op = TRACE_OP_WRITE;
+        extremes.push_back(r);
+        r.offset = INT64_MIN;
+        r.tsc = 1;
+        extremes.push_back(r);
+        roundtrip(extremes);
+}
+
+TEST_CASE("Empty block", "[trace_format][empty]"){
+        roundtrip(std::vector<struct trace_record>());
+}
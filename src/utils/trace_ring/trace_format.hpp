@@ -0,0 +1,150 @@
+#ifndef _TRACE_FORMAT_HPP
+#define _TRACE_FORMAT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * On disk format of SpeedyIO I/O traces, shared by trace_ring.cpp and
+ * tools/trace_decode.
+ *
+ * A trace file is a trace_file_header followed by blocks. Each block is
+ * a trace_block_header and nr_bytes of payload holding nr_records
+ * records, either raw struct trace_records or, with TRACE_F_COMPRESSED,
+ * delta encoded (see trace_encode_block).
+ */
+
+#define TRACE_FILE_MAGIC 0x45434152544f4953ULL     /*"SIOTRACE"*/
+#define TRACE_FILE_VERSION 1
+
+#define TRACE_F_COMPRESSED 0x1
+
+enum trace_op {
+        TRACE_OP_READ = 0,
+        TRACE_OP_WRITE,
+};
+
+struct trace_record {
+        uint64_t tsc;           /*__rdtsc() when the I/O was handled*/
+        uint64_t ino;
+        uint64_t dev;
+        int64_t offset;
+        uint32_t size;
+        uint32_t latency_ns;    /*of the real syscall, 0 if not timed*/
+        uint32_t tid;
+        uint16_t op;            /*enum trace_op*/
+        uint16_t reserved;
+};
+static_assert(sizeof(struct trace_record) == 48, "trace_record is part of the file format");
+
+struct trace_file_header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t record_size;   /*sizeof(struct trace_record)*/
+        uint32_t pid;
+        uint32_t flags;
+        uint64_t tsc_hz;        /*0 if unknown*/
+        uint64_t start_tsc;
+        uint64_t start_realtime_ns;
+};
+
+struct trace_block_header {
+        uint32_t nr_records;
+        uint32_t nr_bytes;
+        uint32_t nr_dropped;    /*records lost to full rings since the last block*/
+        uint32_t reserved;
+};
+
+/*8 fields of upto 10 bytes each*/
+#define TRACE_MAX_ENCODED_BYTES(nr) ((nr) * 80)
+
+static inline uint64_t trace_zigzag(int64_t v){
+        return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t trace_unzigzag(uint64_t v){
+        return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline uint8_t *trace_put_varint(uint8_t *p, uint64_t v){
+        while(v >= 0x80){
+                *p++ = (uint8_t)v | 0x80;
+                v >>= 7;
+        }
+        *p++ = (uint8_t)v;
+        return p;
+}
+
+/*Returns nullptr if the varint runs past end*/
+static inline const uint8_t *trace_get_varint(const uint8_t *p, const uint8_t *end, uint64_t *v){
+        uint64_t val = 0;
+
+        for(int shift = 0; p < end && shift < 64; shift += 7){
+                val |= (uint64_t)(*p & 0x7f) << shift;
+                if(!(*p++ & 0x80)){
+                        *v = val;
+                        return p;
+                }
+        }
+        return nullptr;
+}
+
+/**
+ * Each field is stored as a zigzag varint of its difference from the
+ * previous record in the block. Records of one thread come together, so
+ * tid, ino and dev mostly cost a byte and tsc/offset a few.
+ * out must hold TRACE_MAX_ENCODED_BYTES(nr). Returns the bytes written.
+ */
+static inline size_t trace_encode_block(const struct trace_record *recs, size_t nr, uint8_t *out){
+        struct trace_record prev;
+        uint8_t *p = out;
+
+        memset(&prev, 0, sizeof(prev));
+        for(size_t i = 0; i < nr; i++){
+                const struct trace_record *r = &recs[i];
+
+                p = trace_put_varint(p, trace_zigzag(r->tsc - prev.tsc));
+                p = trace_put_varint(p, trace_zigzag((int64_t)r->tid - prev.tid));
+                p = trace_put_varint(p, trace_zigzag(r->ino - prev.ino));
+                p = trace_put_varint(p, trace_zigzag(r->dev - prev.dev));
+                p = trace_put_varint(p, trace_zigzag(r->offset - prev.offset));
+                p = trace_put_varint(p, r->size);
+                p = trace_put_varint(p, r->latency_ns);
+                p = trace_put_varint(p, r->op);
+                prev = *r;
+        }
+        return p - out;
+}
+
+/*Returns false if the payload is corrupt*/
+static inline bool trace_decode_block(const uint8_t *in, size_t len, struct trace_record *recs, size_t nr){
+        const uint8_t *p = in, *end = in + len;
+        struct trace_record prev;
+        uint64_t v[8];
+
+        memset(&prev, 0, sizeof(prev));
+        for(size_t i = 0; i < nr; i++){
+                struct trace_record *r = &recs[i];
+
+                for(int f = 0; f < 8; f++){
+                        p = trace_get_varint(p, end, &v[f]);
+                        if(!p){
+                                return false;
+                        }
+                }
+                r->tsc = prev.tsc + trace_unzigzag(v[0]);
+                r->tid = prev.tid + trace_unzigzag(v[1]);
+                r->ino = prev.ino + trace_unzigzag(v[2]);
+                r->dev = prev.dev + trace_unzigzag(v[3]);
+                r->offset = prev.offset + trace_unzigzag(v[4]);
+                r->size = v[5];
+                r->latency_ns = v[6];
+                r->op = v[7];
+                r->reserved = 0;
+                prev = *r;
+        }
+        return p == end;
+}
+
+#endif //_TRACE_FORMAT_HPP
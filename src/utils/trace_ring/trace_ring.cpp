@@ -0,0 +1,423 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "trace_ring.hpp"
+#include "utils/ticks.h"
+#include "utils/shim/shim.hpp"
+
+std::atomic<bool> trace_enabled(false);
+
+enum ring_state {
+        RING_FREE = 0,          /*never used*/
+        RING_OWNED,             /*a live thread records into it*/
+        RING_ORPHANED,          /*its thread exited, may be taken over*/
+};
+
+/*
+ * Single producer (the owner thread), single consumer (the flusher).
+ * head and tail only go up; a record lives at [index & (TRACE_RING_RECORDS-1)].
+ */
+struct alignas(CACHELINE_SIZE) trace_ring {
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> tail;
+        std::atomic<int> state;
+        uint32_t tid;
+        std::atomic<struct trace_record *> records;
+};
+
+static_assert((TRACE_RING_RECORDS & (TRACE_RING_RECORDS - 1)) == 0, "TRACE_RING_RECORDS is not a power of 2");
+
+/*all zero, so statically initialized*/
+static struct trace_ring rings[MAX_TRACE_RINGS];
+
+/*rings[0..nr_rings) have been used*/
+static std::atomic<int> nr_rings(0);
+
+static std::atomic<unsigned long> nr_dropped(0);
+
+static thread_local struct trace_ring *my_ring = nullptr;
+
+/*records to drop before looking for a ring again, when all are taken*/
+static thread_local uint32_t ring_retry = 0;
+
+/*
+ * trace_lock protects everything below; held by the flusher while it
+ * drains, and by trace_start/trace_stop.
+ */
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static int trace_fd = -1;
+static bool trace_compress = false;
+static char trace_path[PATH_MAX];
+static unsigned long nr_records_written = 0;
+static unsigned long nr_bytes_written = 0;
+static unsigned long nr_dropped_reported = 0;  /*in a block header*/
+static unsigned long nr_dropped_at_start = 0;
+
+static struct trace_record *drain_buf = nullptr;
+static uint8_t *encode_buf = nullptr;
+
+/*traces started by this process, keeps file names unique*/
+static unsigned int nr_traces = 0;
+
+static bool flusher_started = false;
+static pthread_t flusher_thread;
+
+static struct trace_ring *claim_ring(){
+        struct trace_record *records;
+        int expected, hwm;
+
+        /*rings of exited threads first, they are already mapped*/
+        for(int i = 0; i < nr_rings.load(std::memory_order_acquire); i++){
+                expected = RING_ORPHANED;
+                if(rings[i].state.compare_exchange_strong(expected, RING_OWNED, std::memory_order_acq_rel)){
+                        rings[i].tid = syscall(SYS_gettid);
+                        return &rings[i];
+                }
+        }
+
+        for(int i = 0; i < MAX_TRACE_RINGS; i++){
+                expected = RING_FREE;
+                if(!rings[i].state.compare_exchange_strong(expected, RING_OWNED, std::memory_order_acq_rel)){
+                        continue;
+                }
+
+                records = (struct trace_record *)real_mmap(NULL, sizeof(struct trace_record) * TRACE_RING_RECORDS,
+                                PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if(records == MAP_FAILED){
+                        rings[i].state.store(RING_FREE, std::memory_order_release);
+                        return nullptr;
+                }
+                rings[i].tid = syscall(SYS_gettid);
+                rings[i].records.store(records, std::memory_order_release);
+
+                hwm = nr_rings.load(std::memory_order_relaxed);
+                while(hwm < i + 1 && !nr_rings.compare_exchange_weak(hwm, i + 1, std::memory_order_release));
+                return &rings[i];
+        }
+        return nullptr;
+}
+
+static uint32_t syscall_latency_ns(const struct timespec *start, const struct timespec *end){
+        int64_t ns;
+
+        if(!start || !end){
+                return 0;
+        }
+        ns = (end->tv_sec - start->tv_sec) * 1000000000LL + (end->tv_nsec - start->tv_nsec);
+        return ns < 0 ? 0 : ns > UINT32_MAX ? UINT32_MAX : ns;
+}
+
+void __trace_io(enum trace_op op, ino_t ino, dev_t dev, off_t offset, size_t size,
+                const struct timespec *start, const struct timespec *end){
+        struct trace_ring *ring = my_ring;
+        struct trace_record *rec;
+        uint64_t head;
+
+        if(unlikely(!ring)){
+                if(ring_retry){
+                        ring_retry--;
+                        goto drop;
+                }
+                ring = claim_ring();
+                if(!ring){
+                        ring_retry = TRACE_RING_RECORDS;
+                        goto drop;
+                }
+                my_ring = ring;
+        }
+
+        head = ring->head.load(std::memory_order_relaxed);
+        if(unlikely(head - ring->tail.load(std::memory_order_acquire) >= TRACE_RING_RECORDS)){
+                goto drop;
+        }
+
+        rec = &ring->records.load(std::memory_order_relaxed)[head & (TRACE_RING_RECORDS - 1)];
+        rec->tsc = ticks_now();
+        rec->ino = ino;
+        rec->dev = dev;
+        rec->offset = offset;
+        rec->size = size > UINT32_MAX ? UINT32_MAX : size;
+        rec->latency_ns = syscall_latency_ns(start, end);
+        rec->tid = ring->tid;
+        rec->op = op;
+        rec->reserved = 0;
+
+        ring->head.store(head + 1, std::memory_order_release);
+        return;
+
+drop:
+        nr_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void trace_thread_exit(){
+        if(my_ring){
+                my_ring->state.store(RING_ORPHANED, std::memory_order_release);
+                my_ring = nullptr;
+        }
+}
+
+static bool write_all(int fd, const void *buf, size_t len){
+        const char *p = (const char *)buf;
+        ssize_t nr;
+
+        while(len){
+                nr = real_write(fd, p, len);
+                if(nr < 0 && errno == EINTR){
+                        continue;
+                }
+                if(nr <= 0){
+                        return false;
+                }
+                p += nr;
+                len -= nr;
+        }
+        return true;
+}
+
+/*Called with trace_lock held. Returns false on a write error*/
+static bool write_block(size_t nr){
+        struct trace_block_header hdr;
+        unsigned long dropped = nr_dropped.load(std::memory_order_relaxed);
+        const void *payload = drain_buf;
+
+        hdr.nr_records = nr;
+        hdr.nr_bytes = nr * sizeof(struct trace_record);
+        hdr.nr_dropped = dropped - nr_dropped_reported;
+        hdr.reserved = 0;
+
+        if(trace_compress){
+                hdr.nr_bytes = trace_encode_block(drain_buf, nr, encode_buf);
+                payload = encode_buf;
+        }
+
+        if(!write_all(trace_fd, &hdr, sizeof(hdr)) || !write_all(trace_fd, payload, hdr.nr_bytes)){
+                return false;
+        }
+        nr_dropped_reported = dropped;
+        nr_records_written += nr;
+        nr_bytes_written += sizeof(hdr) + hdr.nr_bytes;
+        return true;
+}
+
+/**
+ * Moves what is in ring to drain_buf and writes it out as one block if
+ * write is set, else throws it away.
+ * Called with trace_lock held. Returns false on a write error.
+ */
+static bool drain_ring(struct trace_ring *ring, bool write){
+        struct trace_record *records = ring->records.load(std::memory_order_acquire);
+        uint64_t tail, head;
+        size_t nr = 0;
+
+        if(!records){
+                return true;
+        }
+
+        tail = ring->tail.load(std::memory_order_relaxed);
+        head = ring->head.load(std::memory_order_acquire);
+        if(tail == head){
+                return true;
+        }
+
+        if(write){
+                for(uint64_t i = tail; i != head; i++){
+                        drain_buf[nr++] = records[i & (TRACE_RING_RECORDS - 1)];
+                }
+        }
+
+        /*the owner may overwrite the slots from here on*/
+        ring->tail.store(head, std::memory_order_release);
+
+        return !nr || write_block(nr);
+}
+
+/*Called with trace_lock held*/
+static void flush_rings(){
+        for(int i = 0; i < nr_rings.load(std::memory_order_acquire); i++){
+                if(drain_ring(&rings[i], true)){
+                        continue;
+                }
+
+                SPEEDYIO_FPRINTF("%s:ERROR writing trace %s failed errno:%d, tracing stopped\n", "SPEEDYIO_ERRCO_0243 %s %d\n", trace_path, errno);
+                trace_enabled.store(false, std::memory_order_relaxed);
+                real_close(trace_fd);
+                trace_fd = -1;
+                return;
+        }
+}
+
+static void *trace_flusher(void *arg){
+        struct timespec ts;
+
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+
+        ts.tv_sec = TRACE_FLUSH_MS / 1000;
+        ts.tv_nsec = (TRACE_FLUSH_MS % 1000) * 1000000L;
+
+        while(true){
+                /*nanosleep is a cancellation point*/
+                nanosleep(&ts, NULL);
+
+                pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+                pthread_mutex_lock(&trace_lock);
+                if(trace_fd >= 0){
+                        flush_rings();
+                }
+                pthread_mutex_unlock(&trace_lock);
+                pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        }
+        return NULL;
+}
+
+/*ticks_now() per second, measured over 10ms*/
+static uint64_t measure_tsc_hz(){
+        struct timespec ts, start, end;
+        uint64_t ticks_start, ticks_end, ns;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ticks_start = ticks_now();
+
+        ts.tv_sec = 0;
+        ts.tv_nsec = 10 * 1000000L;
+        nanosleep(&ts, NULL);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        ticks_end = ticks_now();
+
+        ns = (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+        return ns ? (ticks_end - ticks_start) * 1000000000ULL / ns : 0;
+}
+
+/*A forked child has no flusher and shares the parent's file; it starts with tracing off*/
+static void trace_atfork_child(){
+        trace_enabled.store(false, std::memory_order_relaxed);
+        pthread_mutex_init(&trace_lock, NULL);
+        if(trace_fd >= 0){
+                real_close(trace_fd);
+                trace_fd = -1;
+        }
+        flusher_started = false;
+}
+
+int trace_start(const char *dir, bool compress){
+        struct trace_file_header hdr;
+        struct timespec now;
+        int ret = -1;
+
+        pthread_mutex_lock(&trace_lock);
+
+        if(trace_fd >= 0){
+                goto exit_trace_start;
+        }
+
+        if(!drain_buf){
+                drain_buf = (struct trace_record *)malloc(sizeof(struct trace_record) * TRACE_RING_RECORDS);
+                encode_buf = (uint8_t *)malloc(TRACE_MAX_ENCODED_BYTES(TRACE_RING_RECORDS));
+                if(!drain_buf || !encode_buf){
+                        SPEEDYIO_FPRINTF("%s:ERROR unable to alloc trace buffers\n", "SPEEDYIO_ERRCO_0244\n");
+                        free(drain_buf);
+                        free(encode_buf);
+                        drain_buf = nullptr;
+                        encode_buf = nullptr;
+                        goto exit_trace_start;
+                }
+                pthread_atfork(NULL, NULL, trace_atfork_child);
+        }
+
+        /*records left from an earlier trace*/
+        for(int i = 0; i < nr_rings.load(std::memory_order_acquire); i++){
+                drain_ring(&rings[i], false);
+        }
+
+        clock_gettime(CLOCK_REALTIME, &now);
+        snprintf(trace_path, sizeof(trace_path), "%s/speedyio_trace_%d_%ld_%u.bin",
+                        dir && *dir ? dir : ".", getpid(), (long)now.tv_sec, nr_traces++);
+
+        trace_fd = real_open(trace_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if(trace_fd < 0){
+                SPEEDYIO_FPRINTF("%s:ERROR unable to create trace %s errno:%d\n", "SPEEDYIO_ERRCO_0245 %s %d\n", trace_path, errno);
+                goto exit_trace_start;
+        }
+
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.magic = TRACE_FILE_MAGIC;
+        hdr.version = TRACE_FILE_VERSION;
+        hdr.record_size = sizeof(struct trace_record);
+        hdr.pid = getpid();
+        hdr.flags = compress ? TRACE_F_COMPRESSED : 0;
+        hdr.tsc_hz = measure_tsc_hz();
+        hdr.start_tsc = ticks_now();
+        hdr.start_realtime_ns = now.tv_sec * 1000000000ULL + now.tv_nsec;
+
+        if(!write_all(trace_fd, &hdr, sizeof(hdr))){
+                SPEEDYIO_FPRINTF("%s:ERROR writing trace %s failed errno:%d, tracing stopped\n", "SPEEDYIO_ERRCO_0243 %s %d\n", trace_path, errno);
+                real_close(trace_fd);
+                trace_fd = -1;
+                unlink(trace_path);
+                goto exit_trace_start;
+        }
+
+        if(!flusher_started){
+                if(pthread_create(&flusher_thread, NULL, trace_flusher, NULL)){
+                        SPEEDYIO_FPRINTF("%s:ERROR in creating trace flusher pthread\n", "SPEEDYIO_ERRCO_0246\n");
+                        real_close(trace_fd);
+                        trace_fd = -1;
+                        unlink(trace_path);
+                        goto exit_trace_start;
+                }
+                flusher_started = true;
+        }
+
+        trace_compress = compress;
+        nr_records_written = 0;
+        nr_bytes_written = sizeof(hdr);
+        nr_dropped_reported = nr_dropped.load(std::memory_order_relaxed);
+        nr_dropped_at_start = nr_dropped_reported;
+
+        trace_enabled.store(true, std::memory_order_release);
+        ret = 0;
+
+exit_trace_start:
+        pthread_mutex_unlock(&trace_lock);
+        return ret;
+}
+
+void trace_stop(){
+        trace_enabled.store(false, std::memory_order_relaxed);
+
+        pthread_mutex_lock(&trace_lock);
+        if(trace_fd >= 0){
+                flush_rings();
+        }
+        if(trace_fd >= 0){
+                real_close(trace_fd);
+                trace_fd = -1;
+        }
+        pthread_mutex_unlock(&trace_lock);
+}
+
+void get_trace_stats(struct trace_stats *stats){
+        stats->nr_rings = 0;
+        for(int i = 0; i < nr_rings.load(std::memory_order_acquire); i++){
+                if(rings[i].state.load(std::memory_order_relaxed) == RING_OWNED){
+                        stats->nr_rings++;
+                }
+        }
+
+        pthread_mutex_lock(&trace_lock);
+        stats->enabled = trace_fd >= 0;
+        stats->compressed = trace_compress;
+        stats->nr_records = nr_records_written;
+        stats->nr_bytes = nr_bytes_written;
+        stats->nr_dropped = nr_dropped.load(std::memory_order_relaxed) - nr_dropped_at_start;
+        snprintf(stats->path, sizeof(stats->path), "%s", trace_path);
+        pthread_mutex_unlock(&trace_lock);
+}
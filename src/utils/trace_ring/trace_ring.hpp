@@ -0,0 +1,71 @@
+#ifndef _TRACE_RING_HPP
+#define _TRACE_RING_HPP
+
+#include <stdint.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/types.h>
+
+#include <atomic>
+
+#include "utils/util.hpp"
+#include "trace_format.hpp"
+
+/**
+ * Binary I/O trace capture for production use.
+ *
+ * Each thread that does whitelisted I/O while tracing is on gets its own
+ * mmap'd ring of TRACE_RING_RECORDS fixed size records (trace_format.hpp).
+ * Recording is a ticks_now() and a 48 byte store, no locks, allocation
+ * or syscalls. A flusher thread drains the rings every TRACE_FLUSH_MS to
+ * <dir>/speedyio_trace_<pid>_<time>_<n>.bin, optionally delta compressed.
+ * A full ring drops records (counted in the file) instead of blocking
+ * the application.
+ *
+ * Rings of exited threads are reused by new threads. tools/trace_decode
+ * turns a trace into the .replay CSV written with PRINT_READ_EVENTS.
+ */
+
+extern std::atomic<bool> trace_enabled;
+
+struct trace_stats {
+        bool enabled;
+        bool compressed;
+        int nr_rings;                   /*rings of live threads*/
+        unsigned long nr_records;       /*written since the last trace_start*/
+        unsigned long nr_bytes;
+        unsigned long nr_dropped;
+        char path[PATH_MAX];
+};
+
+/**
+ * Starts tracing to a new file in dir ("." if nullptr).
+ * Returns 0 on success, -1 if tracing is already on or on an error.
+ */
+int trace_start(const char *dir, bool compress);
+
+/*Stops tracing; what is in the rings is flushed and the file closed*/
+void trace_stop();
+
+void get_trace_stats(struct trace_stats *stats);
+
+void __trace_io(enum trace_op op, ino_t ino, dev_t dev, off_t offset, size_t size,
+                const struct timespec *start, const struct timespec *end);
+
+/**
+ * Called from handle_read/handle_write, costs a relaxed load when off.
+ * start and end bound the real syscall; its latency is recorded as 0
+ * if they are nullptr.
+ */
+static inline void trace_io(enum trace_op op, ino_t ino, dev_t dev, off_t offset, size_t size,
+                const struct timespec *start, const struct timespec *end){
+        if(likely(!trace_enabled.load(std::memory_order_relaxed))){
+                return;
+        }
+        __trace_io(op, ino, dev, offset, size, start, end);
+}
+
+/*Gives this thread's ring back, from the per thread destructor*/
+void trace_thread_exit();
+
+#endif //_TRACE_RING_HPP
@@ -17,6 +17,8 @@
 
 /*Used by get_config*/
 #define MAX_DEVICES   8
+#define MAX_WHITELIST_RULES 128
+#define MAX_CACHE_CLASS_SPECS MAX_CACHE_CLASSES
 #define PATH_MAX      4096
 
 #define KILLME()  \
@@ -278,6 +280,23 @@ static inline void cprintf(const char *format, ...) {
 #define MAX_FD_PER_INODE 100
 #endif
 
+/*
+ * Number of fd_info slots embedded in struct inode.
+ * The fdlist moves to the heap and doubles (upto MAX_FD_PER_INODE)
+ * only when a file has more open fds than this.
+ */
+#ifndef INLINE_FD_PER_INODE
+#define INLINE_FD_PER_INODE 4
+#endif
+
+/*
+ * Used to keep hot and contended fields of shared structs
+ * on separate cache lines.
+ */
+#ifndef CACHELINE_SIZE
+#define CACHELINE_SIZE 64
+#endif
+
 
 /*
  * Max number of files to handle in the inode map
@@ -286,6 +305,25 @@ static inline void cprintf(const char *format, ...) {
 #define MAX_IMAP_FILES 50000
 #endif
 
+/*
+ * Number of independently locked shards in the inode map.
+ * Opens of files in different shards never contend. Power of 2.
+ */
+#ifndef NR_IMAP_SHARDS
+#define NR_IMAP_SHARDS 64
+#endif
+
+/*
+ * Max number of cache classes (keyspaces/tables with their own
+ * page cache share), including the default class 0.
+ */
+#ifndef MAX_CACHE_CLASSES
+#define MAX_CACHE_CLASSES 16
+#endif
+
+/*"ks" or "ks.table" of a cache class*/
+#define CACHE_CLASS_NAME_LEN 128
+
 /* Heap macros*/
 
 /*
@@ -405,6 +443,38 @@ static inline void cprintf(const char *format, ...) {
 #endif
 
 
+/*
+ * With ENABLE_FILE_ROLE_TIERS, a file one role tier up (eg. Index.db
+ * over Data.db) is evicted as if it was last accessed this many ms later.
+ */
+#ifndef FILE_ROLE_TIER_AGE_MS
+#define FILE_ROLE_TIER_AGE_MS 2000
+#endif
+
+
+/*
+ * With ENABLE_BUSY_FILES, a file with BUSY_MIN_READS application reads
+ * in flight is busy. A busy victim is passed over for a file that is at
+ * most BUSY_COLD_SLACK_PCT % less cold, upto BUSY_MAX_PASSES files per
+ * pick, and is evicted BUSY_EVICT_CHUNK_KB at a time.
+ */
+#ifndef BUSY_MIN_READS
+#define BUSY_MIN_READS 1
+#endif
+
+#ifndef BUSY_COLD_SLACK_PCT
+#define BUSY_COLD_SLACK_PCT 10
+#endif
+
+#ifndef BUSY_MAX_PASSES
+#define BUSY_MAX_PASSES 4
+#endif
+
+#ifndef BUSY_EVICT_CHUNK_KB
+#define BUSY_EVICT_CHUNK_KB 2048
+#endif
+
+
 /**
  * time interval between start stop trigger checks in sec
  */
@@ -413,6 +483,77 @@ static inline void cprintf(const char *format, ...) {
 #endif
 
 
+/**
+ * Admin socket, see utils/admin_socket/admin_socket.hpp.
+ * Without an admin_socket in the config it listens on the abstract
+ * unix socket ADMIN_SOCKET_NAME_FMT % pid.
+ */
+#ifndef ADMIN_SOCKET_NAME_FMT
+#define ADMIN_SOCKET_NAME_FMT "speedyio.%d"
+#endif
+
+#ifndef ADMIN_MAX_CLIENTS
+#define ADMIN_MAX_CLIENTS 8
+#endif
+
+/*longest command line, a whitelist with many rules is the long one*/
+#ifndef ADMIN_LINE_MAX
+#define ADMIN_LINE_MAX (16 * 1024)
+#endif
+
+#ifndef ADMIN_MAX_ARGS
+#define ADMIN_MAX_ARGS (MAX_WHITELIST_RULES + 2)
+#endif
+
+#ifndef ADMIN_MAX_COMMANDS
+#define ADMIN_MAX_COMMANDS 32
+#endif
+
+/*How often the stats in /dev/shm/speedyio.<pid> are refreshed*/
+#ifndef STATS_PUBLISH_MS
+#define STATS_PUBLISH_MS 100
+#endif
+
+/**
+ * I/O trace capture, see utils/trace_ring/trace_ring.hpp
+ * Each thread gets a ring of TRACE_RING_RECORDS (power of 2) records,
+ * drained every TRACE_FLUSH_MS. A ring holds ~160K I/Os per second.
+ */
+#ifndef TRACE_RING_RECORDS
+#define TRACE_RING_RECORDS 8192
+#endif
+
+#ifndef MAX_TRACE_RINGS
+#define MAX_TRACE_RINGS 512
+#endif
+
+#ifndef TRACE_FLUSH_MS
+#define TRACE_FLUSH_MS 50
+#endif
+
+/**
+ * Online miss ratio curve, see utils/shards/shards.hpp
+ * SHARDS_SAMPLE_PPM of the portions read are sampled; the rate is halved
+ * whenever more than SHARDS_MAX_KEYS sampled portions are tracked.
+ */
+#ifndef SHARDS_SAMPLE_PPM
+#define SHARDS_SAMPLE_PPM 10000
+#endif
+
+#ifndef SHARDS_MAX_KEYS
+#define SHARDS_MAX_KEYS 32768
+#endif
+
+/*sampled reads buffered between two runs of the shards thread*/
+#ifndef SHARDS_BUF_ENTRIES
+#define SHARDS_BUF_ENTRIES 16384
+#endif
+
+#ifndef SHARDS_PROCESS_MS
+#define SHARDS_PROCESS_MS 100
+#endif
+
+
 /**
  * sleep time (sec) for bg_inode_cleaner
  * currently set to 15 min
@@ -0,0 +1,81 @@
+#include "catch_amalgamated.hpp"
+
+#include "utils/whitelist/whitelist.hpp"
+
+/*
+ * The rules are process wide and the built in ones cannot be put back,
+ * so only the first test case configures rules.
+ */
+
+TEST_CASE("Built in rules till rules are configured", "[whitelist][rules]"){
+        char *rules[] = {
+                (char *)"manage:suffix:Data.db",
+                (char *)"manage:suffix:Partitions.db",
+                (char *)"manage:suffix:Summary.db",
+                (char *)"manage-without-fadv-random:suffix:.sst",
+                (char *)"manage-without-fadv-random:suffix:.blob",
+                (char *)"manage:prefix:myapp-",
+                (char *)"manage:glob:seg-*.idx",
+                (char *)"manage:glob:/srv/*/cache/*.bin",
+                (char *)"ignore:dir:/data/tmp/",
+                (char *)"ignore:prefix:tmp-",
+        };
+
+        /*Index.db, Data.db and .sst*/
+        REQUIRE(get_whitelist_action("/data/ks/tbl/nb-1-big-Data.db") == WL_ACTION_MANAGE);
+        REQUIRE(get_whitelist_action("/data/ks/tbl/nb-1-big-Index.db") == WL_ACTION_MANAGE);
+        REQUIRE(get_whitelist_action("/data/rocks/000123.sst") == WL_ACTION_MANAGE);
+        REQUIRE(get_whitelist_action("/data/ks/tbl/nb-1-big-Summary.db") == WL_ACTION_NONE);
+        REQUIRE(get_whitelist_action("Data.db") == WL_ACTION_MANAGE);
+        REQUIRE(get_whitelist_action("") == WL_ACTION_NONE);
+        REQUIRE(get_whitelist_action(nullptr) == WL_ACTION_NONE);
+
+        REQUIRE_FALSE(to_skip_fadv_random("/a/nb-1-big-Data.db"));
+        REQUIRE_FALSE(to_skip_fadv_random("/a/1.sst"));
+        REQUIRE(to_skip_fadv_random("/a/x.jar"));
+
+        REQUIRE(init_whitelist_rules(rules, sizeof(rules) / sizeof(rules[0])) == 0);
+
+        /*suffix, prefix and glob rules match the last path component*/
+        CHECK(get_whitelist_action("/data/ks/tbl/nb-1-big-Partitions.db") == WL_ACTION_MANAGE);
+        CHECK(get_whitelist_action("/data/ks/tbl/nb-1-big-Summary.db") == WL_ACTION_MANAGE);
+        CHECK(get_whitelist_action("/data/ks/tbl/nb-1-big-Index.db") == WL_ACTION_NONE);
+        CHECK(get_whitelist_action("/data/rocks/000123.sst") == WL_ACTION_MANAGE_NO_FADV_RANDOM);
+        CHECK(get_whitelist_action("/data/rocks/000124.blob") == WL_ACTION_MANAGE_NO_FADV_RANDOM);
+        CHECK(get_whitelist_action("/var/lib/myapp-0001.log") == WL_ACTION_MANAGE);
+        CHECK(get_whitelist_action("/var/lib/myapp/notmine.log") == WL_ACTION_NONE);
+        CHECK(get_whitelist_action("/idx/seg-42.idx") == WL_ACTION_MANAGE);
+        CHECK(get_whitelist_action("/idx/seg-42.idx.tmp") == WL_ACTION_NONE);
+
+        /*a glob with a / matches the whole path, * does not cross a /*/
+        CHECK(get_whitelist_action("/srv/a/cache/x.bin") == WL_ACTION_MANAGE);
+        CHECK(get_whitelist_action("/srv/a/b/cache/x.bin") == WL_ACTION_NONE);
+
+        /*ignore beats manage*/
+        CHECK(get_whitelist_action("/data/tmp/000125.sst") == WL_ACTION_IGNORE);
+        CHECK(get_whitelist_action("/data/tmpx/000125.sst") == WL_ACTION_MANAGE_NO_FADV_RANDOM);
+        CHECK(get_whitelist_action("/data/rocks/tmp-000126.sst") == WL_ACTION_IGNORE);
+        CHECK_FALSE(is_whitelisted("/data/tmp/000125.sst"));
+        CHECK(is_whitelisted("/data/rocks/000124.blob"));
+
+        /*with path scoped rules every raw pathname not ignored by name is a candidate*/
+        CHECK(is_whitelist_candidate("x.jar"));
+        CHECK_FALSE(is_whitelist_candidate("tmp-1.sst"));
+}
+
+TEST_CASE("A malformed rule changes no rules", "[whitelist][malformed]"){
+        char *bad_type[] = {(char *)"manage:bogus:x"};
+        char *bad_action[] = {(char *)"keep:suffix:.sst"};
+        char *no_pattern[] = {(char *)"manage:suffix:"};
+        char *one_bad[] = {(char *)"manage:suffix:.log", (char *)"manage:suffix"};
+        enum whitelist_action sst = get_whitelist_action("/data/rocks/000123.sst");
+        enum whitelist_action log = get_whitelist_action("/var/log/app.log");
+
+        REQUIRE(init_whitelist_rules(bad_type, 1) == -1);
+        REQUIRE(init_whitelist_rules(bad_action, 1) == -1);
+        REQUIRE(init_whitelist_rules(no_pattern, 1) == -1);
+        REQUIRE(init_whitelist_rules(one_bad, 2) == -1);
+
+        REQUIRE(get_whitelist_action("/data/rocks/000123.sst") == sst);
+        REQUIRE(get_whitelist_action("/var/log/app.log") == log);
+}
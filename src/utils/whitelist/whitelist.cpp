@@ -1,73 +1,383 @@
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
+#include <fnmatch.h>
+
+#include <atomic>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
 
 #include "../util.hpp"
+#include "whitelist.hpp"
+
+/*
+ * Rules used till init_whitelist_rules is called, or when the config
+ * has none. Same as the old hardcoded whitelist: Index.db, Data.db and
+ * .sst files are managed, with FADV_RANDOM like every other open.
+ */
+static const char *default_rules[] = {
+        "manage:suffix:Index.db",
+        "manage:suffix:Data.db",
+        "manage:suffix:.sst",
+};
+
+static const char *action_names[NR_WL_ACTIONS] = {
+        nullptr, "manage", "manage-without-fadv-random", "ignore"
+};
+
+#define WL_BIT(action) (1U << (action))
+
+/**
+ * ByteTrie
+ * - Keys are inserted into a std::map based trie, then freeze() flattens
+ *   it into node and edge arrays so lookups only touch contiguous memory.
+ * - Each node has the bitmask of actions of the keys ending at it and
+ *   the ids of the globs whose literal tail ends at it.
+ * - walk() follows str byte by byte (from the end if reversed) and calls
+ *   on_node for every node on the way, so a lookup costs at most the
+ *   length of the longest key no matter how many keys there are.
+ */
+class ByteTrie {
+public:
+        ByteTrie() : build(1) {}
+
+        /*Throws std::bad_alloc*/
+        void insert(const char *key, size_t len, bool reversed, unsigned actions, int glob_id) {
+                uint32_t cur = 0;
+                for (size_t i = 0; i < len; i++) {
+                        unsigned char ch = reversed ? key[len - 1 - i] : key[i];
+                        auto it = build[cur].next.find(ch);
+                        if (it == build[cur].next.end()) {
+                                uint32_t child = build.size();
+                                build.emplace_back();
+                                build[cur].next[ch] = child;
+                                cur = child;
+                        } else {
+                                cur = it->second;
+                        }
+                }
+                build[cur].actions |= actions;
+                if (glob_id >= 0)
+                        build[cur].globs.push_back(glob_id);
+        }
+
+        /*Throws std::bad_alloc. Node ids stay the same as in build*/
+        void freeze() {
+                nodes.resize(build.size());
+                for (size_t i = 0; i < build.size(); i++) {
+                        nodes[i].edge_begin = edges.size();
+                        nodes[i].nr_edges = build[i].next.size();
+                        nodes[i].actions = build[i].actions;
+                        nodes[i].glob_begin = glob_ids.size();
+                        nodes[i].nr_globs = build[i].globs.size();
+                        /*std::map keeps the edges sorted by byte*/
+                        for (auto &e : build[i].next)
+                                edges.push_back({e.first, e.second});
+                        glob_ids.insert(glob_ids.end(), build[i].globs.begin(), build[i].globs.end());
+                }
+                std::vector<build_node>().swap(build);
+        }
+
+        /*on_node(actions, glob_ids, nr_globs)*/
+        template <typename F>
+        void walk(const char *str, size_t len, bool reversed, F on_node) const {
+                uint32_t cur = 0;
+                if (nodes.size() <= 1)
+                        return;
+                for (size_t i = 0; i < len; i++) {
+                        unsigned char ch = reversed ? str[len - 1 - i] : str[i];
+                        const struct node &n = nodes[cur];
+                        const struct edge *e = &edges[n.edge_begin];
+                        const struct edge *end = e + n.nr_edges;
+                        while (e < end && e->ch < ch)
+                                e++;
+                        if (e == end || e->ch != ch)
+                                return;
+                        cur = e->child;
+                        on_node(nodes[cur].actions, &glob_ids[nodes[cur].glob_begin], nodes[cur].nr_globs);
+                }
+        }
+
+private:
+        struct build_node {
+                std::map<unsigned char, uint32_t> next;
+                unsigned actions = 0;
+                std::vector<int> globs;
+        };
+
+        struct node {
+                uint32_t edge_begin;
+                uint16_t nr_edges;
+                uint16_t actions;
+                uint32_t glob_begin;
+                uint32_t nr_globs;
+        };
+
+        struct edge {
+                unsigned char ch;
+                uint32_t child;
+        };
+
+        std::vector<build_node> build;
+        std::vector<struct node> nodes;
+        std::vector<struct edge> edges;
+        std::vector<int> glob_ids;
+};
+
+/**
+ * WhitelistMatcher
+ * Compiled form of the whitelist rules.
+ * - suffix rules: one reversed trie walked from the end of the path.
+ * - prefix rules: one trie walked over the last path component.
+ * - dir rules: one trie over the whole path, keys end with '/'.
+ * - glob rules: the literal tail of the glob (after its last wildcard)
+ *   goes into the suffix trie, fnmatch only runs when that tail matched.
+ *   Globs ending in a wildcard are always fnmatch'ed, keep them few.
+ * Globs with a '/' match the whole path, others the last component.
+ */
+class WhitelistMatcher {
+public:
+        WhitelistMatcher() : has_path_rules(false) {}
+
+        /*Returns false if rule is malformed. Throws std::bad_alloc*/
+        bool add_rule(const char *rule) {
+                const char *type, *pattern;
+                int action = WL_ACTION_NONE;
+                size_t len;
+
+                type = strchr(rule, ':');
+                if (!type)
+                        return false;
+                for (int i = WL_ACTION_MANAGE; i < NR_WL_ACTIONS; i++) {
+                        len = strlen(action_names[i]);
+                        if ((size_t)(type - rule) == len && !strncmp(rule, action_names[i], len))
+                                action = i;
+                }
+                if (action == WL_ACTION_NONE)
+                        return false;
+
+                type++;
+                pattern = strchr(type, ':');
+                if (!pattern || !*++pattern)
+                        return false;
+                len = strlen(pattern);
+
+                if (!strncmp(type, "suffix:", 7)) {
+                        suffixes.insert(pattern, len, true, WL_BIT(action), -1);
+                } else if (!strncmp(type, "prefix:", 7)) {
+                        /*prefixes are matched against the last path component*/
+                        if (strchr(pattern, '/'))
+                                return false;
+                        prefixes.insert(pattern, len, false, WL_BIT(action), -1);
+                } else if (!strncmp(type, "dir:", 4)) {
+                        if (pattern[0] != '/')
+                                return false;
+                        std::string dir(pattern);
+                        while (dir.size() > 1 && dir.back() == '/')
+                                dir.pop_back();
+                        if (dir.size() > 1)
+                                dir.push_back('/');
+                        dirs.insert(dir.c_str(), dir.size(), false, WL_BIT(action), -1);
+                        has_path_rules = true;
+                } else if (!strncmp(type, "glob:", 5)) {
+                        add_glob(pattern, action);
+                } else {
+                        return false;
+                }
+                return true;
+        }
+
+        void freeze() {
+                suffixes.freeze();
+                prefixes.freeze();
+                dirs.freeze();
+        }
+
+        /**
+         * Returns the bitmask of actions of all rules matching path.
+         * With name_only, dir and full path glob rules are skipped.
+         */
+        unsigned match(const char *path, bool name_only) const {
+                unsigned bits = 0;
+                size_t len = strlen(path);
+                const char *name = strrchr(path, '/');
+
+                name = name ? name + 1 : path;
+
+                auto check_globs = [&](const int *ids, uint32_t nr) {
+                        for (uint32_t i = 0; i < nr; i++) {
+                                const struct glob_rule &g = globs[ids[i]];
+                                if (g.full_path && name_only)
+                                        continue;
+                                if (!fnmatch(g.pattern.c_str(), g.full_path ? path : name,
+                                                        g.full_path ? FNM_PATHNAME : 0))
+                                        bits |= g.action_bit;
+                        }
+                };
+
+                auto on_node = [&](unsigned actions, const int *ids, uint32_t nr) {
+                        bits |= actions;
+                        check_globs(ids, nr);
+                };
 
-bool endsWith(const char* str, const char* suffix) {
-    if (!str || !suffix) return false;
-    size_t strLen = strlen(str);
-    size_t suffixLen = strlen(suffix);
-    if (suffixLen > strLen) return false;
-    // Compare the ending portion of str with suffix using pointer arithmetic
-    return strcmp(str + (strLen - suffixLen), suffix) == 0;
+                suffixes.walk(path, len, true, on_node);
+                prefixes.walk(name, len - (name - path), false, on_node);
+                if (!name_only)
+                        dirs.walk(path, len, false, on_node);
+                if (!tailless_globs.empty())
+                        check_globs(tailless_globs.data(), tailless_globs.size());
+
+                return bits;
+        }
+
+        /*Is there any rule that needs the canonical path to match*/
+        bool has_path_rules;
+
+private:
+        struct glob_rule {
+                std::string pattern;
+                unsigned action_bit;
+                bool full_path;
+        };
+
+        void add_glob(const char *pattern, int action) {
+                const char *tail = pattern;
+                int id = globs.size();
+                bool full_path = strchr(pattern, '/') != nullptr;
+
+                for (const char *p = pattern; *p; p++) {
+                        if (strchr("*?[]\\", *p))
+                                tail = p + 1;
+                }
+
+                globs.push_back({pattern, WL_BIT(action), full_path});
+                if (full_path)
+                        has_path_rules = true;
+
+                if (*tail)
+                        suffixes.insert(tail, strlen(tail), true, 0, id);
+                else
+                        tailless_globs.push_back(id);
+        }
+
+        ByteTrie suffixes;
+        ByteTrie prefixes;
+        ByteTrie dirs;
+        std::vector<struct glob_rule> globs;
+        std::vector<int> tailless_globs;
+};
+
+/*Returns nullptr if any rule is malformed or memory ran out*/
+static WhitelistMatcher *compile_rules(const char *const *rules, size_t nr_rules) {
+        WhitelistMatcher *m = nullptr;
+
+        try {
+                m = new WhitelistMatcher();
+                for (size_t i = 0; i < nr_rules; i++) {
+                        if (!m->add_rule(rules[i])) {
+                                SPEEDYIO_FPRINTF("%s:ERROR malformed whitelist rule '%s'\n", "SPEEDYIO_ERRCO_0220 %s\n", rules[i]);
+                                goto compile_rules_err;
+                        }
+                }
+                m->freeze();
+        } catch (const std::bad_alloc &e) {
+                SPEEDYIO_FPRINTF("%s:ERROR unable to compile %zu whitelist rules: %s\n", "SPEEDYIO_ERRCO_0221 %zu %s\n", nr_rules, e.what());
+                goto compile_rules_err;
+        }
+        return m;
+
+compile_rules_err:
+        delete m;
+        return nullptr;
 }
 
-bool containsSubstring(const char* str, const char* substr) {
-    return strstr(str, substr) != nullptr;
+/*
+ * Swapped in by init_whitelist_rules, at startup and from the admin
+ * socket. Old matchers are never freed since a concurrent open might
+ * still be using them; reloads are rare.
+ */
+static std::atomic<const WhitelistMatcher *> active_rules(nullptr);
+
+static const WhitelistMatcher *get_matcher() {
+        const WhitelistMatcher *m = active_rules.load(std::memory_order_acquire);
+        if (likely(m))
+                return m;
+
+        static const WhitelistMatcher *defaults =
+                compile_rules(default_rules, sizeof(default_rules) / sizeof(default_rules[0]));
+        return defaults;
+}
+
+static enum whitelist_action bits_to_action(unsigned bits) {
+        if (!bits)
+                return WL_ACTION_NONE;
+        return (enum whitelist_action)(31 - __builtin_clz(bits));
 }
 
-const char *whitelist[] = {"Index.db", "Data.db", ".sst"};
-// const char *whitelist[] = {".db", ".log", ".sst"};
-//const char *whitelist[] = {"big-Data.db", ".sst"};
-// const char *whitelist[] = {".db", ".log", ".sst"};
+int init_whitelist_rules(char *const *rules, size_t nr_rules) {
+        WhitelistMatcher *m;
 
-const char *fadv_whitelist[] = {"Data.db", "Index.db"};
+        if (!nr_rules)
+                return 0;
 
-//const char *whitelist[] = {"Data.db", "Index.db"};
-// const char *whitelist[] = {"sfdaguisadf"};
-//const char *whitelist[] = {".db", ".sst"};
+        m = compile_rules(rules, nr_rules);
+        if (!m)
+                return -1;
+
+        active_rules.store(m, std::memory_order_release);
+        return 0;
+}
+
+enum whitelist_action get_whitelist_action(const char *filename) {
+        if (!filename)
+                return WL_ACTION_NONE;
+        return bits_to_action(get_matcher()->match(filename, false));
+}
 
 /*
- * Returns true for only files with suffixes that are whitelisted
+ * Returns true for files that a manage rule matches and no ignore rule does.
  * FIXME: Will need to change this for other filesystems
  */
 bool is_whitelisted(const char *filename) {
-        bool ret = false;
-        size_t nr_whitelist = sizeof(whitelist) / sizeof(whitelist[0]);
+        enum whitelist_action action = get_whitelist_action(filename);
+        return action == WL_ACTION_MANAGE || action == WL_ACTION_MANAGE_NO_FADV_RANDOM;
+}
 
-        // printf("%s: nr_whitelist: %zu\n", __func__, nr_whitelist);
+/*
+ * Cheap pre-classification of the raw pathname handed to open/openat,
+ * before any path is canonicalized.
+ *
+ * Returns false only when the pathname can never resolve to a whitelisted
+ * file, so the caller can skip the lstat/readlink/realpath work for it.
+ * Suffix, prefix and plain glob rules match on the last path component,
+ * so the raw pathname and its canonical form agree unless the file itself
+ * is a symlink with a whitelisted target but a non-whitelisted name. Such
+ * symlinks are not used by the DBs we support and are treated as
+ * blacklisted. Dir and path glob rules need the canonical path, so with
+ * any of them configured every file not ignored by name is a candidate.
+ */
+bool is_whitelist_candidate(const char *pathname) {
+        const WhitelistMatcher *m = get_matcher();
+        enum whitelist_action action;
 
-        // Compare the extension with each whitelisted extension
-        for (int i = 0; i < nr_whitelist; i++){
-                if (endsWith(filename, whitelist[i])){
-                        ret = true;
-                        goto is_whitelisted_exit;
-                }
-        }
+        if (!pathname)
+                return false;
 
-is_whitelisted_exit:
-        return ret;
+        action = bits_to_action(m->match(pathname, true));
+        if (action == WL_ACTION_IGNORE)
+                return false;
+        if (action != WL_ACTION_NONE)
+                return true;
+        return m->has_path_rules;
 }
 
 /**
-* returns true for files not in fadv_whitelist
+* returns true for files not managed with POSIX_FADV_RANDOM
 * returns false for all other files
 */
 bool to_skip_fadv_random(const char *filename) {
-        bool ret = true;
-        size_t nr_whitelist = sizeof(fadv_whitelist) / sizeof(fadv_whitelist[0]);
-
-        // printf("%s: nr_whitelist: %zu\n", __func__, nr_whitelist);
-
-        // Compare the extension with each whitelisted extension
-        for (int i = 0; i < nr_whitelist; i++){
-                if (endsWith(filename, fadv_whitelist[i])){
-                        ret = false;
-                        goto to_skip_fadv_random_exit;
-                }
-        }
-
-to_skip_fadv_random_exit:
-        return ret;
-}
\ No newline at end of file
+        return get_whitelist_action(filename) != WL_ACTION_MANAGE;
+}
@@ -1,7 +1,39 @@
 #ifndef _WHITELIST_HPP
 #define _WHITELIST_HPP
 
+#include <stddef.h>
+
+/**
+ * What SpeedyIO does with a file, decided by the whitelist rules.
+ *
+ * When more than one rule matches a file, the highest value wins:
+ * an ignore rule always blacklists the file and
+ * manage-without-fadv-random beats manage.
+ */
+enum whitelist_action {
+        WL_ACTION_NONE = 0,                     /*no rule matched: blacklisted*/
+        WL_ACTION_MANAGE,                       /*whitelisted, opened with POSIX_FADV_RANDOM*/
+        WL_ACTION_MANAGE_NO_FADV_RANDOM,        /*whitelisted, kernel readahead left alone*/
+        WL_ACTION_IGNORE,                       /*blacklisted even if a manage rule matched*/
+        NR_WL_ACTIONS
+};
+
+/**
+ * Compiles the whitelist rules from the config file. Each rule is
+ * "<action>:<type>:<pattern>" with
+ *   action: manage | manage-without-fadv-random | ignore
+ *   type:   suffix | prefix | glob | dir
+ * Till a successful call (or if nr_rules is 0) the built in defaults
+ * apply: Index.db, Data.db and .sst files, as before the rules existed.
+ *
+ * Returns 0 on success, -1 if any rule is malformed (no rules are changed).
+ */
+int init_whitelist_rules(char *const *rules, size_t nr_rules);
+
+enum whitelist_action get_whitelist_action(const char *filename);
+
 bool is_whitelisted(const char *);
+bool is_whitelist_candidate(const char *);
 bool to_skip_fadv_random(const char *);
 
 #endif
@@ -0,0 +1,416 @@
+/**
+ * cache_sim: replays .replay traces (PRINT_READ_EVENTS/PRINT_WRITE_EVENTS
+ * or tools/trace_decode output) against the eviction policy of a
+ * BELADY_PROOF build of SpeedyIO and against Belady's OPT.
+ *
+ * All events of all files are merged and replayed from one thread in
+ * rdtsc order. The simulated page cache holds -c bytes in units of a page
+ * or a portion (1 << (PAGE_SHIFT + PVT_HEAP_PG_ORDER)). Every event goes
+ * to mock_read(); whenever the cache is over capacity mock_eviction()
+ * picks what to drop, exactly like the evictor would. OPT evicts the unit
+ * whose next use is farthest away on the same unit accesses.
+ *
+ * cache_sim -c size [-g page|portion|<bytes>] [-r] [-t N] [-l lib.so] trace.replay ...
+ *      -c size   cache size, K/M/G suffixes allowed
+ *      -g unit   cache granularity, default page
+ *      -r        reads only, skip WRITE_EVENTs
+ *      -t N      per file lines to print, most accessed first (default 20, 0 all)
+ *      -l lib    library to replay against (default ../../lib/lib_speedyio_belady.so,
+ *                built with make BELADY at the top of the repo)
+ *
+ * Build: make
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "belady_proof.hpp"
+#include "common/replay.hpp"
+#include "utils/util.hpp"
+
+#define DEFAULT_LIB "../../lib/lib_speedyio_belady.so"
+
+/*unit keys are <file idx, unit nr>*/
+#define UNIT_NR_BITS 40
+#define UNIT_KEY(file, unit) (((uint64_t)(file) << UNIT_NR_BITS) | (unit))
+#define UNIT_FILE(key) ((key) >> UNIT_NR_BITS)
+
+typedef int (*populate_inodes_fn)(struct mock_all_inodes *);
+typedef int *(*mock_read_fn)(struct mock_read_event *);
+typedef struct mock_eviction_item *(*mock_eviction_fn)(void);
+
+struct sim_opts {
+        unsigned long cache_bytes;
+        unsigned long unit_bytes;
+        bool reads_only;
+        long top;
+        const char *lib;
+};
+
+struct event {
+        uint64_t tsc;
+        uint32_t file;
+        off_t offset;
+        size_t size;
+};
+
+struct file_stats {
+        ino_t ino;
+        dev_t dev_id;
+        unsigned long accesses;         /*unit accesses*/
+        unsigned long hits;
+        unsigned long opt_hits;
+        unsigned long bytes;            /*bytes read and written*/
+        unsigned long evicted_units;
+        unsigned long opt_evicted_units;
+};
+
+static std::vector<struct event> events;
+static std::vector<struct file_stats> files;
+static std::map<std::pair<ino_t, dev_t>, uint32_t> file_idx;
+
+static unsigned long parse_size(const char *str){
+        char *end;
+        unsigned long val = strtoul(str, &end, 10);
+
+        switch(*end){
+        case 'g': case 'G':
+                val <<= 10;
+                /* fall through */
+        case 'm': case 'M':
+                val <<= 10;
+                /* fall through */
+        case 'k': case 'K':
+                val <<= 10;
+                end++;
+                break;
+        }
+        return *end ? 0 : val;
+}
+
+static uint32_t get_file(ino_t ino, dev_t dev_id){
+        auto key = std::make_pair(ino, dev_id);
+        auto it = file_idx.find(key);
+        struct file_stats fs;
+
+        if(it != file_idx.end()){
+                return it->second;
+        }
+        memset(&fs, 0, sizeof(fs));
+        fs.ino = ino;
+        fs.dev_id = dev_id;
+        files.push_back(fs);
+        file_idx[key] = files.size() - 1;
+        return files.size() - 1;
+}
+
+static int load_trace(const char *path, const struct sim_opts *opts){
+        std::vector<struct replay_event> replay;
+        struct event ev;
+
+        if(load_replay(path, opts->reads_only, replay)){
+                return 1;
+        }
+        for(auto &r : replay){
+                ev.tsc = r.tsc;
+                ev.file = get_file(r.ino, r.dev_id);
+                ev.offset = r.offset;
+                ev.size = r.size;
+                events.push_back(ev);
+        }
+        return 0;
+}
+
+static inline uint64_t first_unit(const struct event &ev, unsigned long unit_bytes){
+        return ev.offset / unit_bytes;
+}
+
+static inline uint64_t last_unit(const struct event &ev, unsigned long unit_bytes){
+        return (ev.offset + ev.size - 1) / unit_bytes;
+}
+
+struct sim_result {
+        unsigned long accesses;
+        unsigned long hits;
+        unsigned long evicted_units;
+        unsigned long nr_evictions;     /*mock_eviction() calls*/
+        unsigned long nr_no_victim;
+};
+
+/*Drops the units of file in [first, last] from the cache, returns how many were cached*/
+static unsigned long drop_units(std::set<uint64_t> &cached, uint64_t first, uint64_t last){
+        auto from = cached.lower_bound(first);
+        auto to = cached.upper_bound(last);
+        unsigned long nr = std::distance(from, to);
+
+        cached.erase(from, to);
+        return nr;
+}
+
+static int run_policy(const struct sim_opts *opts, unsigned long capacity, struct sim_result *res){
+        populate_inodes_fn populate_inodes;
+        mock_read_fn mock_read;
+        mock_eviction_fn mock_eviction;
+        std::vector<struct mock_inode> inodes(files.size());
+        std::vector<std::set<uint64_t>> cached(files.size());
+        struct mock_all_inodes inode_list;
+        struct mock_read_event rev;
+        struct mock_eviction_item *victim;
+        unsigned long nr_cached = 0, nr;
+        void *lib;
+
+        lib = dlopen(opts->lib, RTLD_NOW | RTLD_LOCAL);
+        if(!lib){
+                fprintf(stderr, "%s\n", dlerror());
+                return 1;
+        }
+        populate_inodes = (populate_inodes_fn)dlsym(lib, "populate_inodes");
+        mock_read = (mock_read_fn)dlsym(lib, "mock_read");
+        mock_eviction = (mock_eviction_fn)dlsym(lib, "mock_eviction");
+        if(!populate_inodes || !mock_read || !mock_eviction){
+                fprintf(stderr, "%s is not a BELADY_PROOF build (make BELADY)\n", opts->lib);
+                return 1;
+        }
+
+        for(size_t i = 0; i < files.size(); i++){
+                inodes[i].ino = files[i].ino;
+                inodes[i].dev_id = files[i].dev_id;
+        }
+        inode_list.nr_inodes = inodes.size();
+        inode_list.inodes = inodes.data();
+        populate_inodes(&inode_list);
+
+        for(auto &ev : events){
+                struct file_stats &fs = files[ev.file];
+
+                for(uint64_t u = first_unit(ev, opts->unit_bytes); u <= last_unit(ev, opts->unit_bytes); u++){
+                        fs.accesses++;
+                        if(cached[ev.file].insert(u).second){
+                                nr_cached++;
+                        }else{
+                                fs.hits++;
+                        }
+                }
+                fs.bytes += ev.size;
+
+                rev.ino = fs.ino;
+                rev.dev_id = fs.dev_id;
+                rev.offset = ev.offset;
+                rev.size = ev.size;
+                rev.timestamp = ev.tsc;
+                mock_read(&rev);
+
+                while(nr_cached > capacity){
+                        victim = mock_eviction();
+                        res->nr_evictions++;
+                        if(!victim || victim->ino == 0){
+                                /*over capacity till the policy finds a victim*/
+                                free(victim);
+                                res->nr_no_victim++;
+                                break;
+                        }
+
+                        auto it = file_idx.find(std::make_pair(victim->ino, victim->dev_id));
+                        if(it != file_idx.end()){
+                                std::set<uint64_t> &units = cached[it->second];
+
+                                if(victim->offset == 0 && victim->size == 0){
+                                        nr = units.size();
+                                        units.clear();
+                                }else if(victim->size > 0){
+                                        nr = drop_units(units, victim->offset / opts->unit_bytes,
+                                                        (victim->offset + victim->size - 1) / opts->unit_bytes);
+                                }else{
+                                        nr = 0;
+                                }
+                                nr_cached -= nr;
+                                files[it->second].evicted_units += nr;
+                                res->evicted_units += nr;
+                        }
+                        free(victim);
+                }
+        }
+
+        for(auto &fs : files){
+                res->accesses += fs.accesses;
+                res->hits += fs.hits;
+        }
+        return 0;
+}
+
+/*Belady's OPT: on a miss with a full cache evict the unit used farthest in the future*/
+static void run_opt(const struct sim_opts *opts, unsigned long capacity, struct sim_result *res){
+        std::vector<uint64_t> keys;
+        std::vector<size_t> next_use;
+        std::unordered_map<uint64_t, size_t> last_seen;
+        std::unordered_map<uint64_t, size_t> cached;    /*unit -> its next use*/
+        std::set<std::pair<size_t, uint64_t>> by_next_use;
+        const size_t never = SIZE_MAX;
+
+        for(auto &ev : events){
+                for(uint64_t u = first_unit(ev, opts->unit_bytes); u <= last_unit(ev, opts->unit_bytes); u++){
+                        keys.push_back(UNIT_KEY(ev.file, u));
+                }
+        }
+
+        next_use.resize(keys.size());
+        for(size_t i = keys.size(); i-- > 0;){
+                auto it = last_seen.find(keys[i]);
+                next_use[i] = it == last_seen.end() ? never : it->second;
+                last_seen[keys[i]] = i;
+        }
+        last_seen.clear();
+
+        for(size_t i = 0; i < keys.size(); i++){
+                uint64_t key = keys[i];
+                auto it = cached.find(key);
+
+                res->accesses++;
+                if(it != cached.end()){
+                        res->hits++;
+                        files[UNIT_FILE(key)].opt_hits++;
+                        by_next_use.erase(std::make_pair(it->second, key));
+                        it->second = next_use[i];
+                        by_next_use.insert(std::make_pair(next_use[i], key));
+                        continue;
+                }
+
+                if(cached.size() >= capacity){
+                        auto victim = std::prev(by_next_use.end());
+
+                        files[UNIT_FILE(victim->second)].opt_evicted_units++;
+                        res->evicted_units++;
+                        cached.erase(victim->second);
+                        by_next_use.erase(victim);
+                }
+                cached[key] = next_use[i];
+                by_next_use.insert(std::make_pair(next_use[i], key));
+        }
+}
+
+static double ratio(unsigned long a, unsigned long b){
+        return b ? 100.0 * a / b : 0.0;
+}
+
+static void print_report(const struct sim_opts *opts, const struct sim_result *policy, const struct sim_result *opt){
+        std::vector<uint32_t> order(files.size());
+
+        printf("events %zu, files %zu, unit %lu bytes, cache %lu bytes (%lu units)\n", events.size(),
+                        files.size(), opts->unit_bytes, opts->cache_bytes, opts->cache_bytes / opts->unit_bytes);
+        printf("%-8s %14s %14s %8s %16s\n", "", "accesses", "hits", "hit%", "bytes_evicted");
+        printf("%-8s %14lu %14lu %8.2f %16lu\n", "speedyio", policy->accesses, policy->hits,
+                        ratio(policy->hits, policy->accesses), policy->evicted_units * opts->unit_bytes);
+        printf("%-8s %14lu %14lu %8.2f %16lu\n", "opt", opt->accesses, opt->hits,
+                        ratio(opt->hits, opt->accesses), opt->evicted_units * opts->unit_bytes);
+        printf("mock_eviction calls %lu, without a victim %lu\n", policy->nr_evictions, policy->nr_no_victim);
+
+        for(size_t i = 0; i < order.size(); i++){
+                order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [](uint32_t a, uint32_t b){
+                return files[a].accesses > files[b].accesses;
+        });
+        if(opts->top > 0 && (size_t)opts->top < order.size()){
+                order.resize(opts->top);
+        }
+
+        printf("\n%12s %8s %12s %14s %8s %8s %16s %16s\n", "ino", "dev", "accesses", "bytes", "hit%",
+                        "opt_hit%", "bytes_evicted", "opt_evicted");
+        for(auto i : order){
+                struct file_stats &fs = files[i];
+
+                printf("%12lu %8lu %12lu %14lu %8.2f %8.2f %16lu %16lu\n", (unsigned long)fs.ino,
+                                (unsigned long)fs.dev_id, fs.accesses, fs.bytes, ratio(fs.hits, fs.accesses),
+                                ratio(fs.opt_hits, fs.accesses), fs.evicted_units * opts->unit_bytes,
+                                fs.opt_evicted_units * opts->unit_bytes);
+        }
+}
+
+static void usage(const char *prog){
+        fprintf(stderr, "usage: %s -c size [-g page|portion|<bytes>] [-r] [-t N] [-l lib.so] trace.replay ...\n", prog);
+}
+
+int main(int argc, char **argv){
+        struct sim_opts opts = {0, (1UL << PAGE_SHIFT), false, 20, DEFAULT_LIB};
+        struct sim_result policy, opt;
+        unsigned long capacity;
+        int c;
+
+        while((c = getopt(argc, argv, "c:g:rt:l:h")) != -1){
+                switch(c){
+                case 'c':
+                        opts.cache_bytes = parse_size(optarg);
+                        break;
+                case 'g':
+                        if(!strcmp(optarg, "page")){
+                                opts.unit_bytes = (1UL << PAGE_SHIFT);
+                        }else if(!strcmp(optarg, "portion")){
+                                opts.unit_bytes = 1UL << (PAGE_SHIFT + PVT_HEAP_PG_ORDER);
+                        }else{
+                                opts.unit_bytes = parse_size(optarg);
+                        }
+                        break;
+                case 'r':
+                        opts.reads_only = true;
+                        break;
+                case 't':
+                        opts.top = atol(optarg);
+                        break;
+                case 'l':
+                        opts.lib = optarg;
+                        break;
+                default:
+                        usage(argv[0]);
+                        return c == 'h' ? 0 : 1;
+                }
+        }
+        if(optind == argc || opts.unit_bytes == 0){
+                usage(argv[0]);
+                return 1;
+        }
+
+        capacity = opts.cache_bytes / opts.unit_bytes;
+        if(capacity == 0){
+                fprintf(stderr, "cache must hold at least one %lu byte unit\n", opts.unit_bytes);
+                return 1;
+        }
+
+        for(int i = optind; i < argc; i++){
+                if(load_trace(argv[i], &opts)){
+                        return 1;
+                }
+        }
+        if(events.empty()){
+                fprintf(stderr, "no events\n");
+                return 1;
+        }
+
+        /*per thread files are each in order, the merge is not*/
+        std::stable_sort(events.begin(), events.end(), [](const struct event &a, const struct event &b){
+                return a.tsc < b.tsc;
+        });
+
+        memset(&policy, 0, sizeof(policy));
+        memset(&opt, 0, sizeof(opt));
+        if(run_policy(&opts, capacity, &policy)){
+                return 1;
+        }
+        run_opt(&opts, capacity, &opt);
+
+        print_report(&opts, &policy, &opt);
+
+        /*skips the latency dumps of the library's destructor*/
+        fflush(stdout);
+        _exit(0);
+}
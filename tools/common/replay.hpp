@@ -0,0 +1,92 @@
+#ifndef _TOOLS_REPLAY_HPP
+#define _TOOLS_REPLAY_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * Reader for the .replay CSV written with PRINT_READ_EVENTS /
+ * PRINT_WRITE_EVENTS or by tools/trace_decode:
+ *
+ *   <READ|WRITE>_EVENT,pid,tid,ino,tsc,offset,size[,dev,latency_ns]
+ *
+ * Without the trace_decode -x fields all files are on dev 0.
+ */
+
+struct replay_event {
+        uint64_t tsc;
+        ino_t ino;
+        dev_t dev_id;
+        off_t offset;
+        size_t size;
+        bool write;
+};
+
+/**
+ * Appends the events of path to events, skipping empty ones and writes
+ * if reads_only. Returns 0 on success, 1 if the file can't be read.
+ */
+static inline int load_replay(const char *path, bool reads_only, std::vector<struct replay_event> &events){
+        char line[512], op[32];
+        unsigned long pid, tid, ino, tsc, size, dev;
+        long offset;
+        unsigned long nr_lines = 0, nr_bad = 0;
+        struct replay_event ev;
+        int nr;
+        FILE *fp;
+
+        fp = fopen(path, "r");
+        if(!fp){
+                fprintf(stderr, "%s: %s\n", path, strerror(errno));
+                return 1;
+        }
+
+        while(fgets(line, sizeof(line), fp)){
+                nr_lines++;
+                dev = 0;
+                nr = sscanf(line, "%31[A-Z_],%lu,%lu,%lu,%lu,%ld,%lu,%lu", op, &pid, &tid, &ino, &tsc,
+                                &offset, &size, &dev);
+                if(nr < 7 || offset < 0 || ino == 0){
+                        nr_bad++;
+                        continue;
+                }
+                if(!strcmp(op, "READ_EVENT")){
+                        ev.write = false;
+                }else if(!strcmp(op, "WRITE_EVENT")){
+                        ev.write = true;
+                }else{
+                        nr_bad++;
+                        continue;
+                }
+                if(size == 0 || (ev.write && reads_only)){
+                        continue;
+                }
+                ev.tsc = tsc;
+                ev.ino = ino;
+                ev.dev_id = dev;
+                ev.offset = offset;
+                ev.size = size;
+                events.push_back(ev);
+        }
+        fclose(fp);
+
+        if(nr_bad){
+                fprintf(stderr, "%s: skipped %lu of %lu lines\n", path, nr_bad, nr_lines);
+        }
+        return 0;
+}
+
+/*per thread files are each in order, a merge of them is not*/
+static inline void sort_replay(std::vector<struct replay_event> &events){
+        std::stable_sort(events.begin(), events.end(), [](const struct replay_event &a, const struct replay_event &b){
+                return a.tsc < b.tsc;
+        });
+}
+
+#endif //_TOOLS_REPLAY_HPP
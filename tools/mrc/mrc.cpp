@@ -0,0 +1,304 @@
+/**
+ * mrc: LRU miss ratio curve of .replay traces in one pass.
+ *
+ * Every event is split into portions of 1 << (PAGE_SHIFT + order) bytes,
+ * the unit the pvt heaps track with PVT_HEAP_PG_ORDER = order. The stack
+ * distance of an access is the number of distinct portions touched since
+ * the previous access to the same portion, counted with a Fenwick tree
+ * over the access sequence (Mattson et al.). An LRU cache of C portions
+ * hits exactly the accesses with a distance below C, so one pass gives
+ * the hit ratio of every cache size.
+ *
+ * mrc [-o order|first-last] [-P] [-j N] [-s N] [-r] trace.replay ...
+ *      -o      portion orders, default PVT_HEAP_PG_ORDER
+ *      -P      all orders 0-10
+ *      -j N    orders computed in parallel, default nr of cpus
+ *      -s N    cache sizes per doubling in the csv, default 8
+ *      -r      reads only, skip WRITE_EVENTs
+ *
+ * The curve goes to stdout as csv:
+ *   order,unit_bytes,cache_units,cache_bytes,hit_ratio,miss_ratio
+ * and the cache size needed for 50/80/90/95/99% hits per order to stderr.
+ *
+ * Build: make
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common/replay.hpp"
+#include "utils/util.hpp"
+
+#define MAX_ORDER 10
+
+/*unit keys are <file idx, unit nr>*/
+#define UNIT_NR_BITS 44
+#define UNIT_KEY(file, unit) (((uint64_t)(file) << UNIT_NR_BITS) | (unit))
+
+struct event {
+        uint32_t file;
+        off_t offset;
+        size_t size;
+};
+
+struct curve {
+        int order;
+        unsigned long unit_bytes;
+        unsigned long accesses;
+        unsigned long cold;                     /*first accesses, a miss at any size*/
+        std::vector<unsigned long> hits;        /*hits[c]: hits with a cache of c units*/
+};
+
+static std::vector<struct event> events;
+
+/*Fenwick tree over access positions, 1 marks the latest access of a unit*/
+struct fenwick {
+        std::vector<int32_t> tree;
+
+        explicit fenwick(size_t n) : tree(n + 1, 0) {}
+
+        void add(size_t pos, int32_t val){
+                for(pos++; pos < tree.size(); pos += pos & -pos){
+                        tree[pos] += val;
+                }
+        }
+
+        /*sum of [0, pos)*/
+        long prefix(size_t pos) const {
+                long sum = 0;
+
+                for(; pos > 0; pos -= pos & -pos){
+                        sum += tree[pos];
+                }
+                return sum;
+        }
+};
+
+static void compute_curve(struct curve *c){
+        std::unordered_map<uint64_t, size_t> last_access;
+        std::vector<unsigned long> dist_hist;
+        size_t nr_accesses = 0, pos = 0;
+        unsigned long sum = 0;
+
+        c->unit_bytes = 1UL << (PAGE_SHIFT + c->order);
+        for(auto &ev : events){
+                nr_accesses += (ev.offset + ev.size - 1) / c->unit_bytes - ev.offset / c->unit_bytes + 1;
+        }
+
+        struct fenwick marks(nr_accesses);
+        last_access.reserve(nr_accesses / 4);
+
+        for(auto &ev : events){
+                uint64_t last = (ev.offset + ev.size - 1) / c->unit_bytes;
+
+                for(uint64_t u = ev.offset / c->unit_bytes; u <= last; u++, pos++){
+                        auto ins = last_access.insert(std::make_pair(UNIT_KEY(ev.file, u), pos));
+
+                        if(ins.second){
+                                c->cold++;
+                        }else{
+                                size_t prev = ins.first->second;
+                                size_t dist = marks.prefix(pos) - marks.prefix(prev + 1);
+
+                                if(dist >= dist_hist.size()){
+                                        dist_hist.resize(dist + 1, 0);
+                                }
+                                dist_hist[dist]++;
+                                marks.add(prev, -1);
+                                ins.first->second = pos;
+                        }
+                        marks.add(pos, 1);
+                }
+        }
+        c->accesses = nr_accesses;
+
+        /*a cache of n units hits every reuse with distance < n*/
+        c->hits.resize(dist_hist.size() + 1, 0);
+        for(size_t n = 1; n < c->hits.size(); n++){
+                sum += dist_hist[n - 1];
+                c->hits[n] = sum;
+        }
+}
+
+static double hit_ratio(const struct curve *c, size_t units){
+        if(!c->accesses){
+                return 0.0;
+        }
+        if(units >= c->hits.size()){
+                units = c->hits.size() - 1;
+        }
+        return (double)c->hits[units] / c->accesses;
+}
+
+static void print_csv(const struct curve *c, int steps){
+        size_t max_units = c->hits.size() - 1, prev = 0, units;
+
+        for(int i = 0; ; i++){
+                units = (size_t)std::llround(std::pow(2.0, (double)i / steps));
+                if(units == prev){
+                        continue;
+                }
+                if(units > max_units){
+                        units = max_units;
+                }
+                printf("%d,%lu,%zu,%lu,%.6f,%.6f\n", c->order, c->unit_bytes, units, units * c->unit_bytes,
+                                hit_ratio(c, units), 1.0 - hit_ratio(c, units));
+                if(units == max_units){
+                        break;
+                }
+                prev = units;
+        }
+}
+
+static void print_summary(const struct curve *c){
+        static const double targets[] = {0.5, 0.8, 0.9, 0.95, 0.99};
+        size_t max_units = c->hits.size() - 1;
+
+        fprintf(stderr, "order %2d (%7lu KB): %lu accesses, %lu units (%lu MB) seen, max hit %.2f%%,",
+                        c->order, c->unit_bytes / KB, c->accesses, c->cold, c->cold * c->unit_bytes / (MB),
+                        100.0 * hit_ratio(c, max_units));
+
+        for(double t : targets){
+                size_t lo = 0, hi = max_units;
+
+                if(hit_ratio(c, max_units) < t){
+                        fprintf(stderr, " %.0f%%: -", 100 * t);
+                        continue;
+                }
+                /*smallest cache reaching t, hits[] is non decreasing*/
+                while(lo < hi){
+                        size_t mid = (lo + hi) / 2;
+
+                        if(hit_ratio(c, mid) >= t){
+                                hi = mid;
+                        }else{
+                                lo = mid + 1;
+                        }
+                }
+                fprintf(stderr, " %.0f%%: %lu MB", 100 * t, (lo * c->unit_bytes + (MB) - 1) / (MB));
+        }
+        fputc('\n', stderr);
+}
+
+static int parse_orders(const char *str, int *first, int *last){
+        char *end;
+
+        *first = strtol(str, &end, 10);
+        *last = *first;
+        if(*end == '-'){
+                *last = strtol(end + 1, &end, 10);
+        }
+        return *end || *first < 0 || *last > MAX_ORDER || *first > *last;
+}
+
+static void usage(const char *prog){
+        fprintf(stderr, "usage: %s [-o order|first-last] [-P] [-j N] [-s N] [-r] trace.replay ...\n", prog);
+}
+
+int main(int argc, char **argv){
+        std::vector<struct replay_event> replay;
+        std::map<std::pair<ino_t, dev_t>, uint32_t> file_idx;
+        std::vector<struct curve> curves;
+        std::vector<std::thread> workers;
+        std::atomic<size_t> next(0);
+        int first = PVT_HEAP_PG_ORDER, last = PVT_HEAP_PG_ORDER;
+        int nr_jobs = sysconf(_SC_NPROCESSORS_ONLN), steps = 8;
+        bool reads_only = false;
+        int opt;
+
+        while((opt = getopt(argc, argv, "o:Pj:s:rh")) != -1){
+                switch(opt){
+                case 'o':
+                        if(parse_orders(optarg, &first, &last)){
+                                fprintf(stderr, "orders must be within 0-%d\n", MAX_ORDER);
+                                return 1;
+                        }
+                        break;
+                case 'P':
+                        first = 0;
+                        last = MAX_ORDER;
+                        break;
+                case 'j':
+                        nr_jobs = atoi(optarg);
+                        break;
+                case 's':
+                        steps = atoi(optarg);
+                        break;
+                case 'r':
+                        reads_only = true;
+                        break;
+                default:
+                        usage(argv[0]);
+                        return opt == 'h' ? 0 : 1;
+                }
+        }
+        if(optind == argc || nr_jobs < 1 || steps < 1){
+                usage(argv[0]);
+                return 1;
+        }
+
+        for(int i = optind; i < argc; i++){
+                if(load_replay(argv[i], reads_only, replay)){
+                        return 1;
+                }
+        }
+        if(replay.empty()){
+                fprintf(stderr, "no events\n");
+                return 1;
+        }
+        sort_replay(replay);
+
+        for(auto &r : replay){
+                auto key = std::make_pair(r.ino, r.dev_id);
+                auto it = file_idx.find(key);
+                struct event ev;
+
+                if(it == file_idx.end()){
+                        it = file_idx.insert(std::make_pair(key, (uint32_t)file_idx.size())).first;
+                }
+                ev.file = it->second;
+                ev.offset = r.offset;
+                ev.size = r.size;
+                events.push_back(ev);
+        }
+        replay.clear();
+        replay.shrink_to_fit();
+
+        curves.resize(last - first + 1);
+        for(int o = first; o <= last; o++){
+                curves[o - first].order = o;
+        }
+
+        /*each order is an independent pass over the same events*/
+        for(int i = 0; i < nr_jobs && i < (int)curves.size(); i++){
+                workers.emplace_back([&curves, &next](){
+                        size_t idx;
+
+                        while((idx = next.fetch_add(1)) < curves.size()){
+                                compute_curve(&curves[idx]);
+                        }
+                });
+        }
+        for(auto &w : workers){
+                w.join();
+        }
+
+        printf("order,unit_bytes,cache_units,cache_bytes,hit_ratio,miss_ratio\n");
+        for(auto &c : curves){
+                print_csv(&c, steps);
+        }
+        fprintf(stderr, "%zu events, %zu files; cache size for a hit ratio:\n", events.size(), file_idx.size());
+        for(auto &c : curves){
+                print_summary(&c);
+        }
+        return 0;
+}
@@ -0,0 +1,446 @@
+/**
+ * speedyio_top: live view of the stats SpeedyIO publishes in
+ * /dev/shm/speedyio.<pid> (see src/utils/stats_shm/stats_shm.hpp).
+ *
+ * speedyio_top [-p pid] [-i interval_ms] [-n iterations]
+ *      refreshes every interval_ms (default 1000). Counters are shown with
+ *      their rate/s, histograms with the count, rate/s and p50/p90/p99/p999
+ *      of the last interval. Percentiles are upper bounds of pow2 bins.
+ *      Without -p every live SpeedyIO process is shown. The estimated
+ *      miss ratio curve (-DENABLE_SHARDS_MRC) is shown as the LRU hit
+ *      ratio per cache size since the process started.
+ *
+ * speedyio_top --prometheus [-p pid]
+ *      prints every segment once in the prometheus text format, for
+ *      node_exporter's textfile collector or a scrape wrapper.
+ *      "resident_portions.<class>" becomes resident_portions{class="<class>"}.
+ *
+ * speedyio_top --gc
+ *      removes segments left behind by processes that died without
+ *      running SpeedyIO's destructor (kill -9, _exit). A SpeedyIO process
+ *      also does this when it starts.
+ *
+ * Build: make
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "utils/stats_shm/stats_shm.hpp"
+#include "utils/shards/shards.hpp"
+
+#define SNAPSHOT_RETRIES 1000
+
+struct segment_view {
+        int pid;
+        const struct stats_segment *seg;        /*mapped read only*/
+        struct stats_segment *prev;             /*last snapshot*/
+        struct stats_segment *cur;
+        bool have_prev;
+};
+
+static bool pid_alive(int pid){
+        return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+/*pids of every /dev/shm/speedyio.<pid>*/
+static std::vector<int> list_segment_pids(){
+        std::vector<int> pids;
+        struct dirent *ent;
+        DIR *dir;
+
+        dir = opendir(STATS_SHM_DIR);
+        if(!dir){
+                return pids;
+        }
+        while((ent = readdir(dir))){
+                char *end;
+                long pid;
+
+                if(strncmp(ent->d_name, STATS_SHM_PREFIX, strlen(STATS_SHM_PREFIX))){
+                        continue;
+                }
+                pid = strtol(ent->d_name + strlen(STATS_SHM_PREFIX), &end, 10);
+                if(*end || pid <= 0){
+                        continue;
+                }
+                pids.push_back(pid);
+        }
+        closedir(dir);
+        return pids;
+}
+
+static const struct stats_segment *map_segment(int pid){
+        char name[64];
+        struct stat st;
+        void *addr = MAP_FAILED;
+        const struct stats_segment *seg;
+        int fd;
+
+        snprintf(name, sizeof(name), STATS_SHM_NAME_FMT, pid);
+        fd = shm_open(name, O_RDONLY, 0);
+        if(fd < 0){
+                return nullptr;
+        }
+        if(fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(struct stats_segment)){
+                addr = mmap(NULL, sizeof(struct stats_segment), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if(addr == MAP_FAILED){
+                return nullptr;
+        }
+
+        seg = (const struct stats_segment *)addr;
+        if(seg->magic != STATS_SHM_MAGIC || seg->version != STATS_SHM_VERSION
+                        || seg->size != sizeof(struct stats_segment)){
+                fprintf(stderr, "speedyio.%d: unknown segment layout (version %u), skipping\n", pid,
+                                seg->magic == STATS_SHM_MAGIC ? seg->version : 0);
+                munmap(addr, sizeof(struct stats_segment));
+                return nullptr;
+        }
+        return seg;
+}
+
+/**
+ * Seqlock read of seg into out.
+ * Returns false if the publisher never let go, eg. it died mid copy.
+ */
+static bool snapshot(const struct stats_segment *seg, struct stats_segment *out){
+        uint64_t begin, end;
+
+        for(int i = 0; i < SNAPSHOT_RETRIES; i++){
+                begin = seg->seq.load(std::memory_order_acquire);
+                if(begin & 1){
+                        usleep(100);
+                        continue;
+                }
+                memcpy((void *)out, (const void *)seg, sizeof(*out));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                end = seg->seq.load(std::memory_order_relaxed);
+                if(begin == end){
+                        return true;
+                }
+        }
+        return false;
+}
+
+static uint64_t hist_total(const uint64_t *bins){
+        uint64_t total = 0;
+
+        for(int i = 0; i < NR_POW2_LATENCY_BINS; i++){
+                total += bins[i];
+        }
+        return total;
+}
+
+/*upper bound (us) of the bin holding the q-th quantile*/
+static uint64_t hist_quantile(const uint64_t *bins, uint64_t total, double q){
+        uint64_t want = (uint64_t)(q * total + 0.999999);
+        uint64_t seen = 0;
+
+        for(int i = 0; i < NR_POW2_LATENCY_BINS; i++){
+                seen += bins[i];
+                if(seen >= want && seen){
+                        return 1ULL << i;
+                }
+        }
+        return 1ULL << (NR_POW2_LATENCY_BINS - 1);
+}
+
+static const struct stats_counter *find_counter(const struct stats_segment *seg, const char *name){
+        for(uint32_t i = 0; i < seg->nr_counters && i < MAX_STATS_COUNTERS; i++){
+                if(!strncmp(seg->counters[i].name, name, STATS_NAME_LEN)){
+                        return &seg->counters[i];
+                }
+        }
+        return nullptr;
+}
+
+/*cumulative hit ratio per cache size of the SHARDS_MRC_HIST_NAME histogram*/
+static void print_mrc(const struct stats_segment *seg, const struct stats_histogram *h){
+        const struct stats_counter *accesses = find_counter(seg, "mrc_accesses");
+        unsigned long portion_kb = (1UL << (PAGE_SHIFT + PVT_HEAP_PG_ORDER)) / 1024;
+        uint64_t hits = 0;
+        int last_bin = -1;
+
+        if(!accesses || !accesses->value){
+                return;
+        }
+        for(int i = 0; i < NR_POW2_LATENCY_BINS; i++){
+                if(h->bins[i]){
+                        last_bin = i;
+                }
+        }
+        printf("  mrc, LRU hit%% by cache size:");
+        for(int i = 0; i <= last_bin; i++){
+                hits += h->bins[i];
+                if((portion_kb << i) >= 1024 * 1024){
+                        printf(" %luG:%.1f", (portion_kb << i) >> 20, 100.0 * hits / accesses->value);
+                }else{
+                        printf(" %luM:%.1f", (portion_kb << i) >> 10, 100.0 * hits / accesses->value);
+                }
+        }
+        printf("\n");
+}
+
+static void print_view(struct segment_view *v){
+        const struct stats_segment *cur = v->cur;
+        const struct stats_segment *prev = v->prev;
+        double secs = 0;
+
+        if(v->have_prev && cur->publish_ns > prev->publish_ns){
+                secs = (cur->publish_ns - prev->publish_ns) / 1e9;
+        }
+
+        printf("pid %d  up %.0fs\n", v->pid, (cur->publish_ns - cur->start_ns) / 1e9);
+        printf("  %-36s %16s %12s\n", "counter", "value", "rate/s");
+        for(uint32_t i = 0; i < cur->nr_counters && i < MAX_STATS_COUNTERS; i++){
+                const struct stats_counter *c = &cur->counters[i];
+
+                printf("  %-36.*s %16lu", STATS_NAME_LEN, c->name, (unsigned long)c->value);
+                if(c->kind == STATS_COUNTER && secs > 0){
+                        printf(" %12.1f", (double)(c->value - prev->counters[i].value) / secs);
+                }
+                printf("\n");
+        }
+
+        printf("  %-36s %12s %12s %8s %8s %8s %8s\n", "histogram (us)", "count", "rate/s", "p50", "p90", "p99", "p999");
+        for(uint32_t i = 0; i < cur->nr_histograms && i < MAX_STATS_HISTOGRAMS; i++){
+                uint64_t delta[NR_POW2_LATENCY_BINS];
+                uint64_t total;
+
+                if(!strncmp(cur->histograms[i].name, SHARDS_MRC_HIST_NAME, STATS_NAME_LEN)){
+                        continue;
+                }
+
+                for(int b = 0; b < NR_POW2_LATENCY_BINS; b++){
+                        delta[b] = cur->histograms[i].bins[b] - (v->have_prev ? prev->histograms[i].bins[b] : 0);
+                }
+                total = hist_total(delta);
+
+                printf("  %-36.*s %12lu %12.1f", STATS_NAME_LEN, cur->histograms[i].name,
+                                (unsigned long)total, secs > 0 ? total / secs : 0.0);
+                if(total){
+                        printf(" %8lu %8lu %8lu %8lu",
+                                        (unsigned long)hist_quantile(delta, total, 0.50),
+                                        (unsigned long)hist_quantile(delta, total, 0.90),
+                                        (unsigned long)hist_quantile(delta, total, 0.99),
+                                        (unsigned long)hist_quantile(delta, total, 0.999));
+                }
+                printf("\n");
+        }
+
+        for(uint32_t i = 0; i < cur->nr_histograms && i < MAX_STATS_HISTOGRAMS; i++){
+                if(!strncmp(cur->histograms[i].name, SHARDS_MRC_HIST_NAME, STATS_NAME_LEN)){
+                        print_mrc(cur, &cur->histograms[i]);
+                }
+        }
+        printf("\n");
+}
+
+/*"a.b" -> family "a", class "b"*/
+static std::string metric_family(const char *name, std::string *cls){
+        std::string s(name, strnlen(name, STATS_NAME_LEN));
+        size_t dot = s.find('.');
+
+        cls->clear();
+        if(dot != std::string::npos){
+                *cls = s.substr(dot + 1);
+                s.resize(dot);
+        }
+        return "speedyio_" + s;
+}
+
+/*families are printed together, with every pid's samples under one TYPE line*/
+static void print_prometheus(std::vector<struct segment_view> &views){
+        std::set<std::string> done;
+        std::string cls, other_cls;
+
+        for(auto &v : views){
+                for(uint32_t i = 0; i < v.cur->nr_counters && i < MAX_STATS_COUNTERS; i++){
+                        std::string family = metric_family(v.cur->counters[i].name, &cls);
+
+                        if(!done.insert(family).second){
+                                continue;
+                        }
+                        printf("# TYPE %s %s\n", family.c_str(), v.cur->counters[i].kind == STATS_COUNTER ? "counter" : "gauge");
+                        for(auto &w : views){
+                                for(uint32_t j = 0; j < w.cur->nr_counters && j < MAX_STATS_COUNTERS; j++){
+                                        if(metric_family(w.cur->counters[j].name, &other_cls) != family){
+                                                continue;
+                                        }
+                                        printf("%s{pid=\"%d\"", family.c_str(), w.pid);
+                                        if(!other_cls.empty()){
+                                                printf(",class=\"%s\"", other_cls.c_str());
+                                        }
+                                        printf("} %lu\n", (unsigned long)w.cur->counters[j].value);
+                                }
+                        }
+                }
+        }
+
+        for(auto &v : views){
+                for(uint32_t i = 0; i < v.cur->nr_histograms && i < MAX_STATS_HISTOGRAMS; i++){
+                        std::string family = metric_family(v.cur->histograms[i].name, &cls);
+
+                        if(!done.insert(family).second){
+                                continue;
+                        }
+                        printf("# TYPE %s histogram\n", family.c_str());
+                        for(auto &w : views){
+                                for(uint32_t j = 0; j < w.cur->nr_histograms && j < MAX_STATS_HISTOGRAMS; j++){
+                                        uint64_t cum = 0;
+
+                                        if(metric_family(w.cur->histograms[j].name, &other_cls) != family){
+                                                continue;
+                                        }
+                                        for(int b = 0; b < NR_POW2_LATENCY_BINS; b++){
+                                                cum += w.cur->histograms[j].bins[b];
+                                                printf("%s_bucket{pid=\"%d\",le=\"%llu\"} %lu\n", family.c_str(),
+                                                                w.pid, 1ULL << b, (unsigned long)cum);
+                                        }
+                                        printf("%s_bucket{pid=\"%d\",le=\"+Inf\"} %lu\n", family.c_str(), w.pid, (unsigned long)cum);
+                                        printf("%s_count{pid=\"%d\"} %lu\n", family.c_str(), w.pid, (unsigned long)cum);
+                                }
+                        }
+                }
+        }
+}
+
+static int gc_segments(){
+        char name[64];
+        int nr_removed = 0;
+
+        for(int pid : list_segment_pids()){
+                if(pid_alive(pid)){
+                        continue;
+                }
+                snprintf(name, sizeof(name), STATS_SHM_NAME_FMT, pid);
+                if(shm_unlink(name) == 0){
+                        printf("removed %s%s\n", STATS_SHM_DIR, name);
+                        nr_removed++;
+                }else{
+                        fprintf(stderr, "unable to remove %s%s: %s\n", STATS_SHM_DIR, name, strerror(errno));
+                }
+        }
+        return nr_removed;
+}
+
+static void usage(const char *prog){
+        fprintf(stderr, "usage: %s [-p pid] [-i interval_ms] [-n iterations] [--prometheus] [--gc]\n", prog);
+}
+
+int main(int argc, char **argv){
+        static struct option long_opts[] = {
+                {"pid", required_argument, NULL, 'p'},
+                {"interval", required_argument, NULL, 'i'},
+                {"iterations", required_argument, NULL, 'n'},
+                {"prometheus", no_argument, NULL, 'P'},
+                {"gc", no_argument, NULL, 'g'},
+                {"help", no_argument, NULL, 'h'},
+                {NULL, 0, NULL, 0},
+        };
+        std::vector<struct segment_view> views;
+        std::vector<int> pids;
+        long interval_ms = 1000;
+        long iterations = -1;
+        bool prometheus = false;
+        bool tty = isatty(STDOUT_FILENO);
+        int opt;
+
+        while((opt = getopt_long(argc, argv, "p:i:n:h", long_opts, NULL)) != -1){
+                switch(opt){
+                case 'p':
+                        pids.push_back(atoi(optarg));
+                        break;
+                case 'i':
+                        interval_ms = atol(optarg);
+                        break;
+                case 'n':
+                        iterations = atol(optarg);
+                        break;
+                case 'P':
+                        prometheus = true;
+                        break;
+                case 'g':
+                        gc_segments();
+                        return 0;
+                default:
+                        usage(argv[0]);
+                        return opt == 'h' ? 0 : 1;
+                }
+        }
+        if(interval_ms <= 0){
+                usage(argv[0]);
+                return 1;
+        }
+
+        if(pids.empty()){
+                for(int pid : list_segment_pids()){
+                        if(pid_alive(pid)){
+                                pids.push_back(pid);
+                        }else{
+                                fprintf(stderr, "speedyio.%d: process is gone, --gc removes its segment\n", pid);
+                        }
+                }
+        }
+
+        for(int pid : pids){
+                struct segment_view v;
+
+                v.pid = pid;
+                v.seg = map_segment(pid);
+                if(!v.seg){
+                        continue;
+                }
+                v.prev = new stats_segment();
+                v.cur = new stats_segment();
+                v.have_prev = false;
+                views.push_back(v);
+        }
+        if(views.empty()){
+                fprintf(stderr, "no SpeedyIO stats segments found in %s\n", STATS_SHM_DIR);
+                return 1;
+        }
+
+        for(long iter = 0; iterations < 0 || iter < iterations; iter++){
+                if(iter){
+                        usleep(interval_ms * 1000);
+                }
+                if(tty && !prometheus){
+                        printf("\033[H\033[2J");
+                }
+
+                for(auto &v : views){
+                        std::swap(v.prev, v.cur);
+                        if(!snapshot(v.seg, v.cur)){
+                                fprintf(stderr, "speedyio.%d: publisher stuck mid update\n", v.pid);
+                                std::swap(v.prev, v.cur);
+                                continue;
+                        }
+                        if(!prometheus){
+                                print_view(&v);
+                        }
+                        v.have_prev = true;
+                }
+
+                if(prometheus){
+                        print_prometheus(views);
+                        break;
+                }
+                fflush(stdout);
+        }
+        return 0;
+}
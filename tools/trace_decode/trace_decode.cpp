@@ -0,0 +1,194 @@
+/**
+ * trace_decode: turns SpeedyIO binary I/O traces
+ * (speedyio_trace_<pid>_<time>_<n>.bin, see src/utils/trace_ring) into the
+ * .replay CSV written with PRINT_READ_EVENTS/PRINT_WRITE_EVENTS:
+ *
+ *   READ_EVENT,<pid>,<tid>,<ino>,<tsc>,<offset>,<size>
+ *   WRITE_EVENT,<pid>,<tid>,<ino>,<tsc>,<offset>,<size>
+ *
+ * trace_decode [-s] [-x] [-o dir] trace.bin ...
+ *      -s      sort by tsc; blocks hold one thread each, so without it
+ *              records are only in order per thread
+ *      -x      append ,<dev>,<latency_ns> to every line
+ *      -o dir  write <dir>/read_events_pid_<pid>_tid_<tid>.replay and
+ *              write_events_... per thread, like PRINT_*_EVENTS did,
+ *              instead of everything to stdout
+ *
+ * Build: make
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "utils/trace_ring/trace_format.hpp"
+
+struct decode_opts {
+        bool sort;
+        bool extended;
+        const char *out_dir;
+};
+
+/*per {pid, tid, op} output files with -o*/
+static std::map<std::tuple<uint32_t, uint32_t, int>, FILE *> out_files;
+
+static FILE *out_file(const struct decode_opts *opts, uint32_t pid, const struct trace_record *r){
+        std::tuple<uint32_t, uint32_t, int> key(pid, r->tid, r->op);
+        char path[4096];
+        FILE *fp;
+
+        if(!opts->out_dir){
+                return stdout;
+        }
+
+        auto it = out_files.find(key);
+        if(it != out_files.end()){
+                return it->second;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s_events_pid_%u_tid_%u.replay", opts->out_dir,
+                        r->op == TRACE_OP_WRITE ? "write" : "read", pid, r->tid);
+        fp = fopen(path, "a");
+        if(!fp){
+                fprintf(stderr, "unable to open %s: %s\n", path, strerror(errno));
+                exit(1);
+        }
+        out_files[key] = fp;
+        return fp;
+}
+
+static void print_record(const struct decode_opts *opts, uint32_t pid, const struct trace_record *r){
+        FILE *fp = out_file(opts, pid, r);
+
+        fprintf(fp, "%s,%u,%u,%lu,%lu,%ld,%u", r->op == TRACE_OP_WRITE ? "WRITE_EVENT" : "READ_EVENT",
+                        pid, r->tid, (unsigned long)r->ino, (unsigned long)r->tsc, (long)r->offset, r->size);
+        if(opts->extended){
+                fprintf(fp, ",%lu,%u", (unsigned long)r->dev, r->latency_ns);
+        }
+        fputc('\n', fp);
+}
+
+/*Returns 0 on success, 1 if the file is not a trace or is corrupt*/
+static int decode_file(const char *path, const struct decode_opts *opts){
+        struct trace_file_header hdr;
+        struct trace_block_header block;
+        std::vector<struct trace_record> records, all;
+        std::vector<uint8_t> payload;
+        unsigned long nr_records = 0, nr_dropped = 0, nr_blocks = 0;
+        int ret = 1;
+        FILE *fp;
+
+        fp = fopen(path, "rb");
+        if(!fp){
+                fprintf(stderr, "%s: %s\n", path, strerror(errno));
+                return 1;
+        }
+
+        if(fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != TRACE_FILE_MAGIC){
+                fprintf(stderr, "%s: not a SpeedyIO trace\n", path);
+                goto exit_decode_file;
+        }
+        if(hdr.version != TRACE_FILE_VERSION || hdr.record_size != sizeof(struct trace_record)){
+                fprintf(stderr, "%s: unsupported trace version %u\n", path, hdr.version);
+                goto exit_decode_file;
+        }
+
+        while(fread(&block, sizeof(block), 1, fp) == 1){
+                payload.resize(block.nr_bytes);
+                records.resize(block.nr_records);
+
+                if(block.nr_bytes && fread(payload.data(), block.nr_bytes, 1, fp) != 1){
+                        /*the process died mid write*/
+                        fprintf(stderr, "%s: truncated block %lu, stopping\n", path, nr_blocks);
+                        break;
+                }
+
+                if(hdr.flags & TRACE_F_COMPRESSED){
+                        if(!trace_decode_block(payload.data(), payload.size(), records.data(), records.size())){
+                                fprintf(stderr, "%s: corrupt block %lu\n", path, nr_blocks);
+                                goto exit_decode_file;
+                        }
+                }else{
+                        if(block.nr_bytes != block.nr_records * sizeof(struct trace_record)){
+                                fprintf(stderr, "%s: corrupt block %lu\n", path, nr_blocks);
+                                goto exit_decode_file;
+                        }
+                        memcpy(records.data(), payload.data(), block.nr_bytes);
+                }
+
+                if(opts->sort){
+                        all.insert(all.end(), records.begin(), records.end());
+                }else{
+                        for(auto &r : records){
+                                print_record(opts, hdr.pid, &r);
+                        }
+                }
+                nr_records += block.nr_records;
+                nr_dropped += block.nr_dropped;
+                nr_blocks++;
+        }
+
+        if(opts->sort){
+                std::stable_sort(all.begin(), all.end(), [](const struct trace_record &a, const struct trace_record &b){
+                        return a.tsc < b.tsc;
+                });
+                for(auto &r : all){
+                        print_record(opts, hdr.pid, &r);
+                }
+        }
+
+        fprintf(stderr, "%s: pid %u, %lu records in %lu blocks, %lu dropped, %s, tsc_hz %lu\n", path, hdr.pid,
+                        nr_records, nr_blocks, nr_dropped, hdr.flags & TRACE_F_COMPRESSED ? "compressed" : "raw",
+                        (unsigned long)hdr.tsc_hz);
+        ret = 0;
+
+exit_decode_file:
+        fclose(fp);
+        return ret;
+}
+
+static void usage(const char *prog){
+        fprintf(stderr, "usage: %s [-s] [-x] [-o dir] trace.bin ...\n", prog);
+}
+
+int main(int argc, char **argv){
+        struct decode_opts opts = {false, false, nullptr};
+        int opt, ret = 0;
+
+        while((opt = getopt(argc, argv, "sxo:h")) != -1){
+                switch(opt){
+                case 's':
+                        opts.sort = true;
+                        break;
+                case 'x':
+                        opts.extended = true;
+                        break;
+                case 'o':
+                        opts.out_dir = optarg;
+                        break;
+                default:
+                        usage(argv[0]);
+                        return opt == 'h' ? 0 : 1;
+                }
+        }
+        if(optind == argc){
+                usage(argv[0]);
+                return 1;
+        }
+
+        for(int i = optind; i < argc; i++){
+                ret |= decode_file(argv[i], &opts);
+        }
+
+        for(auto &it : out_files){
+                fclose(it.second);
+        }
+        return ret;
+}